@@ -8,22 +8,235 @@
 /// 2015-08-14 KNN
 /// 2015-08-16 K-means
 /// 2020-07-19 DBSCAN
+/// 2026-10-19 N-dimensional K-means
+/// 2026-10-19 Hamerly and Elkan K-means
+/// 2026-10-19 Mini-batch K-means
+/// 2026-10-19 Grid index DBSCAN
+/// 2026-10-19 K-d tree nearest neighbors
+/// 2026-10-19 HNSW approximate nearest neighbors
+/// 2026-10-19 Product quantization
+/// 2026-10-19 Hierarchical clustering
+/// 2026-10-19 Aligned feature matrix, feature views and data frames
+/// 2026-10-19 Gaussian mixture models
 ///
 
 #ifndef ALGORITHM_DATA_MINING_DATA_MINING_ALGORITHMS_HPP_
 #define ALGORITHM_DATA_MINING_DATA_MINING_ALGORITHMS_HPP_
 
+#include <cstdint>
+#include <memory>
+#include <new>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "algo_geometry.hpp"
 
 namespace algo::data_mining {
 
+// ///////////////////////////////////////////
+// Feature matrix
+// ///////////////////////////////////////////
+
+/// \brief Allocates memory aligned to Alignment bytes, for containers that are read with vector loads.
+template<typename T, size_t Alignment>
+struct AlignedAllocator {
+  using value_type = T;
+
+  template<typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+
+  template<typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>& /*other*/)
+  {}
+
+  T* allocate(size_t n)
+  { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{Alignment})); }
+
+  void deallocate(T* p, size_t /*n*/)
+  { ::operator delete(p, std::align_val_t{Alignment}); }
+
+  template<typename U>
+  bool operator==(const AlignedAllocator<U, Alignment>& /*other*/) const
+  { return true; }
+
+  template<typename U>
+  bool operator!=(const AlignedAllocator<U, Alignment>& /*other*/) const
+  { return false; }
+};
+
+class FeatureView;
+class DataFrame;
+
+/// \brief A matrix of n-dimensional data points, one row per point and one column per feature. The values are stored
+/// column by column (structure of arrays), so a feature of consecutive points is contiguous and can be processed with
+/// vector instructions. Each column starts on a 64-byte boundary, a cache line, the columns are padded with zeros.
+class FeatureMatrix {
+ public:
+  static constexpr size_t kAlignment{64};
+
+  FeatureMatrix() = default;
+
+  /// \brief A matrix of zeros.
+  FeatureMatrix(size_t rows, size_t cols)
+      : rows_{rows}, cols_{cols}, stride_{(rows + kPad - 1) / kPad * kPad}, data_(stride_ * cols)
+  {}
+
+  /// \brief A matrix with two columns, x and y.
+  explicit FeatureMatrix(const geometry::Points& points);
+
+  /// \brief A matrix from rows that all have the same length, empty if they do not.
+  explicit FeatureMatrix(const std::vector<std::vector<double>>& rows);
+
+  /// \brief Copies the values of a view.
+  explicit FeatureMatrix(const FeatureView& view);
+
+  size_t Rows() const
+  { return rows_; }
+
+  size_t Cols() const
+  { return cols_; }
+
+  /// \brief The distance from the start of a column to the start of the next one, Rows() rounded up to 64 bytes.
+  size_t Stride() const
+  { return stride_; }
+
+  /// \brief The values of feature col, Rows() of them.
+  double* Column(size_t col)
+  { return data_.data() + col * stride_; }
+
+  const double* Column(size_t col) const
+  { return data_.data() + col * stride_; }
+
+  double& operator()(size_t row, size_t col)
+  { return data_[col * stride_ + row]; }
+
+  double operator()(size_t row, size_t col) const
+  { return data_[col * stride_ + row]; }
+
+  /// \brief Copies a row.
+  std::vector<double> Row(size_t row) const;
+
+  /// \brief A view of the rows begin to end, without copying.
+  FeatureView Slice(size_t begin, size_t end) const;
+
+ private:
+  static constexpr size_t kPad{kAlignment / sizeof(double)};
+
+  size_t rows_{0};
+  size_t cols_{0};
+  size_t stride_{0};
+  std::vector<double, AlignedAllocator<double, kAlignment>> data_;
+};
+
+/// \brief A view of column-major values that it does not own, such as a FeatureMatrix or a part of one. The data
+/// mining functions take their input as a view, so they accept a FeatureMatrix, a DataFrame or a slice of the rows or
+/// columns of one of them without a copy. The viewed values must outlive the view.
+class FeatureView {
+ public:
+  FeatureView() = default;
+
+  /// \param data The first value of the first column.
+  /// \param rows Number of rows.
+  /// \param cols Number of columns.
+  /// \param stride The distance from the start of a column to the start of the next one, at least rows.
+  FeatureView(const double* data, size_t rows, size_t cols, size_t stride)
+      : data_{data}, rows_{rows}, cols_{cols}, stride_{stride}
+  {}
+
+  /// \brief Views a whole matrix, implicit so that a FeatureMatrix can be passed where a view is taken.
+  FeatureView(const FeatureMatrix& matrix)
+      : data_{matrix.Column(0)}, rows_{matrix.Rows()}, cols_{matrix.Cols()}, stride_{matrix.Stride()}
+  {}
+
+  /// \brief Views the features of a frame, implicit like the one above.
+  FeatureView(const DataFrame& frame);
+
+  size_t Rows() const
+  { return rows_; }
+
+  size_t Cols() const
+  { return cols_; }
+
+  size_t Stride() const
+  { return stride_; }
+
+  const double* Column(size_t col) const
+  { return data_ + col * stride_; }
+
+  double operator()(size_t row, size_t col) const
+  { return data_[col * stride_ + row]; }
+
+  /// \brief Copies a row.
+  std::vector<double> Row(size_t row) const;
+
+  /// \brief The rows begin to end, end is clamped to Rows().
+  FeatureView Slice(size_t begin, size_t end) const;
+
+  /// \brief The columns begin to end, end is clamped to Cols().
+  FeatureView SliceColumns(size_t begin, size_t end) const;
+
+ private:
+  const double* data_{nullptr};
+  size_t rows_{0};
+  size_t cols_{0};
+  size_t stride_{0};
+};
+
 // ///////////////////////////////////////////
 // K-means
 // ///////////////////////////////////////////
 
+/// \brief How KMeans assigns the points. All give the same clusters up to ties and rounding, Hamerly and Elkan use the
+/// triangle inequality to skip distances that cannot change the assignment.
+enum class KMeansAlgorithm {
+  Lloyd,  ///< All n * k distances in every iteration.
+  Hamerly,///< Two bounds per point, best for few clusters or few features.
+  Elkan   ///< k + 1 bounds per point (n * k doubles of memory), best for many clusters.
+};
+
+/// \brief Settings for KMeans on a FeatureMatrix.
+struct KMeansOptions {
+  KMeansAlgorithm algorithm{KMeansAlgorithm::Lloyd};
+  size_t max_iterations{300};
+  /// Stop when the squared distances moved by the centroids add up to at most tolerance times the mean variance of
+  /// the features. 0 stops when no centroid moves.
+  double tolerance{1e-4};
+  uint64_t seed{0};  ///< Seed of the k-means++ initialization, the same seed gives the same clusters.
+  unsigned threads{0};///< Number of threads, 0 means one per hardware thread.
+};
+
+/// \brief The result of KMeans on a FeatureMatrix.
+struct KMeansResult {
+  FeatureMatrix centroids;     ///< One row per cluster.
+  std::vector<uint32_t> labels;///< The cluster of each point, the nearest centroid.
+  double inertia{0.0};         ///< The sum of the squared distances from the points to their centroids.
+  size_t iterations{0};
+  bool converged{false};       ///< False if max_iterations was reached first.
+  uint64_t distances{0};       ///< Point to centroid distances computed to assign the points.
+  uint64_t skipped_distances{0};///< Distances that Lloyd's algorithm computes and the bounds made unnecessary.
+};
+
+/// \brief Clusters n-dimensional points with K-means (Lloyd's algorithm). The centroids are initialized with
+/// k-means++, which picks each new centroid with a probability proportional to its squared distance to the nearest
+/// centroid picked so far. The points are assigned in parallel, with AVX2 computing the distances of 8 points at a
+/// time, and each thread sums its points per cluster before the sums are combined. A centroid that gets no points
+/// stays where it is. The Hamerly and Elkan variants keep bounds on the distances between the points and the
+/// centroids, and compute a distance only when the bounds cannot rule out a change of the nearest centroid.
+/// \param data The points, one per row.
+/// \param k Number of clusters.
+/// \param options Stop criteria, seed and threads.
+/// \return The clusters, empty if k is 0, k is greater than the number of points or the points have no features.
+/// \link <a href="https://en.wikipedia.org/wiki/K-means%2B%2B">K-means++, Wikipedia.</a>
+/// \link <a href="https://cdn.aaai.org/ICML/2003/ICML03-022.pdf">Elkan, Using the triangle inequality to accelerate
+/// k-means.</a>
+KMeansResult KMeans(const FeatureView& data, size_t k, const KMeansOptions& options = {});
+
+
 struct Centroid {
   geometry::Point p;
   double mean_x, mean_y;
@@ -33,7 +246,60 @@ struct Centroid {
 using Centroids = std::vector<Centroid>;
 using Clusters = std::vector<geometry::Points>;
 
-/// \brief Returns the clusters of K-means. Each cluster i in 1...i...k contains a set of points.
+/// \brief K-means for data that arrives in batches and does not fit in memory. Each batch is assigned to the nearest
+/// centroids, and each centroid moves to the mean of all points it has got so far, so the step size of a centroid is
+/// the number of its new points over its total count and decays as the count grows. With decay < 1 the old counts
+/// are multiplied by decay before each batch, so the centroids keep following data that changes over time.
+///
+/// The first 3k points are buffered and the initial centroids are picked from them with k-means++. After that the
+/// memory is the k centroids and counts, independent of the amount of data.
+/// \link <a href="https://dl.acm.org/doi/10.1145/1772690.1772862">Sculley, Web-scale k-means clustering.</a>
+class MiniBatchKMeans {
+ public:
+  /// \param k Number of clusters.
+  /// \param dims Number of features of the points.
+  /// \param decay Factor applied to the counts before each batch, 1 keeps all history.
+  /// \param seed Seed of the k-means++ initialization.
+  MiniBatchKMeans(size_t k, size_t dims, double decay = 1.0, uint64_t seed = 0);
+
+  /// \brief Updates the centroids with a batch of points. Batches with another number of features are ignored.
+  /// \param batch The points.
+  /// \param threads Number of threads for the assignment, 0 means one per hardware thread.
+  void PartialFit(const FeatureView& batch, unsigned threads = 0);
+
+  /// \brief Returns the nearest centroid of each point, empty if there are no centroids yet.
+  std::vector<uint32_t> Predict(const FeatureView& data, unsigned threads = 0) const;
+
+  /// \brief True when the centroids have been initialized.
+  bool Ready() const
+  { return !counts_.empty(); }
+
+  /// \brief The centroids, one row per cluster, empty until Ready.
+  FeatureMatrix Means() const;
+
+  /// \brief The (decayed) number of points of each centroid.
+  const std::vector<double>& Counts() const
+  { return counts_; }
+
+  /// \brief The centroids as Centroid, with p and mean_x, mean_y at the mean and size the rounded count. Empty unless
+  /// the points are two-dimensional.
+  Centroids ToCentroids() const;
+
+ private:
+  void Update(const FeatureView& batch, unsigned threads);
+
+  size_t k_;
+  size_t dims_;
+  double decay_;
+  uint64_t seed_;
+  std::vector<double> means_;  ///< Row by row.
+  std::vector<double> counts_;
+  std::vector<double> pending_;///< Buffered rows until there are enough for the initialization.
+};
+
+/// \brief Returns the clusters of K-means. Each cluster i in 1...i...k contains a set of points. Runs KMeans on a
+/// FeatureMatrix with the default options.
+/// \param points The points to cluster.
 /// \param k Number of clusters.
 /// \return Clusters. If k is greater than the points.size() it will return an empty object.
 /// \link <a href="https://en.wikipedia.org/wiki/K-means_clustering">K-means, Wikipedia.</a>
@@ -51,13 +317,345 @@ struct LabeledPoint {
 
 using LabeledPoints = std::vector<LabeledPoint>;
 
+/// \brief Labeled n-dimensional points: the features in a FeatureMatrix and an integer label per row, which indexes a
+/// dictionary of label names. A name is stored once, so a row takes 4 bytes for its label instead of a std::string.
+class DataFrame {
+ public:
+  DataFrame() = default;
+
+  /// \brief A frame of rows and cols zero features. Every row has code 0, the empty name, which is the first entry of
+  /// the dictionary.
+  DataFrame(size_t rows, size_t cols);
+
+  /// \brief A frame of the x and y of the points, the names get codes in the order they first appear.
+  explicit DataFrame(const LabeledPoints& points);
+
+  /// \brief A frame of given features and label names.
+  /// \note The frame is empty if there is not one name per row.
+  DataFrame(FeatureMatrix features, const std::vector<std::string>& names);
+
+  size_t Rows() const
+  { return features_.Rows(); }
+
+  size_t Cols() const
+  { return features_.Cols(); }
+
+  FeatureMatrix& Features()
+  { return features_; }
+
+  const FeatureMatrix& Features() const
+  { return features_; }
+
+  /// \brief The label code of each row.
+  const std::vector<uint32_t>& Labels() const
+  { return labels_; }
+
+  /// \brief The names of the codes.
+  const std::vector<std::string>& Dictionary() const
+  { return dictionary_; }
+
+  /// \brief The name of the label of a row.
+  const std::string& Label(size_t row) const
+  { return dictionary_[labels_[row]]; }
+
+  void SetLabel(size_t row, const std::string& name)
+  { labels_[row] = Code(name); }
+
+  /// \brief Returns the code of a name, and adds it to the dictionary if it is not there.
+  uint32_t Code(const std::string& name);
+
+  /// \brief A view of the features of the rows begin to end, their labels are Labels()[begin] to Labels()[end - 1].
+  FeatureView Slice(size_t begin, size_t end) const
+  { return features_.Slice(begin, end); }
+
+ private:
+  FeatureMatrix features_;
+  std::vector<uint32_t> labels_;
+  std::vector<std::string> dictionary_;
+  std::unordered_map<std::string, uint32_t> codes_;
+};
+
 /// \brief Returns clustered data based on the k neighbors in the labeled data. If an unlabeled point is nearest to four points
-/// A,B,B,B and k is set to 3 then the unlabeled will get B as label.
+/// A,B,B,B and k is set to 3 then the unlabeled will get B as label. A tie goes to the label that comes first
+/// alphabetically. It runs the version for a DataFrame below.
 /// \param unlabeled_data Data to label.
 /// \param labeled_data Data with known labels in a 2D-space.
 /// \return Labeled data based on the rules of KNN.
 /// \link <a href="https://en.wikipedia.org/wiki/K-nearest_neighbors_algorithm">KNN, Wikipedia.</a>
-LabeledPoints KNearestNeighbor(const geometry::Points& unlabeled_data, LabeledPoints& labeled_data, uint8_t k);
+LabeledPoints KNearestNeighbor(const geometry::Points& unlabeled_data, const LabeledPoints& labeled_data, uint8_t k);
+
+/// \brief KNN on n-dimensional points: each query gets the most common label among its k nearest labeled rows, a tie
+/// goes to the name that comes first alphabetically. The queries are split between threads.
+/// \param labeled The labeled rows.
+/// \param queries The points to label, with as many columns as labeled.
+/// \param k Number of neighbors, all labeled rows are used if there are fewer.
+/// \param threads Number of threads, 0 means one per hardware thread.
+/// \return The label code of each query, in the dictionary of labeled. Empty if k is 0, there are no labeled rows or
+/// the number of columns differ.
+std::vector<uint32_t> KNearestNeighbor(const DataFrame& labeled, const FeatureView& queries, size_t k,
+                                       unsigned threads = 0);
+
+/// \brief A neighbor found by a nearest neighbor search.
+struct NeighborHit {
+  uint32_t index; ///< The row of the point.
+  double distance;///< The Euclidean distance to the query.
+
+  bool operator==(const NeighborHit& other) const
+  { return index == other.index && distance == other.distance; }
+};
+
+/// \brief A k-d tree over n-dimensional points for exact nearest neighbor queries with the Euclidean distance. Each
+/// node splits its points at the median of the feature with the largest spread, down to leaves of at most leaf_size
+/// points. A query descends to the leaf of the query point first and visits another subtree only if it can hold a
+/// point closer than the k-th nearest found so far, which it keeps in a max-heap of size k. The points are copied in
+/// the order of the leaves, so a leaf is read contiguously.
+///
+/// The pruning works well up to about 10 to 20 dimensions, in more dimensions nearly all leaves get visited, see
+/// HnswIndex for approximate search in high dimensions.
+/// \link <a href="https://en.wikipedia.org/wiki/K-d_tree">K-d tree, Wikipedia.</a>
+class KdTree {
+ public:
+  /// \param data The points, one per row.
+  /// \param leaf_size The maximum number of points in a leaf.
+  explicit KdTree(const FeatureView& data, size_t leaf_size = 16);
+
+  /// \brief Returns the k nearest points to query, nearest first, and the lower row first at equal distance.
+  /// \param query Dims() values.
+  /// \param k Number of neighbors, all points if there are fewer.
+  std::vector<NeighborHit> Nearest(const double* query, size_t k) const;
+
+  /// \brief Nearest for each row of queries, the queries are split between threads.
+  /// \param threads Number of threads, 0 means one per hardware thread.
+  /// \return The neighbors of each query, empty if the queries have another number of features.
+  std::vector<std::vector<NeighborHit>> Nearest(const FeatureView& queries, size_t k, unsigned threads = 0) const;
+
+  size_t Size() const
+  { return index_.size(); }
+
+  size_t Dims() const
+  { return dims_; }
+
+ private:
+  struct Node {
+    uint32_t begin;///< First point, in the order of the tree.
+    uint32_t end;
+    uint32_t dim;  ///< The split feature, kLeaf for a leaf.
+    uint32_t right;///< The node of the upper half, the lower half is the next node.
+    double split;
+  };
+  static constexpr uint32_t kLeaf{UINT32_MAX};
+
+  uint32_t Build(uint32_t begin, uint32_t end, size_t leaf_size);
+  void Search(uint32_t node, const double* query, size_t k, std::vector<std::pair<double, uint32_t>>& heap) const;
+
+  size_t dims_;
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> index_;///< The row of each point, in the order of the tree.
+  std::vector<double> points_; ///< The points row by row, in the order of the tree.
+};
+
+// ///////////////////////////////////////////
+// HNSW
+// ///////////////////////////////////////////
+
+/// \brief How vectors are compared by HnswIndex.
+enum class VectorMetric {
+  L2,          ///< Euclidean distance.
+  InnerProduct ///< 1 - a.b, the cosine distance for vectors of length 1.
+};
+
+/// \brief Settings for HnswIndex.
+struct HnswOptions {
+  size_t m{16};               ///< Links per node on the upper levels, 2 * m on the bottom level.
+  size_t ef_construction{200};///< Candidates kept while inserting, more gives a better graph but slower inserts.
+  size_t ef_search{64};       ///< Candidates kept while searching, more gives a better recall but slower searches.
+  VectorMetric metric{VectorMetric::L2};
+  uint64_t seed{0};///< Seed of the levels of the nodes.
+};
+
+/// \brief Approximate nearest neighbor search of float vectors with a hierarchical navigable small world graph
+/// (HNSW). Each vector is a node on level 0 and, with a probability that falls by a factor of m per level, on the
+/// levels above it. On each level the node is linked to its nearest nodes, chosen so that the links point in different
+/// directions. A search walks greedily from the top level down and keeps the ef_search nearest nodes found on level 0.
+///
+/// The distances are computed with AVX2 or AVX-512 when the CPU has them. Add can be called from several threads at
+/// the same time, also while other threads search: each node has its own lock that guards its links. Save, Load and
+/// SetEfSearch must not run at the same time as other calls.
+/// \link <a href="https://arxiv.org/abs/1603.09320">Malkov and Yashunin, Efficient and robust approximate nearest
+/// neighbor search using Hierarchical Navigable Small World graphs.</a>
+class HnswIndex {
+ public:
+  HnswIndex();
+
+  /// \param dims Number of values of a vector.
+  /// \param capacity The maximum number of vectors, the memory is allocated up front.
+  /// \param options Graph and search settings.
+  HnswIndex(size_t dims, size_t capacity, const HnswOptions& options = {});
+
+  ~HnswIndex();
+  HnswIndex(HnswIndex&&) noexcept;
+  HnswIndex& operator=(HnswIndex&&) noexcept;
+
+  /// \brief Adds a vector, its id is the number of vectors added before it. Thread safe.
+  /// \param vector Dims() values.
+  /// \return The id, -1 if the index is full.
+  long long Add(const float* vector);
+
+  /// \brief Adds count vectors stored one after the other, in parallel. They get consecutive ids in the order given.
+  /// \param threads Number of threads, 0 means one per hardware thread.
+  /// \return The number of vectors added, less than count if the index got full.
+  size_t AddBatch(const float* vectors, size_t count, unsigned threads = 0);
+
+  /// \brief Returns the approximately k nearest vectors, nearest first, with NeighborHit::index the id. Thread safe.
+  /// \param query Dims() values.
+  /// \param k Number of neighbors.
+  /// \param ef Candidates to keep, 0 for ef_search. At least k are kept.
+  std::vector<NeighborHit> Search(const float* query, size_t k, size_t ef = 0) const;
+
+  /// \brief Search for count queries stored one after the other, in parallel.
+  std::vector<std::vector<NeighborHit>> SearchBatch(const float* queries, size_t count, size_t k,
+                                                    unsigned threads = 0) const;
+
+  void SetEfSearch(size_t ef)
+  { options_.ef_search = ef; }
+
+  /// \brief Writes the index to a binary file, in the byte order of the machine.
+  bool Save(const std::string& path) const;
+
+  /// \brief Reads an index written by Save. The sizes in the file are checked against its length, so a damaged file
+  /// makes Load fail instead of allocating what the header claims. Indexes with more than 65536 dims or m above 1024
+  /// are not loaded.
+  /// \param capacity Vectors the loaded index has room for, at least the saved ones. The capacity of the saved index
+  /// is not used.
+  /// \return False if the file could not be read, the index is then unchanged.
+  bool Load(const std::string& path, size_t capacity = 0);
+
+  size_t Size() const;
+
+  size_t Dims() const
+  { return dims_; }
+
+  size_t Capacity() const
+  { return capacity_; }
+
+ private:
+  using Candidate = std::pair<float, uint32_t>;
+  struct Shared;
+
+  /// Takes up to count free ids, the first in first.
+  size_t Reserve(size_t count, uint32_t& first);
+  float Distance(const float* a, const float* b) const;
+  size_t MaxLinks(int level) const;
+  const float* Vector(uint32_t id) const
+  { return data_.data() + static_cast<size_t>(id) * dims_; }
+  uint32_t* Links(uint32_t id, int level);
+  const uint32_t* Links(uint32_t id, int level) const;
+  /// Copies the links of a node under its lock.
+  void CopyLinks(uint32_t id, int level, std::vector<uint32_t>& out) const;
+  int RandomLevel(uint32_t id) const;
+  void Insert(uint32_t id);
+  uint32_t Greedy(const float* query, uint32_t entry, float& dist, int from_level, int to_level) const;
+  std::vector<Candidate> SearchLevel(const float* query, uint32_t entry, float entry_dist, size_t ef,
+                                     int level) const;
+  std::vector<Candidate> SelectNeighbors(const std::vector<Candidate>& sorted, size_t m) const;
+  void Connect(uint32_t id, const std::vector<Candidate>& neighbors, int level);
+
+  size_t dims_{0};
+  size_t capacity_{0};
+  HnswOptions options_;
+  std::vector<float> data_;
+  std::vector<uint8_t> levels_;
+  std::vector<uint32_t> links0_;             ///< Per node the count and 2 * m links of level 0.
+  std::vector<std::vector<uint32_t>> upper_; ///< Per node the count and m links of each level above 0.
+  std::unique_ptr<Shared> shared_;           ///< Locks, count and entry point.
+};
+
+// ///////////////////////////////////////////
+// Product quantization
+// ///////////////////////////////////////////
+
+/// \brief Compresses vectors to one byte per subspace. The features are split into subspaces of equal width, and
+/// each subspace has its own codebook of up to 256 centroids trained with KMeans. A vector is stored as the indices of
+/// the nearest centroid in each subspace, so 128 floats with 16 subspaces take 16 bytes instead of 512.
+/// \link <a href="https://doi.org/10.1109/TPAMI.2010.57">Jégou, Douze and Schmid, Product quantization for nearest
+/// neighbor search.</a>
+class ProductQuantizer {
+ public:
+  ProductQuantizer() = default;
+
+  /// \brief Trains the codebooks.
+  /// \param training The training vectors, one per row. The number of columns must be a multiple of subspaces.
+  /// \param subspaces Number of subspaces, the size of a code in bytes.
+  /// \param centroids Centroids per subspace, at most 256 and at most the number of training rows.
+  /// \param options K-means settings of each subspace.
+  /// \note The quantizer is empty, with Subspaces() 0, if the input is invalid.
+  ProductQuantizer(const FeatureView& training, size_t subspaces, size_t centroids = 256,
+                   const KMeansOptions& options = {});
+
+  /// \brief Writes the code of a vector of Dims() values to code, Subspaces() bytes.
+  void Encode(const float* vector, uint8_t* code) const;
+
+  /// \brief Writes the centroids of a code to vector, Dims() values.
+  void Decode(const uint8_t* code, float* vector) const;
+
+  /// \brief Writes the distance from each subspace of the query to each centroid of that subspace, Subspaces() times
+  /// Centroids() values. The distance of a code is the sum of its entries: the squared distance for
+  /// VectorMetric::L2 and minus the inner product for VectorMetric::InnerProduct.
+  void DistanceTable(const float* query, VectorMetric metric, float* table) const;
+
+  size_t Dims() const
+  { return dims_; }
+
+  size_t Subspaces() const
+  { return subspaces_; }
+
+  size_t Centroids() const
+  { return centroids_; }
+
+ private:
+  size_t dims_{0};
+  size_t subspaces_{0};
+  size_t centroids_{0};
+  std::vector<float> codebooks_;///< Per subspace the centroids, each Dims() / Subspaces() values.
+};
+
+/// \brief A flat index of product quantized vectors, searched with asymmetric distances: the query is not quantized,
+/// a table of its distances to all centroids is computed once and a code costs one table lookup per subspace. The
+/// codes are stored in blocks of 16 vectors by subspace, so AVX2 or AVX-512 gathers the lookups of 8 or 16 vectors at
+/// a time.
+class PqIndex {
+ public:
+  PqIndex() = default;
+
+  explicit PqIndex(ProductQuantizer quantizer, VectorMetric metric = VectorMetric::L2);
+
+  /// \brief Encodes and adds count vectors stored one after the other, the ids are given in order.
+  /// \param threads Number of threads for the encoding, 0 means one per hardware thread.
+  void Add(const float* vectors, size_t count, unsigned threads = 0);
+
+  /// \brief Returns the k nearest codes, nearest first. The distance is approximate, the Euclidean distance to the
+  /// decoded vector for VectorMetric::L2, 1 - a.b for VectorMetric::InnerProduct.
+  std::vector<NeighborHit> Search(const float* query, size_t k) const;
+
+  /// \brief Search for count queries stored one after the other, in parallel.
+  std::vector<std::vector<NeighborHit>> SearchBatch(const float* queries, size_t count, size_t k,
+                                                    unsigned threads = 0) const;
+
+  /// \brief Writes the decoded vector with the given id.
+  void Reconstruct(uint32_t id, float* vector) const;
+
+  size_t Size() const
+  { return size_; }
+
+  const ProductQuantizer& Quantizer() const
+  { return quantizer_; }
+
+ private:
+  ProductQuantizer quantizer_;
+  VectorMetric metric_{VectorMetric::L2};
+  size_t size_{0};
+  std::vector<uint8_t> codes_;///< Blocks of 16 codes, by subspace inside a block.
+};
 
 // ///////////////////////////////////////////
 // DBSCAN
@@ -79,6 +677,180 @@ enum class DistFunc {
 /// \link <a href="https://en.wikipedia.org/wiki/DBSCAN">DBSCAN, Wikipedia.</a>
 LabeledPoints DBSCAN(const geometry::Points& points, DistFunc dist_func, double eps, int min_pts);
 
+/// \brief The result of DBSCAN on a FeatureMatrix.
+struct DbscanResult {
+  std::vector<uint32_t> labels;///< 0 for noise, the clusters are numbered from 1 in the order of their first core.
+  std::vector<uint8_t> core;   ///< 1 for the core points, the points with at least min_pts neighbors.
+  uint32_t clusters{0};
+};
+
+/// \brief DBSCAN on n-dimensional points, with the same definitions as DBSCAN above: the neighbors of a point are the
+/// points closer than eps, itself included, and a core point has at least min_pts of them. The core points that are
+/// neighbors form the clusters, and a point that is not a core point joins the cluster of its first core neighbor.
+///
+/// The neighbors are found with a grid of cells of side eps over the first (up to 3) features, so a query visits at
+/// most 27 cells instead of all points. The core points are found in parallel, and the clusters are formed in
+/// parallel by joining neighboring core points in a concurrent union-find.
+/// \param data The points, one per row.
+/// \param dist_func The distance function, e.g. L1 or L2.
+/// \param eps The distance below which two points are neighbors.
+/// \param min_pts The minimum number of neighbors of a core point.
+/// \param threads Number of threads, 0 means one per hardware thread.
+/// \return The labels, empty if data is empty, eps <= 0 or min_pts is 0.
+DbscanResult DBSCAN(const FeatureView& data, DistFunc dist_func, double eps, size_t min_pts, unsigned threads = 0);
+
+// ///////////////////////////////////////////
+// Hierarchical clustering
+// ///////////////////////////////////////////
+
+/// \brief The distance between two clusters in hierarchical clustering.
+enum class Linkage {
+  Single,  ///< The distance of the nearest two points.
+  Complete,///< The distance of the farthest two points.
+  Average, ///< The mean distance of all pairs of points.
+  Ward     ///< The increase of the sum of squared distances to the centroids, for the Euclidean distance only.
+};
+
+/// \brief One step of hierarchical clustering. The points are clusters 0 to n - 1, and the cluster made by merge i is
+/// cluster n + i, the same numbering as the linkage matrix of SciPy.
+struct ClusterMerge {
+  uint32_t first; ///< The smaller cluster number.
+  uint32_t second;///< The larger cluster number.
+  double distance;///< The linkage distance of the two clusters.
+  uint32_t size;  ///< Number of points in the merged cluster.
+};
+
+/// \brief Returns the distances between all pairs of rows, the condensed upper triangle: the distance of rows i < j is
+/// at n * i - i * (i + 1) / 2 + j - i - 1. The pairs are split evenly between the threads.
+/// \param data The points, one per row.
+/// \param dist_func The distance function, e.g. L1 or L2.
+/// \param threads Number of threads, 0 means one per hardware thread.
+std::vector<double> CondensedDistances(const FeatureView& data, DistFunc dist_func, unsigned threads = 0);
+
+/// \brief Agglomerative hierarchical clustering: starts with every point in its own cluster and merges the nearest two
+/// clusters until one is left. Runs the nearest-neighbor chain algorithm on the condensed distance matrix, which
+/// follows nearest neighbors until two clusters are each other's nearest and merges them. The distances are updated in
+/// place with the Lance-Williams formulas, so this takes O(n^2) time and O(n) memory besides the matrix. Single linkage
+/// does not need the matrix, it takes the minimum spanning tree of the points with Prim's algorithm instead.
+/// \param data The points, one per row.
+/// \param linkage How the distance between two clusters is defined.
+/// \param dist_func The distance between two points, Ward linkage requires DistFunc::Euclidean.
+/// \param threads Number of threads for the distance matrix, 0 means one per hardware thread.
+/// \return The n - 1 merges with increasing distance, empty if there are fewer than two points or if Ward linkage is
+/// used with another distance.
+/// \link <a href="https://arxiv.org/abs/1109.2378">Müllner, Modern hierarchical, agglomerative clustering
+/// algorithms.</a>
+std::vector<ClusterMerge> HierarchicalClustering(const FeatureView& data, Linkage linkage,
+                                                 DistFunc dist_func = DistFunc::Euclidean, unsigned threads = 0);
+
+/// \brief Cuts a hierarchical clustering into the given number of clusters, by undoing the last merges.
+/// \param merges The result of HierarchicalClustering.
+/// \param clusters The number of clusters.
+/// \return The cluster of each point, numbered from 0 in the order of their first point. Empty if clusters is 0 or
+/// greater than the number of points.
+std::vector<uint32_t> CutTree(const std::vector<ClusterMerge>& merges, size_t clusters);
+
+// ///////////////////////////////////////////
+// Gaussian mixture
+// ///////////////////////////////////////////
+
+/// \brief The shape of the covariance matrices of a GaussianMixture.
+enum class CovarianceType {
+  Full,    ///< Any covariance matrix, d * d values per component.
+  Diagonal ///< Independent features, d variances per component.
+};
+
+/// \brief Settings for GaussianMixture.
+struct GmmOptions {
+  CovarianceType covariance{CovarianceType::Full};
+  size_t max_iterations{100};
+  double tolerance{1e-3};     ///< Stops when the mean log-likelihood per point improves by less than this.
+  double regularization{1e-6};///< Added to the variances, keeps the covariance matrices invertible.
+  uint64_t seed{0};           ///< Seed of the K-means that initializes the components.
+  unsigned threads{0};        ///< Number of threads, 0 means one per hardware thread.
+};
+
+/// \brief A mixture of k Gaussian distributions, fitted with expectation maximization (EM): soft clustering, where
+/// each point belongs to each component with a probability, its responsibility. The components start from the
+/// clusters of KMeans. The E-step computes the responsibilities in the log domain with log-sum-exp, so points far
+/// from all components do not underflow, and the M-step sets the weights, means and covariances from them.
+///
+/// The points are processed in chunks of 256 rows per thread: the log probabilities of a chunk are computed column by
+/// column, exponentiated with AVX2 when the CPU has it, and summed into the statistics of the M-step at once. The
+/// memory is a few chunks per thread, not a responsibility for every point and component.
+/// \link <a href="https://en.wikipedia.org/wiki/Mixture_model#Expectation_maximization_(EM)">Mixture model,
+/// Wikipedia.</a>
+class GaussianMixture {
+ public:
+  GaussianMixture() = default;
+
+  /// \param k Number of components.
+  /// \param options Covariance type, stopping criteria and threads.
+  explicit GaussianMixture(size_t k, const GmmOptions& options = {});
+
+  /// \brief Fits the mixture to the rows of data.
+  /// \return False if there are fewer rows than components or if a covariance matrix is not positive definite, the
+  /// mixture is then not fitted.
+  bool Fit(const FeatureView& data);
+
+  /// \brief Returns the most likely component of each row, empty if the mixture is not fitted or the number of
+  /// columns differ.
+  std::vector<uint32_t> Predict(const FeatureView& data) const;
+
+  /// \brief Returns the responsibilities, one row per point and one column per component, each row sums to 1.
+  FeatureMatrix PredictProba(const FeatureView& data) const;
+
+  /// \brief Returns the log of the probability density of each row.
+  std::vector<double> ScoreSamples(const FeatureView& data) const;
+
+  bool Fitted() const
+  { return !constants_.empty(); }
+
+  /// \brief The mean log-likelihood per point in the last E-step of Fit.
+  double LogLikelihood() const
+  { return log_likelihood_; }
+
+  size_t Iterations() const
+  { return iterations_; }
+
+  /// \brief False if max_iterations was reached first.
+  bool Converged() const
+  { return converged_; }
+
+  /// \brief The means, one row per component.
+  const FeatureMatrix& Means() const
+  { return means_; }
+
+  const std::vector<double>& Weights() const
+  { return weights_; }
+
+  /// \brief Per component the covariance matrix row by row, or the variances for CovarianceType::Diagonal.
+  const std::vector<double>& Covariances() const
+  { return covariances_; }
+
+ private:
+  struct Stats;
+
+  Stats Collect(const FeatureView& data, unsigned threads, const uint32_t* hard_labels) const;
+  void Accumulate(const FeatureView& data, size_t begin, size_t m, const double* resp, Stats& stats,
+                  double* scratch) const;
+  bool Maximize(const Stats& stats, size_t n);
+  bool Factorize();
+  void LogProb(const FeatureView& data, size_t begin, size_t m, double* logp, double* scratch) const;
+
+  size_t k_{0};
+  GmmOptions options_;
+  size_t dims_{0};
+  FeatureMatrix means_;
+  std::vector<double> weights_;
+  std::vector<double> covariances_;
+  std::vector<double> factors_;  ///< Per component the inverse Cholesky factor, or 1 / standard deviation.
+  std::vector<double> constants_;///< Per component the log weight minus half the log of (2 pi)^d det(covariance).
+  double log_likelihood_{0.0};
+  size_t iterations_{0};
+  bool converged_{false};
+};
+
 }// namespace algo::data_mining
 
 #endif//ALGORITHM_DATA_MINING_DATA_MINING_ALGORITHMS_HPP_
@@ -6,13 +6,25 @@
 ///
 /// Change list:
 /// 2015-06-18 Binary search
+/// 2026-10-19 Floyd-Rivest selection, partial sort and top-k
+/// 2026-10-19 Branchless and Eytzinger layout binary search
+/// 2026-10-19 Learned index
 ///
 
 #ifndef ALGORITHM_SEARCH_SEARCH_ALGORITHMS_HPP_
 #define ALGORITHM_SEARCH_SEARCH_ALGORITHMS_HPP_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "algo_sort.hpp"
+
 namespace algo::search {
 
 /////////////////////////////////////////////
@@ -29,6 +41,258 @@ namespace algo::search {
 template<typename T>
 int Binary(const std::vector<T>& vec, T value);
 
+/// \brief Hints the CPU to fetch the cache line of p.
+inline void Prefetch(const void* p)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(p);
+#else
+  (void) p;
+#endif
+}
+
+/// \brief Branchless lower bound, returns the position of the first element in data that is not less than value. The
+/// loop always runs ceil(log2(n)) times and the comparison result is used as data (a conditional move) instead of a
+/// branch, so there are no mispredictions.
+/// \tparam T Type used.
+/// \tparam Compare Less-than comparator.
+/// \param data The sorted array.
+/// \param n Number of elements.
+/// \param value The value to search for.
+/// \param comp The comparator.
+/// \return Position of the lower bound, n if all elements are less than value.
+template<typename T, typename Compare = std::less<>>
+size_t LowerBound(const T* data, size_t n, const T& value, Compare comp = {})
+{
+  if (n == 0) {
+    return 0;
+  }
+  const T* base{data};
+  while (n > 1) {
+    size_t half{n / 2};
+    // Both possible next midpoints.
+    Prefetch(base + half / 2);
+    Prefetch(base + half + half / 2);
+    base = comp(base[half], value) ? base + half : base;
+    n -= half;
+  }
+  return static_cast<size_t>(base - data) + comp(*base, value);
+}
+
+/// \brief Branchless lower bound in a sorted vector.
+template<typename T, typename Compare = std::less<>>
+size_t LowerBound(const std::vector<T>& vec, const T& value, Compare comp = {})
+{ return LowerBound(vec.data(), vec.size(), value, comp); }
+
+/////////////////////////////////////////////
+/// Eytzinger search
+/////////////////////////////////////////////
+
+/// \brief A sorted array stored in Eytzinger (BFS) order: the root at 1 and the children of node k at 2k and 2k + 1.
+/// The first levels of the tree share a few cache lines, and the 16 nodes four levels below k are adjacent, so they can
+/// be prefetched while the search walks down. The search is branchless.
+/// \tparam T Type used.
+/// \tparam Compare Less-than comparator.
+/// \link <a href="https://arxiv.org/abs/1509.05053">Array layouts for comparison-based searching, Khuong and Morin.</a>
+template<typename T, typename Compare = std::less<>>
+class Eytzinger {
+ public:
+  /// \brief Builds the layout from sorted input.
+  /// \param sorted Input sorted with respect to comp.
+  /// \param comp The comparator.
+  explicit Eytzinger(const std::vector<T>& sorted, Compare comp = {})
+      : comp_(comp), tree_(sorted.size() + 1), pos_(sorted.size() + 1)
+  {
+    size_t i{0};
+    Build(sorted, i, 1);
+  }
+
+  /// \brief Returns the position in the sorted input of the first element not less than value, or Size() if there is
+  /// none.
+  size_t LowerBound(const T& value) const
+  { return Resolve(Descend(value)); }
+
+  /// \brief Returns the position in the sorted input of value, or -1 if not found. Like Binary, the left-most position
+  /// is returned.
+  long long Find(const T& value) const
+  {
+    size_t k{Descend(value)};
+    k >>= CountTrailingOnes(k) + 1;
+    if (k == 0 || comp_(value, tree_[k])) {
+      return -1;
+    }
+    return static_cast<long long>(pos_[k]);
+  }
+
+  /// \brief Lower bounds of many values. The values are searched in groups that walk down the tree together, so the
+  /// memory accesses of one group overlap instead of waiting on each other.
+  /// \param values The values to search for.
+  /// \param count Number of values.
+  /// \param out The lower bounds, as from LowerBound.
+  void LowerBound(const T* values, size_t count, size_t* out) const
+  {
+    constexpr size_t kGroup{16};
+    const size_t n{Size()};
+    size_t k[kGroup];
+
+    for (size_t first = 0; first < count; first += kGroup) {
+      const size_t g_size{std::min(kGroup, count - first)};
+      std::fill(k, k + g_size, size_t{1});
+
+      bool active{n > 0};
+      while (active) {
+        active = false;
+        for (size_t g = 0; g < g_size; g++) {
+          if (k[g] <= n) {
+            Prefetch(tree_.data() + std::min(k[g] * kPrefetchAhead, n));
+            k[g] = 2 * k[g] + comp_(tree_[k[g]], values[first + g]);
+            active = true;
+          }
+        }
+      }
+      for (size_t g = 0; g < g_size; g++) {
+        out[first + g] = Resolve(k[g]);
+      }
+    }
+  }
+
+  /// \brief Lower bounds of many values.
+  std::vector<size_t> LowerBound(const std::vector<T>& values) const
+  {
+    std::vector<size_t> res(values.size());
+    LowerBound(values.data(), values.size(), res.data());
+    return res;
+  }
+
+  /// \brief Returns the number of elements.
+  size_t Size() const
+  { return tree_.size() - 1; }
+
+ private:
+  /// Nodes in a 64 byte cache line, the node 4 levels below k (for 4 byte T) is at k * 16.
+  static constexpr size_t kPrefetchAhead{std::max<size_t>(64 / sizeof(T), 1)};
+
+  void Build(const std::vector<T>& sorted, size_t& i, size_t k)
+  {
+    if (k <= sorted.size()) {
+      Build(sorted, i, 2 * k);
+      tree_[k] = sorted[i];
+      pos_[k] = i++;
+      Build(sorted, i, 2 * k + 1);
+    }
+  }
+
+  /// Walks down to a leaf, going right when the node is less than value.
+  size_t Descend(const T& value) const
+  {
+    const size_t n{Size()};
+    size_t k{1};
+    while (k <= n) {
+      Prefetch(tree_.data() + std::min(k * kPrefetchAhead, n));
+      k = 2 * k + comp_(tree_[k], value);
+    }
+    return k;
+  }
+
+  /// The last left turn on the path is the lower bound: strip the trailing right turns (ones) and the left turn.
+  size_t Resolve(size_t k) const
+  {
+    k >>= CountTrailingOnes(k) + 1;
+    return k == 0 ? Size() : pos_[k];
+  }
+
+  static int CountTrailingOnes(size_t k)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return ~k == 0 ? static_cast<int>(8 * sizeof(k)) : __builtin_ctzll(~static_cast<unsigned long long>(k));
+#else
+    int ones{0};
+    for (; k & 1u; k >>= 1u) ones++;
+    return ones;
+#endif
+  }
+
+  Compare comp_;
+  std::vector<T> tree_;    ///< The elements in BFS order, tree_[0] is unused.
+  std::vector<size_t> pos_;///< Position in the sorted input of each node.
+};
+
+/////////////////////////////////////////////
+/// Learned index
+/////////////////////////////////////////////
+
+/// \brief A static index over an immutable sorted array of keys. The positions of the keys are approximated by a
+/// piecewise linear function, with at most epsilon positions error for the keys in the array. A lookup predicts the
+/// position from the segment of the key and searches the small window around it. If the key is not inside the window
+/// (which only happens for keys that are not in the array), the lookup falls back to a binary search.
+///
+/// The index does not own the keys, it only stores the segments: 24 bytes each, usually a small fraction of a byte per
+/// key. The same keys that the index was built from must be passed to the lookups.
+/// \link <a href="https://doi.org/10.14778/3389133.3389135">The PGM-index, Ferragina and Vinciguerra.</a>
+class LearnedIndex {
+ public:
+  LearnedIndex() = default;
+
+  /// \brief Builds the index with a greedy shrinking cone: a segment grows as long as one line passes within epsilon of
+  /// all its keys.
+  /// \param keys The keys, sorted ascending. Duplicates are allowed.
+  /// \param n Number of keys.
+  /// \param epsilon Maximum error of the predicted positions, larger means fewer segments but longer searches.
+  LearnedIndex(const uint64_t* keys, size_t n, size_t epsilon = 32);
+
+  /// \brief Builds the index over a sorted vector.
+  explicit LearnedIndex(const std::vector<uint64_t>& keys, size_t epsilon = 32)
+      : LearnedIndex(keys.data(), keys.size(), epsilon)
+  {}
+
+  /// \brief Returns the position of the first key that is not less than key, or the number of keys if there is none.
+  /// \param keys The keys the index was built from.
+  /// \param key The key to search for.
+  size_t LowerBound(const uint64_t* keys, uint64_t key) const;
+
+  /// \brief Lower bound in the vector the index was built from. A vector of another size than the index cannot be the
+  /// one it was built from, it is searched with a plain binary search instead.
+  size_t LowerBound(const std::vector<uint64_t>& keys, uint64_t key) const
+  { return keys.size() == n_ ? LowerBound(keys.data(), key) : search::LowerBound(keys, key); }
+
+  /// \brief Returns the first position of key, or -1 if not found.
+  long long Find(const std::vector<uint64_t>& keys, uint64_t key) const;
+
+  /// \brief Writes the index to a binary file in the byte order of the machine.
+  /// \return True if the file was written.
+  bool Save(const std::string& path) const;
+
+  /// \brief Reads an index written by Save. The number of segments in the file is checked against its length before
+  /// anything is allocated, and the segments must be valid for the number of keys: the first one starts at 0, the
+  /// starts and first keys increase and the slopes are finite and not negative.
+  /// \return True if the file was read, otherwise the index is left unchanged.
+  bool Load(const std::string& path);
+
+  /// \brief Returns the number of keys.
+  size_t Size() const
+  { return n_; }
+
+  /// \brief Returns the number of linear segments.
+  size_t Segments() const
+  { return first_keys_.size(); }
+
+  /// \brief Returns the memory used by the segments.
+  size_t Bytes() const
+  { return first_keys_.size() * (sizeof(uint64_t) + sizeof(Segment)); }
+
+ private:
+  /// Predicted position = start + slope * (key - first key).
+  struct Segment {
+    double slope;
+    uint64_t start;
+  };
+
+  size_t n_{0};
+  size_t epsilon_{0};
+  std::vector<uint64_t> first_keys_;///< Smallest key of each segment, searched to find the segment.
+  std::vector<Segment> segments_;
+};
+
 /////////////////////////////////////////////
 /// Selection search
 /////////////////////////////////////////////
@@ -36,22 +300,243 @@ int Binary(const std::vector<T>& vec, T value);
 /// \brief Finds the k smallest items in vec.
 /// \tparam T Type used.
 /// \param vec The vector to search in.
-/// \param k The value to find.
-/// \return The k smallest values.
+/// \param k Number of items to find.
+/// \return The k smallest values in ascending order. If k is greater than the size of vec, vec is returned as is.
 /// \link <a href="https://en.wikipedia.org/wiki/Selection_algorithm">Selection search, Wikipedia.</a>
-/// \todo{alex011235} Unit test.
 template<typename T>
-std::vector<T> SelectionMin(std::vector<T> vec, T k);
+std::vector<T> SelectionMin(std::vector<T> vec, size_t k);
 
 /// \brief Finds the k largest items in vec.
 /// \tparam T Type used.
 /// \param vec The vector to search in.
-/// \param k The value to find.
-/// \return The k largest values.
+/// \param k Number of items to find.
+/// \return The k largest values in descending order. If k is greater than the size of vec, vec is returned as is.
 /// \link <a href="https://en.wikipedia.org/wiki/Selection_algorithm">Selection search, Wikipedia.</a>
-/// \todo{alex011235} Unit test.
 template<typename T>
-std::vector<T> SelectionMax(std::vector<T> vec, T k);
+std::vector<T> SelectionMax(std::vector<T> vec, size_t k);
+
+/////////////////////////////////////////////
+/// Nth element and partial sort
+/////////////////////////////////////////////
+
+/// \brief Heap based selection, the fallback of NthElement. Puts the element that belongs at nth in sorted order
+/// there, with no greater element before it and no smaller after it.
+template<typename RandomIt, typename Less>
+void HeapSelect(RandomIt first, RandomIt nth, RandomIt last, Less& less)
+{
+  // Max-heap of the nth - first + 1 smallest elements seen so far.
+  std::make_heap(first, nth + 1, less);
+  for (auto it = nth + 1; it != last; ++it) {
+    if (less(*it, *first)) {
+      std::pop_heap(first, nth + 1, less);
+      std::iter_swap(nth, it);
+      std::push_heap(first, nth + 1, less);
+    }
+  }
+  std::pop_heap(first, nth + 1, less);
+}
+
+/// \brief Floyd-Rivest selection of index k in [left, right]. Large ranges recurse on a sample to find pivots close to
+/// the kth element, so the expected number of comparisons is n + min(k, n - k) + o(n). If depth runs out, the rest is
+/// done with HeapSelect.
+template<typename RandomIt, typename Less, typename Diff>
+void FloydRivest(RandomIt first, Diff left, Diff right, Diff k, Less& less, int depth)
+{
+  constexpr Diff kSampleFrom{600};
+
+  while (right > left) {
+    if (depth-- == 0) {
+      HeapSelect(first + left, first + k, first + right + 1, less);
+      return;
+    }
+
+    if (right - left > kSampleFrom) {
+      double n = right - left + 1;
+      double i = k - left + 1;
+      double z{std::log(n)};
+      double s{0.5 * std::exp(2.0 * z / 3.0)};
+      double sd{0.5 * std::sqrt(z * s * (n - s) / n) * (i < n / 2 ? -1.0 : 1.0)};
+      auto new_left = std::max(left, static_cast<Diff>(k - i * s / n + sd));
+      auto new_right = std::min(right, static_cast<Diff>(k + (n - i) * s / n + sd));
+      FloydRivest(first, new_left, new_right, k, less, depth);
+    }
+
+    // Partition around t = the element at k.
+    auto t = first[k];
+    Diff i{left};
+    Diff j{right};
+    std::iter_swap(first + left, first + k);
+    if (less(t, first[right])) {
+      std::iter_swap(first + right, first + left);
+    }
+    while (i < j) {
+      std::iter_swap(first + i, first + j);
+      i++;
+      j--;
+      while (less(first[i], t)) i++;
+      while (less(t, first[j])) j--;
+    }
+    if (!less(first[left], t) && !less(t, first[left])) {
+      std::iter_swap(first + left, first + j);
+    } else {
+      j++;
+      std::iter_swap(first + j, first + right);
+    }
+
+    if (j <= k) left = j + 1;
+    if (k <= j) right = j - 1;
+  }
+}
+
+/// \brief Rearranges [first, last) so that nth holds the element that would be there if the range was sorted, no
+/// element before nth is greater and no element after nth is smaller. Introselect: Floyd-Rivest selection, with a
+/// heap selection fallback that bounds the worst case to O(n log n).
+/// \tparam RandomIt Random access iterator.
+/// \tparam Compare Less-than comparator of the projected values.
+/// \tparam Proj Projection applied to the elements before comparing.
+/// \param first Start of the range.
+/// \param nth The position to select.
+/// \param last End of the range.
+/// \param comp The comparator.
+/// \param proj The projection.
+/// \link <a href="https://en.wikipedia.org/wiki/Floyd%E2%80%93Rivest_algorithm">Floyd-Rivest, Wikipedia.</a>
+template<typename RandomIt, typename Compare = std::less<>, typename Proj = sort::Identity>
+void NthElement(RandomIt first, RandomIt nth, RandomIt last, Compare comp = {}, Proj proj = {})
+{
+  if (last - first < 2 || nth == last) {
+    return;
+  }
+  sort::ProjectedLess<Compare, Proj> less{comp, proj};
+  auto n = last - first;
+  int depth{2 * static_cast<int>(std::log2(static_cast<double>(n))) + 2};
+  FloydRivest(first, decltype(n){0}, n - 1, nth - first, less, depth);
+}
+
+/// \brief Rearranges [first, last) so that [first, middle) holds the smallest elements in sorted order. The order of
+/// the remaining elements is unspecified.
+/// \tparam RandomIt Random access iterator.
+/// \tparam Compare Less-than comparator of the projected values.
+/// \tparam Proj Projection applied to the elements before comparing.
+/// \param first Start of the range.
+/// \param middle End of the sorted part.
+/// \param last End of the range.
+/// \param comp The comparator.
+/// \param proj The projection.
+template<typename RandomIt, typename Compare = std::less<>, typename Proj = sort::Identity>
+void PartialSort(RandomIt first, RandomIt middle, RandomIt last, Compare comp = {}, Proj proj = {})
+{
+  if (middle == first) {
+    return;
+  }
+  NthElement(first, middle - 1, last, comp, proj);
+  sort::Heap(first, middle, comp, proj);
+}
+
+/////////////////////////////////////////////
+/// Top-k
+/////////////////////////////////////////////
+
+/// \brief Streaming top-k, keeps the k greatest elements seen so far (with respect to comp) in a heap. Memory is O(k)
+/// regardless of how many elements are pushed. Use std::greater<> as comparator to keep the k smallest.
+/// \tparam T Element type.
+/// \tparam Compare Less-than comparator.
+template<typename T, typename Compare = std::less<>>
+class TopK {
+ public:
+  explicit TopK(size_t k, Compare comp = {}) : k_(k), greater_{comp}
+  { heap_.reserve(k); }
+
+  /// \brief Offers one element.
+  void Push(const T& x)
+  {
+    if (heap_.size() < k_) {
+      heap_.push_back(x);
+      std::push_heap(heap_.begin(), heap_.end(), greater_);
+    } else if (k_ > 0 && greater_.comp(heap_.front(), x)) {
+      // The root is the smallest kept element, x replaces it.
+      std::pop_heap(heap_.begin(), heap_.end(), greater_);
+      heap_.back() = x;
+      std::push_heap(heap_.begin(), heap_.end(), greater_);
+    }
+  }
+
+  /// \brief Offers all elements in [first, last).
+  template<typename InputIt>
+  void Push(InputIt first, InputIt last)
+  {
+    for (; first != last; ++first) Push(*first);
+  }
+
+  /// \brief Offers all elements kept by other.
+  void Merge(const TopK& other)
+  { Push(other.heap_.begin(), other.heap_.end()); }
+
+  /// \brief Returns the kept elements, greatest first.
+  std::vector<T> Sorted() const
+  {
+    std::vector<T> res{heap_};
+    std::sort_heap(res.begin(), res.end(), greater_);
+    return res;
+  }
+
+  /// \brief Returns the number of kept elements, at most k.
+  size_t Size() const
+  { return heap_.size(); }
+
+ private:
+  /// Inverted comparator, makes the std heap functions keep the smallest kept element at the root.
+  struct Greater {
+    Compare comp;
+    bool operator()(const T& a, const T& b)
+    { return comp(b, a); }
+  };
+
+  size_t k_;
+  Greater greater_;
+  std::vector<T> heap_;
+};
+
+/// \brief Returns the k greatest elements of [first, last) with respect to comp, greatest first. The range is split
+/// into one chunk per thread, each thread fills its own TopK and the heaps are merged at the end.
+/// \tparam RandomIt Random access iterator.
+/// \tparam Compare Less-than comparator.
+/// \param first Start of the range.
+/// \param last End of the range.
+/// \param k Number of elements to return.
+/// \param comp The comparator.
+/// \param threads Number of threads, 0 means one per hardware thread.
+/// \return The top k elements.
+template<typename RandomIt, typename Compare = std::less<>>
+std::vector<typename std::iterator_traits<RandomIt>::value_type> ParallelTopK(RandomIt first, RandomIt last, size_t k,
+                                                                              Compare comp = {}, unsigned threads = 0)
+{
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  constexpr size_t kMinChunk{1u << 14u};
+
+  auto n = static_cast<size_t>(last - first);
+  if (threads == 0) {
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  // Not worth a thread for less than kMinChunk elements.
+  threads = static_cast<unsigned>(std::max<size_t>(std::min<size_t>(threads, n / kMinChunk), 1));
+
+  std::vector<TopK<T, Compare>> partial(threads, TopK<T, Compare>(k, comp));
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    auto begin = first + static_cast<std::ptrdiff_t>(n * t / threads);
+    auto end = first + static_cast<std::ptrdiff_t>(n * (t + 1) / threads);
+    workers.emplace_back([&partial, t, begin, end]() { partial[t].Push(begin, end); });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  for (unsigned t = 1; t < threads; t++) {
+    partial[0].Merge(partial[t]);
+  }
+  return partial[0].Sorted();
+}
+
 }// namespace algo::search
 
 #endif//ALGORITHM_SEARCH_SEARCH_ALGORITHMS_HPP_
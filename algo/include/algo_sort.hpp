@@ -11,67 +11,736 @@
 /// 2016-06-28 Gnome-sort
 /// 2016-10-02 Bucket-sort
 /// 2016-10-02 Insertion-sort
+/// 2026-10-19 External merge sort
+/// 2026-10-19 SIMD sorting networks for small arrays
+/// 2026-10-19 Generic iterator based sorts with comparator and projection
 ///
 
 #ifndef ALGORITHM_SORTING_SORTING_HPP_
 #define ALGORITHM_SORTING_SORTING_HPP_
 
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
-#include <list>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
 namespace algo::sort {
 
+/////////////////////////////////////////////
+/// Common
+/////////////////////////////////////////////
+
+/// \brief Projection that returns its argument, the default projection of the sort algorithms.
+struct Identity {
+  template<typename T>
+  constexpr T&& operator()(T&& t) const noexcept
+  { return std::forward<T>(t); }
+};
+
+/// \brief Compares the projections of two elements.
+template<typename Compare, typename Proj>
+struct ProjectedLess {
+  Compare comp;
+  Proj proj;
+
+  template<typename A, typename B>
+  bool operator()(const A& a, const B& b)
+  { return std::invoke(comp, std::invoke(proj, a), std::invoke(proj, b)); }
+};
+
+/////////////////////////////////////////////
+/// Small sort
+/////////////////////////////////////////////
+
+/// Arrays up to this size are sorted with a sorting network.
+constexpr size_t kSmallSortMax{64};
+
+/// True for the types that have SmallSort kernels.
+template<typename T>
+constexpr bool kHasSmallSort{std::is_same_v<T, int32_t> || std::is_same_v<T, float> || std::is_same_v<T, double>};
+
+/// \brief Sorts a small array with a bitonic sorting network. Uses AVX-512 or AVX2 if the CPU supports it, otherwise
+/// insertion sort. Arrays larger than kSmallSortMax are sorted with std::sort. The Insertion, Heap and Quick sorts use
+/// this for their small inputs and partitions.
+/// \note Floating point input must not contain NaN.
+/// \param data The array to sort.
+/// \param n Number of elements.
+/// \link <a href="https://en.wikipedia.org/wiki/Bitonic_sorter">Bitonic sorter, Wikipedia.</a>
+void SmallSort(int32_t* data, size_t n);
+void SmallSort(float* data, size_t n);
+void SmallSort(double* data, size_t n);
+
+/// True if the range can be handed to SmallSort, i.e. contiguous int32/float/double sorted in ascending order.
+template<typename RandomIt, typename Compare, typename Proj>
+constexpr bool kUsesSmallSort = []() {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  constexpr bool contiguous{std::is_pointer_v<RandomIt> || std::is_same_v<RandomIt, typename std::vector<T>::iterator>};
+  constexpr bool ascending{std::is_same_v<Compare, std::less<>> || std::is_same_v<Compare, std::less<T>>};
+  return kHasSmallSort<T> && contiguous && ascending && std::is_same_v<Proj, Identity>;
+}();
+
+/// \brief Sorts [first, last) with SmallSort if the range qualifies and is small enough.
+/// \return True if the range was sorted.
+template<typename RandomIt, typename Compare, typename Proj>
+bool TrySmallSort(RandomIt first, RandomIt last)
+{
+  if constexpr (kUsesSmallSort<RandomIt, Compare, Proj>) {
+    auto n = static_cast<size_t>(last - first);
+    if (n < 2) {
+      return true;
+    }
+    if (n <= kSmallSortMax) {
+      SmallSort(&first[0], n);
+      return true;
+    }
+  }
+  return false;
+}
+
+/////////////////////////////////////////////
+/// Bubble-sort
+/////////////////////////////////////////////
+
 /// \brief Bubble sort.
-/// \tparam T Type in vector.
-/// \param lst The list to sort.
+/// \tparam RandomIt Random access iterator.
+/// \tparam Compare Less-than comparator of the projected values.
+/// \tparam Proj Projection applied to the elements before comparing.
+/// \param first Start of the range to sort.
+/// \param last End of the range to sort.
+/// \param comp The comparator.
+/// \param proj The projection.
 /// \link <a href="https://en.wikipedia.org/wiki/Bubble_sort">Bubble sort, Wikipedia.</a>
-template<typename T>
-void Bubble(std::vector<T>& vec);
+template<typename RandomIt, typename Compare = std::less<>, typename Proj = Identity>
+void Bubble(RandomIt first, RandomIt last, Compare comp = {}, Proj proj = {})
+{
+  ProjectedLess<Compare, Proj> less{comp, proj};
+  auto n = last - first;
+
+  for (decltype(n) i = 0; i < n; i++) {
+    for (decltype(n) j = 0; j < n - 1; j++) {
+      if (less(first[j + 1], first[j])) {
+        std::iter_swap(first + j, first + j + 1);
+      }
+    }
+  }
+}
+
+/// \brief Bubble sort.
+/// \tparam T Type in vector.
+/// \param vec The vector to sort.
+/// \param comp The comparator.
+/// \param proj The projection.
+template<typename T, typename Compare = std::less<>, typename Proj = Identity>
+void Bubble(std::vector<T>& vec, Compare comp = {}, Proj proj = {})
+{ Bubble(vec.begin(), vec.end(), comp, proj); }
+
+/////////////////////////////////////////////
+/// Bucket-sort
+/////////////////////////////////////////////
+
+/// \brief Bucket sort algorithm, sorts in ascending order of the projected numbers.
+/// \note This implementation only works for positive numbers, the range is left as is if any number is negative.
+/// \tparam RandomIt Random access iterator.
+/// \tparam Proj Projection from element to number.
+/// \param first Start of the range to sort.
+/// \param last End of the range to sort.
+/// \param proj The projection.
+/// \link <a href="https://en.wikipedia.org/wiki/Bucket_sort">Bucket sort, Wikipedia.</a>
+template<typename RandomIt, typename Proj = Identity>
+void Bucket(RandomIt first, RandomIt last, Proj proj = {})
+{
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  if (first == last) {
+    return;
+  }
+
+  auto key = [&proj](const T& t) { return static_cast<double>(std::invoke(proj, t)); };
+  if (std::any_of(first, last, [&key](const T& t) { return key(t) < 0; })) {
+    return;
+  }
+
+  double max_key{key(*std::max_element(first, last, [&key](const T& a, const T& b) { return key(a) < key(b); }))};
+  auto nbr_of_buckets = static_cast<size_t>(std::sqrt(max_key));
+  std::vector<std::vector<T>> buckets(nbr_of_buckets + 1);
+
+  // Put in buckets
+  for (auto it = first; it != last; ++it) {
+    buckets[static_cast<size_t>(std::sqrt(key(*it)))].push_back(std::move(*it));
+  }
+
+  // Put back elements
+  auto out = first;
+  for (auto& bucket : buckets) {
+    out = std::move(bucket.begin(), bucket.end(), out);
+  }
+
+  // Insertion sort (Bentley 1993)
+  for (auto i = first + 1; i < last; ++i) {
+    for (auto j = i; j > first && key(*(j - 1)) > key(*j); --j) {
+      std::iter_swap(j, j - 1);
+    }
+  }
+}
 
 /// \brief Bucket sort algorithm.
 /// \note This implementation only works for positive numbers.
 /// \tparam T Type in vector.
 /// \param vec The vector to be sorted.
-/// \link <a href="https://en.wikipedia.org/wiki/Bucket_sort">Bucket sort, Wikipedia.</a>
-template<typename T>
-void Bucket(std::vector<T>& vec);
+/// \param proj The projection.
+template<typename T, typename Proj = Identity>
+void Bucket(std::vector<T>& vec, Proj proj = {})
+{ Bucket(vec.begin(), vec.end(), proj); }
+
+/////////////////////////////////////////////
+/// Gnome-sort
+/////////////////////////////////////////////
+
+/// \brief Gnome sort algorithm
+/// \tparam RandomIt Random access iterator.
+/// \tparam Compare Less-than comparator of the projected values.
+/// \tparam Proj Projection applied to the elements before comparing.
+/// \param first Start of the range to sort.
+/// \param last End of the range to sort.
+/// \param comp The comparator.
+/// \param proj The projection.
+/// \link <a href=https://en.wikipedia.org/wiki/Gnome_sort>Gnome sort, Wikipedia.</a>
+template<typename RandomIt, typename Compare = std::less<>, typename Proj = Identity>
+void Gnome(RandomIt first, RandomIt last, Compare comp = {}, Proj proj = {})
+{
+  ProjectedLess<Compare, Proj> less{comp, proj};
+  auto n = last - first;
+  decltype(n) i{0};
+
+  while (i < n) {
+    if (i == 0 || !less(first[i], first[i - 1])) {
+      i++;
+    } else {
+      std::iter_swap(first + i, first + i - 1);
+      i--;
+    }
+  }
+}
 
 /// \brief Gnome sort algorithm
 /// \tparam T Type in vector.
 /// \param vec The vector to be sorted.
-/// \link <a href=https://en.wikipedia.org/wiki/Gnome_sort>Gnome sort, Wikipedia.</a>
-template<typename T>
-void Gnome(std::vector<T>& vec);
+/// \param comp The comparator.
+/// \param proj The projection.
+template<typename T, typename Compare = std::less<>, typename Proj = Identity>
+void Gnome(std::vector<T>& vec, Compare comp = {}, Proj proj = {})
+{ Gnome(vec.begin(), vec.end(), comp, proj); }
+
+/////////////////////////////////////////////
+/// Heap-sort
+/////////////////////////////////////////////
+
+/// \brief Sift-down operation for binary heaps. Puts new elements to the appropriate indices.
+/// \param first Start of the heap.
+/// \param start The starting position.
+/// \param end The last position in the heap.
+/// \param less The comparator.
+/// \link <a href=https://en.wikipedia.org/wiki/Binary_heap#Extract>SiftDown, Wikipedia.</>
+template<typename RandomIt, typename Less, typename Diff>
+void Siftdown(RandomIt first, Diff start, Diff end, Less& less)
+{
+  Diff root{start};
+  while (root * 2 + 1 <= end) {
+    Diff child{root * 2 + 1};
+    Diff swap{root};
+
+    if (less(first[swap], first[child])) {
+      swap = child;
+    }
+
+    if (child + 1 <= end && less(first[swap], first[child + 1])) {
+      swap = child + 1;
+    }
+
+    if (swap == root) {
+      return;
+    }
+    std::iter_swap(first + root, first + swap);
+    root = swap;
+  }
+}
+
+/// \brief Heap sort algorithm.
+/// \tparam RandomIt Random access iterator.
+/// \tparam Compare Less-than comparator of the projected values.
+/// \tparam Proj Projection applied to the elements before comparing.
+/// \param first Start of the range to sort.
+/// \param last End of the range to sort.
+/// \param comp The comparator.
+/// \param proj The projection.
+/// \link <a href=https://en.wikipedia.org/wiki/Heapsort>Heapsort, Wikipedia.</a>
+template<typename RandomIt, typename Compare = std::less<>, typename Proj = Identity>
+void Heap(RandomIt first, RandomIt last, Compare comp = {}, Proj proj = {})
+{
+  auto n = last - first;
+  if (n < 2 || TrySmallSort<RandomIt, Compare, Proj>(first, last)) {
+    return;
+  }
+  ProjectedLess<Compare, Proj> less{comp, proj};
+
+  // Build the heap, largest value at the root.
+  for (auto start = (n - 2) / 2; start >= 0; start--) {
+    Siftdown(first, start, n - 1, less);
+  }
+
+  for (auto end = n - 1; end > 0;) {
+    std::iter_swap(first + end, first);
+    end--;
+    Siftdown(first, decltype(n){0}, end, less);
+  }
+}
 
 /// \brief Heap sort algorithm.
 /// \tparam T Type in vector.
 /// \param vec The vector to be sorted.
-/// \link <a href=https://en.wikipedia.org/wiki/Heapsort>Heapsort, Wikipedia.</a>
-template<typename T>
-void Heap(std::vector<T>& vec);
+/// \param comp The comparator.
+/// \param proj The projection.
+template<typename T, typename Compare = std::less<>, typename Proj = Identity>
+void Heap(std::vector<T>& vec, Compare comp = {}, Proj proj = {})
+{ Heap(vec.begin(), vec.end(), comp, proj); }
+
+/////////////////////////////////////////////
+/// Insertion-sort
+/////////////////////////////////////////////
+
+/// \brief Insertion sort algorithm.
+/// \tparam RandomIt Random access iterator.
+/// \tparam Compare Less-than comparator of the projected values.
+/// \tparam Proj Projection applied to the elements before comparing.
+/// \param first Start of the range to sort.
+/// \param last End of the range to sort.
+/// \param comp The comparator.
+/// \param proj The projection.
+/// \link <a href="https://en.wikipedia.org/wiki/Insertion_sort">Insertion sort, Wikipedia.</a>
+template<typename RandomIt, typename Compare = std::less<>, typename Proj = Identity>
+void Insertion(RandomIt first, RandomIt last, Compare comp = {}, Proj proj = {})
+{
+  if (first == last || TrySmallSort<RandomIt, Compare, Proj>(first, last)) {
+    return;
+  }
+  ProjectedLess<Compare, Proj> less{comp, proj};
+
+  for (auto i = first + 1; i < last; ++i) {
+    auto x = std::move(*i);
+    auto j = i;
+    for (; j > first && less(x, *(j - 1)); --j) {
+      *j = std::move(*(j - 1));
+    }
+    *j = std::move(x);
+  }
+}
 
 /// \brief Insertion sort algorithm.
 /// \tparam T Type in vector.
 /// \param vec The vector to be sorted.
-/// \link <a href="https://en.wikipedia.org/wiki/Insertion_sort">Insertion sort, Wikipedia.</a>
-template<typename T>
-void Insertion(std::vector<T>& vec);
+/// \param comp The comparator.
+/// \param proj The projection.
+template<typename T, typename Compare = std::less<>, typename Proj = Identity>
+void Insertion(std::vector<T>& vec, Compare comp = {}, Proj proj = {})
+{ Insertion(vec.begin(), vec.end(), comp, proj); }
+
+/////////////////////////////////////////////
+/// Merge-sort
+/////////////////////////////////////////////
+
+/// \brief Sorts [first, last) into out. Both ranges must hold the same elements on entry, they take turns being the
+/// scratch space of each other in the recursion.
+template<typename RandomIt, typename OutIt, typename Less>
+void MergeSortPriv(RandomIt first, RandomIt last, OutIt out, Less& less)
+{
+  auto n = last - first;
+  if (n == 1) {
+    *out = std::move(*first);
+    return;
+  }
+
+  // Sort the halves in place (using out as scratch), then merge them into out.
+  auto half = n / 2;
+  MergeSortPriv(out, out + half, first, less);
+  MergeSortPriv(out + half, out + n, first + half, less);
+
+  auto a = first, a_end = first + half, b = first + half, b_end = last;
+  while (a != a_end && b != b_end) {
+    *out++ = less(*b, *a) ? std::move(*b++) : std::move(*a++);
+  }
+  out = std::move(a, a_end, out);
+  std::move(b, b_end, out);
+}
+
+/// \brief Merge sort, divide and conquer algorithm. The sort is stable.
+/// \tparam RandomIt Random access iterator.
+/// \tparam Compare Less-than comparator of the projected values.
+/// \tparam Proj Projection applied to the elements before comparing.
+/// \param first Start of the range to sort.
+/// \param last End of the range to sort.
+/// \param comp The comparator.
+/// \param proj The projection.
+/// \link <a href="https://en.wikipedia.org/wiki/Merge_sort">Merge sort, Wikipedia.</a>
+template<typename RandomIt, typename Compare = std::less<>, typename Proj = Identity>
+void Merge(RandomIt first, RandomIt last, Compare comp = {}, Proj proj = {})
+{
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  if (last - first < 2) {
+    return;
+  }
+  ProjectedLess<Compare, Proj> less{comp, proj};
+  std::vector<T> buf(first, last);
+  MergeSortPriv(buf.begin(), buf.end(), first, less);
+}
 
 /// \brief Merge sort, divide and conquer algorithm.
 /// \tparam T Type in vector.
 /// \param lst The list to sort.
-/// \return A sorted list.
-/// \link <a href="https://en.wikipedia.org/wiki/Merge_sort">Merge sort, Wikipedia.</a>
-template<typename T>
-void Merge(std::vector<T>& lst);
+/// \param comp The comparator.
+/// \param proj The projection.
+template<typename T, typename Compare = std::less<>, typename Proj = Identity>
+void Merge(std::vector<T>& lst, Compare comp = {}, Proj proj = {})
+{ Merge(lst.begin(), lst.end(), comp, proj); }
+
+/////////////////////////////////////////////
+/// Quick-sort
+/////////////////////////////////////////////
+
+/// \brief Lomuto partition around the last element.
+/// \return The final position of the pivot.
+template<typename RandomIt, typename Less>
+RandomIt Partition(RandomIt low, RandomIt high, Less& less)
+{
+  auto i = low;
+  for (auto j = low; j != high; ++j) {
+    if (!less(*high, *j)) {
+      std::iter_swap(i, j);
+      ++i;
+    }
+  }
+  std::iter_swap(i, high);
+  return i;
+}
+
+/// \brief Sorts the closed range [low, high].
+template<typename RandomIt, typename Compare, typename Proj, typename Less>
+void QuickSortPriv(RandomIt low, RandomIt high, Less& less)
+{
+  if (!(low < high)) {
+    return;
+  }
+  // Small partitions are sorted with a sorting network.
+  if (TrySmallSort<RandomIt, Compare, Proj>(low, high + 1)) {
+    return;
+  }
+
+  auto pivot = Partition(low, high, less);
+  if (pivot != low) {
+    QuickSortPriv<RandomIt, Compare, Proj>(low, pivot - 1, less);
+  }
+  if (pivot != high) {
+    QuickSortPriv<RandomIt, Compare, Proj>(pivot + 1, high, less);
+  }
+}
+
+/// \brief Quick-sort algorithm.
+/// \tparam RandomIt Random access iterator.
+/// \tparam Compare Less-than comparator of the projected values.
+/// \tparam Proj Projection applied to the elements before comparing.
+/// \param first Start of the range to sort.
+/// \param last End of the range to sort.
+/// \param comp The comparator.
+/// \param proj The projection.
+/// \link <a href="https://en.wikipedia.org/wiki/Quicksort">Quicksort, Wikipedia.</a>
+template<typename RandomIt, typename Compare = std::less<>, typename Proj = Identity>
+void Quick(RandomIt first, RandomIt last, Compare comp = {}, Proj proj = {})
+{
+  if (last - first < 2) {
+    return;
+  }
+  ProjectedLess<Compare, Proj> less{comp, proj};
+  QuickSortPriv<RandomIt, Compare, Proj>(first, last - 1, less);
+}
 
 /// \brief Quick-sort algorithm.
 /// \tparam T Type to be sorted.
 /// \param vec Input vector to sort.
-/// \link <a href="https://en.wikipedia.org/wiki/Quicksort">Quicksort, Wikipedia.</a>
-template<typename T>
-void Quick(std::vector<T>& vec);
+/// \param comp The comparator.
+/// \param proj The projection.
+template<typename T, typename Compare = std::less<>, typename Proj = Identity>
+void Quick(std::vector<T>& vec, Compare comp = {}, Proj proj = {})
+{ Quick(vec.begin(), vec.end(), comp, proj); }
+
+/////////////////////////////////////////////
+/// External merge sort
+/////////////////////////////////////////////
+
+/// \brief Resource limits for the external merge sort.
+struct ExternalConfig {
+  size_t memory_budget{64u << 20u};///< Bytes of RAM used for a run, and for all merge buffers together.
+  size_t disk_budget{0};           ///< Bytes of temporary files that may exist at once, 0 means unlimited.
+  std::string temp_dir;            ///< Directory for the temporary runs, empty means the system temp directory.
+  size_t max_fan_in{256};          ///< Most runs merged at once, each is an open file.
+};
+
+/// \brief A thread that runs tasks one at a time in the order they were submitted. The merge reads all its blocks on
+/// one such thread, instead of starting a thread per block.
+class IoThread {
+ public:
+  IoThread();
+  ~IoThread();
+
+  IoThread(const IoThread&) = delete;
+  IoThread& operator=(const IoThread&) = delete;
+
+  /// \brief Queues a task, the future holds its result.
+  std::future<size_t> Submit(std::function<size_t()> task);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<std::packaged_task<size_t()>> tasks_;
+  bool stop_{false};
+  std::thread thread_;
+};
+
+/// \brief Reads a file block by block, the next block is read on an IoThread while the current is consumed.
+class RunReader {
+ public:
+  RunReader(const std::string& path, size_t block_bytes, IoThread& io);
+  ~RunReader();
+
+  RunReader(const RunReader&) = delete;
+  RunReader& operator=(const RunReader&) = delete;
+
+  /// \brief Returns the next block of the file. An empty block means that the file is exhausted or that it could not
+  /// be read, see Failed.
+  /// \return The block, valid until the next call.
+  const std::vector<char>& NextBlock();
+
+  /// \brief True if the file could not be opened or a read failed before its end.
+  bool Failed() const
+  { return failed_; }
+
+ private:
+  void ReadAhead();
+
+  std::ifstream file_;
+  size_t block_bytes_;
+  IoThread& io_;
+  std::vector<char> current_;///< The block handed out to the caller.
+  std::vector<char> ahead_;  ///< The block being filled on the I/O thread.
+  std::future<size_t> pending_;
+  bool read_error_{false};   ///< Set on the I/O thread, read after pending_ is ready.
+  bool failed_{false};
+};
+
+/// \brief Buffered writer of fixed-size records.
+class RunWriter {
+ public:
+  RunWriter(const std::string& path, size_t block_bytes);
+
+  /// \brief Appends the bytes to the file.
+  void Write(const char* data, size_t bytes);
+
+  /// \brief Writes the buffered bytes, returns false if any write has failed.
+  bool Close();
+
+ private:
+  std::ofstream file_;
+  std::vector<char> buffer_;
+  size_t used_{0};
+};
+
+/// \brief Owns the temporary runs of one external sort, the files are removed on destruction.
+class RunFiles {
+ public:
+  explicit RunFiles(const ExternalConfig& config);
+  ~RunFiles();
+
+  RunFiles(const RunFiles&) = delete;
+  RunFiles& operator=(const RunFiles&) = delete;
+
+  /// \brief Reserves a new temporary run of the given size.
+  /// \return The path of the run, empty if the disk budget would be exceeded.
+  std::string Create(size_t bytes);
+
+  /// \brief Removes a run created by this object.
+  void Remove(const std::string& path);
+
+ private:
+  ExternalConfig config_;
+  std::vector<std::pair<std::string, size_t>> runs_;
+  size_t used_bytes_{0};
+};
+
+/// \brief Returns the size in bytes of the file at path, or -1 if the file can not be read.
+long long FileBytes(const std::string& path);
+
+/// \brief Merges the sorted runs into one sorted output file.
+/// \tparam T Record type.
+/// \tparam Compare Less-than comparator.
+/// \param runs The sorted input runs.
+/// \param out_path The output file.
+/// \param block_bytes The buffer size per run.
+/// \param comp The comparator.
+/// \return True on success, false if a run could not be read or the output could not be written.
+template<typename T, typename Compare>
+bool MergeRuns(const std::vector<std::string>& runs, const std::string& out_path, size_t block_bytes, Compare comp)
+{
+  struct Cursor {
+    std::unique_ptr<RunReader> reader;
+    const char* pos;
+    const char* end;
+  };
+
+  // Declared before the readers, so that it outlives their pending reads.
+  IoThread io;
+  std::vector<Cursor> cursors;
+  for (const auto& run : runs) {
+    auto reader{std::make_unique<RunReader>(run, block_bytes, io)};
+    const std::vector<char>& block{reader->NextBlock()};
+    cursors.push_back(Cursor{std::move(reader), block.data(), block.data() + block.size()});
+  }
+
+  // Min-heap of the current head record of each run.
+  using Head = std::pair<T, size_t>;
+  auto greater = [&comp](const Head& a, const Head& b) { return comp(b.first, a.first); };
+  std::priority_queue<Head, std::vector<Head>, decltype(greater)> heads(greater);
+
+  auto pull = [&cursors, &heads](size_t idx) {
+    Cursor& cur{cursors[idx]};
+    if (cur.pos == cur.end) {
+      const std::vector<char>& block{cur.reader->NextBlock()};
+      cur.pos = block.data();
+      cur.end = block.data() + block.size();
+      if (block.empty()) {
+        return;
+      }
+    }
+    T rec;
+    std::memcpy(&rec, cur.pos, sizeof(T));
+    cur.pos += sizeof(T);
+    heads.emplace(rec, idx);
+  };
+
+  for (size_t idx = 0; idx < cursors.size(); idx++) {
+    pull(idx);
+  }
+
+  RunWriter out(out_path, block_bytes);
+  while (!heads.empty()) {
+    Head head{heads.top()};
+    heads.pop();
+    out.Write(reinterpret_cast<const char*>(&head.first), sizeof(T));
+    pull(head.second);
+  }
+  const bool read_all{std::none_of(cursors.begin(), cursors.end(),
+                                   [](const Cursor& cursor) { return cursor.reader->Failed(); })};
+  return out.Close() && read_all;
+}
+
+/// \brief External merge sort of a binary file of fixed-size records. The input is split into sorted runs that fit
+/// in the memory budget, the runs are spilled to temporary files and then k-way merged with read-ahead buffers.
+/// \tparam T Record type, must be trivially copyable.
+/// \tparam Compare Less-than comparator.
+/// \param in_path File to sort, its size must be a multiple of sizeof(T).
+/// \param out_path Sorted output file, may be the same as in_path.
+/// \param config Memory and disk limits.
+/// \param comp The comparator.
+/// \return True on success. False if a file could not be read/written, or if the budgets are too small.
+/// \link <a href="https://en.wikipedia.org/wiki/External_sorting">External sorting, Wikipedia.</a>
+template<typename T, typename Compare = std::less<T>>
+bool External(const std::string& in_path, const std::string& out_path, const ExternalConfig& config = {},
+              Compare comp = Compare{})
+{
+  static_assert(std::is_trivially_copyable_v<T>, "External sort needs fixed-size POD records.");
+  constexpr size_t kMinBlockBytes{4096};
+
+  long long total_bytes{FileBytes(in_path)};
+  if (total_bytes < 0 || total_bytes % sizeof(T) != 0 || config.memory_budget < sizeof(T)) {
+    return false;
+  }
+  const size_t run_records{config.memory_budget / sizeof(T)};
+  const size_t block_bytes{std::max(kMinBlockBytes / sizeof(T), size_t{1}) * sizeof(T)};
+  RunFiles files(config);
+  std::vector<std::string> runs;
+
+  // Generate sorted runs.
+  {
+    std::ifstream in(in_path, std::ios::binary);
+    std::vector<T> run;
+    size_t left{static_cast<size_t>(total_bytes) / sizeof(T)};
+
+    while (left > 0) {
+      run.resize(std::min(left, run_records));
+      left -= run.size();
+      if (!in.read(reinterpret_cast<char*>(run.data()), run.size() * sizeof(T))) {
+        return false;
+      }
+
+      Heap(run.begin(), run.end(), comp);
+
+      std::string path{files.Create(run.size() * sizeof(T))};
+      if (path.empty()) {
+        return false;
+      }
+      RunWriter writer(path, block_bytes);
+      writer.Write(reinterpret_cast<const char*>(run.data()), run.size() * sizeof(T));
+      if (!writer.Close()) {
+        return false;
+      }
+      runs.push_back(path);
+    }
+  }
+
+  // Each run needs two blocks (current + read-ahead), plus one block for the output.
+  auto merge_block = [&config, block_bytes](size_t nbr_of_runs) {
+    return std::max(config.memory_budget / (2 * nbr_of_runs + 1) / sizeof(T) * sizeof(T), block_bytes);
+  };
+  const size_t fan_in{std::clamp((std::max(config.memory_budget / block_bytes, size_t{1}) - 1) / 2, size_t{2},
+                                 std::max(config.max_fan_in, size_t{2}))};
+
+  // Intermediate passes, until all runs can be merged at once.
+  while (runs.size() > fan_in) {
+    std::vector<std::string> merged;
+    for (size_t first = 0; first < runs.size(); first += fan_in) {
+      std::vector<std::string> group(runs.begin() + first, runs.begin() + std::min(first + fan_in, runs.size()));
+      if (group.size() == 1) {
+        merged.push_back(group.front());
+        continue;
+      }
+      size_t bytes{0};
+      for (const auto& run : group) {
+        bytes += static_cast<size_t>(FileBytes(run));
+      }
+      std::string path{files.Create(bytes)};
+      if (path.empty() || !MergeRuns<T>(group, path, merge_block(group.size()), comp)) {
+        return false;
+      }
+      for (const auto& run : group) {
+        files.Remove(run);
+      }
+      merged.push_back(path);
+    }
+    runs = merged;
+  }
+
+  return MergeRuns<T>(runs, out_path, merge_block(runs.size()), comp);
+}
 }// namespace algo::sort
 
 #endif//ALGORITHM_SORTING_SORTING_H_PP
@@ -9,24 +9,70 @@
 /// 2015-06-19 Longest common substring
 /// 2015-06-16 Rabin-Karp
 /// 2015-08-07 Levenshtein distance
+/// 2026-10-19 Aho-Corasick
+/// 2026-10-19 SIMD substring search
+/// 2026-10-19 Bit-parallel and bounded Levenshtein distance
+/// 2026-10-19 Suffix array
+/// 2026-10-19 FM-index
+/// 2026-10-19 Similarity index
+/// 2026-10-19 Run-length codec
+/// 2026-10-19 Lazy permutations with rank and unrank
+/// 2026-10-19 Rolling hashes, content-defined chunking and dedup
 ///
 
 #ifndef ALGORITHM_SRC_STRING_STRING_HPP_
 #define ALGORITHM_SRC_STRING_STRING_HPP_
 
+#include <array>
+#include <cstdint>
+#include <iosfwd>
 #include <set>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace algo::string {
 
-/// \brief Returns the found locations of the pattern in text.
-/// The implementation is based on the Boyer-Moore string-search algorithm.
+/// \brief Returns the found locations of the pattern in text, matches do not overlap.
+/// The implementation runs on SubstringSearcher below, which uses the bad-character rule of Boyer-Moore (Horspool)
+/// when no vector instructions are available.
 /// \param text The text to look for the pattern.
 /// \param pattern The substring to match.
 /// \return A list of locations.
 /// \link <a href="https://en.wikipedia.org/wiki/Boyer%E2%80%93Moore_string-search_algorithm">Boyer-More, Wikipedia.</a>
-std::vector<int> SearchBoyerMoore(std::string& text, const std::string& pattern);
+std::vector<int> SearchBoyerMoore(const std::string& text, const std::string& pattern);
+
+/////////////////////////////////////////////
+/// Substring search
+/////////////////////////////////////////////
+
+/// \brief Single pattern search, prepared once and reusable across texts. With AVX2 or SSE2, blocks of 32 or 16
+/// positions are filtered at once by comparing the first and the last byte of the pattern, and only the candidates
+/// that pass are compared in full. Otherwise the Boyer-Moore-Horspool bad-character table is used to skip ahead. An
+/// empty pattern never matches.
+/// \link <a href="http://0x80.pl/articles/simd-strfind.html">SIMD-friendly algorithms for substring searching, Mula.</a>
+class SubstringSearcher {
+ public:
+  /// \brief Prepares the search for pattern, the pattern is copied.
+  explicit SubstringSearcher(std::string_view pattern);
+
+  /// \brief Returns the first position of the pattern in text at or after from, or std::string_view::npos.
+  size_t Find(std::string_view text, size_t from = 0) const;
+
+  /// \brief Returns all positions of the pattern in text.
+  /// \param text The text to search in.
+  /// \param overlapping If false, a match starts the search again after its end.
+  std::vector<size_t> FindAll(std::string_view text, bool overlapping = true) const;
+
+ private:
+  std::string pattern_;
+  size_t shift_[256]{};///< Horspool shift for the text byte under the last pattern byte.
+};
+
+/// \brief Returns all (overlapping) positions of pattern in text, see SubstringSearcher.
+std::vector<size_t> SearchAll(std::string_view text, std::string_view pattern);
 
 /// \brief Returns the starting positions of the substring pattern in text.
 /// \param text The text to search within.
@@ -35,19 +81,468 @@ std::vector<int> SearchBoyerMoore(std::string& text, const std::string& pattern)
 /// \link <a href="https://en.wikipedia.org/wiki/Rabin–Karp_algorithm">Rabin-Karp, Wikipedia.</a>
 std::vector<int> SearchRabinKarpSingle(const std::string& text, const std::string& pattern);
 
-/// \brief Returns the starting positions of the substring patterns in patterns.
+/// \brief Returns the starting positions of the substring patterns in patterns. Patterns of other lengths than m are
+/// ignored. The search is done with AhoCorasick below.
 /// \param text The text to search within.
 /// \param patterns Substrings to match.
 /// \param m Fixed length.
-/// \return The starting positions
+/// \return The starting positions, ascending and unique.
 /// \link <a href="https://en.wikipedia.org/wiki/Rabin–Karp_algorithm">Rabin-Karp, Wikipedia.</a>
 std::vector<int> SearchRabinKarpMulti(const std::string& text, std::set<std::string> patterns, int m);
 
-/// \brief Returns the longest common substring that exists in A and B.
+/////////////////////////////////////////////
+/// Rolling hashes
+/////////////////////////////////////////////
+
+/// \brief Fills a table with a random 64-bit value for each byte (splitmix64 with a fixed seed).
+constexpr std::array<uint64_t, 256> MakeByteHashesPriv()
+{
+  std::array<uint64_t, 256> table{};
+  uint64_t state{0x9e3779b97f4a7c15ULL};
+  for (uint64_t& value : table) {
+    state += 0x9e3779b97f4a7c15ULL;
+    uint64_t z{state};
+    z = (z ^ (z >> 30u)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27u)) * 0x94d049bb133111ebULL;
+    value = z ^ (z >> 31u);
+  }
+  return table;
+}
+
+/// \brief The byte values used by the rolling hashes, so the same bytes give the same hash in every process.
+inline constexpr std::array<uint64_t, 256> kByteHashes{MakeByteHashesPriv()};
+
+/// \brief Polynomial rolling hash of the last window bytes, modulo 2^64. The bytes are mapped through kByteHashes
+/// first, which spreads short alphabets over all bits.
+/// \link <a href="https://en.wikipedia.org/wiki/Rabin–Karp_algorithm">Rabin-Karp, Wikipedia.</a>
+class RabinHash {
+ public:
+  /// \param window Number of bytes in the window.
+  explicit RabinHash(size_t window);
+
+  /// \brief Adds a byte while the window is filled, the first window bytes must be added this way.
+  void Push(unsigned char in)
+  { hash_ = hash_ * kBase + kByteHashes[in]; }
+
+  /// \brief Slides the window one byte.
+  /// \param out The byte that leaves, window bytes before in.
+  /// \param in The byte that enters.
+  void Roll(unsigned char out, unsigned char in)
+  { hash_ = hash_ * kBase + kByteHashes[in] - kByteHashes[out] * out_factor_; }
+
+  uint64_t Hash() const
+  { return hash_; }
+
+  void Reset()
+  { hash_ = 0; }
+
+ private:
+  static constexpr uint64_t kBase{0x100000001b3ULL};
+  uint64_t out_factor_{1};///< kBase^window, the factor of the leaving byte after the multiplication.
+  uint64_t hash_{0};
+};
+
+/// \brief Buzhash (cyclic polynomial) of the last window bytes, made of rotations and xor only.
+/// \link <a href="https://en.wikipedia.org/wiki/Rolling_hash#Cyclic_polynomial">Cyclic polynomial, Wikipedia.</a>
+class Buzhash {
+ public:
+  /// \param window Number of bytes in the window.
+  explicit Buzhash(size_t window) : shift_{static_cast<unsigned>(window % 64)}
+  {}
+
+  /// \brief Adds a byte while the window is filled, the first window bytes must be added this way.
+  void Push(unsigned char in)
+  { hash_ = Rotate(hash_, 1) ^ kByteHashes[in]; }
+
+  /// \brief Slides the window one byte.
+  /// \param out The byte that leaves, window bytes before in.
+  /// \param in The byte that enters.
+  void Roll(unsigned char out, unsigned char in)
+  { hash_ = Rotate(hash_, 1) ^ Rotate(kByteHashes[out], shift_) ^ kByteHashes[in]; }
+
+  uint64_t Hash() const
+  { return hash_; }
+
+  void Reset()
+  { hash_ = 0; }
+
+ private:
+  static uint64_t Rotate(uint64_t x, unsigned r)
+  { return r == 0 ? x : (x << r) | (x >> (64u - r)); }
+
+  unsigned shift_;
+  uint64_t hash_{0};
+};
+
+/// \brief Gear hash, a shift and an add per byte. Bytes leave the hash by themselves after they are shifted out, so
+/// bit k depends on the last k + 1 bytes and there is no explicit window. Used by Chunker.
+class GearHash {
+ public:
+  void Roll(unsigned char in)
+  { hash_ = (hash_ << 1u) + kByteHashes[in]; }
+
+  uint64_t Hash() const
+  { return hash_; }
+
+  void Reset()
+  { hash_ = 0; }
+
+ private:
+  uint64_t hash_{0};
+};
+
+/////////////////////////////////////////////
+/// Content-defined chunking
+/////////////////////////////////////////////
+
+/// \brief Splits data into chunks at positions that depend on the content only (FastCDC), so an insertion or
+/// deletion changes the chunks around it and not every chunk after it. A cut is made where the Gear hash has a
+/// number of zero bits. Before the average size more bits are required than after it (normalized chunking), which
+/// keeps the sizes close to the average.
+/// \link <a href="https://www.usenix.org/conference/atc16/technical-sessions/presentation/xia">FastCDC, USENIX ATC
+/// 2016.</a>
+class Chunker {
+ public:
+  /// \brief Chunks with the given average size (rounded to a power of 2), between a quarter and 8 times of it.
+  explicit Chunker(size_t average = 8192);
+
+  /// \brief Chunks between min and max bytes, with the average rounded to a power of 2. The sizes are adjusted so
+  /// that 64 <= min <= average <= max.
+  Chunker(size_t min, size_t average, size_t max);
+
+  /// \brief Returns the length of the first chunk of data. When data is shorter than Max and has no cut point, the
+  /// result is data.size(), which is a chunk only at the end of the input, otherwise more data is needed.
+  size_t Cut(std::string_view data) const;
+
+  /// \brief Splits all of data into chunks.
+  /// \return The chunk lengths in order, they add up to data.size().
+  std::vector<size_t> Split(std::string_view data) const;
+
+  size_t Min() const
+  { return min_; }
+
+  size_t Average() const
+  { return average_; }
+
+  size_t Max() const
+  { return max_; }
+
+ private:
+  void SetMasks();
+
+  size_t min_;
+  size_t average_;
+  size_t max_;
+  uint64_t mask_small_{0};///< Mask used before average, more bits so cuts are less likely.
+  uint64_t mask_large_{0};///< Mask used after average.
+};
+
+/// \brief Returns the SHA-256 hash of data, the 32 bytes in the order of the standard's hex notation.
+/// \link <a href="https://csrc.nist.gov/pubs/fips/180-4/upd1/final">FIPS 180-4, Secure Hash Standard.</a>
+std::array<uint8_t, 32> Sha256(std::string_view data);
+
+/// \brief A chunk of an input added to a DedupIndex.
+struct ChunkRef {
+  uint32_t input; ///< The id returned by DedupIndex::Add.
+  uint64_t offset;///< Start of the chunk in the input.
+  uint64_t length;
+
+  bool operator==(const ChunkRef& other) const
+  { return input == other.input && offset == other.offset && length == other.length; }
+};
+
+/// \brief A chunk with the same content as an earlier chunk.
+struct Duplicate {
+  ChunkRef chunk;
+  ChunkRef original;///< The first chunk seen with this content.
+};
+
+/// \brief Finds duplicate chunks across inputs. Each input is split by a Chunker and each chunk is identified by the
+/// SHA-256 hash of its content, the content itself is not kept, so memory grows with the number of unique chunks
+/// only. Two different chunks are reported as duplicates only if they are a SHA-256 collision.
+class DedupIndex {
+ public:
+  explicit DedupIndex(Chunker chunker = Chunker{});
+
+  /// \brief Chunks data and records its chunks.
+  /// \return The id of the input, used in ChunkRef.
+  uint32_t Add(std::string_view data);
+
+  /// \brief Chunks a stream, reading it in blocks so only about 2 * Chunker::Max bytes are held at a time.
+  /// \param in The stream.
+  /// \param id Set to the id of the input.
+  /// \return False if reading failed, the chunks read until then are kept.
+  bool Add(std::istream& in, uint32_t& id);
+
+  /// \brief The duplicate chunks, in the order they were added.
+  const std::vector<Duplicate>& Duplicates() const
+  { return duplicates_; }
+
+  /// \brief Number of bytes added.
+  uint64_t TotalBytes() const
+  { return total_bytes_; }
+
+  /// \brief Number of bytes in the first chunk of each content, what a deduplicated store would hold.
+  uint64_t UniqueBytes() const
+  { return unique_bytes_; }
+
+  /// \brief Number of distinct chunks.
+  size_t UniqueChunks() const
+  { return chunks_.size(); }
+
+ private:
+  using Digest = std::array<uint8_t, 32>;
+
+  /// \brief The first bytes of the digest, which are already uniformly distributed.
+  struct DigestHash {
+    size_t operator()(const Digest& digest) const
+    {
+      size_t hash{0};
+      for (size_t i = 0; i < sizeof(size_t); i++) {
+        hash = hash << 8u | digest[i];
+      }
+      return hash;
+    }
+  };
+
+  void AddChunk(std::string_view chunk, uint32_t input, uint64_t offset);
+
+  Chunker chunker_;
+  std::unordered_map<Digest, ChunkRef, DigestHash> chunks_;
+  std::vector<Duplicate> duplicates_;
+  uint32_t inputs_{0};
+  uint64_t total_bytes_{0};
+  uint64_t unique_bytes_{0};
+};
+
+/////////////////////////////////////////////
+/// Aho-Corasick
+/////////////////////////////////////////////
+
+/// \brief A match of a pattern in a text.
+struct Match {
+  uint64_t position;///< Start of the match in the text, or in the stream when scanning chunks.
+  uint32_t pattern; ///< Index of the matched pattern.
+
+  bool operator==(const Match& other) const
+  { return position == other.position && pattern == other.pattern; }
+};
+
+/// \brief Multi-pattern matcher. The patterns are compiled once into a deterministic automaton that finds all
+/// (overlapping) occurrences of all patterns in one pass over the text, in time linear in the text length plus the
+/// number of matches, independent of the number of patterns.
+///
+/// The transitions are stored in one dense table, one row per trie node. The bytes are first mapped to classes, where
+/// all bytes that occur in no pattern share one class, so a row has one column per distinct pattern byte plus one. The
+/// table has (total pattern length + 1) rows at most.
+/// \link <a href="https://en.wikipedia.org/wiki/Aho%E2%80%93Corasick_algorithm">Aho-Corasick, Wikipedia.</a>
+class AhoCorasick {
+ public:
+  /// \brief Streaming scan: text can be fed in chunks and matches that cross the chunk boundaries are found.
+  class Scanner {
+   public:
+    explicit Scanner(const AhoCorasick& automaton) : automaton_(&automaton)
+    {}
+
+    /// \brief Scans the next chunk of the stream.
+    /// \param chunk The next chunk.
+    /// \param matches The matches that end in the chunk are appended here, with positions in the stream.
+    void Feed(std::string_view chunk, std::vector<Match>& matches);
+
+    /// \brief Starts over on a new stream.
+    void Reset()
+    {
+      state_ = 0;
+      offset_ = 0;
+    }
+
+    /// \brief Returns the number of bytes scanned.
+    uint64_t Offset() const
+    { return offset_; }
+
+   private:
+    const AhoCorasick* automaton_;
+    uint32_t state_{0};
+    uint64_t offset_{0};
+  };
+
+  /// \brief Builds the automaton. Empty patterns never match. If the table would need more than 2^31 entries, the
+  /// automaton is left empty and Valid() returns false.
+  /// \param patterns The patterns to search for, matches refer to them by index.
+  explicit AhoCorasick(const std::vector<std::string>& patterns);
+
+  /// \brief Returns all matches in text, ordered by their end position, longer matches first for the same end.
+  std::vector<Match> Search(std::string_view text) const;
+
+  /// \brief Returns true if any pattern occurs in text, it stops at the first match.
+  bool Contains(std::string_view text) const;
+
+  /// \brief Returns false if the patterns were too many to build the automaton.
+  bool Valid() const
+  { return !delta_.empty(); }
+
+  /// \brief Returns the number of states.
+  size_t States() const
+  { return classes_ == 0 ? 0 : delta_.size() / classes_; }
+
+ private:
+  /// Set in a transition if the target state has matches.
+  static constexpr uint32_t kOutputBit{1u << 31u};
+
+  /// Walks text from state (a row offset), appending the matches with positions relative to offset.
+  uint32_t Scan(std::string_view text, uint32_t state, uint64_t offset, std::vector<Match>* matches) const;
+
+  uint8_t byte_class_[256]{};
+  uint32_t classes_{0};
+  std::vector<uint32_t> delta_;     ///< Row offset (state * classes_) of the next state, plus kOutputBit.
+  std::vector<uint32_t> out_begin_; ///< Patterns that end in state s: out_[out_begin_[s] ... out_begin_[s + 1]).
+  std::vector<uint32_t> out_;
+  std::vector<uint32_t> dict_link_; ///< Longest proper suffix state with own patterns, 0 if none.
+  std::vector<uint32_t> lengths_;   ///< Pattern lengths.
+};
+
+/// \brief Returns the longest common substring that exists in A and B. If there are several, the one that ends first
+/// in A is returned. Runs in linear time on the suffix array of A and B.
 /// \param A input string.
 /// \param B input string.
 /// \return Longest common substring of A and B.
-std::string LongestCommonSubstring(std::string A, std::string B);
+std::string LongestCommonSubstring(const std::string& A, const std::string& B);
+
+/////////////////////////////////////////////
+/// Suffix array
+/////////////////////////////////////////////
+
+/// \brief Returns the suffix array of text: the start positions of all suffixes in lexicographic order. Built in
+/// linear time with SA-IS. The text must be shorter than 2^32 - 1 characters.
+/// \param text The text.
+/// \return The suffix array.
+/// \link <a href="https://doi.org/10.1109/TC.2010.188">Two efficient algorithms for linear time suffix array
+/// construction, Nong, Zhang and Chan.</a>
+std::vector<uint32_t> BuildSuffixArray(std::string_view text);
+
+/// \brief Returns the longest common prefix array in linear time with Kasai's algorithm: lcp[i] is the length of the
+/// longest common prefix of the suffixes sa[i - 1] and sa[i], lcp[0] = 0.
+/// \param text The text.
+/// \param sa The suffix array of text.
+/// \return The LCP array.
+std::vector<uint32_t> BuildLcp(std::string_view text, const std::vector<uint32_t>& sa);
+
+/// \brief Substring index over a text. The text is searched by binary search over the suffix array, a pattern of
+/// length m is found in O(m log n).
+class SuffixArray {
+ public:
+  /// \brief Builds the suffix array and the LCP array of text, the text is copied.
+  explicit SuffixArray(std::string text);
+
+  /// \brief Returns the number of occurrences of pattern.
+  size_t Count(std::string_view pattern) const;
+
+  /// \brief Returns the positions of pattern, ascending.
+  std::vector<size_t> Locate(std::string_view pattern) const;
+
+  /// \brief Returns the text.
+  const std::string& Text() const
+  { return text_; }
+
+  /// \brief Returns the suffix array.
+  const std::vector<uint32_t>& Suffixes() const
+  { return sa_; }
+
+  /// \brief Returns the LCP array.
+  const std::vector<uint32_t>& Lcp() const
+  { return lcp_; }
+
+ private:
+  /// Returns [first, last) in the suffix array of the suffixes that start with pattern.
+  std::pair<size_t, size_t> Range(std::string_view pattern) const;
+
+  std::string text_;
+  std::vector<uint32_t> sa_;
+  std::vector<uint32_t> lcp_;
+};
+
+/////////////////////////////////////////////
+/// FM-index
+/////////////////////////////////////////////
+
+/// \brief Full-text index that answers count and locate queries without the text. It stores the Burrows-Wheeler
+/// transform of the text in a wavelet matrix (8 bit vectors with rank support, about 1.1 bytes per character) and every
+/// sample_rate-th suffix array value. Counting a pattern of length m takes O(m) rank queries, and locating each
+/// occurrence takes at most sample_rate more.
+///
+/// The index is one flat array of 64-bit words, so it can be written to a file and used directly from memory that is
+/// owned elsewhere, for example a memory mapped file (see Attach). The file is in the byte order of the machine.
+/// \link <a href="https://doi.org/10.1109/SFCS.2000.892127">Opportunistic data structures with applications, Ferragina
+/// and Manzini.</a>
+class FmIndex {
+ public:
+  FmIndex() = default;
+
+  /// \brief Builds the index, the text can be dropped afterwards. The text must be shorter than 2^32 - 1 characters.
+  /// \param text The text to index.
+  /// \param sample_rate Every sample_rate-th text position is stored, larger means less memory and slower Locate.
+  explicit FmIndex(std::string_view text, uint32_t sample_rate = 32);
+
+  /// \brief Returns the number of occurrences of pattern.
+  size_t Count(std::string_view pattern) const;
+
+  /// \brief Returns the positions of pattern in the text, ascending.
+  std::vector<size_t> Locate(std::string_view pattern) const;
+
+  /// \brief Returns the length of the indexed text.
+  size_t Size() const;
+
+  /// \brief Writes the index to a file.
+  /// \return True if the file was written.
+  bool Save(const std::string& path) const;
+
+  /// \brief Reads an index written by Save into memory. The file is not trusted: its tables are checked against each
+  /// other and against the bit vectors, which reads the whole file once.
+  /// \return True if the file held a consistent index, otherwise the index is left unchanged.
+  bool Load(const std::string& path);
+
+  /// \brief Uses an index written by Save from a buffer without copying it, the buffer must stay valid and unchanged
+  /// while the index is used.
+  /// The buffer is checked like in Load, which touches every page of it once.
+  /// \param data The contents of the file, aligned to 8 bytes.
+  /// \param bytes Size of the buffer.
+  /// \return True if the buffer held a consistent index, otherwise the index is left unchanged.
+  bool Attach(const void* data, size_t bytes);
+
+  /// \brief Returns the size of the index in bytes.
+  size_t Bytes() const
+  { return words_ * sizeof(uint64_t); }
+
+ private:
+  /// Word offsets of the parts of the index, given by the text length and the number of samples.
+  struct Layout {
+    size_t rows{0};
+    size_t bit_words{0};
+    size_t rank_words{0};
+    size_t counts{0};      ///< C: number of symbols smaller than c, the end marker included.
+    size_t starts{0};      ///< Position of the first c on the last wavelet level.
+    size_t zeros{0};       ///< Zeros on each wavelet level.
+    size_t levels{0};      ///< 8 x (bits, ranks).
+    size_t sampled{0};     ///< Bits and ranks marking the sampled rows.
+    size_t samples{0};     ///< Text positions of the sampled rows, 32 bits each.
+    size_t total{0};
+  };
+
+  static Layout MakeLayout(size_t n, size_t sample_count);
+  bool Bind(const uint64_t* data, size_t words);
+  const uint64_t* Base() const
+  { return external_ != nullptr ? external_ : storage_.data(); }
+
+  /// Occurrences of c in the BWT before row.
+  size_t Rank(unsigned char c, size_t row) const;
+  /// Row of the suffix that starts one position earlier.
+  size_t LastToFirst(size_t row) const;
+
+  std::vector<uint64_t> storage_;
+  const uint64_t* external_{nullptr};
+  size_t words_{0};
+  Layout layout_;
+};
 
 /// \brief Generates all permutations of the input string str using Heap's algorithm.
 /// \param str The input string.
@@ -55,6 +550,54 @@ std::string LongestCommonSubstring(std::string A, std::string B);
 /// \link <a href="https://en.wikipedia.org/wiki/Heap%27s_algorithm">Heap's algorithm, Wikipedia.</a>
 std::vector<std::string> GenerateAllPermutations(std::string& str);
 
+/// \brief Generates the distinct permutations of a string in lexicographic order, one at a time. The permutations are
+/// produced in place with std::next_permutation, so there is one string and no allocation after construction.
+///
+/// A range of ranks can be given, see PermutationRank, so the permutations can be split between threads.
+class PermutationGenerator {
+ public:
+  /// \brief Generates all distinct permutations of str.
+  /// \param str The characters to permute, in any order.
+  explicit PermutationGenerator(std::string str);
+
+  /// \brief Generates the permutations with rank first, first + 1, ..., first + count - 1. Generates none if first is
+  /// out of range.
+  /// \param str The characters to permute, in any order.
+  /// \param first Rank of the first permutation.
+  /// \param count The maximum number of permutations.
+  PermutationGenerator(std::string str, uint64_t first, uint64_t count);
+
+  /// \brief Moves to the next permutation, the first call moves to the first one.
+  /// \return False if there are no more permutations.
+  bool Next();
+
+  /// \brief The current permutation, valid after Next returned true.
+  const std::string& Current() const
+  { return current_; }
+
+ private:
+  std::string current_;
+  uint64_t remaining_;
+  bool started_{false};
+};
+
+/// \brief Returns the number of distinct permutations of str, n! / (n_1! n_2! ... n_k!) where n_i are the counts of
+/// the distinct characters.
+/// \param str The input string.
+/// \return The number of permutations, 0 if it does not fit in 64 bits.
+uint64_t CountPermutations(std::string_view str);
+
+/// \brief Returns the position of perm in the lexicographic order of the distinct permutations of its characters.
+/// \param perm The permutation.
+/// \return The rank, UINT64_MAX if CountPermutations(perm) does not fit in 64 bits.
+uint64_t PermutationRank(std::string_view perm);
+
+/// \brief Returns the permutation of the characters of str with the given rank, the inverse of PermutationRank.
+/// \param str The characters to permute, in any order.
+/// \param rank The rank, less than CountPermutations(str).
+/// \return The permutation, empty if rank is out of range.
+std::string PermutationUnrank(std::string_view str, uint64_t rank);
+
 /// \brief Checks if str2 is a rotation of str1, e.g: atc is a rotation of cat.
 /// \param str1 First string.
 /// \param str2 Second string,
@@ -66,6 +609,94 @@ bool IsRotated(const std::string& str1, const std::string& str2);
 /// \return Compressed string if shorter than input.
 std::string Compress(const std::string& str);
 
+/////////////////////////////////////////////
+/// Run-length codec
+/////////////////////////////////////////////
+
+/// \brief Streaming run-length encoder. The output is a sequence of tokens, each a varint (LEB128) header
+/// length << 1 | is_run, followed by the length bytes of a literal or the one byte of a run. Runs of at least three
+/// equal bytes become run tokens and everything else is gathered in literals of at most 64 KiB, so the memory use is
+/// constant. The output does not depend on how the input is split into chunks.
+class RleEncoder {
+ public:
+  /// \brief Encodes the next chunk of the input, appending to out. The last run is held back until the next chunk or
+  /// Finish, since it may continue.
+  void Feed(std::string_view chunk, std::string& out);
+
+  /// \brief Appends the held back data to out, the encoder can then be used for a new input.
+  void Finish(std::string& out);
+
+ private:
+  void CloseRun(std::string& out);
+  void AppendLiteral(const char* data, size_t n, std::string& out);
+  void FlushLiteral(std::string& out);
+
+  std::string literal_;
+  char run_byte_{0};
+  uint64_t run_length_{0};
+};
+
+/// \brief Streaming run-length decoder, the input can be split anywhere, also inside a token.
+class RleDecoder {
+ public:
+  /// \param max_output The input is malformed if it decodes to more bytes. The headers are not trusted, a run is
+  /// checked against the limit before it is written. Without a limit, a run appended to a string is only checked
+  /// against max_size, so set one when decoding untrusted input to memory.
+  explicit RleDecoder(uint64_t max_output = UINT64_MAX) : max_output_{max_output}
+  {}
+
+  /// \brief Decodes the next chunk of the input, appending to out.
+  /// \return False if the input is malformed or out can not hold the output, then all following calls fail too.
+  bool Feed(std::string_view chunk, std::string& out);
+
+  /// \brief Decodes the next chunk of the input into a stream, long runs are written in blocks so the memory use is
+  /// constant.
+  /// \return False if the input is malformed or the stream failed.
+  bool Feed(std::string_view chunk, std::ostream& out);
+
+  /// \brief Returns true if the input so far ends between two tokens and was well formed.
+  bool Finish() const
+  { return !failed_ && state_ == State::kHeader && shift_ == 0; }
+
+ private:
+  enum class State { kHeader, kLiteral, kRunByte };
+
+  template<typename Sink>
+  bool FeedPriv(std::string_view chunk, Sink& sink);
+
+  State state_{State::kHeader};
+  uint64_t header_{0};
+  unsigned shift_{0};
+  uint64_t remaining_{0};
+  uint64_t max_output_;
+  uint64_t output_{0};
+  bool failed_{false};
+};
+
+/// \brief Returns data encoded with RleEncoder.
+std::string RleEncode(std::string_view data);
+
+/// \brief Decodes data encoded with RleEncoder.
+/// \param encoded The encoded data.
+/// \param out The decoded data.
+/// \param max_output Most bytes to decode, a few bytes of input can claim a run of any length.
+/// \return False if encoded is malformed or truncated, or decodes to more than max_output bytes.
+bool RleDecode(std::string_view encoded, std::string& out, uint64_t max_output = uint64_t{1} << 32u);
+
+/// \brief Encodes a stream chunk by chunk, in constant memory.
+/// \param in The input.
+/// \param out The encoded output.
+/// \param chunk_bytes Bytes read at a time.
+/// \return False if reading or writing failed.
+bool RleEncode(std::istream& in, std::ostream& out, size_t chunk_bytes = size_t{1} << 20u);
+
+/// \brief Decodes a stream chunk by chunk, in constant memory.
+/// \param in The encoded input.
+/// \param out The decoded output.
+/// \param chunk_bytes Bytes read at a time.
+/// \return False if the input is malformed or truncated, or reading or writing failed.
+bool RleDecode(std::istream& in, std::ostream& out, size_t chunk_bytes = size_t{1} << 20u);
+
 /// \brief Tests if the input string has unique chars. Only works fo ASCII [0...255].
 /// \param str The string to test.
 /// \return True if unique chars otherwise false.
@@ -78,13 +709,35 @@ bool HasUniqueChars(const std::string& str);
 namespace metric {
 
 /// \brief Returns the Levenshtein distance between two strings. This is a string metric for measuring the
-/// difference between two strings.
+/// difference between two strings. It uses the bit-parallel algorithm of Myers, which processes 64 characters of the
+/// shorter string per machine word, in O(n * m / 64) time.
 /// \param word_a First word.
 /// \param word_b Second word.
 /// \return Calculated distance.
 /// \link <a href="https://en.wikipedia.org/wiki/Levenshtein_distance">Levenshtein distance, Wikipedia.</a>
+/// \link <a href="https://doi.org/10.1145/316542.316550">A fast bit-vector algorithm for approximate string matching
+/// based on dynamic programming, Myers.</a>
 int Levenshtein(const std::string& word_a, const std::string& word_b);
 
+/// \brief Returns the Levenshtein distance between two strings if it is at most max_distance, otherwise
+/// max_distance + 1. The computation stops as soon as the distance is known to exceed max_distance, and for long
+/// strings and small cutoffs only the diagonal band of width 2 * max_distance + 1 is computed.
+/// \param word_a First word.
+/// \param word_b Second word.
+/// \param max_distance The cutoff.
+/// \return The distance, or max_distance + 1 if it is greater than max_distance, -1 if max_distance is negative.
+int LevenshteinBounded(const std::string& word_a, const std::string& word_b, int max_distance);
+
+/// \brief Returns the Levenshtein distance between query and each candidate. The bit masks of the query are computed
+/// once, and for queries of at most 64 characters four candidates are processed at once with AVX2.
+/// \param query The word to compare.
+/// \param candidates The words to compare with.
+/// \param max_distance The cutoff, distances greater than max_distance are returned as max_distance + 1. Negative
+/// means no cutoff.
+/// \return The distances, in the order of candidates.
+std::vector<int> LevenshteinBatch(const std::string& query, const std::vector<std::string>& candidates,
+                                  int max_distance = -1);
+
 /// \brief Returns the Hamming distance between word_a and word_b.
 /// \param word_a First word.
 /// \param word_b Second word.
@@ -106,6 +759,74 @@ double Dice(const std::string& word_a, const std::string& word_b);
 /// \link <a href="https://en.wikipedia.org/wiki/Jaro–Winkler_distance">Jaro-Winkler, Wikipedia.</a>
 double JaroWinkler(const std::string& word_a, const std::string& word_b);
 
+/////////////////////////////////////////////
+/// Similarity search
+/////////////////////////////////////////////
+
+enum class Similarity {
+  Dice,       ///< Dice's coefficient of the bigrams, as Dice(query, entry).
+  JaroWinkler ///< Jaro-Winkler, as JaroWinkler(query, entry).
+};
+
+/// \brief An entry found by SimilarityIndex.
+struct SimilarityHit {
+  size_t index;///< Position of the entry in the dictionary.
+  double score;///< The similarity.
+};
+
+/// \brief Finds the entries of a dictionary that are at least as similar as a threshold to a query. The entries are
+/// pruned before they are scored:
+/// - Dice: an inverted index from each bigram to the entries that contain it, sorted by the number of bigrams. The
+///   postings of the query bigrams are counted, which gives the number of shared bigrams and therefore the exact score,
+///   and entries too long to reach the threshold are skipped.
+/// - JaroWinkler: only entries whose length is close enough to the query to reach the threshold are scored.
+class SimilarityIndex {
+ public:
+  /// \brief Builds the index over the dictionary entries.
+  explicit SimilarityIndex(std::vector<std::string> entries);
+
+  /// \brief Returns the entries with a similarity of at least threshold to query, ordered by index.
+  /// \param query The word to search for.
+  /// \param threshold The least similarity.
+  /// \param similarity The similarity measure.
+  std::vector<SimilarityHit> Search(const std::string& query, double threshold, Similarity similarity) const;
+
+  /// \brief Searches for many queries, split over threads.
+  /// \param queries The words to search for.
+  /// \param threshold The least similarity.
+  /// \param similarity The similarity measure.
+  /// \param threads Number of threads, 0 means one per hardware thread.
+  /// \return The hits for each query.
+  std::vector<std::vector<SimilarityHit>> Search(const std::vector<std::string>& queries, double threshold,
+                                                 Similarity similarity, unsigned threads = 0) const;
+
+  /// \brief Returns the number of entries.
+  size_t Size() const
+  { return entries_.size(); }
+
+  /// \brief Returns entry i.
+  const std::string& Entry(size_t i) const
+  { return entries_[i]; }
+
+ private:
+  /// Scratch space of one searching thread, a counter per entry and the entries touched.
+  struct Scratch {
+    std::vector<uint32_t> shared;
+    std::vector<uint32_t> touched;
+  };
+
+  std::vector<SimilarityHit> SearchDice(const std::string& query, double threshold, Scratch& scratch) const;
+  std::vector<SimilarityHit> SearchJaroWinkler(const std::string& query, double threshold) const;
+  std::vector<SimilarityHit> SearchPriv(const std::string& query, double threshold, Similarity similarity,
+                                        Scratch& scratch) const;
+
+  std::vector<std::string> entries_;
+  std::vector<uint32_t> bigram_counts_;///< Bigrams of each entry, duplicates included.
+  std::vector<uint32_t> post_begin_;   ///< Entries with bigram g: postings_[post_begin_[g] ... post_begin_[g + 1]).
+  std::vector<uint32_t> postings_;     ///< Sorted by bigram count, then index.
+  std::vector<uint32_t> by_length_;    ///< Entry indices sorted by length.
+};
+
 }// namespace metric
 }// namespace algo::string
 
@@ -8,240 +8,2833 @@
 #include "algo_data_mining.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <queue>
-#include <set>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 
-#include "algo_math.hpp"
+#include "algo_simd.hpp"
 
 namespace algo::data_mining {
 
+/////////////////////////////////////////////
+/// Feature matrix
+/////////////////////////////////////////////
+
+FeatureMatrix::FeatureMatrix(const geometry::Points& points) : FeatureMatrix(points.size(), 2)
+{
+  for (size_t i = 0; i < points.size(); i++) {
+    (*this)(i, 0) = points[i].x;
+    (*this)(i, 1) = points[i].y;
+  }
+}
+
+FeatureMatrix::FeatureMatrix(const std::vector<std::vector<double>>& rows)
+{
+  const size_t cols{rows.empty() ? 0 : rows[0].size()};
+  for (const auto& row : rows) {
+    if (row.size() != cols) {
+      return;
+    }
+  }
+  *this = FeatureMatrix(rows.size(), cols);
+  for (size_t i = 0; i < rows.size(); i++) {
+    for (size_t j = 0; j < cols; j++) {
+      (*this)(i, j) = rows[i][j];
+    }
+  }
+}
+
+std::vector<double> FeatureMatrix::Row(size_t row) const
+{
+  std::vector<double> values(cols_);
+  for (size_t j = 0; j < cols_; j++) {
+    values[j] = (*this)(row, j);
+  }
+  return values;
+}
+
+FeatureMatrix::FeatureMatrix(const FeatureView& view) : FeatureMatrix(view.Rows(), view.Cols())
+{
+  for (size_t j = 0; j < cols_; j++) {
+    std::copy(view.Column(j), view.Column(j) + rows_, Column(j));
+  }
+}
+
+FeatureView FeatureMatrix::Slice(size_t begin, size_t end) const
+{
+  return FeatureView(*this).Slice(begin, end);
+}
+
+FeatureView::FeatureView(const DataFrame& frame) : FeatureView(frame.Features())
+{}
+
+std::vector<double> FeatureView::Row(size_t row) const
+{
+  std::vector<double> values(cols_);
+  for (size_t j = 0; j < cols_; j++) {
+    values[j] = (*this)(row, j);
+  }
+  return values;
+}
+
+FeatureView FeatureView::Slice(size_t begin, size_t end) const
+{
+  end = std::min(end, rows_);
+  begin = std::min(begin, end);
+  return FeatureView(data_ == nullptr ? data_ : data_ + begin, end - begin, cols_, stride_);
+}
+
+FeatureView FeatureView::SliceColumns(size_t begin, size_t end) const
+{
+  end = std::min(end, cols_);
+  begin = std::min(begin, end);
+  return FeatureView(data_ == nullptr ? data_ : data_ + begin * stride_, rows_, end - begin, stride_);
+}
+
+/////////////////////////////////////////////
+/// K-means
+/////////////////////////////////////////////
+
 namespace {
-constexpr double kDblMax{1.79769e+308};
-// Euclidean distance
-constexpr auto Dist2 = [](const geometry::Point& p1, const geometry::Point& p2) {
-  return sqrt(pow(p1.x - p2.x, 2) + pow(p1.y - p2.y, 2));
+
+/// \brief Resolves the number of threads for n items, at least min_chunk items per thread.
+unsigned ThreadCount(unsigned threads, size_t n, size_t min_chunk)
+{
+  if (threads == 0) {
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  return static_cast<unsigned>(std::max<size_t>(std::min<size_t>(threads, n / min_chunk), 1));
+}
+
+/// \brief Splits [0, n) into one contiguous range per thread and calls work(thread, begin, end) on each, the last
+/// range on the calling thread.
+template<typename Work>
+void ParallelFor(size_t n, unsigned threads, const Work& work)
+{
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t + 1 < threads; t++) {
+    workers.emplace_back([&work, t, n, threads]() { work(t, n * t / threads, n * (t + 1) / threads); });
+  }
+  work(threads - 1, n * (threads - 1) / threads, n);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+constexpr size_t kMinRowsPerThread{4096};
+
+/// \brief Finds the nearest of k centroids, stored row by row, for the points begin to end. Writes the index of the
+/// centroid and the squared distance. The first centroid wins ties. The distances are summed over the features in
+/// order with separate multiplications and additions, so all kernels give the same bits.
+using NearestFunc = void (*)(const FeatureView& data, const double* centroids, size_t k, size_t begin, size_t end,
+                             uint32_t* labels, double* dist2);
+
+void NearestScalar(const FeatureView& data, const double* centroids, size_t k, size_t begin, size_t end,
+                   uint32_t* labels, double* dist2)
+{
+  constexpr size_t kBlock{64};
+  const size_t d{data.Cols()};
+  double acc[kBlock];
+
+  for (size_t i0 = begin; i0 < end; i0 += kBlock) {
+    const size_t m{std::min(kBlock, end - i0)};
+    std::fill(dist2 + i0, dist2 + i0 + m, std::numeric_limits<double>::infinity());
+    for (size_t c = 0; c < k; c++) {
+      std::fill(acc, acc + m, 0.0);
+      for (size_t j = 0; j < d; j++) {
+        const double* col{data.Column(j) + i0};
+        const double center{centroids[c * d + j]};
+        for (size_t i = 0; i < m; i++) {
+          const double diff{col[i] - center};
+          acc[i] += diff * diff;
+        }
+      }
+      for (size_t i = 0; i < m; i++) {
+        if (acc[i] < dist2[i0 + i]) {
+          dist2[i0 + i] = acc[i];
+          labels[i0 + i] = static_cast<uint32_t>(c);
+        }
+      }
+    }
+  }
+}
+
+#ifdef ALGO_SIMD_X86
+/// \brief Handles 8 points at a time in two registers, the rest with the scalar kernel.
+ALGO_TARGET_AVX2 void NearestAvx2(const FeatureView& data, const double* centroids, size_t k, size_t begin,
+                                  size_t end, uint32_t* labels, double* dist2)
+{
+  const size_t d{data.Cols()};
+  size_t i{begin};
+  for (; i + 8 <= end; i += 8) {
+    __m256d best0{_mm256_set1_pd(std::numeric_limits<double>::infinity())};
+    __m256d best1{best0};
+    __m256d label0{_mm256_setzero_pd()};
+    __m256d label1{label0};
+    for (size_t c = 0; c < k; c++) {
+      __m256d acc0{_mm256_setzero_pd()};
+      __m256d acc1{_mm256_setzero_pd()};
+      for (size_t j = 0; j < d; j++) {
+        const double* col{data.Column(j) + i};
+        const __m256d center{_mm256_set1_pd(centroids[c * d + j])};
+        const __m256d diff0{_mm256_sub_pd(_mm256_loadu_pd(col), center)};
+        const __m256d diff1{_mm256_sub_pd(_mm256_loadu_pd(col + 4), center)};
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(diff0, diff0));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(diff1, diff1));
+      }
+      const __m256d index{_mm256_set1_pd(static_cast<double>(c))};
+      const __m256d less0{_mm256_cmp_pd(acc0, best0, _CMP_LT_OQ)};
+      const __m256d less1{_mm256_cmp_pd(acc1, best1, _CMP_LT_OQ)};
+      best0 = _mm256_blendv_pd(best0, acc0, less0);
+      best1 = _mm256_blendv_pd(best1, acc1, less1);
+      label0 = _mm256_blendv_pd(label0, index, less0);
+      label1 = _mm256_blendv_pd(label1, index, less1);
+    }
+    _mm256_storeu_pd(dist2 + i, best0);
+    _mm256_storeu_pd(dist2 + i + 4, best1);
+    alignas(32) double index[8];
+    _mm256_store_pd(index, label0);
+    _mm256_store_pd(index + 4, label1);
+    for (size_t l = 0; l < 8; l++) {
+      labels[i + l] = static_cast<uint32_t>(index[l]);
+    }
+  }
+  NearestScalar(data, centroids, k, i, end, labels, dist2);
+}
+#endif
+
+void Nearest(const FeatureView& data, const double* centroids, size_t k, size_t begin, size_t end, uint32_t* labels,
+             double* dist2)
+{
+  static const NearestFunc kernel = []() -> NearestFunc {
+#ifdef ALGO_SIMD_X86
+    if (simd::HasAvx2()) {
+      return NearestAvx2;
+    }
+#endif
+    return NearestScalar;
+  }();
+  kernel(data, centroids, k, begin, end, labels, dist2);
+}
+
+/// \brief Picks k centroids from the rows of data with k-means++.
+/// \return The centroids row by row.
+std::vector<double> SeedPlusPlus(const FeatureView& data, size_t k, std::mt19937_64& gen, unsigned threads)
+{
+  const size_t n{data.Rows()};
+  const size_t d{data.Cols()};
+  std::vector<double> centroids(k * d);
+  std::vector<double> min_dist2(n, std::numeric_limits<double>::infinity());
+  std::vector<double> dist2(n);
+  std::vector<uint32_t> unused(n);
+
+  size_t pick{std::uniform_int_distribution<size_t>{0, n - 1}(gen)};
+  for (size_t c = 0; c < k; c++) {
+    for (size_t j = 0; j < d; j++) {
+      centroids[c * d + j] = data(pick, j);
+    }
+    if (c + 1 == k) {
+      break;
+    }
+    const double* centroid{centroids.data() + c * d};
+    std::vector<double> partial(threads, 0.0);
+    ParallelFor(n, threads, [&](unsigned t, size_t begin, size_t end) {
+      Nearest(data, centroid, 1, begin, end, unused.data(), dist2.data());
+      for (size_t i = begin; i < end; i++) {
+        min_dist2[i] = std::min(min_dist2[i], dist2[i]);
+        partial[t] += min_dist2[i];
+      }
+    });
+
+    double total{0.0};
+    for (double sum : partial) {
+      total += sum;
+    }
+    if (total <= 0.0) {
+      // Fewer distinct points than clusters, the remaining centroids are duplicates.
+      pick = std::uniform_int_distribution<size_t>{0, n - 1}(gen);
+      continue;
+    }
+    double r{std::uniform_real_distribution<double>{0.0, total}(gen)};
+    pick = n - 1;
+    for (size_t i = 0; i < n; i++) {
+      r -= min_dist2[i];
+      if (r < 0.0) {
+        pick = i;
+        break;
+      }
+    }
+  }
+  return centroids;
+}
+
+/// \brief The mean variance of the features, the scale of the convergence tolerance.
+double MeanVariance(const FeatureView& data)
+{
+  const size_t n{data.Rows()};
+  double sum{0.0};
+  for (size_t j = 0; j < data.Cols(); j++) {
+    const double* col{data.Column(j)};
+    double mean{0.0};
+    for (size_t i = 0; i < n; i++) {
+      mean += col[i];
+    }
+    mean /= static_cast<double>(n);
+    double var{0.0};
+    for (size_t i = 0; i < n; i++) {
+      var += (col[i] - mean) * (col[i] - mean);
+    }
+    sum += var / static_cast<double>(n);
+  }
+  return sum / static_cast<double>(data.Cols());
+}
+
+/// \brief Per thread sums of the points in each cluster.
+struct Accumulator {
+  std::vector<double> sums;
+  std::vector<size_t> counts;
+  uint64_t distances{0};
+};
+
+/// \brief Sums the points begin to end per cluster.
+void SumClusters(const FeatureView& data, const uint32_t* labels, size_t k, size_t begin, size_t end,
+                 Accumulator& acc)
+{
+  const size_t d{data.Cols()};
+  acc.sums.assign(k * d, 0.0);
+  acc.counts.assign(k, 0);
+  for (size_t i = begin; i < end; i++) {
+    acc.counts[labels[i]]++;
+  }
+  for (size_t j = 0; j < d; j++) {
+    const double* col{data.Column(j)};
+    for (size_t i = begin; i < end; i++) {
+      acc.sums[labels[i] * d + j] += col[i];
+    }
+  }
+}
+
+void CopyRow(const FeatureView& data, size_t i, double* row)
+{
+  for (size_t j = 0; j < data.Cols(); j++) {
+    row[j] = data(i, j);
+  }
+}
+
+/// \brief The squared distance between a point and a centroid, summed in the same order as the Nearest kernels.
+double Distance2(const double* row, const double* centroid, size_t d)
+{
+  double sum{0.0};
+  for (size_t j = 0; j < d; j++) {
+    const double diff{row[j] - centroid[j]};
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+/// \brief The assignment step of Lloyd's algorithm, all distances every time.
+class LloydStep {
+ public:
+  explicit LloydStep(size_t n) : dist2_(n)
+  {}
+
+  void Prepare(const std::vector<double>& /*centroids*/, size_t /*k*/, size_t /*d*/,
+               const std::vector<double>& /*moves*/)
+  {}
+
+  void Assign(const FeatureView& data, const std::vector<double>& centroids, size_t k, size_t begin, size_t end,
+              uint32_t* labels, uint64_t& distances)
+  {
+    Nearest(data, centroids.data(), k, begin, end, labels, dist2_.data());
+    distances += (end - begin) * k;
+  }
+
+ private:
+  std::vector<double> dist2_;
+};
+
+/// \brief Computes the distances from a point to all centroids and finds the nearest and the second nearest, as
+/// Nearest does.
+/// \return The squared distance to the nearest.
+double NearestTwo(const double* row, const std::vector<double>& centroids, size_t k, size_t d, uint32_t& best,
+                  double& second2)
+{
+  double best2{std::numeric_limits<double>::infinity()};
+  second2 = std::numeric_limits<double>::infinity();
+  for (size_t c = 0; c < k; c++) {
+    const double dist2{Distance2(row, centroids.data() + c * d, d)};
+    if (dist2 < best2) {
+      second2 = best2;
+      best2 = dist2;
+      best = static_cast<uint32_t>(c);
+    } else if (dist2 < second2) {
+      second2 = dist2;
+    }
+  }
+  return best2;
+}
+
+/// \brief Half the distance from each centroid to its nearest other centroid, and to each other centroid if all is
+/// set. A point closer than that to its centroid cannot be closer to the other one.
+void HalfDistances(const std::vector<double>& centroids, size_t k, size_t d, std::vector<double>& nearest,
+                   std::vector<double>* all)
+{
+  nearest.assign(k, std::numeric_limits<double>::infinity());
+  for (size_t a = 0; a < k; a++) {
+    for (size_t b = a + 1; b < k; b++) {
+      const double half{0.5 * std::sqrt(Distance2(centroids.data() + a * d, centroids.data() + b * d, d))};
+      nearest[a] = std::min(nearest[a], half);
+      nearest[b] = std::min(nearest[b], half);
+      if (all != nullptr) {
+        (*all)[a * k + b] = half;
+        (*all)[b * k + a] = half;
+      }
+    }
+  }
+}
+
+/// \brief Hamerly's assignment step: an upper bound of the distance to the own centroid and a lower bound of the
+/// distance to all others. The point keeps its centroid without computing any distance if the upper bound is below
+/// the lower bound, or below half the distance between its centroid and the nearest other centroid. On equal bounds
+/// the distances are computed, so that a tie goes to the first centroid as in Lloyd's step.
+class HamerlyStep {
+ public:
+  explicit HamerlyStep(size_t n) : upper_(n), lower_(n)
+  {}
+
+  void Prepare(const std::vector<double>& centroids, size_t k, size_t d, const std::vector<double>& moves)
+  {
+    HalfDistances(centroids, k, d, half_, nullptr);
+    // The lower bound moves down by the most any other centroid moved.
+    max_move_ = 0.0;
+    second_move_ = 0.0;
+    for (size_t c = 0; c < k; c++) {
+      if (moves[c] > max_move_) {
+        second_move_ = max_move_;
+        max_move_ = moves[c];
+        max_moved_ = c;
+      } else if (moves[c] > second_move_) {
+        second_move_ = moves[c];
+      }
+    }
+    moves_ = &moves;
+    first_ = passes_++ == 0;
+  }
+
+  void Assign(const FeatureView& data, const std::vector<double>& centroids, size_t k, size_t begin, size_t end,
+              uint32_t* labels, uint64_t& distances)
+  {
+    const size_t d{data.Cols()};
+    std::vector<double> row(d);
+    for (size_t i = begin; i < end; i++) {
+      if (!first_) {
+        const uint32_t a{labels[i]};
+        double upper{upper_[i] + (*moves_)[a]};
+        const double lower{lower_[i] - (a == max_moved_ ? second_move_ : max_move_)};
+        const double bound{std::max(half_[a], lower)};
+        lower_[i] = lower;
+        if (upper < bound) {
+          upper_[i] = upper;
+          continue;
+        }
+        CopyRow(data, i, row.data());
+        upper = std::sqrt(Distance2(row.data(), centroids.data() + a * d, d));
+        distances++;
+        if (upper < bound) {
+          upper_[i] = upper;
+          continue;
+        }
+      } else {
+        CopyRow(data, i, row.data());
+      }
+      double second2;
+      upper_[i] = std::sqrt(NearestTwo(row.data(), centroids, k, d, labels[i], second2));
+      lower_[i] = std::sqrt(second2);
+      distances += k;
+    }
+  }
+
+ private:
+  std::vector<double> upper_;
+  std::vector<double> lower_;
+  std::vector<double> half_;
+  const std::vector<double>* moves_{nullptr};
+  double max_move_{0.0};
+  double second_move_{0.0};
+  size_t max_moved_{0};
+  size_t passes_{0};
+  bool first_{true};
+};
+
+/// \brief Elkan's assignment step: a lower bound of the distance to every centroid, k per point, and the distances
+/// between all centroids. A distance is only computed if both the lower bound and half the distance between the
+/// centroids are below the upper bound.
+class ElkanStep {
+ public:
+  ElkanStep(size_t n, size_t k) : upper_(n), lower_(n * k), between_(k * k)
+  {}
+
+  void Prepare(const std::vector<double>& centroids, size_t k, size_t d, const std::vector<double>& moves)
+  {
+    HalfDistances(centroids, k, d, half_, &between_);
+    moves_ = &moves;
+    first_ = passes_++ == 0;
+  }
+
+  void Assign(const FeatureView& data, const std::vector<double>& centroids, size_t k, size_t begin, size_t end,
+              uint32_t* labels, uint64_t& distances)
+  {
+    const size_t d{data.Cols()};
+    std::vector<double> row(d);
+    for (size_t i = begin; i < end; i++) {
+      double* lower{lower_.data() + i * k};
+      if (first_) {
+        CopyRow(data, i, row.data());
+        double best2{std::numeric_limits<double>::infinity()};
+        for (size_t c = 0; c < k; c++) {
+          const double dist2{Distance2(row.data(), centroids.data() + c * d, d)};
+          lower[c] = std::sqrt(dist2);
+          if (dist2 < best2) {
+            best2 = dist2;
+            labels[i] = static_cast<uint32_t>(c);
+          }
+        }
+        upper_[i] = std::sqrt(best2);
+        distances += k;
+        continue;
+      }
+
+      uint32_t a{labels[i]};
+      double upper{upper_[i] + (*moves_)[a]};
+      for (size_t c = 0; c < k; c++) {
+        lower[c] = std::max(lower[c] - (*moves_)[c], 0.0);
+      }
+      if (upper < half_[a]) {
+        upper_[i] = upper;
+        continue;
+      }
+
+      bool tight{false};
+      double upper2{0.0};
+      for (size_t c = 0; c < k; c++) {
+        if (c == a || upper < lower[c] || upper < between_[a * k + c]) {
+          continue;
+        }
+        if (!tight) {
+          CopyRow(data, i, row.data());
+          upper2 = Distance2(row.data(), centroids.data() + a * d, d);
+          upper = std::sqrt(upper2);
+          lower[a] = upper;
+          tight = true;
+          distances++;
+          if (upper < lower[c] || upper < between_[a * k + c]) {
+            continue;
+          }
+        }
+        const double dist2{Distance2(row.data(), centroids.data() + c * d, d)};
+        lower[c] = std::sqrt(dist2);
+        distances++;
+        // As Nearest, the first centroid wins ties.
+        if (dist2 < upper2 || (dist2 == upper2 && c < a)) {
+          a = static_cast<uint32_t>(c);
+          upper = lower[c];
+          upper2 = dist2;
+        }
+      }
+      labels[i] = a;
+      upper_[i] = upper;
+    }
+  }
+
+ private:
+  std::vector<double> upper_;
+  std::vector<double> lower_;
+  std::vector<double> half_;
+  std::vector<double> between_;
+  const std::vector<double>* moves_{nullptr};
+  size_t passes_{0};
+  bool first_{true};
 };
 
-}// namespace
+/// \brief Runs K-means with the given assignment step. After each assignment the centroids move to the mean of their
+/// points, and the assignment step gets how far each centroid moved.
+template<typename Step>
+KMeansResult Iterate(const FeatureView& data, size_t k, const KMeansOptions& options, unsigned threads,
+                     std::vector<double> centroids, Step& step)
+{
+  const size_t n{data.Rows()};
+  const size_t d{data.Cols()};
+  const double tolerance{options.tolerance * MeanVariance(data)};
+
+  KMeansResult res;
+  res.labels.resize(n);
+  std::vector<Accumulator> accumulators(threads);
+  std::vector<double> moves(k, 0.0);
+  uint64_t passes{0};
+  bool last{options.max_iterations == 0};
+
+  while (true) {
+    step.Prepare(centroids, k, d, moves);
+    ParallelFor(n, threads, [&](unsigned t, size_t begin, size_t end) {
+      Accumulator& acc{accumulators[t]};
+      acc.distances = 0;
+      step.Assign(data, centroids, k, begin, end, res.labels.data(), acc.distances);
+      if (!last) {
+        SumClusters(data, res.labels.data(), k, begin, end, acc);
+      }
+    });
+    passes++;
+    for (const auto& acc : accumulators) {
+      res.distances += acc.distances;
+    }
+    if (last) {
+      break;
+    }
+    res.iterations++;
+
+    for (size_t t = 1; t < threads; t++) {
+      for (size_t x = 0; x < k * d; x++) {
+        accumulators[0].sums[x] += accumulators[t].sums[x];
+      }
+      for (size_t c = 0; c < k; c++) {
+        accumulators[0].counts[c] += accumulators[t].counts[c];
+      }
+    }
+    double shift{0.0};
+    const Accumulator& total{accumulators[0]};
+    for (size_t c = 0; c < k; c++) {
+      double move2{0.0};
+      if (total.counts[c] != 0) {
+        for (size_t j = 0; j < d; j++) {
+          const double mean{total.sums[c * d + j] / static_cast<double>(total.counts[c])};
+          move2 += (mean - centroids[c * d + j]) * (mean - centroids[c * d + j]);
+          centroids[c * d + j] = mean;
+        }
+      }
+      moves[c] = std::sqrt(move2);
+      shift += move2;
+    }
+    res.converged = shift <= tolerance;
+    last = res.converged || res.iterations >= options.max_iterations;
+  }
+  res.skipped_distances = passes * n * k - res.distances;
+
+  // The inertia of the final labels.
+  std::vector<double> partial(threads, 0.0);
+  ParallelFor(n, threads, [&](unsigned t, size_t begin, size_t end) {
+    std::vector<double> row(d);
+    for (size_t i = begin; i < end; i++) {
+      CopyRow(data, i, row.data());
+      partial[t] += Distance2(row.data(), centroids.data() + res.labels[i] * d, d);
+    }
+  });
+  for (double sum : partial) {
+    res.inertia += sum;
+  }
+
+  res.centroids = FeatureMatrix(k, d);
+  for (size_t c = 0; c < k; c++) {
+    for (size_t j = 0; j < d; j++) {
+      res.centroids(c, j) = centroids[c * d + j];
+    }
+  }
+  return res;
+}
+
+}// namespace
+
+KMeansResult KMeans(const FeatureView& data, size_t k, const KMeansOptions& options)
+{
+  const size_t n{data.Rows()};
+  if (k == 0 || k > n || data.Cols() == 0 || k > std::numeric_limits<uint32_t>::max()) {
+    return KMeansResult{};
+  }
+  const unsigned threads{ThreadCount(options.threads, n, kMinRowsPerThread)};
+  std::mt19937_64 gen{options.seed};
+  std::vector<double> centroids{SeedPlusPlus(data, k, gen, threads)};
+
+  switch (options.algorithm) {
+    case KMeansAlgorithm::Hamerly: {
+      HamerlyStep step{n};
+      return Iterate(data, k, options, threads, std::move(centroids), step);
+    }
+    case KMeansAlgorithm::Elkan: {
+      ElkanStep step{n, k};
+      return Iterate(data, k, options, threads, std::move(centroids), step);
+    }
+    default: {
+      LloydStep step{n};
+      return Iterate(data, k, options, threads, std::move(centroids), step);
+    }
+  }
+}
+
+MiniBatchKMeans::MiniBatchKMeans(size_t k, size_t dims, double decay, uint64_t seed)
+    : k_{k}, dims_{dims}, decay_{std::clamp(decay, 0.0, 1.0)}, seed_{seed}
+{}
+
+void MiniBatchKMeans::PartialFit(const FeatureView& batch, unsigned threads)
+{
+  if (batch.Cols() != dims_ || batch.Rows() == 0 || k_ == 0 || dims_ == 0) {
+    return;
+  }
+  if (Ready()) {
+    Update(batch, threads);
+    return;
+  }
+
+  for (size_t i = 0; i < batch.Rows(); i++) {
+    for (size_t j = 0; j < dims_; j++) {
+      pending_.push_back(batch(i, j));
+    }
+  }
+  const size_t rows{pending_.size() / dims_};
+  if (rows < 3 * k_) {
+    return;
+  }
+  FeatureMatrix buffered(rows, dims_);
+  for (size_t i = 0; i < rows; i++) {
+    for (size_t j = 0; j < dims_; j++) {
+      buffered(i, j) = pending_[i * dims_ + j];
+    }
+  }
+  pending_ = std::vector<double>{};
+  std::mt19937_64 gen{seed_};
+  means_ = SeedPlusPlus(buffered, k_, gen, ThreadCount(threads, rows, kMinRowsPerThread));
+  counts_.assign(k_, 0.0);
+  Update(buffered, threads);
+}
+
+void MiniBatchKMeans::Update(const FeatureView& batch, unsigned threads)
+{
+  const size_t n{batch.Rows()};
+  threads = ThreadCount(threads, n, kMinRowsPerThread);
+  std::vector<uint32_t> labels(n);
+  std::vector<double> dist2(n);
+  std::vector<Accumulator> accumulators(threads);
+  ParallelFor(n, threads, [&](unsigned t, size_t begin, size_t end) {
+    Nearest(batch, means_.data(), k_, begin, end, labels.data(), dist2.data());
+    SumClusters(batch, labels.data(), k_, begin, end, accumulators[t]);
+  });
+
+  // The new mean of all points, (mean * count + sum) / (count + m), a step of m / (count + m) towards the batch mean.
+  for (size_t c = 0; c < k_; c++) {
+    size_t m{0};
+    for (const auto& acc : accumulators) {
+      m += acc.counts[c];
+    }
+    counts_[c] *= decay_;
+    if (m == 0) {
+      continue;
+    }
+    const double total{counts_[c] + static_cast<double>(m)};
+    for (size_t j = 0; j < dims_; j++) {
+      double sum{0.0};
+      for (const auto& acc : accumulators) {
+        sum += acc.sums[c * dims_ + j];
+      }
+      means_[c * dims_ + j] = (means_[c * dims_ + j] * counts_[c] + sum) / total;
+    }
+    counts_[c] = total;
+  }
+}
+
+std::vector<uint32_t> MiniBatchKMeans::Predict(const FeatureView& data, unsigned threads) const
+{
+  if (!Ready() || data.Cols() != dims_) {
+    return {};
+  }
+  std::vector<uint32_t> labels(data.Rows());
+  std::vector<double> dist2(data.Rows());
+  ParallelFor(data.Rows(), ThreadCount(threads, data.Rows(), kMinRowsPerThread),
+              [&](unsigned /*t*/, size_t begin, size_t end) {
+                Nearest(data, means_.data(), k_, begin, end, labels.data(), dist2.data());
+              });
+  return labels;
+}
+
+FeatureMatrix MiniBatchKMeans::Means() const
+{
+  if (!Ready()) {
+    return FeatureMatrix{};
+  }
+  FeatureMatrix means(k_, dims_);
+  for (size_t c = 0; c < k_; c++) {
+    for (size_t j = 0; j < dims_; j++) {
+      means(c, j) = means_[c * dims_ + j];
+    }
+  }
+  return means;
+}
+
+Centroids MiniBatchKMeans::ToCentroids() const
+{
+  Centroids centroids;
+  if (!Ready() || dims_ != 2) {
+    return centroids;
+  }
+  for (size_t c = 0; c < k_; c++) {
+    const double x{means_[2 * c]};
+    const double y{means_[2 * c + 1]};
+    centroids.push_back(Centroid{{x, y}, x, y, static_cast<size_t>(std::llround(counts_[c]))});
+  }
+  return centroids;
+}
+
+Clusters KMeans(geometry::Points points, int8_t k)
+{
+  if (k > static_cast<int>(points.size()) || k <= 0 || points.empty()) {
+    return Clusters{};
+  }
+  const KMeansResult res{KMeans(FeatureMatrix(points), static_cast<size_t>(k))};
+
+  Clusters clusters(static_cast<size_t>(k));
+  for (size_t i = 0; i < points.size(); i++) {
+    clusters[res.labels[i]].emplace_back(points[i]);
+  }
+  return clusters;
+}
+
+/////////////////////////////////////////////
+/// KNN
+/////////////////////////////////////////////
+
+DataFrame::DataFrame(size_t rows, size_t cols) : features_(rows, cols), labels_(rows)
+{
+  Code("");
+}
+
+DataFrame::DataFrame(const LabeledPoints& points) : features_(points.size(), 2), labels_(points.size())
+{
+  for (size_t i = 0; i < points.size(); i++) {
+    features_(i, 0) = points[i].x;
+    features_(i, 1) = points[i].y;
+    labels_[i] = Code(points[i].label);
+  }
+}
+
+DataFrame::DataFrame(FeatureMatrix features, const std::vector<std::string>& names)
+{
+  if (features.Rows() != names.size()) {
+    return;
+  }
+  features_ = std::move(features);
+  labels_.resize(names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    labels_[i] = Code(names[i]);
+  }
+}
+
+uint32_t DataFrame::Code(const std::string& name)
+{
+  const auto [it, added] = codes_.emplace(name, static_cast<uint32_t>(dictionary_.size()));
+  if (added) {
+    dictionary_.push_back(name);
+  }
+  return it->second;
+}
+
+std::vector<uint32_t> KNearestNeighbor(const DataFrame& labeled, const FeatureView& queries, size_t k, unsigned threads)
+{
+  std::vector<uint32_t> codes;
+  if (k == 0 || labeled.Rows() == 0 || labeled.Dictionary().empty() || queries.Cols() != labeled.Cols()) {
+    return codes;
+  }
+  const KdTree tree{labeled};
+  const auto neighbors = tree.Nearest(queries, k, threads);
+
+  // Counts the votes per code, the codes are ranked by name so that a tie goes to the first name.
+  const std::vector<std::string>& names{labeled.Dictionary()};
+  codes.resize(queries.Rows());
+  for (size_t q = 0; q < queries.Rows(); q++) {
+    std::map<uint32_t, int> counts;
+    for (const auto& hit : neighbors[q]) {
+      counts[labeled.Labels()[hit.index]]++;
+    }
+    uint32_t best{0};
+    int max_count{0};
+    for (const auto& [code, count] : counts) {
+      if (count > max_count || (count == max_count && names[code] < names[best])) {
+        max_count = count;
+        best = code;
+      }
+    }
+    codes[q] = best;
+  }
+  return codes;
+}
+
+LabeledPoints KNearestNeighbor(const geometry::Points& unlabeled_data, const LabeledPoints& labeled_data, uint8_t k)
+{
+  if (k > unlabeled_data.size() || k == 0 || unlabeled_data.empty() || labeled_data.empty()) {
+    return LabeledPoints{};
+  }
+  const DataFrame labeled{labeled_data};
+  const std::vector<uint32_t> codes{KNearestNeighbor(labeled, FeatureMatrix(unlabeled_data), k, 1)};
+
+  LabeledPoints ret_labeled;
+  for (size_t q = 0; q < unlabeled_data.size(); q++) {
+    const std::string& label{labeled.Dictionary()[codes[q]]};
+    ret_labeled.emplace_back(LabeledPoint{unlabeled_data[q].x, unlabeled_data[q].y, 0.0, label});
+  }
+  return ret_labeled;
+}
+
+/////////////////////////////////////////////
+/// K-d tree
+/////////////////////////////////////////////
+
+KdTree::KdTree(const FeatureView& data, size_t leaf_size) : dims_{data.Cols()}
+{
+  const size_t n{data.Rows()};
+  if (n == 0 || dims_ == 0 || n >= kLeaf) {
+    return;
+  }
+  index_.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    index_[i] = static_cast<uint32_t>(i);
+  }
+  points_.resize(n * dims_);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < dims_; j++) {
+      points_[i * dims_ + j] = data(i, j);
+    }
+  }
+  Build(0, static_cast<uint32_t>(n), std::max<size_t>(leaf_size, 1));
+
+  // Reorder the points so that each leaf is contiguous.
+  std::vector<double> ordered(n * dims_);
+  for (size_t p = 0; p < n; p++) {
+    for (size_t j = 0; j < dims_; j++) {
+      ordered[p * dims_ + j] = data(index_[p], j);
+    }
+  }
+  points_ = std::move(ordered);
+}
+
+uint32_t KdTree::Build(uint32_t begin, uint32_t end, size_t leaf_size)
+{
+  const auto node = static_cast<uint32_t>(nodes_.size());
+  nodes_.push_back(Node{begin, end, kLeaf, 0, 0.0});
+  if (end - begin <= leaf_size) {
+    return node;
+  }
+
+  // Split the feature with the largest spread, the points are still in the order of the rows here.
+  uint32_t dim{0};
+  double widest{-1.0};
+  for (size_t j = 0; j < dims_; j++) {
+    double low{std::numeric_limits<double>::infinity()};
+    double high{-low};
+    for (uint32_t p = begin; p < end; p++) {
+      low = std::min(low, points_[index_[p] * dims_ + j]);
+      high = std::max(high, points_[index_[p] * dims_ + j]);
+    }
+    if (high - low > widest) {
+      widest = high - low;
+      dim = static_cast<uint32_t>(j);
+    }
+  }
+  if (widest <= 0.0) {
+    return node;// All points are equal.
+  }
+
+  const uint32_t mid{begin + (end - begin) / 2};
+  const auto less = [this, dim](uint32_t a, uint32_t b) { return points_[a * dims_ + dim] < points_[b * dims_ + dim]; };
+  std::nth_element(index_.begin() + begin, index_.begin() + mid, index_.begin() + end, less);
+  const double split{points_[index_[mid] * dims_ + dim]};
+
+  Build(begin, mid, leaf_size);
+  const uint32_t right{Build(mid, end, leaf_size)};
+  nodes_[node].dim = dim;
+  nodes_[node].right = right;
+  nodes_[node].split = split;
+  return node;
+}
+
+void KdTree::Search(uint32_t node, const double* query, size_t k, std::vector<std::pair<double, uint32_t>>& heap) const
+{
+  const Node& nd{nodes_[node]};
+  if (nd.dim == kLeaf) {
+    for (uint32_t p = nd.begin; p < nd.end; p++) {
+      const std::pair<double, uint32_t> hit{Distance2(query, points_.data() + p * dims_, dims_), index_[p]};
+      if (heap.size() < k) {
+        heap.push_back(hit);
+        std::push_heap(heap.begin(), heap.end());
+      } else if (hit < heap.front()) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = hit;
+        std::push_heap(heap.begin(), heap.end());
+      }
+    }
+    return;
+  }
+
+  // The lower half has no point above split and the upper half none below it.
+  const double diff{query[nd.dim] - nd.split};
+  Search(diff <= 0.0 ? node + 1 : nd.right, query, k, heap);
+  if (heap.size() < k || diff * diff <= heap.front().first) {
+    Search(diff <= 0.0 ? nd.right : node + 1, query, k, heap);
+  }
+}
+
+std::vector<NeighborHit> KdTree::Nearest(const double* query, size_t k) const
+{
+  std::vector<NeighborHit> hits;
+  if (nodes_.empty() || k == 0) {
+    return hits;
+  }
+  std::vector<std::pair<double, uint32_t>> heap;
+  heap.reserve(std::min(k, Size()));
+  Search(0, query, k, heap);
+  std::sort_heap(heap.begin(), heap.end());
+  for (const auto& [dist2, index] : heap) {
+    hits.push_back(NeighborHit{index, std::sqrt(dist2)});
+  }
+  return hits;
+}
+
+std::vector<std::vector<NeighborHit>> KdTree::Nearest(const FeatureView& queries, size_t k, unsigned threads) const
+{
+  constexpr size_t kMinQueriesPerThread{64};
+  std::vector<std::vector<NeighborHit>> hits;
+  if (queries.Cols() != dims_) {
+    return hits;
+  }
+  hits.resize(queries.Rows());
+  ParallelFor(queries.Rows(), ThreadCount(threads, queries.Rows(), kMinQueriesPerThread),
+              [&](unsigned /*t*/, size_t begin, size_t end) {
+                std::vector<double> row(dims_);
+                for (size_t q = begin; q < end; q++) {
+                  CopyRow(queries, q, row.data());
+                  hits[q] = Nearest(row.data(), k);
+                }
+              });
+  return hits;
+}
+
+/////////////////////////////////////////////
+/// HNSW
+/////////////////////////////////////////////
+
+namespace {
+
+/// \brief Distance kernel over two float vectors of d values.
+using FloatDistFunc = float (*)(const float* a, const float* b, size_t d);
+
+float SquaredL2Scalar(const float* a, const float* b, size_t d)
+{
+  float sum{0.0f};
+  for (size_t j = 0; j < d; j++) {
+    const float diff{a[j] - b[j]};
+    sum += diff * diff;
+  }
+  return sum;
+}
+
+float DotScalar(const float* a, const float* b, size_t d)
+{
+  float sum{0.0f};
+  for (size_t j = 0; j < d; j++) {
+    sum += a[j] * b[j];
+  }
+  return sum;
+}
+
+#ifdef ALGO_SIMD_X86
+ALGO_TARGET_AVX2 float HorizontalSum(__m256 v)
+{
+  const __m128 half{_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1))};
+  const __m128 pair{_mm_add_ps(half, _mm_movehl_ps(half, half))};
+  return _mm_cvtss_f32(_mm_add_ss(pair, _mm_shuffle_ps(pair, pair, 1)));
+}
+
+ALGO_TARGET_AVX2 float SquaredL2Avx2(const float* a, const float* b, size_t d)
+{
+  __m256 acc{_mm256_setzero_ps()};
+  size_t j{0};
+  for (; j + 8 <= d; j += 8) {
+    const __m256 diff{_mm256_sub_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j))};
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(diff, diff));
+  }
+  return HorizontalSum(acc) + SquaredL2Scalar(a + j, b + j, d - j);
+}
+
+ALGO_TARGET_AVX2 float DotAvx2(const float* a, const float* b, size_t d)
+{
+  __m256 acc{_mm256_setzero_ps()};
+  size_t j{0};
+  for (; j + 8 <= d; j += 8) {
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + j), _mm256_loadu_ps(b + j)));
+  }
+  return HorizontalSum(acc) + DotScalar(a + j, b + j, d - j);
+}
+
+ALGO_TARGET_AVX512 float HorizontalSum(__m512 v)
+{
+  alignas(64) float lanes[16];
+  _mm512_store_ps(lanes, v);
+  float sum{0.0f};
+  for (const float lane : lanes) {
+    sum += lane;
+  }
+  return sum;
+}
+
+ALGO_TARGET_AVX512 float SquaredL2Avx512(const float* a, const float* b, size_t d)
+{
+  __m512 acc{_mm512_setzero_ps()};
+  size_t j{0};
+  for (; j + 16 <= d; j += 16) {
+    const __m512 diff{_mm512_sub_ps(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j))};
+    acc = _mm512_fmadd_ps(diff, diff, acc);
+  }
+  return HorizontalSum(acc) + SquaredL2Scalar(a + j, b + j, d - j);
+}
+
+ALGO_TARGET_AVX512 float DotAvx512(const float* a, const float* b, size_t d)
+{
+  __m512 acc{_mm512_setzero_ps()};
+  size_t j{0};
+  for (; j + 16 <= d; j += 16) {
+    acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + j), _mm512_loadu_ps(b + j), acc);
+  }
+  return HorizontalSum(acc) + DotScalar(a + j, b + j, d - j);
+}
+#endif
+
+float SquaredL2(const float* a, const float* b, size_t d)
+{
+  static const FloatDistFunc kernel = []() -> FloatDistFunc {
+#ifdef ALGO_SIMD_X86
+    if (simd::HasAvx512()) {
+      return SquaredL2Avx512;
+    }
+    if (simd::HasAvx2()) {
+      return SquaredL2Avx2;
+    }
+#endif
+    return SquaredL2Scalar;
+  }();
+  return kernel(a, b, d);
+}
+
+float Dot(const float* a, const float* b, size_t d)
+{
+  static const FloatDistFunc kernel = []() -> FloatDistFunc {
+#ifdef ALGO_SIMD_X86
+    if (simd::HasAvx512()) {
+      return DotAvx512;
+    }
+    if (simd::HasAvx2()) {
+      return DotAvx2;
+    }
+#endif
+    return DotScalar;
+  }();
+  return kernel(a, b, d);
+}
+
+/// \brief Marks the nodes visited by a search. Clearing is done by bumping the tag, so a search does not touch all
+/// nodes. One per thread, shared by all indexes.
+struct VisitedList {
+  bool Visit(uint32_t id)
+  {
+    if (tags[id] == tag) {
+      return false;
+    }
+    tags[id] = tag;
+    return true;
+  }
+
+  void Reset(size_t capacity)
+  {
+    if (tags.size() < capacity) {
+      tags.resize(capacity, 0);
+    }
+    if (++tag == 0) {
+      std::fill(tags.begin(), tags.end(), 0);
+      tag = 1;
+    }
+  }
+
+  std::vector<uint16_t> tags;
+  uint16_t tag{0};
+};
+
+constexpr uint32_t kNoNode{std::numeric_limits<uint32_t>::max()};
+constexpr int kMaxHnswLevel{16};
+/// Largest dims and m that Load accepts, so that a header can not make a node take any amount of memory.
+constexpr uint64_t kMaxHnswDims{uint64_t{1} << 16u};
+constexpr uint64_t kMaxHnswM{uint64_t{1} << 10u};
+constexpr char kHnswMagic[8]{'A', 'L', 'G', 'O', 'H', 'N', 'S', '1'};
+
+}// namespace
+
+struct HnswIndex::Shared {
+  explicit Shared(size_t capacity) : locks(capacity)
+  {}
+
+  std::vector<std::mutex> locks;///< Guards the links of each node.
+  std::mutex entry_lock;        ///< Guards entry and max_level.
+  uint32_t entry{kNoNode};
+  int max_level{-1};
+  std::atomic<uint32_t> count{0};
+};
+
+HnswIndex::HnswIndex() = default;
+
+HnswIndex::HnswIndex(size_t dims, size_t capacity, const HnswOptions& options)
+    : dims_{dims}, capacity_{std::min<size_t>(capacity, kNoNode)}, options_{options}
+{
+  options_.m = std::max<size_t>(options_.m, 2);
+  options_.ef_construction = std::max(options_.ef_construction, options_.m);
+  data_.resize(capacity_ * dims_);
+  levels_.resize(capacity_);
+  links0_.resize(capacity_ * (1 + 2 * options_.m));
+  upper_.resize(capacity_);
+  shared_ = std::make_unique<Shared>(capacity_);
+}
+
+HnswIndex::~HnswIndex() = default;
+HnswIndex::HnswIndex(HnswIndex&&) noexcept = default;
+HnswIndex& HnswIndex::operator=(HnswIndex&&) noexcept = default;
+
+size_t HnswIndex::Size() const
+{
+  return shared_ ? shared_->count.load() : 0;
+}
+
+float HnswIndex::Distance(const float* a, const float* b) const
+{
+  if (options_.metric == VectorMetric::InnerProduct) {
+    return 1.0f - Dot(a, b, dims_);
+  }
+  return SquaredL2(a, b, dims_);
+}
+
+size_t HnswIndex::MaxLinks(int level) const
+{
+  return level == 0 ? 2 * options_.m : options_.m;
+}
+
+const uint32_t* HnswIndex::Links(uint32_t id, int level) const
+{
+  if (level == 0) {
+    return links0_.data() + id * (1 + 2 * options_.m);
+  }
+  return upper_[id].data() + static_cast<size_t>(level - 1) * (1 + options_.m);
+}
+
+uint32_t* HnswIndex::Links(uint32_t id, int level)
+{
+  return const_cast<uint32_t*>(std::as_const(*this).Links(id, level));
+}
+
+void HnswIndex::CopyLinks(uint32_t id, int level, std::vector<uint32_t>& out) const
+{
+  std::lock_guard<std::mutex> lock(shared_->locks[id]);
+  const uint32_t* links{Links(id, level)};
+  out.assign(links + 1, links + 1 + links[0]);
+}
+
+int HnswIndex::RandomLevel(uint32_t id) const
+{
+  // A splitmix64 hash of the seed and id, so the levels do not depend on the order of concurrent inserts.
+  uint64_t h{options_.seed + (static_cast<uint64_t>(id) + 1) * 0x9E3779B97F4A7C15ULL};
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+  h ^= h >> 31;
+  const double uniform{static_cast<double>((h >> 11) + 1) * 0x1.0p-53};
+  const double level{-std::log(uniform) / std::log(static_cast<double>(options_.m))};
+  return std::min(static_cast<int>(level), kMaxHnswLevel);
+}
+
+uint32_t HnswIndex::Greedy(const float* query, uint32_t entry, float& dist, int from_level, int to_level) const
+{
+  std::vector<uint32_t> links;
+  for (int level = from_level; level >= to_level; level--) {
+    bool moved{true};
+    while (moved) {
+      moved = false;
+      CopyLinks(entry, level, links);
+      for (const uint32_t n : links) {
+        const float d{Distance(query, Vector(n))};
+        if (d < dist) {
+          dist = d;
+          entry = n;
+          moved = true;
+        }
+      }
+    }
+  }
+  return entry;
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::SearchLevel(const float* query, uint32_t entry, float entry_dist,
+                                                         size_t ef, int level) const
+{
+  thread_local VisitedList visited;
+  visited.Reset(capacity_);
+  visited.Visit(entry);
+
+  // The candidates to expand nearest first, and the ef nearest found so far with the farthest on top.
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<>> candidates;
+  std::priority_queue<Candidate> found;
+  candidates.emplace(entry_dist, entry);
+  found.emplace(entry_dist, entry);
+
+  std::vector<uint32_t> links;
+  while (!candidates.empty()) {
+    const Candidate current{candidates.top()};
+    if (current.first > found.top().first && found.size() >= ef) {
+      break;
+    }
+    candidates.pop();
+    CopyLinks(current.second, level, links);
+    for (const uint32_t n : links) {
+      if (!visited.Visit(n)) {
+        continue;
+      }
+      const float d{Distance(query, Vector(n))};
+      if (found.size() < ef || d < found.top().first) {
+        candidates.emplace(d, n);
+        found.emplace(d, n);
+        if (found.size() > ef) {
+          found.pop();
+        }
+      }
+    }
+  }
+
+  std::vector<Candidate> sorted(found.size());
+  for (size_t i = sorted.size(); i-- > 0;) {
+    sorted[i] = found.top();
+    found.pop();
+  }
+  return sorted;
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::SelectNeighbors(const std::vector<Candidate>& sorted, size_t m) const
+{
+  // Prefers a candidate that is nearer to the node than to all kept ones, so the links spread out in different
+  // directions instead of all pointing into the same cluster. The free links are then filled with the nearest of the
+  // others, fewer links leave more nodes that no other node links to.
+  std::vector<Candidate> kept;
+  std::vector<Candidate> pruned;
+  for (const Candidate& candidate : sorted) {
+    if (kept.size() == m) {
+      break;
+    }
+    const float* vec{Vector(candidate.second)};
+    const bool diverse{std::all_of(kept.begin(), kept.end(), [&](const Candidate& k) {
+      return Distance(vec, Vector(k.second)) > candidate.first;
+    })};
+    (diverse ? kept : pruned).push_back(candidate);
+  }
+  for (size_t i = 0; i < pruned.size() && kept.size() < m; i++) {
+    kept.push_back(pruned[i]);
+  }
+  return kept;
+}
+
+void HnswIndex::Connect(uint32_t id, const std::vector<Candidate>& neighbors, int level)
+{
+  {
+    std::lock_guard<std::mutex> lock(shared_->locks[id]);
+    uint32_t* links{Links(id, level)};
+    links[0] = static_cast<uint32_t>(neighbors.size());
+    for (size_t i = 0; i < neighbors.size(); i++) {
+      links[i + 1] = neighbors[i].second;
+    }
+  }
+
+  // Only one node lock is held at a time, so concurrent inserts can not deadlock.
+  const size_t max_links{MaxLinks(level)};
+  std::vector<Candidate> candidates;
+  for (const auto& [dist, n] : neighbors) {
+    std::lock_guard<std::mutex> lock(shared_->locks[n]);
+    uint32_t* links{Links(n, level)};
+    if (links[0] < max_links) {
+      links[++links[0]] = id;
+      continue;
+    }
+    // Full, select the links of n again among the old ones and the new node.
+    candidates.assign(1, Candidate{dist, id});
+    const float* vec{Vector(n)};
+    for (uint32_t i = 1; i <= links[0]; i++) {
+      candidates.emplace_back(Distance(vec, Vector(links[i])), links[i]);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    const std::vector<Candidate> kept{SelectNeighbors(candidates, max_links)};
+    links[0] = static_cast<uint32_t>(kept.size());
+    for (size_t i = 0; i < kept.size(); i++) {
+      links[i + 1] = kept[i].second;
+    }
+  }
+}
+
+void HnswIndex::Insert(uint32_t id)
+{
+  const float* query{Vector(id)};
+  const int level{RandomLevel(id)};
+  levels_[id] = static_cast<uint8_t>(level);
+  upper_[id].assign(static_cast<size_t>(level) * (1 + options_.m), 0);
+
+  // The entry lock is kept only by a node that becomes the new top, the others release it at once.
+  std::unique_lock<std::mutex> top(shared_->entry_lock);
+  const uint32_t entry{shared_->entry};
+  const int max_level{shared_->max_level};
+  if (entry == kNoNode) {
+    shared_->entry = id;
+    shared_->max_level = level;
+    return;
+  }
+  if (level <= max_level) {
+    top.unlock();
+  }
+
+  float dist{Distance(query, Vector(entry))};
+  uint32_t nearest{Greedy(query, entry, dist, max_level, level + 1)};
+  const int top_level{std::min(level, max_level)};
+  std::vector<std::vector<Candidate>> neighbors(static_cast<size_t>(top_level) + 1);
+  for (int l = top_level; l >= 0; l--) {
+    const std::vector<Candidate> candidates{SearchLevel(query, nearest, dist, options_.ef_construction, l)};
+    neighbors[static_cast<size_t>(l)] = SelectNeighbors(candidates, options_.m);
+    dist = candidates.front().first;
+    nearest = candidates.front().second;
+  }
+  // Linked from the bottom up, so a search that reaches the node on a level finds its links on all levels below.
+  for (int l = 0; l <= top_level; l++) {
+    Connect(id, neighbors[static_cast<size_t>(l)], l);
+  }
+
+  if (level > max_level) {
+    shared_->entry = id;
+    shared_->max_level = level;
+  }
+}
+
+size_t HnswIndex::Reserve(size_t count, uint32_t& first)
+{
+  first = shared_->count.load();
+  size_t reserved{0};
+  do {
+    reserved = std::min<size_t>(count, capacity_ - first);
+  } while (reserved > 0 && !shared_->count.compare_exchange_weak(first, first + static_cast<uint32_t>(reserved)));
+  return reserved;
+}
+
+long long HnswIndex::Add(const float* vector)
+{
+  uint32_t id{0};
+  if (!shared_ || Reserve(1, id) == 0) {
+    return -1;
+  }
+  std::copy(vector, vector + dims_, data_.begin() + static_cast<std::ptrdiff_t>(id * dims_));
+  Insert(id);
+  return id;
+}
+
+size_t HnswIndex::AddBatch(const float* vectors, size_t count, unsigned threads)
+{
+  constexpr size_t kMinInsertsPerThread{64};
+  uint32_t first{0};
+  const size_t added{shared_ ? Reserve(count, first) : 0};
+  if (added == 0) {
+    return 0;
+  }
+  std::copy(vectors, vectors + added * dims_, data_.begin() + static_cast<std::ptrdiff_t>(first * dims_));
+  ParallelFor(added, ThreadCount(threads, added, kMinInsertsPerThread), [&](unsigned /*t*/, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      Insert(first + static_cast<uint32_t>(i));
+    }
+  });
+  return added;
+}
+
+std::vector<NeighborHit> HnswIndex::Search(const float* query, size_t k, size_t ef) const
+{
+  std::vector<NeighborHit> hits;
+  if (!shared_ || k == 0) {
+    return hits;
+  }
+  uint32_t entry{kNoNode};
+  int max_level{-1};
+  {
+    std::lock_guard<std::mutex> lock(shared_->entry_lock);
+    entry = shared_->entry;
+    max_level = shared_->max_level;
+  }
+  if (entry == kNoNode) {
+    return hits;
+  }
+
+  float dist{Distance(query, Vector(entry))};
+  const uint32_t nearest{Greedy(query, entry, dist, max_level, 1)};
+  ef = std::max(ef == 0 ? options_.ef_search : ef, k);
+  const std::vector<Candidate> found{SearchLevel(query, nearest, dist, ef, 0)};
+  for (size_t i = 0; i < std::min(k, found.size()); i++) {
+    const float d{options_.metric == VectorMetric::L2 ? std::sqrt(std::max(found[i].first, 0.0f)) : found[i].first};
+    hits.push_back(NeighborHit{found[i].second, d});
+  }
+  return hits;
+}
+
+std::vector<std::vector<NeighborHit>> HnswIndex::SearchBatch(const float* queries, size_t count, size_t k,
+                                                             unsigned threads) const
+{
+  constexpr size_t kMinQueriesPerThread{64};
+  std::vector<std::vector<NeighborHit>> hits(count);
+  ParallelFor(count, ThreadCount(threads, count, kMinQueriesPerThread), [&](unsigned /*t*/, size_t begin, size_t end) {
+    for (size_t q = begin; q < end; q++) {
+      hits[q] = Search(queries + q * dims_, k);
+    }
+  });
+  return hits;
+}
+
+bool HnswIndex::Save(const std::string& path) const
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file || !shared_) {
+    return false;
+  }
+  const size_t n{Size()};
+  const uint64_t header[10]{dims_,
+                            capacity_,
+                            n,
+                            options_.m,
+                            options_.ef_construction,
+                            options_.ef_search,
+                            static_cast<uint64_t>(options_.metric),
+                            options_.seed,
+                            shared_->entry,
+                            static_cast<uint64_t>(shared_->max_level + 1)};
+  file.write(kHnswMagic, sizeof(kHnswMagic));
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(data_.data()), static_cast<std::streamsize>(n * dims_ * sizeof(float)));
+  file.write(reinterpret_cast<const char*>(levels_.data()), static_cast<std::streamsize>(n));
+  file.write(reinterpret_cast<const char*>(links0_.data()),
+             static_cast<std::streamsize>(n * (1 + 2 * options_.m) * sizeof(uint32_t)));
+  for (size_t i = 0; i < n; i++) {
+    file.write(reinterpret_cast<const char*>(upper_[i].data()),
+               static_cast<std::streamsize>(upper_[i].size() * sizeof(uint32_t)));
+  }
+  return static_cast<bool>(file);
+}
+
+bool HnswIndex::Load(const std::string& path, size_t capacity)
+{
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(kHnswMagic)];
+  uint64_t header[10];
+  if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), kHnswMagic)
+      || !file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+    return false;
+  }
+  const auto [dims, saved_capacity, n, m, ef_construction, ef_search, metric, seed, entry, levels] = header;
+  if (dims == 0 || dims > kMaxHnswDims || saved_capacity > kNoNode || n > saved_capacity || m < 2 || m > kMaxHnswM
+      || metric > 1 || levels > kMaxHnswLevel + 1 || (n == 0) != (levels == 0) || (n > 0 && entry >= n)) {
+    return false;
+  }
+
+  // The sizes in the header are not trusted. The vectors and the level 0 links of the saved nodes must be in the
+  // file, and no size may wrap, before anything is allocated. The memory for more nodes is what the caller asked for.
+  const std::streamoff start{file.tellg()};
+  file.seekg(0, std::ios::end);
+  const std::streamoff end{file.tellg()};
+  file.seekg(start);
+  uint64_t remaining{static_cast<uint64_t>(end - start)};
+  const auto fits = [](uint64_t count, uint64_t size, uint64_t limit) { return count == 0 || size <= limit / count; };
+  if (!fits(n, dims, remaining / sizeof(float))) {
+    return false;
+  }
+  remaining -= n * dims * sizeof(float);
+  if (n > remaining || !fits(n, 1 + 2 * m, (remaining - n) / sizeof(uint32_t))) {
+    return false;
+  }
+  capacity = std::max<size_t>(std::min<size_t>(capacity, kNoNode), n);
+  if (!fits(capacity, dims, std::numeric_limits<size_t>::max() / sizeof(float))
+      || !fits(capacity, 1 + 2 * m, std::numeric_limits<size_t>::max() / sizeof(uint32_t))) {
+    return false;
+  }
+
+  HnswOptions options{m, ef_construction, ef_search, static_cast<VectorMetric>(metric), seed};
+  HnswIndex index(dims, capacity, options);
+  if (!file.read(reinterpret_cast<char*>(index.data_.data()), static_cast<std::streamsize>(n * dims * sizeof(float)))
+      || !file.read(reinterpret_cast<char*>(index.levels_.data()), static_cast<std::streamsize>(n))
+      || !file.read(reinterpret_cast<char*>(index.links0_.data()),
+                    static_cast<std::streamsize>(n * (1 + 2 * m) * sizeof(uint32_t)))) {
+    return false;
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    const int level{index.levels_[i]};
+    if (level >= static_cast<int>(levels)) {
+      return false;
+    }
+    if (static_cast<uint64_t>(level) * (1 + m) * sizeof(uint32_t) > static_cast<uint64_t>(end - file.tellg())) {
+      return false;
+    }
+    index.upper_[i].resize(static_cast<size_t>(level) * (1 + m));
+    if (!file.read(reinterpret_cast<char*>(index.upper_[i].data()),
+                   static_cast<std::streamsize>(index.upper_[i].size() * sizeof(uint32_t)))) {
+      return false;
+    }
+  }
+
+  // Checks the links, so a damaged file can not make a search read outside the index.
+  for (uint32_t i = 0; i < n; i++) {
+    for (int level = 0; level <= index.levels_[i]; level++) {
+      const uint32_t* links{index.Links(i, level)};
+      if (links[0] > index.MaxLinks(level)
+          || std::any_of(links + 1, links + 1 + links[0],
+                         [&](uint32_t l) { return l >= n || index.levels_[l] < level; })) {
+        return false;
+      }
+    }
+  }
+  if (n > 0 && index.levels_[entry] + 1 != static_cast<int>(levels)) {
+    return false;
+  }
+
+  index.shared_->count = static_cast<uint32_t>(n);
+  index.shared_->entry = n > 0 ? static_cast<uint32_t>(entry) : kNoNode;
+  index.shared_->max_level = static_cast<int>(levels) - 1;
+  *this = std::move(index);
+  return true;
+}
+
+/////////////////////////////////////////////
+/// Product quantization
+/////////////////////////////////////////////
+
+namespace {
+
+/// Codes per block of the PqIndex layout.
+constexpr size_t kPqBlock{16};
+
+/// \brief Sums the table entries of the codes in blocks, one distance per code. Each block holds kPqBlock codes by
+/// subspace. The entries are added in the order of the subspaces, so all kernels give the same bits.
+using AdcFunc = void (*)(const uint8_t* codes, size_t blocks, size_t subspaces, size_t centroids, const float* table,
+                         float* out);
+
+void AdcScalar(const uint8_t* codes, size_t blocks, size_t subspaces, size_t centroids, const float* table, float* out)
+{
+  for (size_t b = 0; b < blocks; b++) {
+    float acc[kPqBlock]{};
+    for (size_t s = 0; s < subspaces; s++) {
+      const uint8_t* code{codes + (b * subspaces + s) * kPqBlock};
+      const float* row{table + s * centroids};
+      for (size_t i = 0; i < kPqBlock; i++) {
+        acc[i] += row[code[i]];
+      }
+    }
+    std::copy(acc, acc + kPqBlock, out + b * kPqBlock);
+  }
+}
+
+#ifdef ALGO_SIMD_X86
+ALGO_TARGET_AVX2 void AdcAvx2(const uint8_t* codes, size_t blocks, size_t subspaces, size_t centroids,
+                              const float* table, float* out)
+{
+  for (size_t b = 0; b < blocks; b++) {
+    __m256 acc0{_mm256_setzero_ps()};
+    __m256 acc1{_mm256_setzero_ps()};
+    for (size_t s = 0; s < subspaces; s++) {
+      const __m128i code{_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + (b * subspaces + s) * kPqBlock))};
+      const float* row{table + s * centroids};
+      acc0 = _mm256_add_ps(acc0, _mm256_i32gather_ps(row, _mm256_cvtepu8_epi32(code), 4));
+      acc1 = _mm256_add_ps(acc1, _mm256_i32gather_ps(row, _mm256_cvtepu8_epi32(_mm_srli_si128(code, 8)), 4));
+    }
+    _mm256_storeu_ps(out + b * kPqBlock, acc0);
+    _mm256_storeu_ps(out + b * kPqBlock + 8, acc1);
+  }
+}
+
+ALGO_TARGET_AVX512 void AdcAvx512(const uint8_t* codes, size_t blocks, size_t subspaces, size_t centroids,
+                                  const float* table, float* out)
+{
+  for (size_t b = 0; b < blocks; b++) {
+    __m512 acc{_mm512_setzero_ps()};
+    for (size_t s = 0; s < subspaces; s++) {
+      const __m128i code{_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + (b * subspaces + s) * kPqBlock))};
+      // The masked forms with all lanes set, the plain ones trip -Wmaybe-uninitialized in some GCC versions.
+      const __m512i index{_mm512_maskz_cvtepu8_epi32(0xFFFF, code)};
+      acc = _mm512_add_ps(acc, _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, index, table + s * centroids, 4));
+    }
+    _mm512_storeu_ps(out + b * kPqBlock, acc);
+  }
+}
+#endif
+
+void Adc(const uint8_t* codes, size_t blocks, size_t subspaces, size_t centroids, const float* table, float* out)
+{
+  static const AdcFunc kernel = []() -> AdcFunc {
+#ifdef ALGO_SIMD_X86
+    if (simd::HasAvx512()) {
+      return AdcAvx512;
+    }
+    if (simd::HasAvx2()) {
+      return AdcAvx2;
+    }
+#endif
+    return AdcScalar;
+  }();
+  kernel(codes, blocks, subspaces, centroids, table, out);
+}
+
+}// namespace
+
+ProductQuantizer::ProductQuantizer(const FeatureView& training, size_t subspaces, size_t centroids,
+                                   const KMeansOptions& options)
+{
+  const size_t rows{training.Rows()};
+  const size_t dims{training.Cols()};
+  if (subspaces == 0 || dims == 0 || dims % subspaces != 0 || centroids == 0 || centroids > 256 || centroids > rows) {
+    return;
+  }
+
+  const size_t width{dims / subspaces};
+  std::vector<float> codebooks(subspaces * centroids * width);
+  FeatureMatrix sub(rows, width);
+  for (size_t s = 0; s < subspaces; s++) {
+    for (size_t j = 0; j < width; j++) {
+      for (size_t i = 0; i < rows; i++) {
+        sub(i, j) = training(i, s * width + j);
+      }
+    }
+    const KMeansResult result{KMeans(sub, centroids, options)};
+    if (result.centroids.Rows() != centroids) {
+      return;
+    }
+    for (size_t c = 0; c < centroids; c++) {
+      for (size_t j = 0; j < width; j++) {
+        codebooks[(s * centroids + c) * width + j] = static_cast<float>(result.centroids(c, j));
+      }
+    }
+  }
+
+  dims_ = dims;
+  subspaces_ = subspaces;
+  centroids_ = centroids;
+  codebooks_ = std::move(codebooks);
+}
+
+void ProductQuantizer::Encode(const float* vector, uint8_t* code) const
+{
+  const size_t width{dims_ / std::max<size_t>(subspaces_, 1)};
+  for (size_t s = 0; s < subspaces_; s++) {
+    const float* sub{vector + s * width};
+    const float* codebook{codebooks_.data() + s * centroids_ * width};
+    float best{std::numeric_limits<float>::infinity()};
+    for (size_t c = 0; c < centroids_; c++) {
+      const float dist{SquaredL2(sub, codebook + c * width, width)};
+      if (dist < best) {
+        best = dist;
+        code[s] = static_cast<uint8_t>(c);
+      }
+    }
+  }
+}
+
+void ProductQuantizer::Decode(const uint8_t* code, float* vector) const
+{
+  const size_t width{dims_ / std::max<size_t>(subspaces_, 1)};
+  for (size_t s = 0; s < subspaces_; s++) {
+    const float* centroid{codebooks_.data() + (s * centroids_ + code[s]) * width};
+    std::copy(centroid, centroid + width, vector + s * width);
+  }
+}
+
+void ProductQuantizer::DistanceTable(const float* query, VectorMetric metric, float* table) const
+{
+  const size_t width{dims_ / std::max<size_t>(subspaces_, 1)};
+  for (size_t s = 0; s < subspaces_; s++) {
+    for (size_t c = 0; c < centroids_; c++) {
+      const float* centroid{codebooks_.data() + (s * centroids_ + c) * width};
+      table[s * centroids_ + c] = metric == VectorMetric::L2 ? SquaredL2(query + s * width, centroid, width)
+                                                             : -Dot(query + s * width, centroid, width);
+    }
+  }
+}
+
+PqIndex::PqIndex(ProductQuantizer quantizer, VectorMetric metric) : quantizer_{std::move(quantizer)}, metric_{metric}
+{}
+
+void PqIndex::Add(const float* vectors, size_t count, unsigned threads)
+{
+  constexpr size_t kMinCodesPerThread{1024};
+  const size_t dims{quantizer_.Dims()};
+  const size_t subspaces{quantizer_.Subspaces()};
+  if (subspaces == 0 || count == 0) {
+    return;
+  }
+  const size_t first{size_};
+  codes_.resize((first + count + kPqBlock - 1) / kPqBlock * kPqBlock * subspaces);
+  ParallelFor(count, ThreadCount(threads, count, kMinCodesPerThread), [&](unsigned /*t*/, size_t begin, size_t end) {
+    std::vector<uint8_t> code(subspaces);
+    for (size_t i = begin; i < end; i++) {
+      quantizer_.Encode(vectors + i * dims, code.data());
+      const size_t id{first + i};
+      uint8_t* block{codes_.data() + id / kPqBlock * kPqBlock * subspaces + id % kPqBlock};
+      for (size_t s = 0; s < subspaces; s++) {
+        block[s * kPqBlock] = code[s];
+      }
+    }
+  });
+  size_ += count;
+}
+
+void PqIndex::Reconstruct(uint32_t id, float* vector) const
+{
+  const size_t subspaces{quantizer_.Subspaces()};
+  if (id >= size_) {
+    return;
+  }
+  std::vector<uint8_t> code(subspaces);
+  const uint8_t* block{codes_.data() + id / kPqBlock * kPqBlock * subspaces + id % kPqBlock};
+  for (size_t s = 0; s < subspaces; s++) {
+    code[s] = block[s * kPqBlock];
+  }
+  quantizer_.Decode(code.data(), vector);
+}
+
+std::vector<NeighborHit> PqIndex::Search(const float* query, size_t k) const
+{
+  // Blocks summed per kernel call, the distances then go through a max-heap of the k nearest.
+  constexpr size_t kBlocksPerScan{64};
+  std::vector<NeighborHit> hits;
+  if (size_ == 0 || k == 0) {
+    return hits;
+  }
+  const size_t subspaces{quantizer_.Subspaces()};
+  const size_t centroids{quantizer_.Centroids()};
+  std::vector<float> table(subspaces * centroids);
+  quantizer_.DistanceTable(query, metric_, table.data());
+
+  const size_t blocks{(size_ + kPqBlock - 1) / kPqBlock};
+  std::vector<float> dist(kBlocksPerScan * kPqBlock);
+  std::vector<std::pair<float, uint32_t>> heap;
+  heap.reserve(std::min(k, size_));
+  for (size_t b = 0; b < blocks; b += kBlocksPerScan) {
+    const size_t scan{std::min(kBlocksPerScan, blocks - b)};
+    Adc(codes_.data() + b * kPqBlock * subspaces, scan, subspaces, centroids, table.data(), dist.data());
+    const size_t first{b * kPqBlock};
+    const size_t count{std::min(scan * kPqBlock, size_ - first)};
+    for (size_t i = 0; i < count; i++) {
+      const std::pair<float, uint32_t> hit{dist[i], static_cast<uint32_t>(first + i)};
+      if (heap.size() < k) {
+        heap.push_back(hit);
+        std::push_heap(heap.begin(), heap.end());
+      } else if (hit < heap.front()) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.back() = hit;
+        std::push_heap(heap.begin(), heap.end());
+      }
+    }
+  }
+
+  std::sort_heap(heap.begin(), heap.end());
+  for (const auto& [d, index] : heap) {
+    hits.push_back(NeighborHit{index, metric_ == VectorMetric::L2 ? std::sqrt(std::max(d, 0.0f)) : 1.0f + d});
+  }
+  return hits;
+}
+
+std::vector<std::vector<NeighborHit>> PqIndex::SearchBatch(const float* queries, size_t count, size_t k,
+                                                           unsigned threads) const
+{
+  constexpr size_t kMinQueriesPerThread{4};
+  std::vector<std::vector<NeighborHit>> hits(count);
+  const size_t dims{quantizer_.Dims()};
+  ParallelFor(count, ThreadCount(threads, count, kMinQueriesPerThread), [&](unsigned /*t*/, size_t begin, size_t end) {
+    for (size_t q = begin; q < end; q++) {
+      hits[q] = Search(queries + q * dims, k);
+    }
+  });
+  return hits;
+}
 
 /////////////////////////////////////////////
-/// K-means
+/// DBSCAN
 /////////////////////////////////////////////
 
-Clusters KMeans(geometry::Points points, int8_t k)
-{
-  if (k > static_cast<int>(points.size()) || k == 0 || points.empty()) {
-    return Clusters{};
-  }
-  Centroids ctr(k);
-  size_t N{points.size()};
-  // Initialize random centroids
-  std::generate(ctr.begin(), ctr.end(), [&points, &N]() {
-    return Centroid{points[static_cast<int>(math::random_num::cont::Uniform(0, N))], 0.0, 0.0, 0};
-  });
+namespace {
+
+/// \brief A grid of cubes of side eps over the first (up to 3) features. Points closer than eps are in the same or in
+/// adjacent cells in these features, whatever the other features and the distance function. The rows are copied in
+/// the order of their cells, so the points of a cell are contiguous.
+class GridIndex {
+ public:
+  static constexpr size_t kMaxGridDims{3};
 
-  int converge_clusters{0}, converge{0};
-  // Compute centroid locations
-  while (converge_clusters < 1) {
+  GridIndex(const FeatureView& data, double eps)
+      : n_{data.Rows()}, d_{data.Cols()}, g_{std::min(d_, kMaxGridDims)}, coords_(n_ * g_), position_(n_)
+  {
+    std::vector<double> low(g_, std::numeric_limits<double>::infinity());
+    for (size_t j = 0; j < g_; j++) {
+      const double* col{data.Column(j)};
+      for (size_t i = 0; i < n_; i++) {
+        low[j] = std::min(low[j], col[i]);
+      }
+    }
+    std::vector<uint64_t> keys(n_);
+    for (size_t i = 0; i < n_; i++) {
+      for (size_t j = 0; j < g_; j++) {
+        // Clamped so the cast is defined, far away cells then share a coordinate, which only adds candidates.
+        const double cell{std::floor((data(i, j) - low[j]) / eps)};
+        coords_[i * g_ + j] = static_cast<int64_t>(std::min(cell, 4e18));
+      }
+      keys[i] = Key(coords_.data() + i * g_);
+    }
 
-    for (const auto& pt : points) {
+    std::vector<uint32_t> order(n_);
+    for (size_t i = 0; i < n_; i++) {
+      order[i] = static_cast<uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) {
+      return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+    });
 
-      double dist_min{kDblMax};
-      int cluster{0}, min_cluster{0};
+    index_ = order;
+    rows_.resize(n_ * d_);
+    for (size_t p = 0; p < n_; p++) {
+      position_[order[p]] = static_cast<uint32_t>(p);
+      for (size_t j = 0; j < d_; j++) {
+        rows_[p * d_ + j] = data(order[p], j);
+      }
+      auto [it, inserted] = cells_.emplace(keys[order[p]], std::make_pair(p, p + 1));
+      if (!inserted) {
+        it->second.second = p + 1;
+      }
+    }
+  }
 
-      for (auto& ct : ctr) {
-        double dist_curr{Dist2(ct.p, pt)};
+  /// \brief Calls visit(j, row) for the points in the cells around point i, in the order of the cells. A hash collision
+  /// can merge cells, which only adds candidates. Stops when visit returns false.
+  template<typename Visit>
+  void ForCandidates(size_t i, const Visit& visit) const
+  {
+    // The keys of the 3^g adjacent cells, without duplicates so no point is visited twice.
+    uint64_t keys[27];
+    size_t count{0};
+    int64_t cell[kMaxGridDims];
+    size_t cells{1};
+    for (size_t j = 0; j < g_; j++) {
+      cells *= 3;
+    }
+    for (size_t offset = 0; offset < cells; offset++) {
+      size_t rest{offset};
+      for (size_t j = 0; j < g_; j++) {
+        cell[j] = coords_[i * g_ + j] + static_cast<int64_t>(rest % 3) - 1;
+        rest /= 3;
+      }
+      keys[count++] = Key(cell);
+    }
+    std::sort(keys, keys + count);
+    count = static_cast<size_t>(std::unique(keys, keys + count) - keys);
 
-        if (dist_curr < dist_min) {
-          dist_min = dist_curr;
-          min_cluster = cluster;
+    for (size_t c = 0; c < count; c++) {
+      const auto it = cells_.find(keys[c]);
+      if (it == cells_.end()) {
+        continue;
+      }
+      for (size_t p = it->second.first; p < it->second.second; p++) {
+        if (!visit(index_[p], rows_.data() + p * d_)) {
+          return;
         }
-        cluster++;
       }
+    }
+  }
+
+  /// \brief The features of point i.
+  const double* Row(size_t i) const
+  { return rows_.data() + position_[i] * d_; }
 
-      ctr[min_cluster].mean_x += pt.x;
-      ctr[min_cluster].mean_y += pt.y;
-      ctr[min_cluster].size++;
+ private:
+  uint64_t Key(const int64_t* cell) const
+  {
+    uint64_t key{0x9e3779b97f4a7c15ULL};
+    for (size_t j = 0; j < g_; j++) {
+      key = (key ^ static_cast<uint64_t>(cell[j])) * 0xbf58476d1ce4e5b9ULL;
+      key ^= key >> 31u;
     }
+    return key;
+  }
+
+  size_t n_;
+  size_t d_;
+  size_t g_;
+  std::vector<int64_t> coords_;///< The cell of each point.
+  std::vector<uint32_t> position_;
+  std::vector<uint32_t> index_;///< The point of each row.
+  std::vector<double> rows_;
+  std::unordered_map<uint64_t, std::pair<size_t, size_t>> cells_;
+};
 
-    for (auto& ct : ctr) {
-      ct.mean_x /= ct.size;// New mean
-      ct.mean_y /= ct.size;// New mean
+/// \brief True if a and b are closer than eps.
+bool Within(DistFunc dist_func, const double* a, const double* b, size_t d, double eps)
+{
+  double sum{0.0};
+  if (dist_func == DistFunc::Manhattan) {
+    for (size_t j = 0; j < d; j++) {
+      sum += std::abs(a[j] - b[j]);
+    }
+    return sum < eps;
+  }
+  for (size_t j = 0; j < d; j++) {
+    sum += (a[j] - b[j]) * (a[j] - b[j]);
+  }
+  return sum < eps * eps;
+}
 
-      if (geometry::Point{ct.mean_x, ct.mean_y} == ct.p) { converge++; }
+/// \brief A union-find that threads can update at the same time. A root is always linked below a smaller root with
+/// compare-and-swap, so the root of a set is its smallest element.
+class ConcurrentUnionFind {
+ public:
+  explicit ConcurrentUnionFind(size_t n) : parent_(n)
+  {
+    for (size_t i = 0; i < n; i++) {
+      parent_[i].store(static_cast<uint32_t>(i), std::memory_order_relaxed);
+    }
+  }
 
-      // Update centroid location and reset the rest
-      ct = {{ct.mean_x, ct.mean_y}, 0, 0.0, 0};
+  uint32_t Find(uint32_t x)
+  {
+    while (true) {
+      const uint32_t parent{parent_[x].load()};
+      if (parent == x) {
+        return x;
+      }
+      // Path halving, a failed exchange just means another thread got there first.
+      uint32_t expected{parent};
+      const uint32_t grandparent{parent_[parent].load()};
+      parent_[x].compare_exchange_weak(expected, grandparent);
+      x = grandparent;
     }
+  }
 
-    // Check if clusters has converged
-    if (converge == k) { converge_clusters++; }
-    converge = 0;
+  void Union(uint32_t a, uint32_t b)
+  {
+    while (true) {
+      a = Find(a);
+      b = Find(b);
+      if (a == b) {
+        return;
+      }
+      if (a < b) {
+        std::swap(a, b);
+      }
+      uint32_t expected{a};
+      if (parent_[a].compare_exchange_strong(expected, b)) {
+        return;
+      }
+    }
   }
 
-  // Put the points in the correct cluster
-  Clusters clusters(k);
-  for (const auto& pt : points) {
-    double dist_min{kDblMax};
-    int cluster{0}, min_cluster{0};
+ private:
+  std::vector<std::atomic<uint32_t>> parent_;
+};
 
-    for (auto& ct : ctr) {
-      double dist_curr{Dist2(ct.p, pt)};
+}//namespace
 
-      if (dist_curr < dist_min) {
-        dist_min = dist_curr;
-        min_cluster = cluster;
-      }
-      cluster++;
+DbscanResult DBSCAN(const FeatureView& data, DistFunc dist_func, double eps, size_t min_pts, unsigned threads)
+{
+  const size_t n{data.Rows()};
+  const size_t d{data.Cols()};
+  if (n == 0 || d == 0 || !(eps > 0.0) || min_pts == 0 || n > std::numeric_limits<uint32_t>::max()) {
+    return DbscanResult{};
+  }
+  threads = ThreadCount(threads, n, kMinRowsPerThread);
+  const GridIndex grid{data, eps};
+
+  DbscanResult res;
+  res.core.resize(n);
+  ParallelFor(n, threads, [&](unsigned /*t*/, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const double* row{grid.Row(i)};
+      size_t count{0};
+      grid.ForCandidates(i, [&](uint32_t /*j*/, const double* other) {
+        count += Within(dist_func, row, other, d, eps) ? 1 : 0;
+        return count < min_pts;
+      });
+      res.core[i] = count >= min_pts ? 1 : 0;
+    }
+  });
+
+  // Join the core points with their core neighbors, and find the first core neighbor of the other points.
+  constexpr uint32_t kNone{std::numeric_limits<uint32_t>::max()};
+  ConcurrentUnionFind sets{n};
+  std::vector<uint32_t> first_core(n, kNone);
+  ParallelFor(n, threads, [&](unsigned /*t*/, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const double* row{grid.Row(i)};
+      const bool core{res.core[i] != 0};
+      grid.ForCandidates(i, [&](uint32_t j, const double* other) {
+        if (res.core[j] != 0 && Within(dist_func, row, other, d, eps)) {
+          if (core) {
+            if (j < i) {
+              sets.Union(static_cast<uint32_t>(i), j);
+            }
+          } else {
+            first_core[i] = std::min(first_core[i], j);
+          }
+        }
+        return true;
+      });
+    }
+  });
+
+  // The root of a cluster is its first core point, so numbering the roots in order numbers the clusters by it.
+  res.labels.assign(n, 0);
+  for (size_t i = 0; i < n; i++) {
+    if (res.core[i] != 0 && sets.Find(static_cast<uint32_t>(i)) == i) {
+      res.labels[i] = ++res.clusters;
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (res.core[i] != 0) {
+      res.labels[i] = res.labels[sets.Find(static_cast<uint32_t>(i))];
+    } else if (first_core[i] != kNone) {
+      res.labels[i] = res.labels[sets.Find(first_core[i])];
     }
-    clusters[min_cluster].emplace_back(pt);
   }
+  return res;
+}
 
-  return clusters;
+LabeledPoints DBSCAN(const geometry::Points& points, DistFunc dist_func, double eps, int min_pts)
+{
+  LabeledPoints lpts;
+  if (static_cast<size_t>(min_pts) >= points.size() || min_pts <= 0 || points.empty() || eps <= 0.0) {
+    return lpts;
+  }
+  const DbscanResult res{DBSCAN(FeatureMatrix(points), dist_func, eps, static_cast<size_t>(min_pts))};
+  for (size_t i = 0; i < points.size(); i++) {
+    lpts.emplace_back(LabeledPoint{points[i].x, points[i].y, 0.0, std::to_string(res.labels[i])});
+  }
+  return lpts;
 }
 
+
 /////////////////////////////////////////////
-/// KNN
+/// Hierarchical clustering
 /////////////////////////////////////////////
 
 namespace {
-// For comparing distances
-struct LPointDistComp {
-  bool operator()(const LabeledPoint& p1, const LabeledPoint& p2) const
-  {
-    return p1.dist < p2.dist;
-  }
-};
-}//namespace
 
-LabeledPoints KNearestNeighbor(const geometry::Points& unlabeled_data, LabeledPoints& labeled_data, uint8_t k)
+/// \brief Writes the distances from row i to the rows begin to end. The features are the outer loop, so the inner
+/// loop runs over a column and vectorizes.
+void DistanceRow(const FeatureView& data, DistFunc dist_func, size_t i, size_t begin, size_t end, double* out)
 {
-  if (k > unlabeled_data.size() || k == 0 || unlabeled_data.empty() || labeled_data.empty()) {
-    return LabeledPoints{};
+  std::fill(out, out + (end - begin), 0.0);
+  for (size_t j = 0; j < data.Cols(); j++) {
+    const double* col{data.Column(j) + begin};
+    const double center{data(i, j)};
+    if (dist_func == DistFunc::Manhattan) {
+      for (size_t p = 0; p < end - begin; p++) {
+        out[p] += std::abs(col[p] - center);
+      }
+    } else {
+      for (size_t p = 0; p < end - begin; p++) {
+        out[p] += (col[p] - center) * (col[p] - center);
+      }
+    }
+  }
+  if (dist_func == DistFunc::Euclidean) {
+    for (size_t p = 0; p < end - begin; p++) {
+      out[p] = std::sqrt(out[p]);
+    }
   }
+}
 
-  std::set<std::string> labels;
-  LabeledPoints ret_labeled;
+/// \brief The position of the pair i < j in a condensed matrix of n points.
+size_t CondensedIndex(size_t n, size_t i, size_t j)
+{
+  return n * i - i * (i + 1) / 2 + j - i - 1;
+}
 
-  for (auto point : unlabeled_data) {
+/// \brief The distance from the merge of a and b to x, from the distances before the merge (Lance-Williams).
+double LanceWilliams(Linkage linkage, double ax, double bx, double ab, double size_a, double size_b, double size_x)
+{
+  switch (linkage) {
+    case Linkage::Complete:
+      return std::max(ax, bx);
+    case Linkage::Average:
+      return (size_a * ax + size_b * bx) / (size_a + size_b);
+    case Linkage::Ward: {
+      const double sum{(size_a + size_x) * ax * ax + (size_b + size_x) * bx * bx - size_x * ab * ab};
+      return std::sqrt(std::max(sum, 0.0) / (size_a + size_b + size_x));
+    }
+    default:
+      return std::min(ax, bx);
+  }
+}
 
-    for (auto& ld : labeled_data) {
-      ld.dist = Dist2(point, {ld.x, ld.y});
-      labels.insert(ld.label);
+/// \brief Merges of the nearest-neighbor chain algorithm, in the order they were found, as pairs of points. The
+/// cluster of a merge lives on in the slot of its second point.
+std::vector<std::pair<std::pair<uint32_t, uint32_t>, double>> NearestNeighborChain(std::vector<double>& dist, size_t n,
+                                                                                   Linkage linkage)
+{
+  std::vector<std::pair<std::pair<uint32_t, uint32_t>, double>> merges;
+  std::vector<uint32_t> size(n, 1);
+  std::vector<uint8_t> active(n, 1);
+  std::vector<uint32_t> chain;
+  const auto at = [&dist, n](size_t i, size_t j) -> double& {
+    return dist[i < j ? CondensedIndex(n, i, j) : CondensedIndex(n, j, i)];
+  };
+  // Calls f(x, distance of a and x) for the active x, walking down the column of a and then along its row.
+  const auto for_each_active = [&dist, &active, n](size_t a, const auto& f) {
+    size_t pos{a - 1};
+    for (size_t x = 0; x < a; x++) {
+      if (active[x]) {
+        f(x, dist[pos]);
+      }
+      pos += n - x - 2;
     }
+    pos = a + 1 < n ? CondensedIndex(n, a, a + 1) : 0;
+    for (size_t x = a + 1; x < n; x++, pos++) {
+      if (active[x]) {
+        f(x, dist[pos]);
+      }
+    }
+  };
 
-    std::sort(labeled_data.begin(), labeled_data.end(), LPointDistComp());
-    std::string label_to_use;
-    int max_count{0};
+  size_t first_active{0};
+  for (size_t step = 0; step + 1 < n; step++) {
+    if (chain.empty()) {
+      while (!active[first_active]) {
+        first_active++;
+      }
+      chain.push_back(static_cast<uint32_t>(first_active));
+    }
 
-    for (const auto& label : labels) {
-      int count = std::count_if(labeled_data.begin(), labeled_data.begin() + k, [&label](const LabeledPoint& lp) {
-        return lp.label == label;
+    // Follows the nearest neighbors until the last two are each other's nearest. The previous cluster of the chain
+    // wins ties, so the chain can not cycle.
+    uint32_t a{0};
+    uint32_t b{0};
+    double ab{0.0};
+    while (true) {
+      a = chain.back();
+      const bool has_prev{chain.size() >= 2};
+      b = has_prev ? chain[chain.size() - 2] : 0;
+      ab = has_prev ? at(a, b) : std::numeric_limits<double>::infinity();
+      for_each_active(a, [&ab, &b](size_t x, double d) {
+        if (d < ab) {
+          ab = d;
+          b = static_cast<uint32_t>(x);
+        }
       });
+      if (has_prev && b == chain[chain.size() - 2]) {
+        break;
+      }
+      chain.push_back(b);
+    }
+    chain.resize(chain.size() - 2);
 
-      if (count > max_count) {
-        max_count = count;
-        label_to_use = label;
+    merges.push_back({{a, b}, ab});
+    active[a] = 0;
+    for_each_active(b, [&](size_t x, double& d) {
+      d = LanceWilliams(linkage, at(a, x), d, ab, size[a], size[b], size[x]);
+    });
+    size[b] += size[a];
+  }
+  return merges;
+}
+
+/// \brief The minimum spanning tree of the points with Prim's algorithm, each edge as a pair of points. Only the
+/// distances of the last added point are computed in each step, so no distance matrix is stored.
+std::vector<std::pair<std::pair<uint32_t, uint32_t>, double>> PrimTree(const FeatureView& data, DistFunc dist_func)
+{
+  const size_t n{data.Rows()};
+  std::vector<std::pair<std::pair<uint32_t, uint32_t>, double>> edges;
+  std::vector<double> nearest(n, std::numeric_limits<double>::infinity());
+  std::vector<uint32_t> parent(n, 0);
+  std::vector<uint8_t> in_tree(n, 0);
+  std::vector<double> row(n);
+
+  size_t last{0};
+  in_tree[0] = 1;
+  for (size_t step = 0; step + 1 < n; step++) {
+    DistanceRow(data, dist_func, last, 0, n, row.data());
+    size_t next{n};
+    for (size_t x = 0; x < n; x++) {
+      if (in_tree[x]) {
+        continue;
+      }
+      if (row[x] < nearest[x]) {
+        nearest[x] = row[x];
+        parent[x] = static_cast<uint32_t>(last);
+      }
+      if (next == n || nearest[x] < nearest[next]) {
+        next = x;
       }
     }
+    edges.push_back({{parent[next], static_cast<uint32_t>(next)}, nearest[next]});
+    in_tree[next] = 1;
+    last = next;
+  }
+  return edges;
+}
 
-    ret_labeled.emplace_back(LabeledPoint{point.x, point.y, 0.0, label_to_use});
+/// \brief Sorts merges of pairs of points by distance and numbers the clusters like SciPy.
+std::vector<ClusterMerge> NumberMerges(std::vector<std::pair<std::pair<uint32_t, uint32_t>, double>> merges, size_t n)
+{
+  std::stable_sort(merges.begin(), merges.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+  ConcurrentUnionFind sets{n};
+  std::vector<uint32_t> cluster(n);
+  std::vector<uint32_t> size(n, 1);
+  for (size_t i = 0; i < n; i++) {
+    cluster[i] = static_cast<uint32_t>(i);
   }
 
-  return ret_labeled;
+  std::vector<ClusterMerge> result;
+  for (const auto& [pair, distance] : merges) {
+    const uint32_t a{sets.Find(pair.first)};
+    const uint32_t b{sets.Find(pair.second)};
+    result.push_back(ClusterMerge{std::min(cluster[a], cluster[b]), std::max(cluster[a], cluster[b]), distance,
+                                  size[a] + size[b]});
+    sets.Union(a, b);
+    const uint32_t root{sets.Find(a)};
+    cluster[root] = static_cast<uint32_t>(n + result.size() - 1);
+    size[root] = result.back().size;
+  }
+  return result;
+}
+
+}// namespace
+
+std::vector<double> CondensedDistances(const FeatureView& data, DistFunc dist_func, unsigned threads)
+{
+  constexpr size_t kMinPairsPerThread{1 << 16};
+  const size_t n{data.Rows()};
+  std::vector<double> dist(n < 2 ? 0 : n * (n - 1) / 2);
+
+  // Each thread takes an equal share of the pairs, starting in the middle of a row.
+  ParallelFor(dist.size(), ThreadCount(threads, dist.size(), kMinPairsPerThread),
+              [&](unsigned /*t*/, size_t begin, size_t end) {
+                size_t i{0};
+                while (CondensedIndex(n, i, n - 1) < begin) {
+                  i++;
+                }
+                size_t pos{begin};
+                while (pos < end) {
+                  const size_t row_begin{CondensedIndex(n, i, i + 1)};
+                  const size_t j_begin{i + 1 + (pos - row_begin)};
+                  const size_t j_end{std::min(n, j_begin + (end - pos))};
+                  DistanceRow(data, dist_func, i, j_begin, j_end, dist.data() + pos);
+                  pos += j_end - j_begin;
+                  i++;
+                }
+              });
+  return dist;
+}
+
+std::vector<ClusterMerge> HierarchicalClustering(const FeatureView& data, Linkage linkage, DistFunc dist_func,
+                                                 unsigned threads)
+{
+  const size_t n{data.Rows()};
+  if (n < 2 || n > std::numeric_limits<uint32_t>::max() / 2
+      || (linkage == Linkage::Ward && dist_func != DistFunc::Euclidean)) {
+    return {};
+  }
+  if (linkage == Linkage::Single) {
+    return NumberMerges(PrimTree(data, dist_func), n);
+  }
+  std::vector<double> dist{CondensedDistances(data, dist_func, threads)};
+  return NumberMerges(NearestNeighborChain(dist, n, linkage), n);
+}
+
+std::vector<uint32_t> CutTree(const std::vector<ClusterMerge>& merges, size_t clusters)
+{
+  const size_t n{merges.size() + 1};
+  if (clusters == 0 || clusters > n) {
+    return {};
+  }
+  // The points of each cluster: the first merges are applied on the points they contain.
+  ConcurrentUnionFind sets{n};
+  std::vector<uint32_t> point(n + merges.size());
+  for (size_t i = 0; i < n; i++) {
+    point[i] = static_cast<uint32_t>(i);
+  }
+  for (size_t m = 0; m < n - clusters; m++) {
+    sets.Union(point[merges[m].first], point[merges[m].second]);
+    point[n + m] = point[merges[m].first];
+  }
+
+  std::vector<uint32_t> labels(n);
+  std::unordered_map<uint32_t, uint32_t> numbers;
+  for (size_t i = 0; i < n; i++) {
+    const auto next = static_cast<uint32_t>(numbers.size());
+    labels[i] = numbers.emplace(sets.Find(static_cast<uint32_t>(i)), next).first->second;
+  }
+  return labels;
 }
 
+
 /////////////////////////////////////////////
-/// DBSCAN
+/// Gaussian mixture
 /////////////////////////////////////////////
 
 namespace {
-constexpr auto Dist = [](DistFunc dist_func, const geometry::Point& pt1, const geometry::Point& pt2) {
-  if (dist_func == DistFunc::Manhattan) {
-    return std::abs(std::abs(pt1.x) + std::abs(pt1.y) - std::abs(pt2.x) + std::abs(pt2.y));
+
+constexpr size_t kGmmChunk{256};
+constexpr double kLog2Pi{1.8378770664093454836};
+
+/// \brief Replaces n values with their exponential.
+using ExpFunc = void (*)(double* values, size_t n);
+
+void ExpScalar(double* values, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    values[i] = std::exp(values[i]);
   }
-  if (dist_func == DistFunc::Euclidean) {
-    return Dist2(pt1, pt2);
+}
+
+#ifdef ALGO_SIMD_X86
+/// \brief exp(x) = 2^t exp(r) with x = t ln 2 + r and |r| <= ln 2 / 2. exp(r) is a Taylor polynomial of degree 12,
+/// within a few ulp, and 2^t is built in the exponent bits. The input is clamped to [-708, 709], so the smallest result
+/// is exp(-708) instead of 0, which is far below the values log-sum-exp adds it to.
+ALGO_TARGET_AVX2 void ExpAvx2(double* values, size_t n)
+{
+  constexpr double kTaylor[13]{1.0,
+                               1.0,
+                               1.0 / 2,
+                               1.0 / 6,
+                               1.0 / 24,
+                               1.0 / 120,
+                               1.0 / 720,
+                               1.0 / 5040,
+                               1.0 / 40320,
+                               1.0 / 362880,
+                               1.0 / 3628800,
+                               1.0 / 39916800,
+                               1.0 / 479001600};
+  // ln 2 in two parts, t times the first part is exact.
+  const __m256d ln2_high{_mm256_set1_pd(6.93145751953125e-1)};
+  const __m256d ln2_low{_mm256_set1_pd(1.42860682030941723212e-6)};
+  const __m256d log2e{_mm256_set1_pd(1.4426950408889634074)};
+  const __m256d low{_mm256_set1_pd(-708.0)};
+  const __m256d high{_mm256_set1_pd(709.0)};
+  size_t i{0};
+  for (; i + 4 <= n; i += 4) {
+    const __m256d x{_mm256_min_pd(_mm256_max_pd(_mm256_loadu_pd(values + i), low), high)};
+    const __m256d t{_mm256_round_pd(_mm256_mul_pd(x, log2e), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)};
+    const __m256d r{_mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(t, ln2_high)), _mm256_mul_pd(t, ln2_low))};
+    __m256d poly{_mm256_set1_pd(kTaylor[12])};
+    for (int p = 11; p >= 0; p--) {
+      poly = _mm256_add_pd(_mm256_mul_pd(poly, r), _mm256_set1_pd(kTaylor[p]));
+    }
+    const __m256i exponent{_mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(t)), _mm256_set1_epi64x(1023))};
+    _mm256_storeu_pd(values + i, _mm256_mul_pd(poly, _mm256_castsi256_pd(_mm256_slli_epi64(exponent, 52))));
   }
-  return 0.0;
-};
+  ExpScalar(values + i, n - i);
+}
+#endif
+
+void Exp(double* values, size_t n)
+{
+  static const ExpFunc kernel = []() -> ExpFunc {
+#ifdef ALGO_SIMD_X86
+    if (simd::HasAvx2()) {
+      return ExpAvx2;
+    }
+#endif
+    return ExpScalar;
+  }();
+  kernel(values, n);
+}
+
+/// \brief Turns the log probabilities of m points and k components, stored component by component, into
+/// responsibilities with log-sum-exp, and writes the log of the summed probabilities of each point to lse. All loops
+/// run over the points, so they vectorize. sums holds m values.
+void Responsibilities(double* logp, size_t m, size_t k, double* lse, double* sums)
+{
+  std::fill(lse, lse + m, -std::numeric_limits<double>::infinity());
+  for (size_t c = 0; c < k; c++) {
+    for (size_t r = 0; r < m; r++) {
+      lse[r] = std::max(lse[r], logp[c * m + r]);
+    }
+  }
+  for (size_t c = 0; c < k; c++) {
+    for (size_t r = 0; r < m; r++) {
+      logp[c * m + r] -= lse[r];
+    }
+  }
+  Exp(logp, m * k);
+  std::fill(sums, sums + m, 0.0);
+  for (size_t c = 0; c < k; c++) {
+    for (size_t r = 0; r < m; r++) {
+      sums[r] += logp[c * m + r];
+    }
+  }
+  for (size_t r = 0; r < m; r++) {
+    lse[r] += std::log(sums[r]);
+    sums[r] = 1.0 / sums[r];
+  }
+  for (size_t c = 0; c < k; c++) {
+    for (size_t r = 0; r < m; r++) {
+      logp[c * m + r] *= sums[r];
+    }
+  }
+}
+
+}// namespace
 
-struct Neighbor {
-  LabeledPoint pt;
-  int idx;
+/// \brief The sums of the M-step. The points are centered on the current means, which keeps the sums of squares
+/// accurate when the means are far from the origin.
+struct GaussianMixture::Stats {
+  Stats(size_t k, size_t d, bool full) : counts(k), first(k * d), second(k * d * (full ? d : 1))
+  {}
+
+  double log_likelihood{0.0};
+  std::vector<double> counts;///< Sum of responsibilities.
+  std::vector<double> first; ///< Sum of responsibility times the centered point.
+  std::vector<double> second;///< Sum of responsibility times the outer product, or squares, of the centered point.
 };
 
-using Neighbors = std::queue<Neighbor>;
+GaussianMixture::GaussianMixture(size_t k, const GmmOptions& options) : k_{k}, options_{options}
+{}
 
-/// \brief Finds the neighbours of pt in lpts that are within eps distance. Skips itself (pt) in the result.
-/// \param lpts All the points to scan for neighbors.
-/// \param dist_func The distance functions, e.g. L1, L2.
-/// \param pt The main point that is the "center" when looking for neighbors.
-/// \param eps The maximum distance between two neighbors.
-/// \param skip_idx The index of pt in lpts, so it can be skipped.
-/// \return All the quialified neighbors of pt in lpts.
-Neighbors RangeQuery(const LabeledPoints& lpts, DistFunc dist_func, const LabeledPoint& pt, double eps)
+void GaussianMixture::LogProb(const FeatureView& data, size_t begin, size_t m, double* logp, double* scratch) const
 {
-  Neighbors neighbors;
-  for (size_t idx = 0; idx < lpts.size(); idx++) {
-    double dist{Dist(dist_func, {lpts[idx].x, lpts[idx].y}, {pt.x, pt.y})};
-    if (dist < eps) {
-      neighbors.push(Neighbor{lpts[idx], static_cast<int>(idx)});
+  const size_t d{dims_};
+  const bool full{options_.covariance == CovarianceType::Full};
+  double* diff{scratch};
+  double* y{scratch + m * d};
+  for (size_t c = 0; c < k_; c++) {
+    double* out{logp + c * m};
+    std::fill(out, out + m, 0.0);
+    for (size_t j = 0; j < d; j++) {
+      const double* col{data.Column(j) + begin};
+      const double mean{means_(c, j)};
+      for (size_t r = 0; r < m; r++) {
+        diff[j * m + r] = col[r] - mean;
+      }
+    }
+    if (full) {
+      // The squared length of W (x - mean), with W the inverse of the Cholesky factor of the covariance.
+      const double* w{factors_.data() + c * d * d};
+      for (size_t j = 0; j < d; j++) {
+        std::fill(y, y + m, 0.0);
+        for (size_t l = 0; l <= j; l++) {
+          const double factor{w[j * d + l]};
+          for (size_t r = 0; r < m; r++) {
+            y[r] += factor * diff[l * m + r];
+          }
+        }
+        for (size_t r = 0; r < m; r++) {
+          out[r] += y[r] * y[r];
+        }
+      }
+    } else {
+      const double* inv_std{factors_.data() + c * d};
+      for (size_t j = 0; j < d; j++) {
+        for (size_t r = 0; r < m; r++) {
+          const double z{diff[j * m + r] * inv_std[j]};
+          out[r] += z * z;
+        }
+      }
+    }
+    for (size_t r = 0; r < m; r++) {
+      out[r] = constants_[c] - 0.5 * out[r];
     }
   }
-  return neighbors;
 }
-}//namespace
 
-LabeledPoints DBSCAN(const geometry::Points& points, DistFunc dist_func, double eps, int min_pts)
+void GaussianMixture::Accumulate(const FeatureView& data, size_t begin, size_t m, const double* resp, Stats& stats,
+                                 double* scratch) const
 {
-  LabeledPoints lpts;
-  if (static_cast<size_t>(min_pts) >= points.size() || min_pts == 0 || points.empty() || eps <= 0.0) {
-    return lpts;
-  }
-  for (const auto& pt : points) {
-    lpts.emplace_back(LabeledPoint{pt.x, pt.y, 0.0, "undef"});
+  const size_t d{dims_};
+  const bool full{options_.covariance == CovarianceType::Full};
+  double* diff{scratch};
+  for (size_t c = 0; c < k_; c++) {
+    const double* w{resp + c * m};
+    for (size_t r = 0; r < m; r++) {
+      stats.counts[c] += w[r];
+    }
+    for (size_t j = 0; j < d; j++) {
+      const double* col{data.Column(j) + begin};
+      const double mean{means_(c, j)};
+      double sum{0.0};
+      for (size_t r = 0; r < m; r++) {
+        diff[j * m + r] = col[r] - mean;
+        sum += w[r] * diff[j * m + r];
+      }
+      stats.first[c * d + j] += sum;
+    }
+    for (size_t j = 0; j < d; j++) {
+      for (size_t l = full ? 0 : j; l <= j; l++) {
+        double sum{0.0};
+        for (size_t r = 0; r < m; r++) {
+          sum += w[r] * diff[j * m + r] * diff[l * m + r];
+        }
+        stats.second[full ? (c * d + j) * d + l : c * d + j] += sum;
+      }
+    }
   }
-  int cluster_count{0};
-  // DBSCAN algorithm
-  for (size_t idx = 0; idx < lpts.size(); idx++) {
-    if (lpts[idx].label != "undef") {
-      continue;
+}
+
+GaussianMixture::Stats GaussianMixture::Collect(const FeatureView& data, unsigned threads,
+                                                const uint32_t* hard_labels) const
+{
+  const size_t n{data.Rows()};
+  const bool full{options_.covariance == CovarianceType::Full};
+  std::vector<Stats> parts(threads, Stats{k_, dims_, full});
+  ParallelFor(n, threads, [&](unsigned t, size_t begin, size_t end) {
+    std::vector<double> resp(kGmmChunk * k_);
+    std::vector<double> scratch(kGmmChunk * (dims_ + 1));
+    std::vector<double> lse(kGmmChunk);
+    std::vector<double> sums(kGmmChunk);
+    for (size_t b = begin; b < end; b += kGmmChunk) {
+      const size_t m{std::min(kGmmChunk, end - b)};
+      if (hard_labels != nullptr) {
+        std::fill(resp.begin(), resp.end(), 0.0);
+        for (size_t r = 0; r < m; r++) {
+          resp[hard_labels[b + r] * m + r] = 1.0;
+        }
+      } else {
+        LogProb(data, b, m, resp.data(), scratch.data());
+        Responsibilities(resp.data(), m, k_, lse.data(), sums.data());
+        for (size_t r = 0; r < m; r++) {
+          parts[t].log_likelihood += lse[r];
+        }
+      }
+      Accumulate(data, b, m, resp.data(), parts[t], scratch.data());
     }
+  });
 
-    Neighbors neighbors{RangeQuery(lpts, dist_func, lpts[idx], eps)};
-    if (neighbors.size() < static_cast<size_t>(min_pts)) {
-      lpts[idx].label = "0";// Noise
-      continue;
+  Stats total{k_, dims_, full};
+  for (const Stats& part : parts) {
+    total.log_likelihood += part.log_likelihood;
+    for (size_t i = 0; i < total.counts.size(); i++) {
+      total.counts[i] += part.counts[i];
+    }
+    for (size_t i = 0; i < total.first.size(); i++) {
+      total.first[i] += part.first[i];
+    }
+    for (size_t i = 0; i < total.second.size(); i++) {
+      total.second[i] += part.second[i];
     }
-    cluster_count++;
-    lpts[idx].label = std::to_string(cluster_count);
+  }
+  return total;
+}
 
-    while (!neighbors.empty()) {
-      Neighbor q{neighbors.front()};
-      neighbors.pop();
+bool GaussianMixture::Maximize(const Stats& stats, size_t n)
+{
+  const size_t d{dims_};
+  const bool full{options_.covariance == CovarianceType::Full};
+  const double reg{std::max(options_.regularization, 0.0)};
+  weights_.resize(k_);
+  covariances_.assign(k_ * d * (full ? d : 1), 0.0);
+  for (size_t c = 0; c < k_; c++) {
+    // A component without points keeps its mean and gets the regularization as covariance.
+    const double count{stats.counts[c] + 10 * std::numeric_limits<double>::epsilon()};
+    weights_[c] = count / (static_cast<double>(n) + 10 * std::numeric_limits<double>::epsilon() * k_);
+    std::vector<double> shift(d);
+    for (size_t j = 0; j < d; j++) {
+      shift[j] = stats.first[c * d + j] / count;
+      means_(c, j) += shift[j];
+    }
+    for (size_t j = 0; j < d; j++) {
+      if (full) {
+        for (size_t l = 0; l <= j; l++) {
+          const double cov{stats.second[(c * d + j) * d + l] / count - shift[j] * shift[l]};
+          covariances_[(c * d + j) * d + l] = cov;
+          covariances_[(c * d + l) * d + j] = cov;
+        }
+        covariances_[(c * d + j) * d + j] += reg;
+      } else {
+        covariances_[c * d + j] = std::max(stats.second[c * d + j] / count - shift[j] * shift[j], 0.0) + reg;
+      }
+    }
+  }
+  return Factorize();
+}
 
-      if (q.pt.label == "0") {// Noise
-        lpts[q.idx].label = std::to_string(cluster_count);
+bool GaussianMixture::Factorize()
+{
+  const size_t d{dims_};
+  const bool full{options_.covariance == CovarianceType::Full};
+  std::vector<double> factors(k_ * d * (full ? d : 1));
+  std::vector<double> constants(k_);
+  std::vector<double> chol(d * d);
+  for (size_t c = 0; c < k_; c++) {
+    double log_det{0.0};
+    if (full) {
+      // Cholesky factor L of the covariance, then W = L^-1, both lower triangular.
+      const double* cov{covariances_.data() + c * d * d};
+      std::fill(chol.begin(), chol.end(), 0.0);
+      for (size_t j = 0; j < d; j++) {
+        for (size_t l = 0; l <= j; l++) {
+          double sum{cov[j * d + l]};
+          for (size_t p = 0; p < l; p++) {
+            sum -= chol[j * d + p] * chol[l * d + p];
+          }
+          if (l == j) {
+            if (!(sum > 0.0)) {
+              return false;
+            }
+            chol[j * d + j] = std::sqrt(sum);
+          } else {
+            chol[j * d + l] = sum / chol[l * d + l];
+          }
+        }
+        log_det += 2.0 * std::log(chol[j * d + j]);
+      }
+      double* w{factors.data() + c * d * d};
+      for (size_t j = 0; j < d; j++) {
+        w[j * d + j] = 1.0 / chol[j * d + j];
+        for (size_t l = 0; l < j; l++) {
+          double sum{0.0};
+          for (size_t p = l; p < j; p++) {
+            sum += chol[j * d + p] * w[p * d + l];
+          }
+          w[j * d + l] = -sum / chol[j * d + j];
+        }
       }
-      if (q.pt.label == "undef") {
-        lpts[q.idx].label = std::to_string(cluster_count);
-        Neighbors neighbors_n{RangeQuery(lpts, dist_func, q.pt, eps)};
+    } else {
+      for (size_t j = 0; j < d; j++) {
+        const double var{covariances_[c * d + j]};
+        if (!(var > 0.0)) {
+          return false;
+        }
+        factors[c * d + j] = 1.0 / std::sqrt(var);
+        log_det += std::log(var);
+      }
+    }
+    constants[c] = std::log(weights_[c]) - 0.5 * (static_cast<double>(d) * kLog2Pi + log_det);
+  }
+  factors_ = std::move(factors);
+  constants_ = std::move(constants);
+  return true;
+}
+
+bool GaussianMixture::Fit(const FeatureView& data)
+{
+  const size_t n{data.Rows()};
+  factors_.clear();
+  constants_.clear();
+  iterations_ = 0;
+  converged_ = false;
+  if (k_ == 0 || n < k_ || data.Cols() == 0 || k_ > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+  dims_ = data.Cols();
+  const unsigned threads{ThreadCount(options_.threads, n, kMinRowsPerThread)};
+
+  // The first M-step gives each point responsibility 1 for its K-means cluster.
+  KMeansOptions kmeans;
+  kmeans.seed = options_.seed;
+  kmeans.threads = options_.threads;
+  const KMeansResult init{KMeans(data, k_, kmeans)};
+  if (init.labels.size() != n) {
+    return false;
+  }
+  means_ = init.centroids;
+  if (!Maximize(Collect(data, threads, init.labels.data()), n)) {
+    constants_.clear();
+    return false;
+  }
+
+  double previous{-std::numeric_limits<double>::infinity()};
+  while (iterations_ < options_.max_iterations) {
+    const Stats stats{Collect(data, threads, nullptr)};
+    iterations_++;
+    log_likelihood_ = stats.log_likelihood / static_cast<double>(n);
+    if (!Maximize(stats, n)) {
+      constants_.clear();
+      return false;
+    }
+    if (std::abs(log_likelihood_ - previous) < options_.tolerance) {
+      converged_ = true;
+      break;
+    }
+    previous = log_likelihood_;
+  }
+  return true;
+}
 
-        if (neighbors_n.size() >= static_cast<size_t>(min_pts)) {
-          while (!neighbors_n.empty()) {
-            Neighbor nb{neighbors_n.front()};
-            neighbors_n.pop();
-            lpts[nb.idx].label = std::to_string(cluster_count);
-            neighbors.push(nb);
+std::vector<uint32_t> GaussianMixture::Predict(const FeatureView& data) const
+{
+  std::vector<uint32_t> labels;
+  if (!Fitted() || data.Cols() != dims_) {
+    return labels;
+  }
+  const size_t n{data.Rows()};
+  labels.resize(n);
+  ParallelFor(n, ThreadCount(options_.threads, n, kMinRowsPerThread), [&](unsigned /*t*/, size_t begin, size_t end) {
+    std::vector<double> logp(kGmmChunk * k_);
+    std::vector<double> scratch(kGmmChunk * (dims_ + 1));
+    for (size_t b = begin; b < end; b += kGmmChunk) {
+      const size_t m{std::min(kGmmChunk, end - b)};
+      LogProb(data, b, m, logp.data(), scratch.data());
+      for (size_t r = 0; r < m; r++) {
+        uint32_t best{0};
+        for (size_t c = 1; c < k_; c++) {
+          if (logp[c * m + r] > logp[best * m + r]) {
+            best = static_cast<uint32_t>(c);
           }
         }
+        labels[b + r] = best;
       }
     }
+  });
+  return labels;
+}
+
+FeatureMatrix GaussianMixture::PredictProba(const FeatureView& data) const
+{
+  if (!Fitted() || data.Cols() != dims_) {
+    return FeatureMatrix{};
   }
-  return lpts;
+  const size_t n{data.Rows()};
+  FeatureMatrix proba(n, k_);
+  ParallelFor(n, ThreadCount(options_.threads, n, kMinRowsPerThread), [&](unsigned /*t*/, size_t begin, size_t end) {
+    std::vector<double> resp(kGmmChunk * k_);
+    std::vector<double> scratch(kGmmChunk * (dims_ + 1));
+    std::vector<double> lse(kGmmChunk);
+    std::vector<double> sums(kGmmChunk);
+    for (size_t b = begin; b < end; b += kGmmChunk) {
+      const size_t m{std::min(kGmmChunk, end - b)};
+      LogProb(data, b, m, resp.data(), scratch.data());
+      Responsibilities(resp.data(), m, k_, lse.data(), sums.data());
+      for (size_t c = 0; c < k_; c++) {
+        std::copy(resp.data() + c * m, resp.data() + (c + 1) * m, proba.Column(c) + b);
+      }
+    }
+  });
+  return proba;
+}
+
+std::vector<double> GaussianMixture::ScoreSamples(const FeatureView& data) const
+{
+  std::vector<double> scores;
+  if (!Fitted() || data.Cols() != dims_) {
+    return scores;
+  }
+  const size_t n{data.Rows()};
+  scores.resize(n);
+  ParallelFor(n, ThreadCount(options_.threads, n, kMinRowsPerThread), [&](unsigned /*t*/, size_t begin, size_t end) {
+    std::vector<double> resp(kGmmChunk * k_);
+    std::vector<double> scratch(kGmmChunk * (dims_ + 1));
+    std::vector<double> sums(kGmmChunk);
+    for (size_t b = begin; b < end; b += kGmmChunk) {
+      const size_t m{std::min(kGmmChunk, end - b)};
+      LogProb(data, b, m, resp.data(), scratch.data());
+      Responsibilities(resp.data(), m, k_, scores.data() + b, sums.data());
+    }
+  });
+  return scores;
 }
 
 }// namespace algo::data_mining
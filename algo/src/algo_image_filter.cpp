@@ -10,6 +10,8 @@
 #include <algorithm>
 #include <cmath>
 
+#include "algo_sort.hpp"
+
 namespace algo::image::filter {
 
 /////////////////////////////////////////////
@@ -201,10 +203,11 @@ Data8 MedianFilterPriv(const Data8& im, int rows, int cols, int w_width, int w_h
   int edge_x{w_width / 2};
   int edge_y{w_height / 2};
 
+  std::vector<int> window(w_width * w_height, 0);
+
   for (int x = 0; x < cols - edge_x; x++) {
     for (int y = 0; y < rows - edge_y; y++) {
 
-      std::vector<int> window(w_height * w_height, 0);
       int i{0};
 
       for (int wx = 0; wx < w_width; wx++) {
@@ -213,7 +216,7 @@ Data8 MedianFilterPriv(const Data8& im, int rows, int cols, int w_width, int w_h
           i++;
         }
       }
-      std::sort(window.begin(), window.end());
+      sort::SmallSort(window.data(), window.size());
       res[y * cols + x] = window[w_width * w_height / 2];
     }
   }
@@ -9,6 +9,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <fstream>
+#include <limits>
 #include <string>
 
 namespace algo::search {
@@ -24,19 +26,7 @@ int Binary(const std::vector<T>& vec, T value)
     return -1;
   }
 
-  size_t l{0};
-  size_t r{vec.size()};
-
-  while (l < r) {
-
-    int m = std::floor((l + r) / 2);
-    if (vec[m] < value) {
-      l = m + 1;
-    } else {
-      r = m;
-    }
-  }
-
+  const size_t l{LowerBound(vec, value)};
   if (l == vec.size()) {
     return -1;
   }
@@ -47,88 +37,176 @@ template int Binary<int>(const std::vector<int>& vec, int value);
 template int Binary<std::string>(const std::vector<std::string>& vec, std::string value);
 
 /////////////////////////////////////////////
-/// Selection search
+/// Learned index
 /////////////////////////////////////////////
 
-template<typename T>
-void SelectionMinPriv(std::vector<T>& vec, const T& k)
+LearnedIndex::LearnedIndex(const uint64_t* keys, size_t n, size_t epsilon) : n_(n), epsilon_(epsilon)
 {
-  for (T i = 0; i <= k; ++i) {
-    size_t min_index{static_cast<size_t>(i)};
-    T minVal{vec[i]};
-
-    for (size_t j = i + 1; j < vec.size(); ++j) {
-      if (vec[j] < minVal) {
-        min_index = j;
-        minVal = vec[j];
+  const double eps{static_cast<double>(epsilon)};
+  size_t i{0};
+
+  while (i < n) {
+    // The segment is anchored in its first key, the cone [lo, hi] holds the slopes that fit all keys so far.
+    const uint64_t x0{keys[i]};
+    const size_t y0{i};
+    double lo{0.0};
+    double hi{std::numeric_limits<double>::infinity()};
+
+    for (i++; i < n; i++) {
+      if (keys[i] == keys[i - 1]) {
+        // Only the first position of a key is a lower bound.
+        continue;
+      }
+      const double dx{static_cast<double>(keys[i] - x0)};
+      const double dy{static_cast<double>(i - y0)};
+      const double new_lo{std::max(lo, (dy - eps) / dx)};
+      const double new_hi{std::min(hi, (dy + eps) / dx)};
+      if (new_lo > new_hi) {
+        break;
       }
+      lo = new_lo;
+      hi = new_hi;
     }
 
-    T t{vec[min_index]};
-    vec[min_index] = vec[i];
-    vec[i] = t;
+    first_keys_.push_back(x0);
+    segments_.push_back({std::isinf(hi) ? 0.0 : (lo + hi) / 2, y0});
   }
 }
 
-template<typename T>
-std::vector<T> SelectionMin(std::vector<T> vec, T k)
+size_t LearnedIndex::LowerBound(const uint64_t* keys, uint64_t key) const
 {
-  if (vec.empty()) {
-    return vec;
+  if (n_ == 0) {
+    return 0;
   }
 
-  if (static_cast<size_t>(k) > vec.size()) {
-    return vec;
+  // The last segment that starts at or before key.
+  size_t s{search::LowerBound(first_keys_.data(), first_keys_.size(), key, std::less_equal<>{})};
+  s = s == 0 ? 0 : s - 1;
+
+  const Segment& seg{segments_[s]};
+  const double offset{key < first_keys_[s] ? 0.0 : seg.slope * static_cast<double>(key - first_keys_[s])};
+  const double predicted{std::min(static_cast<double>(seg.start) + offset, static_cast<double>(n_))};
+  const auto pos = static_cast<size_t>(predicted);
+
+  // One extra position on each side covers the rounding of the prediction.
+  const size_t lo{pos > epsilon_ + 1 ? pos - epsilon_ - 1 : 0};
+  const size_t hi{std::min(n_, pos + epsilon_ + 2)};
+
+  if (lo > 0 && keys[lo - 1] >= key) {
+    return search::LowerBound(keys, lo, key);
   }
+  const size_t res{lo + search::LowerBound(keys + lo, hi - lo, key)};
+  if (res == hi && hi < n_) {
+    return hi + search::LowerBound(keys + hi, n_ - hi, key);
+  }
+  return res;
+}
 
-  std::vector<T> temp{};
-  SelectionMinPriv(vec, k);
-  temp.resize(k);
-  std::copy_n(vec.begin(), k, temp.begin());
-  return temp;
+long long LearnedIndex::Find(const std::vector<uint64_t>& keys, uint64_t key) const
+{
+  const size_t pos{LowerBound(keys, key)};
+  if (pos == keys.size() || keys[pos] != key) {
+    return -1;
+  }
+  return static_cast<long long>(pos);
 }
 
-template std::vector<int> SelectionMin<int>(std::vector<int> vec, int value);
+namespace {
+constexpr char kLearnedIndexMagic[8]{'A', 'L', 'G', 'O', 'L', 'I', 'X', '1'};
+}// namespace
 
-template<typename T>
-void SelectionMaxPriv(std::vector<T>& vec, const T& k)
+bool LearnedIndex::Save(const std::string& path) const
 {
-  for (int i = 0; i <= k; ++i) {
-    size_t max_index{static_cast<size_t>(i)};
-    T minVal{vec[i]};
-
-    for (size_t j = i + 1; j < vec.size(); ++j) {
-      if (vec[j] > minVal) {
-        max_index = j;
-        minVal = vec[j];
-      }
-    }
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  const uint64_t header[3]{n_, epsilon_, first_keys_.size()};
+  file.write(kLearnedIndexMagic, sizeof(kLearnedIndexMagic));
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  file.write(reinterpret_cast<const char*>(first_keys_.data()), first_keys_.size() * sizeof(uint64_t));
+  file.write(reinterpret_cast<const char*>(segments_.data()), segments_.size() * sizeof(Segment));
+  return static_cast<bool>(file);
+}
+
+bool LearnedIndex::Load(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  char magic[sizeof(kLearnedIndexMagic)];
+  uint64_t header[3];
+  if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), kLearnedIndexMagic)
+      || !file.read(reinterpret_cast<char*>(header), sizeof(header)) || header[2] > header[0]
+      || (header[0] > 0 && header[2] == 0)) {
+    return false;
+  }
 
-    T t{vec[max_index]};
-    vec[max_index] = vec[i];
-    vec[i] = t;
+  // The number of segments is not trusted, the file must hold them before they are allocated.
+  const std::streamoff start{file.tellg()};
+  file.seekg(0, std::ios::end);
+  const auto remaining = static_cast<uint64_t>(file.tellg() - start);
+  file.seekg(start);
+  if (header[2] > remaining / (sizeof(uint64_t) + sizeof(Segment))) {
+    return false;
   }
+
+  std::vector<uint64_t> first_keys(header[2]);
+  std::vector<Segment> segments(header[2]);
+  if (!file.read(reinterpret_cast<char*>(first_keys.data()), first_keys.size() * sizeof(uint64_t))
+      || !file.read(reinterpret_cast<char*>(segments.data()), segments.size() * sizeof(Segment))) {
+    return false;
+  }
+
+  // LowerBound trusts the segments to predict positions inside [0, n] and to be ordered by their first keys.
+  for (size_t s = 0; s < segments.size(); s++) {
+    const Segment& seg{segments[s]};
+    const bool ordered{s == 0 ? seg.start == 0
+                              : seg.start > segments[s - 1].start && first_keys[s] > first_keys[s - 1]};
+    if (!ordered || seg.start >= header[0] || !std::isfinite(seg.slope) || seg.slope < 0.0) {
+      return false;
+    }
+  }
+
+  n_ = header[0];
+  epsilon_ = header[1];
+  first_keys_ = std::move(first_keys);
+  segments_ = std::move(segments);
+  return true;
 }
 
+/////////////////////////////////////////////
+/// Selection search
+/////////////////////////////////////////////
+
 template<typename T>
-std::vector<T> SelectionMax(std::vector<T> vec, T k)
+std::vector<T> SelectionMin(std::vector<T> vec, size_t k)
 {
-
-  if (vec.empty()) {
+  if (k > vec.size()) {
     return vec;
   }
+  PartialSort(vec.begin(), vec.begin() + k, vec.end());
+  vec.resize(k);
+  return vec;
+}
+
+template std::vector<int> SelectionMin<int>(std::vector<int> vec, size_t k);
+template std::vector<unsigned> SelectionMin<unsigned>(std::vector<unsigned> vec, size_t k);
+template std::vector<double> SelectionMin<double>(std::vector<double> vec, size_t k);
+template std::vector<std::string> SelectionMin<std::string>(std::vector<std::string> vec, size_t k);
 
-  if (static_cast<size_t>(k) > vec.size()) {
+template<typename T>
+std::vector<T> SelectionMax(std::vector<T> vec, size_t k)
+{
+  if (k > vec.size()) {
     return vec;
   }
-
-  std::vector<T> temp{};
-  SelectionMaxPriv(vec, k);
-  temp.resize(k);
-  std::copy_n(vec.begin(), k, temp.begin());
-  return temp;
+  PartialSort(vec.begin(), vec.begin() + k, vec.end(), std::greater<>{});
+  vec.resize(k);
+  return vec;
 }
 
-template std::vector<int> SelectionMax<int>(std::vector<int> vec, int value);
+template std::vector<int> SelectionMax<int>(std::vector<int> vec, size_t k);
+template std::vector<unsigned> SelectionMax<unsigned>(std::vector<unsigned> vec, size_t k);
+template std::vector<double> SelectionMax<double>(std::vector<double> vec, size_t k);
+template std::vector<std::string> SelectionMax<std::string>(std::vector<std::string> vec, size_t k);
 
 }// namespace algo::search
@@ -0,0 +1,46 @@
+///
+/// \brief Internal helpers for SIMD kernels, not part of the public headers.
+/// \author alex011235
+/// \date 2026-10-19
+/// \link <a href=https://github.com/alex011235/algo>Algo, Github</a>
+///
+/// The kernels are compiled for their instruction set with target attributes, so the library itself is built for the
+/// baseline CPU. The callers check the CPU at runtime and fall back to scalar code. Only GCC and Clang on x86 get
+/// the vector kernels, other compilers and CPUs use the scalar code.
+///
+
+#ifndef ALGO_ALGO_SRC_ALGO_SIMD_HPP_
+#define ALGO_ALGO_SRC_ALGO_SIMD_HPP_
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ALGO_SIMD_X86 1
+#include <immintrin.h>
+#define ALGO_TARGET_AVX2 __attribute__((target("avx2")))
+#define ALGO_TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+namespace algo::simd {
+
+/// \brief Returns true if the CPU supports AVX2.
+inline bool HasAvx2()
+{
+#ifdef ALGO_SIMD_X86
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+/// \brief Returns true if the CPU supports AVX-512 Foundation.
+inline bool HasAvx512()
+{
+#ifdef ALGO_SIMD_X86
+  return __builtin_cpu_supports("avx512f");
+#else
+  return false;
+#endif
+}
+
+}// namespace algo::simd
+
+#endif//ALGO_ALGO_SRC_ALGO_SIMD_HPP_
@@ -6,345 +6,504 @@
 #include "algo_sort.hpp"
 
 #include <algorithm>
-#include <cmath>
-#include <list>
+#include <atomic>
+#include <filesystem>
+#include <limits>
+#include <random>
+
+#include "algo_simd.hpp"
 
 namespace algo::sort {
 
 /////////////////////////////////////////////
-/// Bubble-sort
+/// Small sort
 /////////////////////////////////////////////
 
+namespace {
+
+/// \brief Value used to pad the network input, it ends up after all real values.
 template<typename T>
-void Bubble(std::vector<T>& vec)
+constexpr T Pad()
 {
-  if (vec.empty()) {
-    return;
+  if constexpr (std::numeric_limits<T>::has_infinity) {
+    return std::numeric_limits<T>::infinity();
+  } else {
+    return std::numeric_limits<T>::max();
   }
-  size_t n{vec.size()};
+}
 
-  for (size_t i = 0; i < n; i++) {
-    for (size_t j = 0; j < n - 1; j++) {
-      if (vec[j] > vec[j + 1]) {
-        std::swap(vec[j], vec[j + 1]);
-      }
+template<typename T>
+void SmallSortScalar(T* data, size_t n)
+{
+  for (size_t i = 1; i < n; i++) {
+    T x{data[i]};
+    size_t j{i};
+    for (; j > 0 && x < data[j - 1]; j--) {
+      data[j] = data[j - 1];
     }
+    data[j] = x;
   }
 }
 
-// Defines what types may be used for Bubble-sort.
-template void Bubble<unsigned>(std::vector<unsigned>& vec);
-template void Bubble<signed>(std::vector<signed>& vec);
-template void Bubble<double>(std::vector<double>& vec);
-template void Bubble<std::string>(std::vector<std::string>& vec);
-
-/////////////////////////////////////////////
-/// Bucket-sort
-/////////////////////////////////////////////
-
-template<typename T>
-void Bucket(std::vector<T>& vec)
-{
-  if (vec.empty()) {
-    return;
+#ifdef ALGO_SIMD_X86
+
+// The traits below describe one SIMD register of each type: load/store, min/max, the partner lanes (lane ^ j) and
+// Pick, which takes the min for the lanes that should keep the smaller value in a compare-exchange step. Element i is
+// compared with element i ^ j and keeps the min iff (i & j) == 0 equals (i & k) == 0, where k is the size of the
+// bitonic sequences being merged.
+
+struct Avx2Int32 {
+  using Scalar = int32_t;
+  using Reg = __m256i;
+  static constexpr int kLanes{8};
+
+  ALGO_TARGET_AVX2 static Reg Load(const Scalar* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+  ALGO_TARGET_AVX2 static void Store(Scalar* p, Reg v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+  ALGO_TARGET_AVX2 static Reg Min(Reg a, Reg b) { return _mm256_min_epi32(a, b); }
+  ALGO_TARGET_AVX2 static Reg Max(Reg a, Reg b) { return _mm256_max_epi32(a, b); }
+
+  ALGO_TARGET_AVX2 static __m256i MinMask(int base, int j, int k)
+  {
+    __m256i idx{_mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(base))};
+    __m256i zero{_mm256_setzero_si256()};
+    __m256i low{_mm256_cmpeq_epi32(_mm256_and_si256(idx, _mm256_set1_epi32(j)), zero)};
+    __m256i asc{_mm256_cmpeq_epi32(_mm256_and_si256(idx, _mm256_set1_epi32(k)), zero)};
+    return _mm256_cmpeq_epi32(low, asc);
   }
 
-  if (std::any_of(vec.begin(), vec.end(), [](T t) { return t < 0; })) {
-    return;
+  ALGO_TARGET_AVX2 static Reg Partner(Reg v, int j)
+  {
+    __m256i idx{_mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(j))};
+    return _mm256_permutevar8x32_epi32(v, idx);
   }
 
-  auto max_elem_ptr = std::max_element(vec.begin(), vec.end());
-  int nbrOfBuckets{static_cast<int>(sqrt(*max_elem_ptr))};
-  std::vector<std::vector<T>> buckets(nbrOfBuckets + 1);
+  ALGO_TARGET_AVX2 static Reg Pick(Reg mn, Reg mx, int base, int j, int k)
+  {
+    return _mm256_blendv_epi8(mx, mn, MinMask(base, j, k));
+  }
+};
+
+struct Avx2Float {
+  using Scalar = float;
+  using Reg = __m256;
+  static constexpr int kLanes{8};
+
+  ALGO_TARGET_AVX2 static Reg Load(const Scalar* p) { return _mm256_loadu_ps(p); }
+  ALGO_TARGET_AVX2 static void Store(Scalar* p, Reg v) { _mm256_storeu_ps(p, v); }
+  ALGO_TARGET_AVX2 static Reg Min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+  ALGO_TARGET_AVX2 static Reg Max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+
+  ALGO_TARGET_AVX2 static Reg Partner(Reg v, int j)
+  {
+    __m256i idx{_mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(j))};
+    return _mm256_permutevar8x32_ps(v, idx);
+  }
 
-  // Put in buckets
-  for (const T& x : vec) {
-    buckets[static_cast<T>(sqrt(x))].push_back(x);
+  ALGO_TARGET_AVX2 static Reg Pick(Reg mn, Reg mx, int base, int j, int k)
+  {
+    return _mm256_blendv_ps(mx, mn, _mm256_castsi256_ps(Avx2Int32::MinMask(base, j, k)));
+  }
+};
+
+struct Avx2Double {
+  using Scalar = double;
+  using Reg = __m256d;
+  static constexpr int kLanes{4};
+
+  ALGO_TARGET_AVX2 static Reg Load(const Scalar* p) { return _mm256_loadu_pd(p); }
+  ALGO_TARGET_AVX2 static void Store(Scalar* p, Reg v) { _mm256_storeu_pd(p, v); }
+  ALGO_TARGET_AVX2 static Reg Min(Reg a, Reg b) { return _mm256_min_pd(a, b); }
+  ALGO_TARGET_AVX2 static Reg Max(Reg a, Reg b) { return _mm256_max_pd(a, b); }
+
+  ALGO_TARGET_AVX2 static Reg Partner(Reg v, int j)
+  {
+    // A 64-bit lane l is the 32-bit lanes 2l and 2l + 1.
+    __m256i idx{_mm256_xor_si256(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(2 * j))};
+    return _mm256_castsi256_pd(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(v), idx));
   }
 
-  // Put back elements
-  int count{0};
-  for (const std::vector<T>& bucket : buckets) {
-    for (T e : bucket) {
-      vec[count++] = e;
+  ALGO_TARGET_AVX2 static Reg Pick(Reg mn, Reg mx, int base, int j, int k)
+  {
+    __m256i idx{_mm256_add_epi64(_mm256_setr_epi64x(0, 1, 2, 3), _mm256_set1_epi64x(base))};
+    __m256i zero{_mm256_setzero_si256()};
+    __m256i low{_mm256_cmpeq_epi64(_mm256_and_si256(idx, _mm256_set1_epi64x(j)), zero)};
+    __m256i asc{_mm256_cmpeq_epi64(_mm256_and_si256(idx, _mm256_set1_epi64x(k)), zero)};
+    return _mm256_blendv_pd(mx, mn, _mm256_castsi256_pd(_mm256_cmpeq_epi64(low, asc)));
+  }
+};
+
+// BitonicNetwork passes vector registers without a target attribute, which GCC warns changes the ABI. It is always
+// inlined into a kernel with the target, so no such call is made.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+/// \brief The bitonic network on the registers of V, shared by the AVX2 and AVX-512 kernels below. It has no target
+/// attribute of its own and is always inlined, so the register operations are compiled for the instruction set of the
+/// kernel it is inlined into.
+template<typename V>
+__attribute__((always_inline)) inline void BitonicNetwork(typename V::Scalar* data, size_t n)
+{
+  using T = typename V::Scalar;
+  constexpr int kL{V::kLanes};
+  T buf[kSmallSortMax];
+  typename V::Reg v[kSmallSortMax / kL];
+
+  int size{kL};
+  while (static_cast<size_t>(size) < n) size *= 2;
+  const int regs{size / kL};
+  std::copy(data, data + n, buf);
+  std::fill(buf + n, buf + size, Pad<T>());
+  for (int r = 0; r < regs; r++) v[r] = V::Load(buf + r * kL);
+
+  for (int k = 2; k <= size; k *= 2) {
+    for (int j = k / 2; j > 0; j /= 2) {
+      if (j >= kL) {
+        // Compare-exchange between registers, the direction is the same for all lanes. Min and max return their
+        // second operand for equal values, the operands are swapped for max so that values that compare equal but
+        // differ in their bits, -0.0 and +0.0, are each kept once.
+        const int jr{j / kL};
+        for (int p = 0; p < regs; p++) {
+          if ((p & jr) != 0) continue;
+          auto mn = V::Min(v[p], v[p | jr]);
+          auto mx = V::Max(v[p | jr], v[p]);
+          bool asc{((p * kL) & k) == 0};
+          v[p] = asc ? mn : mx;
+          v[p | jr] = asc ? mx : mn;
+        }
+      } else {
+        // Compare-exchange within a register. A lane and its partner both take the partner's value on equal values,
+        // which swaps them.
+        for (int p = 0; p < regs; p++) {
+          auto other = V::Partner(v[p], j);
+          v[p] = V::Pick(V::Min(v[p], other), V::Max(v[p], other), p * kL, j, k);
+        }
+      }
     }
   }
 
-  // Insertion sort (Bentley 1993)
-  for (size_t i = 1; i < vec.size(); i++) {
-    for (size_t j = i; j > 0 && vec[j - 1] > vec[j]; j--)
-      std::swap(vec[j], vec[j - 1]);
-  }
+  for (int r = 0; r < regs; r++) V::Store(buf + r * kL, v[r]);
+  std::copy(buf, buf + n, data);
 }
 
-// Defines what types may be used for Bucket-sort.
-template void Bucket<unsigned>(std::vector<unsigned>& vec);
-template void Bucket<int>(std::vector<int>& vec);
-template void Bucket<double>(std::vector<double>& vec);
-
-/////////////////////////////////////////////
-/// Gnome-sort
-/////////////////////////////////////////////
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 
-template<typename T>
-void Gnome(std::vector<T>& vec)
+template<typename V>
+ALGO_TARGET_AVX2 void BitonicAvx2(typename V::Scalar* data, size_t n)
 {
-  int i{0};
-  size_t n{vec.size()};
-
-  while (static_cast<size_t>(i) < n) {
-
-    if (i == 0)
-      i++;
-    if (vec[i] >= vec[i - 1])
-      i++;
-    else {
-      std::swap(vec[i], vec[i - 1]);
-      i--;
-    }
-  }
+  BitonicNetwork<V>(data, n);
 }
 
-// Defines what types may be used for Gnome-sort.
-template void Gnome<unsigned>(std::vector<unsigned>& vec);
-template void Gnome<int>(std::vector<int>& vec);
-template void Gnome<double>(std::vector<double>& vec);
-template void Gnome<std::string>(std::vector<std::string>& vec);
+// GCC 12 reports the _mm512_undefined_* placeholders inside the AVX-512 intrinsics as uninitialized (GCC bug 105593).
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+struct Avx512Int32 {
+  using Scalar = int32_t;
+  using Reg = __m512i;
+  static constexpr int kLanes{16};
+
+  ALGO_TARGET_AVX512 static Reg Load(const Scalar* p) { return _mm512_loadu_si512(p); }
+  ALGO_TARGET_AVX512 static void Store(Scalar* p, Reg v) { _mm512_storeu_si512(p, v); }
+  ALGO_TARGET_AVX512 static Reg Min(Reg a, Reg b) { return _mm512_min_epi32(a, b); }
+  ALGO_TARGET_AVX512 static Reg Max(Reg a, Reg b) { return _mm512_max_epi32(a, b); }
+
+  ALGO_TARGET_AVX512 static __m512i Lanes()
+  {
+    return _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  }
 
-/////////////////////////////////////////////
-/// Heap-sort
-/////////////////////////////////////////////
+  ALGO_TARGET_AVX512 static __mmask16 MinMask(int base, int j, int k)
+  {
+    __m512i idx{_mm512_add_epi32(Lanes(), _mm512_set1_epi32(base))};
+    __mmask16 low{_mm512_testn_epi32_mask(idx, _mm512_set1_epi32(j))};
+    __mmask16 asc{_mm512_testn_epi32_mask(idx, _mm512_set1_epi32(k))};
+    return static_cast<__mmask16>(~(low ^ asc));
+  }
 
-/// \brief Sift-down operation for binary heaps. Puts new elements to the appropriate indices.
-/// \tparam T Type in vector.
-/// \param vec the vector to arrange the elements.
-/// \param start The starting position.
-/// \param len The length.
-/// \link <a href=https://en.wikipedia.org/wiki/Binary_heap#Extract>SiftDown, Wikipedia.</>
-template<typename T>
-void Siftdown(std::vector<T>& vec, int start, int len)
-{
-  int root{start};
-  while (root * 2 + 1 <= len) {
-    int child{root * 2 + 1};
-    int swap{root};
+  ALGO_TARGET_AVX512 static Reg Partner(Reg v, int j)
+  {
+    return _mm512_permutexvar_epi32(_mm512_xor_si512(Lanes(), _mm512_set1_epi32(j)), v);
+  }
 
-    if (vec[swap] < vec[child]) {
-      swap = child;
-    }
+  ALGO_TARGET_AVX512 static Reg Pick(Reg mn, Reg mx, int base, int j, int k)
+  {
+    return _mm512_mask_blend_epi32(MinMask(base, j, k), mx, mn);
+  }
+};
 
-    if (child + 1 <= len && vec[swap] < vec[child + 1]) {
-      swap = child + 1;
-    }
+struct Avx512Float {
+  using Scalar = float;
+  using Reg = __m512;
+  static constexpr int kLanes{16};
 
-    if (swap == root) {
-      return;
-    } else {
-      T t{vec[root]};
-      vec[root] = vec[swap];
-      vec[swap] = t;
-      root = swap;
-    }
+  ALGO_TARGET_AVX512 static Reg Load(const Scalar* p) { return _mm512_loadu_ps(p); }
+  ALGO_TARGET_AVX512 static void Store(Scalar* p, Reg v) { _mm512_storeu_ps(p, v); }
+  ALGO_TARGET_AVX512 static Reg Min(Reg a, Reg b) { return _mm512_min_ps(a, b); }
+  ALGO_TARGET_AVX512 static Reg Max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+
+  ALGO_TARGET_AVX512 static Reg Partner(Reg v, int j)
+  {
+    return _mm512_permutexvar_ps(_mm512_xor_si512(Avx512Int32::Lanes(), _mm512_set1_epi32(j)), v);
   }
-}
 
-/// \brief Builds the heap vector, largest value at the root.
-/// \tparam T Type in vector.
-/// \param vec The vector to heapify.
-/// \param len Number of elements.
-template<typename T>
-void Heapify(std::vector<T>& vec, size_t len)
-{
-  int start = floor((len - 2.0) / 2.0);
+  ALGO_TARGET_AVX512 static Reg Pick(Reg mn, Reg mx, int base, int j, int k)
+  {
+    return _mm512_mask_blend_ps(Avx512Int32::MinMask(base, j, k), mx, mn);
+  }
+};
+
+struct Avx512Double {
+  using Scalar = double;
+  using Reg = __m512d;
+  static constexpr int kLanes{8};
+
+  ALGO_TARGET_AVX512 static Reg Load(const Scalar* p) { return _mm512_loadu_pd(p); }
+  ALGO_TARGET_AVX512 static void Store(Scalar* p, Reg v) { _mm512_storeu_pd(p, v); }
+  ALGO_TARGET_AVX512 static Reg Min(Reg a, Reg b) { return _mm512_min_pd(a, b); }
+  ALGO_TARGET_AVX512 static Reg Max(Reg a, Reg b) { return _mm512_max_pd(a, b); }
+
+  ALGO_TARGET_AVX512 static __m512i Lanes() { return _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7); }
+
+  ALGO_TARGET_AVX512 static Reg Partner(Reg v, int j)
+  {
+    return _mm512_permutexvar_pd(_mm512_xor_si512(Lanes(), _mm512_set1_epi64(j)), v);
+  }
 
-  while (start >= 0) {
-    Siftdown(vec, start, len - 1);
-    start--;
+  ALGO_TARGET_AVX512 static Reg Pick(Reg mn, Reg mx, int base, int j, int k)
+  {
+    __m512i idx{_mm512_add_epi64(Lanes(), _mm512_set1_epi64(base))};
+    __mmask8 low{_mm512_testn_epi64_mask(idx, _mm512_set1_epi64(j))};
+    __mmask8 asc{_mm512_testn_epi64_mask(idx, _mm512_set1_epi64(k))};
+    return _mm512_mask_blend_pd(static_cast<__mmask8>(~(low ^ asc)), mx, mn);
   }
+};
+
+template<typename V>
+ALGO_TARGET_AVX512 void BitonicAvx512(typename V::Scalar* data, size_t n)
+{
+  BitonicNetwork<V>(data, n);
 }
 
-/// \brief Internal function for the Heapsort algorithm.
-/// \tparam T Type in vector.
-/// \param vec The vector to be sorted.
-/// \param len Number of elements.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
+
 template<typename T>
-void HeapSortPriv(std::vector<T>& vec, size_t len)
-{
-  Heapify(vec, len);
+using SmallSortKernel = void (*)(T*, size_t);
 
-  size_t end{len - 1};
-  while (end > 0) {
-    std::swap(vec[end], vec[0]);
-    end--;
-    Siftdown(vec, 0, end);
+/// \brief Returns the best kernel for this CPU.
+template<typename T, typename Avx2, typename Avx512>
+SmallSortKernel<T> SelectSmallSort()
+{
+#ifdef ALGO_SIMD_X86
+  if (simd::HasAvx512()) {
+    return BitonicAvx512<Avx512>;
+  }
+  if (simd::HasAvx2()) {
+    return BitonicAvx2<Avx2>;
   }
+#endif
+  return SmallSortScalar<T>;
 }
 
-template<typename T>
-void Heap(std::vector<T>& vec)
+template<typename T, typename Avx2, typename Avx512>
+void SmallSortPriv(T* data, size_t n)
 {
-  if (vec.empty()) {
+  if (n > kSmallSortMax) {
+    std::sort(data, data + n);
     return;
   }
-  HeapSortPriv(vec, vec.size());
+  static const SmallSortKernel<T> kernel{SelectSmallSort<T, Avx2, Avx512>()};
+  kernel(data, n);
 }
 
-// Defines what types may be used for Heap-sort.
-template void Heap<unsigned>(std::vector<unsigned>& vec);
-template void Heap<int>(std::vector<int>& vec);
-template void Heap<double>(std::vector<double>& vec);
-template void Heap<std::string>(std::vector<std::string>& vec);
+}// namespace
+
+#ifdef ALGO_SIMD_X86
+void SmallSort(int32_t* data, size_t n) { SmallSortPriv<int32_t, Avx2Int32, Avx512Int32>(data, n); }
+void SmallSort(float* data, size_t n) { SmallSortPriv<float, Avx2Float, Avx512Float>(data, n); }
+void SmallSort(double* data, size_t n) { SmallSortPriv<double, Avx2Double, Avx512Double>(data, n); }
+#else
+void SmallSort(int32_t* data, size_t n) { SmallSortPriv<int32_t, void, void>(data, n); }
+void SmallSort(float* data, size_t n) { SmallSortPriv<float, void, void>(data, n); }
+void SmallSort(double* data, size_t n) { SmallSortPriv<double, void, void>(data, n); }
+#endif
 
 /////////////////////////////////////////////
-/// Insertion-sort
+/// External merge sort
 /////////////////////////////////////////////
 
-template<typename T>
-void Insertion(std::vector<T>& vec)
+IoThread::IoThread()
+    : thread_([this]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+          ready_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+          if (tasks_.empty()) {
+            return;
+          }
+          std::packaged_task<size_t()> task{std::move(tasks_.front())};
+          tasks_.pop_front();
+          lock.unlock();
+          task();
+          lock.lock();
+        }
+      })
+{}
+
+IoThread::~IoThread()
 {
-  if (vec.empty()) {
-    return;
-  }
-
-  size_t N{vec.size()};
-  for (size_t i = 0; i < N; i++) {
-    for (size_t j = i; j > 0 && vec[j - 1] > vec[j]; j--)
-      std::swap(vec[j], vec[j - 1]);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
   }
+  ready_.notify_one();
+  thread_.join();
 }
 
-// Defines what types may be used for Insertion-sort.
-template void Insertion<unsigned>(std::vector<unsigned>& vec);
-template void Insertion<int>(std::vector<int>& vec);
-template void Insertion<double>(std::vector<double>& vec);
-template void Insertion<std::string>(std::vector<std::string>& vec);
-
-/////////////////////////////////////////////
-/// Merge-sort
-/////////////////////////////////////////////
-
-/// \brief Merge step.
-/// \tparam T Type in lists.
-/// \param A First list.
-/// \param B Second list.
-/// \return A sorted and merged vector.
-template<typename T>
-std::vector<T> merge(std::list<T>& A, std::list<T>& B)
+std::future<size_t> IoThread::Submit(std::function<size_t()> task)
 {
-  std::vector<T> C;
-
-  while (!A.empty() && !B.empty()) {
-    if (A.front() > B.front()) {
-      C.push_back(B.front());
-      B.pop_front();
-    } else {
-      C.push_back(A.front());
-      A.pop_front();
-    }
+  std::packaged_task<size_t()> packaged{std::move(task)};
+  std::future<size_t> result{packaged.get_future()};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(packaged));
   }
+  ready_.notify_one();
+  return result;
+}
 
-  while (!A.empty()) {
-    C.push_back(A.front());
-    A.pop_front();
+RunReader::RunReader(const std::string& path, size_t block_bytes, IoThread& io)
+    : file_(path, std::ios::binary), block_bytes_(block_bytes), io_(io)
+{
+  failed_ = !file_.is_open();
+  if (!failed_) {
+    ReadAhead();
   }
+}
 
-  while (!B.empty()) {
-    C.push_back(B.front());
-    B.pop_front();
+RunReader::~RunReader()
+{
+  if (pending_.valid()) {
+    pending_.wait();
   }
-  return C;
 }
 
-template<typename T>
-std::vector<T> MergeSortPriv(const std::vector<T>& lst)
+void RunReader::ReadAhead()
 {
+  ahead_.resize(block_bytes_);
+  pending_ = io_.Submit([this]() {
+    file_.read(ahead_.data(), static_cast<std::streamsize>(ahead_.size()));
+    // A short read is only fine at the end of the file.
+    read_error_ = file_.bad() || (file_.fail() && !file_.eof());
+    return static_cast<size_t>(file_.gcount());
+  });
+}
 
-  if (lst.empty()) {
-    return lst;
+const std::vector<char>& RunReader::NextBlock()
+{
+  size_t bytes{pending_.valid() ? pending_.get() : 0};
+  failed_ = failed_ || read_error_;
+  if (failed_) {
+    bytes = 0;
   }
+  std::swap(current_, ahead_);
+  current_.resize(bytes);
 
-  size_t n{lst.size()};
-
-  // Base case
-  if (n == 1) {
-    return lst;
+  // Start reading the next block while the caller consumes this one.
+  if (bytes == block_bytes_) {
+    ReadAhead();
   }
+  return current_;
+}
 
-  size_t half{n / 2};
-  std::vector<T> A, B;
+RunWriter::RunWriter(const std::string& path, size_t block_bytes)
+    : file_(path, std::ios::binary | std::ios::trunc), buffer_(block_bytes)
+{}
 
-  for (auto it = lst.begin(); it != (lst.begin() + half); ++it) {
-    A.push_back(*it);
+void RunWriter::Write(const char* data, size_t bytes)
+{
+  if (used_ + bytes > buffer_.size()) {
+    file_.write(buffer_.data(), static_cast<std::streamsize>(used_));
+    used_ = 0;
   }
-  for (auto it = (lst.begin() + half); it != lst.end(); ++it) {
-    B.push_back(*it);
+  // Large writes bypass the buffer.
+  if (bytes > buffer_.size()) {
+    file_.write(data, static_cast<std::streamsize>(bytes));
+    return;
   }
-
-  A = MergeSortPriv(A);
-  B = MergeSortPriv(B);
-
-  std::list<T> Al(A.size()), Bl(B.size());
-  std::copy(A.begin(), A.end(), Al.begin());
-  std::copy(B.begin(), B.end(), Bl.begin());
-  return merge(Al, Bl);
+  std::memcpy(buffer_.data() + used_, data, bytes);
+  used_ += bytes;
 }
 
-template<typename T>
-void Merge(std::vector<T>& lst)
+bool RunWriter::Close()
 {
-  lst = MergeSortPriv(lst);
+  file_.write(buffer_.data(), static_cast<std::streamsize>(used_));
+  used_ = 0;
+  file_.close();
+  return !file_.fail();
 }
 
-// Defines what types may be used for Merge-sort.
-template void Merge<unsigned>(std::vector<unsigned>& vec);
-template void Merge<int>(std::vector<int>& vec);
-template void Merge<double>(std::vector<double>& vec);
-template void Merge<std::string>(std::vector<std::string>& vec);
+RunFiles::RunFiles(const ExternalConfig& config) : config_(config)
+{}
 
-/////////////////////////////////////////////
-/// Quick-sort
-/////////////////////////////////////////////
+RunFiles::~RunFiles()
+{
+  std::error_code ec;
+  for (const auto& run : runs_) {
+    std::filesystem::remove(run.first, ec);
+  }
+}
 
-template<typename T>
-int Partition(std::vector<T>& vec, int low, int high)
+std::string RunFiles::Create(size_t bytes)
 {
-  T x{vec[high]};
-  int i{low - 1};
+  if (config_.disk_budget != 0 && used_bytes_ + bytes > config_.disk_budget) {
+    return "";
+  }
 
-  for (int j = low; j != high; j++) {
-    if (vec[j] <= x) {
-      i++;
-      std::swap(vec[j], vec[i]);
-    }
+  // Unique names, also between processes sorting in the same directory.
+  static std::atomic<unsigned> counter{0};
+  static const unsigned kSeed{std::random_device{}()};
+
+  std::error_code ec;
+  std::filesystem::path dir{config_.temp_dir.empty() ? std::filesystem::temp_directory_path(ec) : std::filesystem::path{config_.temp_dir}};
+  if (ec) {
+    return "";
   }
+  std::string path{(dir / ("algo_run_" + std::to_string(kSeed) + "_" + std::to_string(counter++))).string()};
 
-  std::swap(vec[i + 1], vec[high]);
-  return i + 1;
+  runs_.emplace_back(path, bytes);
+  used_bytes_ += bytes;
+  return path;
 }
 
-// Start of the Quicksort algorithm
-template<typename T>
-void QuickSort(std::vector<T>& vec, int low, int high)
+void RunFiles::Remove(const std::string& path)
 {
-  if (low < high) {
-    int pivot{Partition(vec, low, high)};
-    QuickSort(vec, low, pivot - 1);
-    QuickSort(vec, pivot + 1, high);
+  auto it = std::find_if(runs_.begin(), runs_.end(), [&path](const auto& run) { return run.first == path; });
+  if (it == runs_.end()) {
+    return;
   }
+  std::error_code ec;
+  std::filesystem::remove(it->first, ec);
+  used_bytes_ -= it->second;
+  runs_.erase(it);
 }
 
-template<typename T>
-void Quick(std::vector<T>& vec)
+long long FileBytes(const std::string& path)
 {
-  if (vec.empty()) {
-    return;
+  std::error_code ec;
+  auto bytes = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return -1;
   }
-  QuickSort(vec, 0, vec.size() - 1);
+  return static_cast<long long>(bytes);
 }
-
-// Defines what types may be used for Quick-sort.
-template void Quick<unsigned>(std::vector<unsigned>& vec);
-template void Quick<int>(std::vector<int>& vec);
-template void Quick<double>(std::vector<double>& vec);
-template void Quick<std::string>(std::vector<std::string>& vec);
-}// namespace algo::sort
\ No newline at end of file
+}// namespace algo::sort
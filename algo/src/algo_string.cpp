@@ -8,133 +8,1207 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <numeric>
+#include <ostream>
+#include <thread>
 #include <vector>
 
+#include "algo_simd.hpp"
+
 namespace algo::string {
 
-int LastOccurrence(std::string str, char c)
+namespace {
+
+constexpr uint32_t kEmpty{UINT32_MAX};
+
+/// \brief SA-IS: the suffixes are classified as S (smaller than the next suffix) or L (larger). The leftmost S
+/// suffixes (LMS) are sorted by induced sorting, named, and sorted recursively if the names are not unique. The final
+/// order of the LMS suffixes then induces the order of all suffixes. The end of s acts as a sentinel smaller than all
+/// characters.
+/// \tparam Char Character type, unsigned.
+/// \param s The text.
+/// \param n Length of s.
+/// \param upper The largest character in s.
+/// \return The suffix array.
+template<typename Char>
+std::vector<uint32_t> SuffixArrayPriv(const Char* s, size_t n, size_t upper)
 {
-  int index = str.length();
-  while (index != 0) {
-    if (str[index] == c) {
-      return index;
+  if (n == 0) {
+    return {};
+  }
+  if (n == 1) {
+    return {0};
+  }
+
+  std::vector<uint32_t> sa(n);
+  std::vector<bool> is_s(n, false);
+  for (size_t i = n - 1; i-- > 0;) {
+    is_s[i] = s[i] == s[i + 1] ? is_s[i + 1] : s[i] < s[i + 1];
+  }
+
+  // Bucket c holds the L suffixes from bucket_l[c] and the S suffixes from bucket_s[c].
+  std::vector<uint32_t> bucket_l(upper + 2, 0), bucket_s(upper + 2, 0);
+  for (size_t i = 0; i < n; i++) {
+    if (!is_s[i]) {
+      bucket_s[s[i]]++;
+    } else {
+      bucket_l[s[i] + 1]++;
+    }
+  }
+  for (size_t c = 0; c <= upper; c++) {
+    bucket_s[c] += bucket_l[c];
+    bucket_l[c + 1] += bucket_s[c];
+  }
+
+  std::vector<uint32_t> buf(upper + 2);
+  auto induce = [&](const std::vector<uint32_t>& lms) {
+    std::fill(sa.begin(), sa.end(), kEmpty);
+    std::copy(bucket_s.begin(), bucket_s.end(), buf.begin());
+    for (uint32_t d : lms) {
+      sa[buf[s[d]]++] = d;
+    }
+    // L suffixes from left to right, the last suffix is L and comes first in its bucket.
+    std::copy(bucket_l.begin(), bucket_l.end(), buf.begin());
+    sa[buf[s[n - 1]]++] = static_cast<uint32_t>(n - 1);
+    for (size_t i = 0; i < n; i++) {
+      const uint32_t v{sa[i]};
+      if (v != kEmpty && v >= 1 && !is_s[v - 1]) {
+        sa[buf[s[v - 1]]++] = v - 1;
+      }
+    }
+    // S suffixes from right to left, from the end of their buckets.
+    std::copy(bucket_l.begin(), bucket_l.end(), buf.begin());
+    for (size_t i = n; i-- > 0;) {
+      const uint32_t v{sa[i]};
+      if (v != kEmpty && v >= 1 && is_s[v - 1]) {
+        sa[--buf[s[v - 1] + 1]] = v - 1;
+      }
+    }
+  };
+
+  std::vector<uint32_t> lms_index(n, kEmpty);
+  std::vector<uint32_t> lms;
+  for (size_t i = 1; i < n; i++) {
+    if (!is_s[i - 1] && is_s[i]) {
+      lms_index[i] = static_cast<uint32_t>(lms.size());
+      lms.push_back(static_cast<uint32_t>(i));
+    }
+  }
+  const size_t m{lms.size()};
+  induce(lms);
+
+  if (m > 0) {
+    // The LMS substrings are sorted now, equal neighbours get the same name.
+    std::vector<uint32_t> sorted_lms;
+    sorted_lms.reserve(m);
+    for (uint32_t v : sa) {
+      if (lms_index[v] != kEmpty) sorted_lms.push_back(v);
+    }
+    std::vector<uint32_t> names(m);
+    uint32_t name{0};
+    names[lms_index[sorted_lms[0]]] = 0;
+    for (size_t i = 1; i < m; i++) {
+      size_t l{sorted_lms[i - 1]};
+      size_t r{sorted_lms[i]};
+      const size_t end_l{lms_index[l] + 1 < m ? lms[lms_index[l] + 1] : n};
+      const size_t end_r{lms_index[r] + 1 < m ? lms[lms_index[r] + 1] : n};
+      bool same{end_l - l == end_r - r};
+      if (same) {
+        while (l < end_l && s[l] == s[r]) {
+          l++;
+          r++;
+        }
+        same = l != n && r != n && s[l] == s[r];
+      }
+      if (!same) name++;
+      names[lms_index[sorted_lms[i]]] = name;
+    }
+
+    const std::vector<uint32_t> rec_sa{SuffixArrayPriv(names.data(), m, name)};
+    for (size_t i = 0; i < m; i++) {
+      sorted_lms[i] = lms[rec_sa[i]];
     }
-    index--;
+    induce(sorted_lms);
   }
-  return 0;
+  return sa;
 }
 
-std::vector<int> SearchBoyerMoore(std::string& text, const std::string& pattern)
+/// \brief Kasai: the LCP of the suffix at i + 1 with its predecessor is at least the LCP at i minus one.
+template<typename Char>
+std::vector<uint32_t> LcpPriv(const Char* s, size_t n, const std::vector<uint32_t>& sa)
 {
-  int m = pattern.length(), n = text.length(), i = m - 1, j = i;
-  int chunk = 0, w_length = m;
-  std::vector<int> matches;
+  std::vector<uint32_t> rank(n), lcp(n, 0);
+  for (size_t i = 0; i < n; i++) rank[sa[i]] = static_cast<uint32_t>(i);
 
-  do {
-    if (pattern[j] == text[i]) {
-      if (j == 0) {
-        matches.push_back(i + chunk);
-        text = text.substr(i + w_length);
-        chunk = chunk + i + w_length;
-        n = text.length(), i = m - 1, j = i;
-      } else {
-        i--;
-        j--;
-      }
-    } else {
-      i = i + m - std::min(j, 1 + LastOccurrence(text, text[i]));
-      j = m - 1;
+  size_t h{0};
+  for (size_t i = 0; i < n; i++) {
+    if (rank[i] == 0) {
+      h = 0;
+      continue;
     }
-  } while (i < n - 1);
+    const size_t j{sa[rank[i] - 1]};
+    while (i + h < n && j + h < n && s[i + h] == s[j + h]) h++;
+    lcp[rank[i]] = static_cast<uint32_t>(h);
+    if (h > 0) h--;
+  }
+  return lcp;
+}
+
+}// namespace
+
+
+std::vector<int> SearchBoyerMoore(const std::string& text, const std::string& pattern)
+{
+  std::vector<int> matches;
+  for (size_t pos : SubstringSearcher(pattern).FindAll(text, false)) {
+    matches.push_back(static_cast<int>(pos));
+  }
   return matches;
 }
 
-std::string LongestCommonSubstring(std::string A, std::string B)
+/////////////////////////////////////////////
+/// Substring search
+/////////////////////////////////////////////
+
+namespace {
+
+constexpr size_t kNpos{std::string_view::npos};
+
+/// Returns the first match in the candidate positions [from, last], where s has room for the pattern at last.
+using FindKernel = size_t (*)(const char* s, size_t from, size_t last, const char* p, size_t m);
+
+#ifdef ALGO_SIMD_X86
+
+/// Scalar tail of the vector kernels.
+size_t FindScalar(const char* s, size_t from, size_t last, const char* p, size_t m)
+{
+  for (size_t i = from; i <= last; i++) {
+    if (s[i] == p[0] && s[i + m - 1] == p[m - 1] && std::memcmp(s + i, p, m) == 0) {
+      return i;
+    }
+  }
+  return kNpos;
+}
+
+/// Checks the candidates in mask, bit k is position i + k.
+inline size_t VerifyCandidates(uint32_t mask, const char* s, size_t i, const char* p, size_t m)
+{
+  while (mask != 0) {
+    const auto bit = static_cast<size_t>(__builtin_ctz(mask));
+    if (std::memcmp(s + i + bit + 1, p + 1, m - 2) == 0) {
+      return i + bit;
+    }
+    mask &= mask - 1;
+  }
+  return kNpos;
+}
+
+ALGO_TARGET_AVX2 size_t FindAvx2(const char* s, size_t from, size_t last, const char* p, size_t m)
+{
+  const __m256i first{_mm256_set1_epi8(p[0])};
+  const __m256i back{_mm256_set1_epi8(p[m - 1])};
+  size_t i{from};
+  for (; i + 32 <= last + 1; i += 32) {
+    const __m256i block_first{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i))};
+    const __m256i block_back{_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + m - 1))};
+    const __m256i eq{_mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(back, block_back))};
+    const size_t pos{VerifyCandidates(static_cast<uint32_t>(_mm256_movemask_epi8(eq)), s, i, p, m)};
+    if (pos != kNpos) {
+      return pos;
+    }
+  }
+  return FindScalar(s, i, last, p, m);
+}
+
+#ifdef __SSE2__
+size_t FindSse2(const char* s, size_t from, size_t last, const char* p, size_t m)
+{
+  const __m128i first{_mm_set1_epi8(p[0])};
+  const __m128i back{_mm_set1_epi8(p[m - 1])};
+  size_t i{from};
+  for (; i + 16 <= last + 1; i += 16) {
+    const __m128i block_first{_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i))};
+    const __m128i block_back{_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + m - 1))};
+    const __m128i eq{_mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(back, block_back))};
+    const size_t pos{VerifyCandidates(static_cast<uint32_t>(_mm_movemask_epi8(eq)), s, i, p, m)};
+    if (pos != kNpos) {
+      return pos;
+    }
+  }
+  return FindScalar(s, i, last, p, m);
+}
+#endif
+
+#endif
+
+/// \brief Returns the vector kernel for this CPU, nullptr if there is none.
+FindKernel SelectFindKernel()
+{
+#ifdef ALGO_SIMD_X86
+  if (simd::HasAvx2()) {
+    return FindAvx2;
+  }
+#ifdef __SSE2__
+  return FindSse2;
+#endif
+#endif
+  return nullptr;
+}
+
+}// namespace
+
+SubstringSearcher::SubstringSearcher(std::string_view pattern) : pattern_(pattern)
+{
+  const size_t m{pattern_.size()};
+  std::fill(shift_, shift_ + 256, m);
+  for (size_t i = 0; i + 1 < m; i++) {
+    shift_[static_cast<unsigned char>(pattern_[i])] = m - 1 - i;
+  }
+}
+
+size_t SubstringSearcher::Find(std::string_view text, size_t from) const
 {
+  const size_t n{text.size()};
+  const size_t m{pattern_.size()};
+  if (m == 0 || from > n || n - from < m) {
+    return kNpos;
+  }
+  const char* s{text.data()};
+  const char* p{pattern_.data()};
+
+  if (m == 1) {
+    const void* hit{std::memchr(s + from, p[0], n - from)};
+    return hit == nullptr ? kNpos : static_cast<size_t>(static_cast<const char*>(hit) - s);
+  }
+
+  static const FindKernel kernel{SelectFindKernel()};
+  if (kernel != nullptr) {
+    return kernel(s, from, n - m, p, m);
+  }
+
+  // Horspool: shift by the text byte under the last pattern byte.
+  for (size_t i = from; i + m <= n; i += shift_[static_cast<unsigned char>(s[i + m - 1])]) {
+    if (s[i + m - 1] == p[m - 1] && std::memcmp(s + i, p, m - 1) == 0) {
+      return i;
+    }
+  }
+  return kNpos;
+}
 
+std::vector<size_t> SubstringSearcher::FindAll(std::string_view text, bool overlapping) const
+{
+  std::vector<size_t> matches;
+  const size_t step{overlapping ? 1 : pattern_.size()};
+  for (size_t pos = Find(text); pos != kNpos; pos = Find(text, pos + step)) {
+    matches.push_back(pos);
+  }
+  return matches;
+}
+
+std::vector<size_t> SearchAll(std::string_view text, std::string_view pattern)
+{ return SubstringSearcher(pattern).FindAll(text); }
+
+std::string LongestCommonSubstring(const std::string& A, const std::string& B)
+{
   if (A.empty() || B.empty()) {
     return "";
   }
 
-  // Append blank spaces to search in whole strings, note for-loops start on 1.
-  A = " " + A + " ";
-  B = " " + B + " ";
+  // A and B joined by a separator that is smaller than all bytes and occurs once, so no common prefix crosses it.
+  const size_t na{A.size()};
+  std::vector<uint32_t> joined(na + 1 + B.size());
+  for (size_t i = 0; i < na; i++) joined[i] = static_cast<unsigned char>(A[i]) + 1u;
+  joined[na] = 0;
+  for (size_t i = 0; i < B.size(); i++) joined[na + 1 + i] = static_cast<unsigned char>(B[i]) + 1u;
 
-  std::vector<std::vector<int>> L(A.length(), std::vector<int>(B.length(), 0));
-  int max_substr = 0, x_longest = 0;
+  const std::vector<uint32_t> sa{SuffixArrayPriv(joined.data(), joined.size(), 256)};
+  const std::vector<uint32_t> lcp{LcpPriv(joined.data(), joined.size(), sa)};
+  auto in_a = [na](uint32_t pos) { return pos < na; };
+  auto in_b = [na](uint32_t pos) { return pos > na; };
 
-  for (size_t i = 1; i < A.length(); ++i) {
-    for (size_t j = 1; j < B.length(); ++j) {
+  // The longest common substring is the longest prefix shared by adjacent suffixes from A and B.
+  uint32_t best{0};
+  for (size_t i = 1; i < sa.size(); i++) {
+    if ((in_a(sa[i - 1]) && in_b(sa[i])) || (in_b(sa[i - 1]) && in_a(sa[i]))) {
+      best = std::max(best, lcp[i]);
+    }
+  }
+  if (best == 0) {
+    return "";
+  }
 
-      if (A[i - 1] == B[j - 1]) {
-        L[i][j] = L[i - 1][j - 1] + 1;
+  // Among the runs of suffixes that share best characters and come from both strings, pick the first position in A.
+  size_t first_in_a{na};
+  for (size_t i = 0; i < sa.size();) {
+    size_t j{i + 1};
+    while (j < sa.size() && lcp[j] >= best) j++;
+    bool has_b{false};
+    size_t min_a{na};
+    for (size_t k = i; k < j; k++) {
+      has_b = has_b || in_b(sa[k]);
+      if (in_a(sa[k])) min_a = std::min<size_t>(min_a, sa[k]);
+    }
+    if (has_b) first_in_a = std::min(first_in_a, min_a);
+    i = j;
+  }
+  return A.substr(first_in_a, best);
+}
 
-        if (L[i][j] > max_substr) {
-          max_substr = L[i][j];
-          x_longest = i;
-        }
+/////////////////////////////////////////////
+/// Suffix array
+/////////////////////////////////////////////
+
+std::vector<uint32_t> BuildSuffixArray(std::string_view text)
+{ return SuffixArrayPriv(reinterpret_cast<const unsigned char*>(text.data()), text.size(), 255); }
+
+std::vector<uint32_t> BuildLcp(std::string_view text, const std::vector<uint32_t>& sa)
+{ return LcpPriv(reinterpret_cast<const unsigned char*>(text.data()), text.size(), sa); }
+
+SuffixArray::SuffixArray(std::string text)
+    : text_(std::move(text)), sa_(BuildSuffixArray(text_)), lcp_(BuildLcp(text_, sa_))
+{}
+
+std::pair<size_t, size_t> SuffixArray::Range(std::string_view pattern) const
+{
+  const std::string_view text{text_};
+  // Compares only the first pattern.size() characters of the suffix.
+  auto prefix = [&](uint32_t pos) { return text.substr(pos, pattern.size()); };
+  const auto first = std::lower_bound(sa_.begin(), sa_.end(), pattern,
+                                      [&](uint32_t pos, std::string_view p) { return prefix(pos) < p; });
+  const auto last = std::upper_bound(first, sa_.end(), pattern,
+                                     [&](std::string_view p, uint32_t pos) { return p < prefix(pos); });
+  return {static_cast<size_t>(first - sa_.begin()), static_cast<size_t>(last - sa_.begin())};
+}
+
+size_t SuffixArray::Count(std::string_view pattern) const
+{
+  const auto [first, last] = Range(pattern);
+  return last - first;
+}
+
+std::vector<size_t> SuffixArray::Locate(std::string_view pattern) const
+{
+  const auto [first, last] = Range(pattern);
+  std::vector<size_t> pos(sa_.begin() + first, sa_.begin() + last);
+  std::sort(pos.begin(), pos.end());
+  return pos;
+}
+
+/////////////////////////////////////////////
+/// FM-index
+/////////////////////////////////////////////
+
+namespace {
+
+constexpr uint64_t kFmIndexMagic{0x31494d464f474c41ULL};// "ALGOFMI1"
+constexpr size_t kFmHeader{5};                          // magic, n, sample rate, end marker row, sample count
+constexpr size_t kRankBlock{8};                         // Words per rank block.
+
+inline size_t Popcount(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_popcountll(x));
+#else
+  size_t count{0};
+  for (; x != 0; x &= x - 1) count++;
+  return count;
+#endif
+}
+
+/// \brief Bit vector with a cumulative count of ones per block of 8 words, so a rank reads at most 9 words.
+struct RankBits {
+  const uint64_t* bits;
+  const uint64_t* ranks;
+
+  bool Get(size_t i) const
+  { return (bits[i / 64] >> (i % 64)) & 1u; }
+
+  /// Ones before position i.
+  size_t Rank1(size_t i) const
+  {
+    const size_t word{i / 64};
+    size_t r{ranks[word / kRankBlock]};
+    for (size_t w = word - word % kRankBlock; w < word; w++) r += Popcount(bits[w]);
+    if (i % 64 != 0) r += Popcount(bits[word] & ((uint64_t{1} << (i % 64)) - 1));
+    return r;
+  }
+};
+
+/// \brief The samples are packed two per word.
+inline uint32_t GetSample(const uint64_t* samples, size_t k)
+{
+  uint32_t v;
+  std::memcpy(&v, reinterpret_cast<const char*>(samples) + k * sizeof(uint32_t), sizeof(v));
+  return v;
+}
+
+inline void SetSample(uint64_t* samples, size_t k, uint32_t v)
+{ std::memcpy(reinterpret_cast<char*>(samples) + k * sizeof(uint32_t), &v, sizeof(v)); }
+
+/// \brief Fills the rank blocks of bits.
+void BuildRanks(const uint64_t* bits, size_t bit_words, uint64_t* ranks)
+{
+  uint64_t total{0};
+  for (size_t w = 0; w < bit_words; w++) {
+    if (w % kRankBlock == 0) ranks[w / kRankBlock] = total;
+    total += Popcount(bits[w]);
+  }
+  ranks[bit_words / kRankBlock + (bit_words % kRankBlock != 0)] = total;
+}
+
+/// \brief Checks that the rank blocks match the bits and that the bits past the last row are 0.
+/// \param ones Set to the number of ones.
+bool CheckRanks(const uint64_t* bits, size_t bit_words, size_t rows, const uint64_t* ranks, size_t& ones)
+{
+  uint64_t total{0};
+  for (size_t w = 0; w < bit_words; w++) {
+    if (w % kRankBlock == 0 && ranks[w / kRankBlock] != total) {
+      return false;
+    }
+    total += Popcount(bits[w]);
+  }
+  if (rows % 64 != 0 && (bits[bit_words - 1] >> (rows % 64)) != 0) {
+    return false;
+  }
+  ones = total;
+  return ranks[bit_words / kRankBlock + (bit_words % kRankBlock != 0)] == total;
+}
+
+/// \brief Follows row down the levels of the wavelet matrix as symbol c.
+/// \return The position on the last level, the start of c plus the occurrences of c before row.
+size_t WaveletPosition(const uint64_t* levels, size_t bit_words, size_t rank_words, const uint64_t* zeros,
+                       unsigned char c, size_t row)
+{
+  size_t p{row};
+  for (size_t level = 0; level < 8; level++) {
+    const uint64_t* bits{levels + level * (bit_words + rank_words)};
+    const RankBits rb{bits, bits + bit_words};
+    const size_t ones{rb.Rank1(p)};
+    p = ((c >> (7u - level)) & 1u) ? zeros[level] + ones : p - ones;
+  }
+  return p;
+}
+
+}// namespace
+
+FmIndex::Layout FmIndex::MakeLayout(size_t n, size_t sample_count)
+{
+  Layout l;
+  l.rows = n + 1;
+  l.bit_words = (l.rows + 63) / 64;
+  l.rank_words = l.bit_words / kRankBlock + 2;
+  l.counts = kFmHeader;
+  l.starts = l.counts + 257;
+  l.zeros = l.starts + 256;
+  l.levels = l.zeros + 8;
+  l.sampled = l.levels + 8 * (l.bit_words + l.rank_words);
+  l.samples = l.sampled + l.bit_words + l.rank_words;
+  l.total = l.samples + (sample_count + 1) / 2;
+  return l;
+}
+
+FmIndex::FmIndex(std::string_view text, uint32_t sample_rate)
+{
+  const size_t n{text.size()};
+  sample_rate = std::max<uint32_t>(sample_rate, 1);
+  const std::vector<uint32_t> sa{BuildSuffixArray(text)};
+
+  // The rows are the sorted suffixes of text plus an end marker smaller than all bytes, row 0 is the marker alone.
+  // Row r + 1 is sa[r], and its BWT symbol is the byte before it. The marker itself is stored as a 0 byte.
+  const size_t rows{n + 1};
+  std::vector<unsigned char> bwt(rows);
+  bwt[0] = n > 0 ? static_cast<unsigned char>(text[n - 1]) : 0;
+  size_t marker_row{0};
+  size_t sample_count{0};
+  for (size_t r = 0; r < n; r++) {
+    if (sa[r] == 0) {
+      marker_row = r + 1;
+      bwt[r + 1] = 0;
+    } else {
+      bwt[r + 1] = static_cast<unsigned char>(text[sa[r] - 1]);
+    }
+    if (sa[r] % sample_rate == 0) sample_count++;
+  }
+
+  layout_ = MakeLayout(n, sample_count);
+  storage_.assign(layout_.total, 0);
+  uint64_t* base{storage_.data()};
+  base[0] = kFmIndexMagic;
+  base[1] = n;
+  base[2] = sample_rate;
+  base[3] = marker_row;
+  base[4] = sample_count;
+
+  uint64_t* counts{base + layout_.counts};
+  counts[0] = 1;// The end marker.
+  std::vector<size_t> histogram(256, 0);
+  for (char c : text) histogram[static_cast<unsigned char>(c)]++;
+  for (size_t c = 0; c < 256; c++) counts[c + 1] = counts[c] + histogram[c];
+
+  // Wavelet matrix: level l holds bit 7 - l of each symbol, then the symbols are stably split on that bit.
+  std::vector<unsigned char> next(rows);
+  for (size_t level = 0; level < 8; level++) {
+    uint64_t* bits{base + layout_.levels + level * (layout_.bit_words + layout_.rank_words)};
+    const unsigned shift{7u - static_cast<unsigned>(level)};
+    size_t zeros{0};
+    for (size_t i = 0; i < rows; i++) {
+      if ((bwt[i] >> shift) & 1u) {
+        bits[i / 64] |= uint64_t{1} << (i % 64);
       } else {
-        L[i][j] = 0;
+        zeros++;
       }
     }
+    BuildRanks(bits, layout_.bit_words, bits + layout_.bit_words);
+    base[layout_.zeros + level] = zeros;
+
+    size_t z{0}, o{zeros};
+    for (size_t i = 0; i < rows; i++) {
+      next[((bwt[i] >> shift) & 1u) ? o++ : z++] = bwt[i];
+    }
+    bwt.swap(next);
   }
-  std::string res = A.substr(x_longest - max_substr, max_substr);
+  uint64_t* starts{base + layout_.starts};
+  for (size_t i = rows; i-- > 0;) starts[bwt[i]] = i;
 
-  if (res[0] == ' ') {
-    return std::string(res.begin() + 1, res.end());
+  // Samples at text positions divisible by sample_rate, position 0 included so every walk ends.
+  uint64_t* sampled{base + layout_.sampled};
+  uint64_t* samples{base + layout_.samples};
+  for (size_t r = 0, k = 0; r < n; r++) {
+    if (sa[r] % sample_rate == 0) {
+      sampled[(r + 1) / 64] |= uint64_t{1} << ((r + 1) % 64);
+      SetSample(samples, k++, sa[r]);
+    }
   }
-  return res;
+  BuildRanks(sampled, layout_.bit_words, sampled + layout_.bit_words);
+  words_ = layout_.total;
 }
 
-namespace {
-/// \brief Returns the hash for str.
-/// \param str The string to hash.
-/// \return hash.
-constexpr auto Fingerprint = [](auto str) {
-  std::hash<std::string> shash;
-  return shash(str);
-};
-}//namespace
+size_t FmIndex::Size() const
+{ return words_ == 0 ? 0 : Base()[1]; }
+
+size_t FmIndex::Rank(unsigned char c, size_t row) const
+{
+  const uint64_t* base{Base()};
+  const size_t p{WaveletPosition(base + layout_.levels, layout_.bit_words, layout_.rank_words, base + layout_.zeros,
+                                 c, row)};
+  size_t rank{p - base[layout_.starts + c]};
+  // The end marker is stored as a 0 byte.
+  if (c == 0 && row > base[3]) rank--;
+  return rank;
+}
+
+size_t FmIndex::LastToFirst(size_t row) const
+{
+  const uint64_t* base{Base()};
+  // Reads the symbol while following its position down the levels, the end position is its rank plus its start.
+  size_t p{row};
+  unsigned c{0};
+  for (size_t level = 0; level < 8; level++) {
+    const uint64_t* bits{base + layout_.levels + level * (layout_.bit_words + layout_.rank_words)};
+    const RankBits rb{bits, bits + layout_.bit_words};
+    const bool bit{rb.Get(p)};
+    const size_t ones{rb.Rank1(p)};
+    c = (c << 1u) | bit;
+    p = bit ? base[layout_.zeros + level] + ones : p - ones;
+  }
+  size_t rank{p - base[layout_.starts + c]};
+  if (c == 0 && row > base[3]) rank--;
+  return base[layout_.counts + c] + rank;
+}
+
+size_t FmIndex::Count(std::string_view pattern) const
+{
+  if (words_ == 0) {
+    return 0;
+  }
+  if (pattern.empty()) {
+    return Size();
+  }
+  const uint64_t* counts{Base() + layout_.counts};
+  size_t first{0}, last{layout_.rows};
+  for (size_t i = pattern.size(); i-- > 0 && first < last;) {
+    const auto c = static_cast<unsigned char>(pattern[i]);
+    first = counts[c] + Rank(c, first);
+    last = counts[c] + Rank(c, last);
+  }
+  return first < last ? last - first : 0;
+}
+
+std::vector<size_t> FmIndex::Locate(std::string_view pattern) const
+{
+  std::vector<size_t> pos;
+  if (words_ == 0) {
+    return pos;
+  }
+  if (pattern.empty()) {
+    for (size_t i = 0; i < Size(); i++) pos.push_back(i);
+    return pos;
+  }
+
+  const uint64_t* base{Base()};
+  const uint64_t* counts{base + layout_.counts};
+  size_t first{0}, last{layout_.rows};
+  for (size_t i = pattern.size(); i-- > 0 && first < last;) {
+    const auto c = static_cast<unsigned char>(pattern[i]);
+    first = counts[c] + Rank(c, first);
+    last = counts[c] + Rank(c, last);
+  }
+
+  const RankBits sampled{base + layout_.sampled, base + layout_.sampled + layout_.bit_words};
+  const uint64_t* samples{base + layout_.samples};
+  // A sample is less than sample rate steps away, the bound only ends the walk in a file that passes Bind but whose
+  // rows do not form one cycle.
+  const size_t max_steps{static_cast<size_t>(std::min<uint64_t>(base[2], Size()))};
+  for (size_t row = first; row < last; row++) {
+    size_t r{row};
+    size_t steps{0};
+    while (!sampled.Get(r) && steps < max_steps) {
+      r = LastToFirst(r);
+      steps++;
+    }
+    if (sampled.Get(r)) {
+      pos.push_back(GetSample(samples, sampled.Rank1(r)) + steps);
+    }
+  }
+  std::sort(pos.begin(), pos.end());
+  return pos;
+}
+
+bool FmIndex::Bind(const uint64_t* data, size_t words)
+{
+  if (words < kFmHeader || data[0] != kFmIndexMagic || data[2] == 0) {
+    return false;
+  }
+  const Layout layout{MakeLayout(data[1], data[4])};
+  if (words != layout.total || data[3] > data[1] || data[4] > layout.rows) {
+    return false;
+  }
+
+  // The queries index the tables with the values read from them, so every table must agree with the bit vectors.
+  const size_t n{data[1]};
+  const uint64_t* counts{data + layout.counts};
+  if (counts[0] != 1 || counts[256] != layout.rows) {
+    return false;
+  }
+  for (size_t c = 0; c < 256; c++) {
+    if (counts[c + 1] < counts[c]) {
+      return false;
+    }
+  }
+
+  const uint64_t* zeros{data + layout.zeros};
+  for (size_t level = 0; level < 8; level++) {
+    const uint64_t* bits{data + layout.levels + level * (layout.bit_words + layout.rank_words)};
+    size_t ones{0};
+    if (!CheckRanks(bits, layout.bit_words, layout.rows, bits + layout.bit_words, ones)
+        || zeros[level] != layout.rows - ones) {
+      return false;
+    }
+  }
+
+  // Each byte occurs in the wavelet matrix as often as the counts say and starts where the last level puts it. The end
+  // marker is stored as a 0 byte.
+  auto position = [&](unsigned char c, size_t row) {
+    return WaveletPosition(data + layout.levels, layout.bit_words, layout.rank_words, zeros, c, row);
+  };
+  for (size_t c = 0; c < 256; c++) {
+    const auto symbol = static_cast<unsigned char>(c);
+    const size_t first{position(symbol, 0)};
+    const size_t occurrences{counts[c + 1] - counts[c] + (c == 0)};
+    if (position(symbol, layout.rows) - first != occurrences
+        || (occurrences > 0 && data[layout.starts + c] != first)) {
+      return false;
+    }
+  }
+  if (position(0, data[3] + 1) - position(0, data[3]) != 1) {
+    return false;
+  }
+
+  // Every text position that is a multiple of the sample rate is sampled, position 0 in the row of the end marker.
+  const uint64_t* sampled{data + layout.sampled};
+  size_t sampled_rows{0};
+  if (!CheckRanks(sampled, layout.bit_words, layout.rows, sampled + layout.bit_words, sampled_rows)
+      || sampled_rows != data[4] || data[4] != (n == 0 ? 0 : (n - 1) / data[2] + 1)
+      || (n > 0 && !RankBits{sampled, sampled + layout.bit_words}.Get(data[3]))) {
+    return false;
+  }
+  for (size_t k = 0; k < data[4]; k++) {
+    const uint32_t sample{GetSample(data + layout.samples, k)};
+    if (sample >= n || sample % data[2] != 0) {
+      return false;
+    }
+  }
+
+  layout_ = layout;
+  words_ = words;
+  return true;
+}
+
+bool FmIndex::Save(const std::string& path) const
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(Base()), static_cast<std::streamsize>(Bytes()));
+  return static_cast<bool>(file);
+}
+
+bool FmIndex::Load(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return false;
+  }
+  const auto bytes = static_cast<size_t>(file.tellg());
+  if (bytes % sizeof(uint64_t) != 0) {
+    return false;
+  }
+  std::vector<uint64_t> words(bytes / sizeof(uint64_t));
+  file.seekg(0);
+  if (!file.read(reinterpret_cast<char*>(words.data()), static_cast<std::streamsize>(bytes))) {
+    return false;
+  }
+
+  FmIndex loaded;
+  if (!loaded.Bind(words.data(), words.size())) {
+    return false;
+  }
+  loaded.storage_ = std::move(words);
+  *this = std::move(loaded);
+  return true;
+}
+
+bool FmIndex::Attach(const void* data, size_t bytes)
+{
+  if (reinterpret_cast<uintptr_t>(data) % alignof(uint64_t) != 0 || bytes % sizeof(uint64_t) != 0) {
+    return false;
+  }
+  const auto* words = static_cast<const uint64_t*>(data);
+  FmIndex attached;
+  if (!attached.Bind(words, bytes / sizeof(uint64_t))) {
+    return false;
+  }
+  attached.external_ = words;
+  *this = std::move(attached);
+  return true;
+}
 
 std::vector<int> SearchRabinKarpSingle(const std::string& text, const std::string& pattern)
 {
   std::vector<int> pos;
-  size_t n = text.length();
-  size_t m = pattern.length();
-  unsigned long hash_p = Fingerprint(pattern);
-  unsigned long hash_t = Fingerprint(text.substr(0, m));
+  const size_t n{text.size()};
+  const size_t m{pattern.size()};
+  if (m == 0 || m > n) {
+    return pos;
+  }
+
+  RabinHash hash_p{m};
+  RabinHash hash_t{m};
+  for (size_t i = 0; i < m; i++) {
+    hash_p.Push(static_cast<unsigned char>(pattern[i]));
+    hash_t.Push(static_cast<unsigned char>(text[i]));
+  }
 
-  for (size_t i = 0; i < (n - m + 1); i++) {
-    if (hash_t == hash_p) {
-      if (text.substr(i, m) == pattern) pos.push_back(i);
+  for (size_t i = 0;; i++) {
+    if (hash_t.Hash() == hash_p.Hash() && text.compare(i, m, pattern) == 0) {
+      pos.push_back(static_cast<int>(i));
     }
-    std::string temp = text.substr(i + 1, m);
-    hash_t = Fingerprint(temp);
+    if (i + m == n) {
+      break;
+    }
+    hash_t.Roll(static_cast<unsigned char>(text[i]), static_cast<unsigned char>(text[i + m]));
   }
   return pos;
 }
 
 std::vector<int> SearchRabinKarpMulti(const std::string& text, std::set<std::string> patterns, int m)
 {
-  std::set<unsigned long> hash_pm;
+  std::vector<std::string> fixed;
+  for (const auto& pattern : patterns) {
+    if (m > 0 && pattern.size() == static_cast<size_t>(m)) {
+      fixed.emplace_back(pattern);
+    }
+  }
+
+  // All patterns have the same length, so the matches come ordered by start and there is at most one per start.
   std::vector<int> pos;
-  size_t n = text.length();
+  for (const Match& match : AhoCorasick(fixed).Search(text)) {
+    pos.push_back(static_cast<int>(match.position));
+  }
+  return pos;
+}
+
+/////////////////////////////////////////////
+/// Rolling hashes
+/////////////////////////////////////////////
+
+RabinHash::RabinHash(size_t window)
+{
+  for (size_t i = 0; i < window; i++) {
+    out_factor_ *= kBase;
+  }
+}
+
+/////////////////////////////////////////////
+/// Content-defined chunking
+/////////////////////////////////////////////
+
+namespace {
+
+constexpr size_t kMinChunk{64};
+constexpr unsigned kMaxAverageBits{40};
+
+/// \brief A mask of the bits highest bits. The high bits of the Gear hash depend on the most bytes.
+uint64_t HighBits(unsigned bits)
+{
+  return bits == 0 ? 0 : ~uint64_t{0} << (64u - bits);
+}
+
+constexpr uint32_t kSha256Rounds[64]{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+uint32_t Rotr(uint32_t x, unsigned r)
+{
+  return (x >> r) | (x << (32u - r));
+}
+
+/// \brief Runs the SHA-256 compression function on one 64-byte block.
+void Sha256Block(uint32_t state[8], const unsigned char* block)
+{
+  uint32_t w[64];
+  for (size_t i = 0; i < 16; i++) {
+    w[i] = uint32_t{block[4 * i]} << 24u | uint32_t{block[4 * i + 1]} << 16u | uint32_t{block[4 * i + 2]} << 8u
+           | uint32_t{block[4 * i + 3]};
+  }
+  for (size_t i = 16; i < 64; i++) {
+    const uint32_t s0{Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3u)};
+    const uint32_t s1{Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10u)};
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t a{state[0]}, b{state[1]}, c{state[2]}, d{state[3]};
+  uint32_t e{state[4]}, f{state[5]}, g{state[6]}, h{state[7]};
+  for (size_t i = 0; i < 64; i++) {
+    const uint32_t t1{h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + kSha256Rounds[i] + w[i]};
+    const uint32_t t2{(Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c))};
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+}// namespace
+
+std::array<uint8_t, 32> Sha256(std::string_view data)
+{
+  uint32_t state[8]{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  const auto* p = reinterpret_cast<const unsigned char*>(data.data());
+  size_t i{0};
+  for (; i + 64 <= data.size(); i += 64) {
+    Sha256Block(state, p + i);
+  }
+
+  // The padding: a 1 bit, zeros, and the length in bits in the last 8 bytes, in one or two blocks.
+  unsigned char last[128]{};
+  const size_t rest{data.size() - i};
+  std::memcpy(last, p + i, rest);
+  last[rest] = 0x80;
+  const size_t blocks{rest < 56 ? 1U : 2U};
+  const uint64_t bits{static_cast<uint64_t>(data.size()) * 8};
+  for (size_t b = 0; b < 8; b++) {
+    last[blocks * 64 - 1 - b] = static_cast<unsigned char>(bits >> (8 * b));
+  }
+  for (size_t b = 0; b < blocks; b++) {
+    Sha256Block(state, last + 64 * b);
+  }
+
+  std::array<uint8_t, 32> digest{};
+  for (size_t w = 0; w < 8; w++) {
+    for (size_t b = 0; b < 4; b++) {
+      digest[4 * w + b] = static_cast<uint8_t>(state[w] >> (24 - 8 * b));
+    }
+  }
+  return digest;
+}
+
+Chunker::Chunker(size_t average) : Chunker(average / 4, average, average * 8)
+{}
+
+Chunker::Chunker(size_t min, size_t average, size_t max)
+{
+  unsigned bits{6};
+  while (bits < kMaxAverageBits && (size_t{2} << bits) <= average) {
+    bits++;
+  }
+  average_ = size_t{1} << bits;
+  min_ = std::clamp(min, kMinChunk, average_);
+  max_ = std::max(max, average_);
+  mask_small_ = HighBits(bits + 2);
+  mask_large_ = HighBits(bits - 2);
+}
+
+size_t Chunker::Cut(std::string_view data) const
+{
+  const size_t n{std::min(data.size(), max_)};
+  if (n <= min_) {
+    return n;
+  }
+  const auto* p = reinterpret_cast<const unsigned char*>(data.data());
+  const size_t normal{std::min(n, average_)};
+
+  GearHash gear;
+  size_t i{min_};
+  for (; i < normal; i++) {
+    gear.Roll(p[i]);
+    if ((gear.Hash() & mask_small_) == 0) {
+      return i + 1;
+    }
+  }
+  for (; i < n; i++) {
+    gear.Roll(p[i]);
+    if ((gear.Hash() & mask_large_) == 0) {
+      return i + 1;
+    }
+  }
+  return n;
+}
+
+std::vector<size_t> Chunker::Split(std::string_view data) const
+{
+  std::vector<size_t> lengths;
+  while (!data.empty()) {
+    const size_t length{Cut(data)};
+    lengths.push_back(length);
+    data.remove_prefix(length);
+  }
+  return lengths;
+}
+
+DedupIndex::DedupIndex(Chunker chunker) : chunker_{chunker}
+{}
+
+void DedupIndex::AddChunk(std::string_view chunk, uint32_t input, uint64_t offset)
+{
+  const Digest digest{Sha256(chunk)};
+
+  const ChunkRef ref{input, offset, chunk.size()};
+  total_bytes_ += chunk.size();
+  auto [it, inserted] = chunks_.emplace(digest, ref);
+  if (inserted) {
+    unique_bytes_ += chunk.size();
+  } else {
+    duplicates_.push_back({ref, it->second});
+  }
+}
+
+uint32_t DedupIndex::Add(std::string_view data)
+{
+  const uint32_t id{inputs_++};
+  uint64_t offset{0};
+  while (!data.empty()) {
+    const size_t length{chunker_.Cut(data)};
+    AddChunk(data.substr(0, length), id, offset);
+    data.remove_prefix(length);
+    offset += length;
+  }
+  return id;
+}
+
+bool DedupIndex::Add(std::istream& in, uint32_t& id)
+{
+  id = inputs_++;
+  std::string buffer(2 * chunker_.Max(), '\0');
+  size_t filled{0};
+  uint64_t offset{0};
 
+  while (true) {
+    in.read(buffer.data() + filled, static_cast<std::streamsize>(buffer.size() - filled));
+    filled += static_cast<size_t>(in.gcount());
+    if (in.bad()) {
+      return false;
+    }
+    const bool end{in.eof()};
+
+    // A chunk may end at the end of the buffer only if the input ends there too.
+    std::string_view data{buffer.data(), filled};
+    while (!data.empty() && (end || data.size() >= chunker_.Max())) {
+      const size_t length{chunker_.Cut(data)};
+      AddChunk(data.substr(0, length), id, offset);
+      data.remove_prefix(length);
+      offset += length;
+    }
+    if (end) {
+      return true;
+    }
+    std::memmove(buffer.data(), data.data(), data.size());
+    filled = data.size();
+  }
+}
+
+/////////////////////////////////////////////
+/// Aho-Corasick
+/////////////////////////////////////////////
+
+AhoCorasick::AhoCorasick(const std::vector<std::string>& patterns) : lengths_(patterns.size())
+{
+  // Bytes that occur in no pattern share class 0, unless all 256 bytes occur.
+  bool used[256]{};
   for (const auto& pattern : patterns) {
-    hash_pm.insert(Fingerprint(pattern));
+    for (unsigned char c : pattern) used[c] = true;
+  }
+  const auto distinct = static_cast<uint32_t>(std::count(used, used + 256, true));
+  classes_ = distinct == 256 ? 256 : distinct + 1;
+  uint32_t next_class{classes_ - distinct};
+  for (size_t b = 0; b < 256; b++) {
+    byte_class_[b] = used[b] ? static_cast<uint8_t>(next_class++) : 0;
   }
 
-  unsigned long hash_t = Fingerprint(text.substr(0, m));
+  // The trie, with state numbers as transitions while building.
+  constexpr uint32_t kNone{UINT32_MAX};
+  const size_t C{classes_};
+  delta_.assign(C, kNone);
+  std::vector<uint32_t> end_state(patterns.size(), 0);
 
-  for (size_t j = 0; j < (n - m + 1); j++) {
-    bool h_find = hash_pm.find(hash_t) != hash_pm.end();
-    bool p_find = patterns.find(text.substr(j, m)) != patterns.end();
-    if (h_find && p_find) pos.push_back(j);
+  for (size_t i = 0; i < patterns.size(); i++) {
+    lengths_[i] = static_cast<uint32_t>(patterns[i].size());
+    uint32_t state{0};
+    for (unsigned char c : patterns[i]) {
+      const size_t idx{state * C + byte_class_[c]};
+      if (delta_[idx] == kNone) {
+        if (delta_.size() + C > kOutputBit) {
+          delta_.clear();
+          return;
+        }
+        delta_[idx] = static_cast<uint32_t>(delta_.size() / C);
+        delta_.resize(delta_.size() + C, kNone);
+      }
+      state = delta_[idx];
+    }
+    end_state[i] = state;
+  }
+  const size_t states{delta_.size() / C};
 
-    std::string temp = text.substr(j + 1, m);
-    hash_t = Fingerprint(temp);
+  // Patterns per end state, the root has none since empty patterns never match.
+  out_begin_.assign(states + 1, 0);
+  for (size_t i = 0; i < patterns.size(); i++) {
+    if (end_state[i] != 0) out_begin_[end_state[i] + 1]++;
   }
-  return pos;
+  for (size_t s = 0; s < states; s++) out_begin_[s + 1] += out_begin_[s];
+  out_.resize(out_begin_[states]);
+  std::vector<uint32_t> cursor(out_begin_.begin(), out_begin_.end() - 1);
+  for (size_t i = 0; i < patterns.size(); i++) {
+    if (end_state[i] != 0) out_[cursor[end_state[i]]++] = static_cast<uint32_t>(i);
+  }
+  auto has_own = [this](uint32_t s) { return out_begin_[s] != out_begin_[s + 1]; };
+
+  // Breadth first, the failure state of a node is shallower and therefore already complete. Missing transitions are
+  // taken from the failure state, which turns the trie into a DFA.
+  std::vector<uint32_t> fail(states, 0);
+  std::vector<uint32_t> order;
+  order.reserve(states);
+  dict_link_.assign(states, 0);
+
+  for (size_t c = 0; c < C; c++) {
+    if (delta_[c] == kNone) {
+      delta_[c] = 0;
+    } else {
+      order.push_back(delta_[c]);
+    }
+  }
+  for (size_t head = 0; head < order.size(); head++) {
+    const uint32_t s{order[head]};
+    for (size_t c = 0; c < C; c++) {
+      const uint32_t t{delta_[s * C + c]};
+      const uint32_t f{delta_[fail[s] * C + c]};
+      if (t == kNone) {
+        delta_[s * C + c] = f;
+      } else {
+        fail[t] = f;
+        dict_link_[t] = has_own(f) ? f : dict_link_[f];
+        order.push_back(t);
+      }
+    }
+  }
+
+  // Row offsets instead of state numbers, so the scan needs no multiplication.
+  for (auto& t : delta_) {
+    const bool output{has_own(t) || dict_link_[t] != 0};
+    t = static_cast<uint32_t>(t * C) | (output ? kOutputBit : 0);
+  }
+}
+
+uint32_t AhoCorasick::Scan(std::string_view text, uint32_t state, uint64_t offset, std::vector<Match>* matches) const
+{
+  const uint32_t* delta{delta_.data()};
+  for (size_t i = 0; i < text.size(); i++) {
+    const uint32_t next{delta[state + byte_class_[static_cast<unsigned char>(text[i])]]};
+    state = next & ~kOutputBit;
+    if (next & kOutputBit) {
+      const uint64_t end{offset + i + 1};
+      for (uint32_t s = state / classes_; s != 0; s = dict_link_[s]) {
+        for (uint32_t k = out_begin_[s]; k < out_begin_[s + 1]; k++) {
+          matches->push_back({end - lengths_[out_[k]], out_[k]});
+        }
+      }
+    }
+  }
+  return state;
+}
+
+std::vector<Match> AhoCorasick::Search(std::string_view text) const
+{
+  std::vector<Match> matches;
+  if (Valid()) {
+    Scan(text, 0, 0, &matches);
+  }
+  return matches;
+}
+
+bool AhoCorasick::Contains(std::string_view text) const
+{
+  if (!Valid()) {
+    return false;
+  }
+  const uint32_t* delta{delta_.data()};
+  uint32_t state{0};
+  for (char c : text) {
+    state = delta[state + byte_class_[static_cast<unsigned char>(c)]];
+    if (state & kOutputBit) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void AhoCorasick::Scanner::Feed(std::string_view chunk, std::vector<Match>& matches)
+{
+  if (automaton_->Valid()) {
+    state_ = automaton_->Scan(chunk, state_, offset_, &matches);
+  }
+  offset_ += chunk.size();
 }
 
 /// \brief Hidden function for generating all the permutations of the input str.
@@ -164,6 +1238,153 @@ std::vector<std::string> GenerateAllPermutations(std::string& str)
   return vec;
 }
 
+namespace {
+
+/// \brief Multiplies a and b.
+/// \return False if the product does not fit in 64 bits.
+bool MultiplyChecked(uint64_t a, uint64_t b, uint64_t& product)
+{
+  if (a != 0 && b > UINT64_MAX / a) {
+    return false;
+  }
+  product = a * b;
+  return true;
+}
+
+/// \brief Returns total * count / len, where the division is known to be exact, without overflowing on the way.
+uint64_t ExactShare(uint64_t total, uint64_t len, uint64_t count)
+{
+  const uint64_t g{std::gcd(total, len)};
+  return (total / g) * (count / (len / g));
+}
+
+/// \brief Counts the permutations of a multiset with the given character counts.
+uint64_t CountPermutationsPriv(const uint64_t* counts)
+{
+  uint64_t result{1};
+  uint64_t m{0};
+
+  for (size_t c = 0; c < 256; c++) {
+    m += counts[c];
+    const uint64_t k{std::min(counts[c], m - counts[c])};
+    // Binomial(m, k), each step divided by the gcd first so that only the result has to fit.
+    uint64_t binomial{1};
+    for (uint64_t i = 0; i < k; i++) {
+      const uint64_t g{std::gcd(binomial, i + 1)};
+      if (!MultiplyChecked(binomial / g, (m - i) / ((i + 1) / g), binomial)) {
+        return 0;
+      }
+    }
+    if (!MultiplyChecked(result, binomial, result)) {
+      return 0;
+    }
+  }
+  return result;
+}
+
+/// \brief Orders the characters as unsigned bytes, the order used by the ranks.
+bool ByteLess(char a, char b)
+{
+  return static_cast<unsigned char>(a) < static_cast<unsigned char>(b);
+}
+
+void CountChars(std::string_view str, uint64_t* counts)
+{
+  for (char c : str) {
+    counts[static_cast<unsigned char>(c)]++;
+  }
+}
+
+}// namespace
+
+PermutationGenerator::PermutationGenerator(std::string str) : current_{std::move(str)}, remaining_{UINT64_MAX}
+{
+  std::sort(current_.begin(), current_.end(), ByteLess);
+}
+
+PermutationGenerator::PermutationGenerator(std::string str, uint64_t first, uint64_t count)
+    : current_{PermutationUnrank(str, first)}, remaining_{count}
+{
+  if (current_.size() != str.size()) {
+    remaining_ = 0;
+  }
+}
+
+bool PermutationGenerator::Next()
+{
+  if (remaining_ == 0) {
+    return false;
+  }
+  if (started_ && !std::next_permutation(current_.begin(), current_.end(), ByteLess)) {
+    remaining_ = 0;
+    return false;
+  }
+  started_ = true;
+  remaining_--;
+  return true;
+}
+
+uint64_t CountPermutations(std::string_view str)
+{
+  uint64_t counts[256]{};
+  CountChars(str, counts);
+  return CountPermutationsPriv(counts);
+}
+
+uint64_t PermutationRank(std::string_view perm)
+{
+  uint64_t counts[256]{};
+  CountChars(perm, counts);
+  uint64_t total{CountPermutationsPriv(counts)};
+  if (total == 0) {
+    return UINT64_MAX;
+  }
+
+  // The permutations of the remaining characters that start with c are total * counts[c] / len.
+  uint64_t rank{0};
+  for (size_t i = 0; i < perm.size(); i++) {
+    const uint64_t len{perm.size() - i};
+    const auto current = static_cast<unsigned char>(perm[i]);
+    for (size_t c = 0; c < current; c++) {
+      if (counts[c] != 0) {
+        rank += ExactShare(total, len, counts[c]);
+      }
+    }
+    total = ExactShare(total, len, counts[current]);
+    counts[current]--;
+  }
+  return rank;
+}
+
+std::string PermutationUnrank(std::string_view str, uint64_t rank)
+{
+  uint64_t counts[256]{};
+  CountChars(str, counts);
+  uint64_t total{CountPermutationsPriv(counts)};
+  if (total == 0 || rank >= total) {
+    return {};
+  }
+
+  std::string perm(str.size(), '\0');
+  for (size_t i = 0; i < perm.size(); i++) {
+    const uint64_t len{perm.size() - i};
+    for (size_t c = 0; c < 256; c++) {
+      if (counts[c] == 0) {
+        continue;
+      }
+      const uint64_t block{ExactShare(total, len, counts[c])};
+      if (rank < block) {
+        perm[i] = static_cast<char>(c);
+        counts[c]--;
+        total = block;
+        break;
+      }
+      rank -= block;
+    }
+  }
+  return perm;
+}
+
 bool IsRotated(const std::string& str1, const std::string& str2)
 {
   if (str1.empty() && str2.empty()) {
@@ -211,6 +1432,293 @@ std::string Compress(const std::string& str)
   return res;
 }
 
+/////////////////////////////////////////////
+/// Run-length codec
+/////////////////////////////////////////////
+
+namespace {
+
+constexpr uint64_t kRleMinRun{3};
+constexpr size_t kRleMaxLiteral{size_t{1} << 16u};
+
+void AppendVarint(uint64_t value, std::string& out)
+{
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7u;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+/// \brief Returns the number of leading bytes of p that equal p[0].
+size_t RunLength(const char* p, size_t n)
+{
+  size_t i{1};
+#if defined(ALGO_SIMD_X86) && defined(__SSE2__)
+  const __m128i byte{_mm_set1_epi8(p[0])};
+  for (; i + 16 <= n; i += 16) {
+    const auto equal = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(byte, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)))));
+    if (equal != 0xffff) {
+      return i + static_cast<size_t>(__builtin_ctz(~equal));
+    }
+  }
+#endif
+  while (i < n && p[i] == p[0]) i++;
+  return i;
+}
+
+/// \brief Returns the first position at or after from where three equal bytes start, or n - 2 if there is none.
+size_t FindRunStart(const char* p, size_t from, size_t n)
+{
+  size_t i{from};
+#if defined(ALGO_SIMD_X86) && defined(__SSE2__)
+  for (; i + 18 <= n; i += 16) {
+    const __m128i a{_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i))};
+    const __m128i b{_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 1))};
+    const __m128i c{_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i + 2))};
+    const auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(b, c))));
+    if (mask != 0) {
+      return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+  }
+#endif
+  for (; i + 2 < n; i++) {
+    if (p[i] == p[i + 1] && p[i + 1] == p[i + 2]) {
+      return i;
+    }
+  }
+  return n < 2 ? 0 : n - 2;
+}
+
+}// namespace
+
+void RleEncoder::FlushLiteral(std::string& out)
+{
+  if (!literal_.empty()) {
+    AppendVarint(static_cast<uint64_t>(literal_.size()) << 1u, out);
+    out += literal_;
+    literal_.clear();
+  }
+}
+
+void RleEncoder::AppendLiteral(const char* data, size_t n, std::string& out)
+{
+  while (n > 0) {
+    const size_t take{std::min(n, kRleMaxLiteral - literal_.size())};
+    literal_.append(data, take);
+    data += take;
+    n -= take;
+    if (literal_.size() == kRleMaxLiteral) FlushLiteral(out);
+  }
+}
+
+void RleEncoder::CloseRun(std::string& out)
+{
+  if (run_length_ >= kRleMinRun) {
+    FlushLiteral(out);
+    AppendVarint((run_length_ << 1u) | 1u, out);
+    out.push_back(run_byte_);
+  } else {
+    const char bytes[2]{run_byte_, run_byte_};
+    AppendLiteral(bytes, run_length_, out);
+  }
+  run_length_ = 0;
+}
+
+void RleEncoder::Feed(std::string_view chunk, std::string& out)
+{
+  const char* p{chunk.data()};
+  const size_t n{chunk.size()};
+  size_t i{0};
+
+  // The held back run may go on.
+  if (run_length_ > 0) {
+    while (i < n && p[i] == run_byte_) i++;
+    run_length_ += i;
+    if (i == n) {
+      return;
+    }
+    CloseRun(out);
+  }
+
+  while (i < n) {
+    // Everything before the next three equal bytes is literal, except a short run at the end of the chunk.
+    size_t start{FindRunStart(p, i, n)};
+    if (start + 2 >= n) {
+      start = n - 1;
+      while (start > i && p[start - 1] == p[n - 1]) start--;
+    }
+    AppendLiteral(p + i, start - i, out);
+
+    const size_t length{RunLength(p + start, n - start)};
+    run_byte_ = p[start];
+    run_length_ = length;
+    i = start + length;
+    if (i < n) {
+      CloseRun(out);
+    }
+  }
+}
+
+void RleEncoder::Finish(std::string& out)
+{
+  if (run_length_ > 0) {
+    CloseRun(out);
+  }
+  FlushLiteral(out);
+}
+
+namespace {
+
+/// \brief Appends the decoded bytes to a string.
+struct StringSink {
+  std::string& out;
+
+  bool Write(const char* data, size_t n)
+  {
+    out.append(data, n);
+    return true;
+  }
+
+  bool Fill(char byte, uint64_t n)
+  {
+    if (n > out.max_size() - out.size()) {
+      return false;
+    }
+    out.append(static_cast<size_t>(n), byte);
+    return true;
+  }
+};
+
+/// \brief Writes the decoded bytes to a stream, runs in blocks.
+struct StreamSink {
+  std::ostream& out;
+
+  bool Write(const char* data, size_t n)
+  { return static_cast<bool>(out.write(data, static_cast<std::streamsize>(n))); }
+
+  bool Fill(char byte, uint64_t n)
+  {
+    char block[4096];
+    std::fill(block, block + std::min<uint64_t>(n, sizeof(block)), byte);
+    while (n > 0) {
+      const size_t take{static_cast<size_t>(std::min<uint64_t>(n, sizeof(block)))};
+      if (!Write(block, take)) {
+        return false;
+      }
+      n -= take;
+    }
+    return true;
+  }
+};
+
+}// namespace
+
+template<typename Sink>
+bool RleDecoder::FeedPriv(std::string_view chunk, Sink& sink)
+{
+  const char* p{chunk.data()};
+  const size_t n{chunk.size()};
+  size_t i{0};
+
+  while (i < n && !failed_) {
+    switch (state_) {
+      case State::kHeader: {
+        const auto b = static_cast<unsigned char>(p[i++]);
+        if (shift_ > 63 || (shift_ == 63 && (b & 0x7eu) != 0)) {
+          failed_ = true;
+          break;
+        }
+        header_ |= static_cast<uint64_t>(b & 0x7fu) << shift_;
+        shift_ += 7;
+        if (b & 0x80u) {
+          break;
+        }
+        remaining_ = header_ >> 1u;
+        state_ = (header_ & 1u) ? State::kRunByte : State::kLiteral;
+        header_ = 0;
+        shift_ = 0;
+        failed_ = remaining_ == 0 || remaining_ > max_output_ - output_;
+        output_ += remaining_;
+        break;
+      }
+      case State::kLiteral: {
+        const size_t take{static_cast<size_t>(std::min<uint64_t>(remaining_, n - i))};
+        failed_ = !sink.Write(p + i, take);
+        i += take;
+        remaining_ -= take;
+        if (remaining_ == 0) state_ = State::kHeader;
+        break;
+      }
+      case State::kRunByte:
+        failed_ = !sink.Fill(p[i++], remaining_);
+        state_ = State::kHeader;
+        break;
+    }
+  }
+  return !failed_;
+}
+
+bool RleDecoder::Feed(std::string_view chunk, std::string& out)
+{
+  StringSink sink{out};
+  return FeedPriv(chunk, sink);
+}
+
+bool RleDecoder::Feed(std::string_view chunk, std::ostream& out)
+{
+  StreamSink sink{out};
+  return FeedPriv(chunk, sink);
+}
+
+std::string RleEncode(std::string_view data)
+{
+  std::string out;
+  RleEncoder encoder;
+  encoder.Feed(data, out);
+  encoder.Finish(out);
+  return out;
+}
+
+bool RleDecode(std::string_view encoded, std::string& out, uint64_t max_output)
+{
+  out.clear();
+  RleDecoder decoder{max_output};
+  return decoder.Feed(encoded, out) && decoder.Finish();
+}
+
+bool RleEncode(std::istream& in, std::ostream& out, size_t chunk_bytes)
+{
+  std::string chunk(std::max<size_t>(chunk_bytes, 1), '\0');
+  std::string encoded;
+  RleEncoder encoder;
+  while (in) {
+    in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    encoder.Feed(std::string_view(chunk.data(), static_cast<size_t>(in.gcount())), encoded);
+    if (!out.write(encoded.data(), static_cast<std::streamsize>(encoded.size()))) {
+      return false;
+    }
+    encoded.clear();
+  }
+  encoder.Finish(encoded);
+  out.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+  return in.eof() && static_cast<bool>(out);
+}
+
+bool RleDecode(std::istream& in, std::ostream& out, size_t chunk_bytes)
+{
+  std::string chunk(std::max<size_t>(chunk_bytes, 1), '\0');
+  RleDecoder decoder;
+  while (in) {
+    in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    if (!decoder.Feed(std::string_view(chunk.data(), static_cast<size_t>(in.gcount())), out)) {
+      return false;
+    }
+  }
+  return in.eof() && decoder.Finish();
+}
+
 bool HasUniqueChars(const std::string& str)
 {
   std::vector<int> visited(255, 0);
@@ -231,28 +1739,262 @@ bool HasUniqueChars(const std::string& str)
 
 namespace metric {
 
+namespace {
+
+constexpr size_t kWordBits{64};
+
+/// \brief Bit masks of a pattern of at most 64 characters: bit i of peq[c] is set if pattern[i] == c.
+struct MyersPattern {
+  explicit MyersPattern(const std::string& pattern) : m(pattern.size())
+  {
+    for (size_t i = 0; i < m; i++) {
+      peq[static_cast<unsigned char>(pattern[i])] |= uint64_t{1} << i;
+    }
+  }
+
+  uint64_t peq[256]{};
+  size_t m;
+};
+
+/// \brief Distance between a pattern of 1 to 64 characters and text, one column of the DP matrix per step. Stops when
+/// the distance must be greater than max_distance (if non-negative) and returns max_distance + 1.
+int MyersWord(const MyersPattern& pattern, const std::string& text, int max_distance)
+{
+  const uint64_t last{uint64_t{1} << (pattern.m - 1)};
+  const size_t n{text.size()};
+  uint64_t vp{~uint64_t{0}};
+  uint64_t vn{0};
+  auto score = static_cast<long long>(pattern.m);
+
+  for (size_t j = 0; j < n; j++) {
+    const uint64_t eq{pattern.peq[static_cast<unsigned char>(text[j])]};
+    const uint64_t xv{eq | vn};
+    const uint64_t xh{(((eq & vp) + vp) ^ vp) | eq};
+    uint64_t hp{vn | ~(xh | vp)};
+    uint64_t hn{vp & xh};
+    score += static_cast<long long>((hp & last) != 0) - static_cast<long long>((hn & last) != 0);
+    // The top row grows by one per column.
+    hp = (hp << 1u) | 1u;
+    hn <<= 1u;
+    vp = hn | ~(xv | hp);
+    vn = hp & xv;
+
+    // Every remaining column lowers the score by at most one.
+    if (max_distance >= 0 && score - static_cast<long long>(n - j - 1) > max_distance) {
+      return max_distance + 1;
+    }
+  }
+  return max_distance >= 0 ? static_cast<int>(std::min<long long>(score, max_distance + 1)) : static_cast<int>(score);
+}
+
+/// \brief Myers for patterns longer than 64 characters, the blocks of 64 rows pass their horizontal delta down.
+int MyersBlocks(const std::string& pattern, const std::string& text, int max_distance)
+{
+  const size_t m{pattern.size()};
+  const size_t n{text.size()};
+  const size_t blocks{(m + kWordBits - 1) / kWordBits};
+  std::vector<uint64_t> peq(blocks * 256, 0);
+  for (size_t i = 0; i < m; i++) {
+    peq[(i / kWordBits) * 256 + static_cast<unsigned char>(pattern[i])] |= uint64_t{1} << (i % kWordBits);
+  }
+  std::vector<uint64_t> vp(blocks, ~uint64_t{0});
+  std::vector<uint64_t> vn(blocks, 0);
+  const uint64_t last{uint64_t{1} << ((m - 1) % kWordBits)};
+  auto score = static_cast<long long>(m);
+
+  for (size_t j = 0; j < n; j++) {
+    const auto c = static_cast<unsigned char>(text[j]);
+    int hin{1};
+    for (size_t b = 0; b < blocks; b++) {
+      uint64_t eq{peq[b * 256 + c]};
+      const uint64_t hin_neg{hin < 0 ? uint64_t{1} : 0};
+      const uint64_t xv{eq | vn[b]};
+      eq |= hin_neg;
+      const uint64_t xh{(((eq & vp[b]) + vp[b]) ^ vp[b]) | eq};
+      uint64_t hp{vn[b] | ~(xh | vp[b])};
+      uint64_t hn{vp[b] & xh};
+      const uint64_t out_bit{b + 1 == blocks ? last : uint64_t{1} << 63u};
+      const int hout{static_cast<int>((hp & out_bit) != 0) - static_cast<int>((hn & out_bit) != 0)};
+      hp = (hp << 1u) | (hin > 0 ? uint64_t{1} : 0);
+      hn = (hn << 1u) | hin_neg;
+      vp[b] = hn | ~(xv | hp);
+      vn[b] = hp & xv;
+      hin = hout;
+    }
+    score += hin;
+
+    if (max_distance >= 0 && score - static_cast<long long>(n - j - 1) > max_distance) {
+      return max_distance + 1;
+    }
+  }
+  return max_distance >= 0 ? static_cast<int>(std::min<long long>(score, max_distance + 1)) : static_cast<int>(score);
+}
+
+/// \brief DP restricted to the cells within max_distance of the diagonal, cells outside the band are more than
+/// max_distance anyway. Stops when a whole column of the band exceeds max_distance.
+int BandedLevenshtein(const std::string& word_a, const std::string& word_b, int max_distance)
+{
+  const size_t m{word_a.size()};
+  const size_t n{word_b.size()};
+  const auto k = static_cast<size_t>(max_distance);
+  const int inf{max_distance + 1};
+
+  std::vector<int> prev(m + 1), cur(m + 1);
+  for (size_t i = 0; i <= m; i++) prev[i] = i <= k ? static_cast<int>(i) : inf;
+
+  for (size_t j = 1; j <= n; j++) {
+    const size_t lo{j > k ? j - k : 1};
+    const size_t hi{std::min(m, j + k)};
+    cur[lo - 1] = lo == 1 && j <= k ? static_cast<int>(j) : inf;
+    int column_min{cur[lo - 1]};
+
+    for (size_t i = lo; i <= hi; i++) {
+      const int cost{word_a[i - 1] == word_b[j - 1] ? 0 : 1};
+      const int d{std::min({prev[i] + 1, cur[i - 1] + 1, prev[i - 1] + cost})};
+      cur[i] = std::min(d, inf);
+      column_min = std::min(column_min, cur[i]);
+    }
+    // The cell below the band is read by the next column.
+    if (hi < m) cur[hi + 1] = inf;
+
+    if (column_min > max_distance) {
+      return inf;
+    }
+    std::swap(prev, cur);
+  }
+  return prev[m];
+}
+
+/// \brief Distance with the shorter word as pattern, max_distance < 0 means no cutoff.
+int MyersDistance(const std::string& word_a, const std::string& word_b, int max_distance)
+{
+  const std::string& pattern{word_a.size() <= word_b.size() ? word_a : word_b};
+  const std::string& text{word_a.size() <= word_b.size() ? word_b : word_a};
+  if (pattern.empty()) {
+    const auto d = static_cast<int>(text.size());
+    return max_distance >= 0 ? std::min(d, max_distance + 1) : d;
+  }
+  if (pattern.size() <= kWordBits) {
+    return MyersWord(MyersPattern(pattern), text, max_distance);
+  }
+  return MyersBlocks(pattern, text, max_distance);
+}
+
+#ifdef ALGO_SIMD_X86
+/// \brief MyersWord for four texts at once, one per 64-bit lane.
+ALGO_TARGET_AVX2 void MyersWordAvx2(const MyersPattern& pattern, const std::string* const texts[4], int out[4])
+{
+  const __m256i ones{_mm256_set1_epi64x(-1)};
+  const __m256i one{_mm256_set1_epi64x(1)};
+  const __m128i shift{_mm_cvtsi32_si128(static_cast<int>(pattern.m - 1))};
+  const __m256i lengths{_mm256_set_epi64x(static_cast<long long>(texts[3]->size()),
+                                          static_cast<long long>(texts[2]->size()),
+                                          static_cast<long long>(texts[1]->size()),
+                                          static_cast<long long>(texts[0]->size()))};
+  size_t n{0};
+  for (size_t l = 0; l < 4; l++) n = std::max(n, texts[l]->size());
+
+  __m256i vp{ones};
+  __m256i vn{_mm256_setzero_si256()};
+  __m256i score{_mm256_set1_epi64x(static_cast<long long>(pattern.m))};
+  const auto* peq = reinterpret_cast<const long long*>(pattern.peq);
+
+  for (size_t j = 0; j < n; j++) {
+    long long c[4];
+    for (size_t l = 0; l < 4; l++) {
+      c[l] = j < texts[l]->size() ? static_cast<unsigned char>((*texts[l])[j]) : 0;
+    }
+    const __m256i active{_mm256_cmpgt_epi64(lengths, _mm256_set1_epi64x(static_cast<long long>(j)))};
+    const __m256i eq{_mm256_i64gather_epi64(peq, _mm256_set_epi64x(c[3], c[2], c[1], c[0]), 8)};
+
+    const __m256i xv{_mm256_or_si256(eq, vn)};
+    const __m256i sum{_mm256_add_epi64(_mm256_and_si256(eq, vp), vp)};
+    const __m256i xh{_mm256_or_si256(_mm256_xor_si256(sum, vp), eq)};
+    __m256i hp{_mm256_or_si256(vn, _mm256_xor_si256(_mm256_or_si256(xh, vp), ones))};
+    __m256i hn{_mm256_and_si256(vp, xh)};
+
+    const __m256i delta{_mm256_sub_epi64(_mm256_and_si256(_mm256_srl_epi64(hp, shift), one),
+                                         _mm256_and_si256(_mm256_srl_epi64(hn, shift), one))};
+    score = _mm256_add_epi64(score, _mm256_and_si256(delta, active));
+
+    hp = _mm256_or_si256(_mm256_slli_epi64(hp, 1), one);
+    hn = _mm256_slli_epi64(hn, 1);
+    const __m256i new_vp{_mm256_or_si256(hn, _mm256_xor_si256(_mm256_or_si256(xv, hp), ones))};
+    const __m256i new_vn{_mm256_and_si256(hp, xv)};
+    vp = _mm256_blendv_epi8(vp, new_vp, active);
+    vn = _mm256_blendv_epi8(vn, new_vn, active);
+  }
+
+  long long res[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(res), score);
+  for (size_t l = 0; l < 4; l++) out[l] = static_cast<int>(res[l]);
+}
+#endif
+
+}// namespace
+
 int Levenshtein(const std::string& word_a, const std::string& word_b)
+{ return MyersDistance(word_a, word_b, -1); }
+
+int LevenshteinBounded(const std::string& word_a, const std::string& word_b, int max_distance)
 {
-  size_t a_size{word_a.length()};
-  size_t b_size{word_b.length()};
+  if (max_distance < 0) {
+    return -1;
+  }
+  const size_t m{std::min(word_a.size(), word_b.size())};
+  const size_t n{std::max(word_a.size(), word_b.size())};
+  if (n - m > static_cast<size_t>(max_distance)) {
+    return max_distance + 1;
+  }
+  // Both are linear in n, a band cell costs about as much as an eighth of a 64-row block.
+  const size_t blocks{(m + kWordBits - 1) / kWordBits};
+  if (blocks > 1 && 2 * static_cast<size_t>(max_distance) + 1 < 8 * blocks) {
+    return BandedLevenshtein(word_a, word_b, max_distance);
+  }
+  return MyersDistance(word_a, word_b, max_distance);
+}
 
-  std::vector<std::vector<int>> d(a_size + 1, std::vector<int>(b_size + 1, 0));
-  d[0][0] = 0;
+std::vector<int> LevenshteinBatch(const std::string& query, const std::vector<std::string>& candidates,
+                                  int max_distance)
+{
+  std::vector<int> res(candidates.size());
+  const auto clamp = [max_distance](int d) { return max_distance >= 0 ? std::min(d, max_distance + 1) : d; };
 
-  for (size_t i = 1; i < a_size + 1; i++) d[i][0] = i;
-  for (size_t j = 1; j < b_size + 1; j++) d[0][j] = j;
+  if (query.empty() || query.size() > kWordBits) {
+    for (size_t i = 0; i < candidates.size(); i++) {
+      res[i] = max_distance >= 0 ? LevenshteinBounded(query, candidates[i], max_distance)
+                                 : Levenshtein(query, candidates[i]);
+    }
+    return res;
+  }
 
-  for (size_t j = 1; j < b_size + 1; j++) {
-    for (size_t i = 1; i < a_size + 1; i++) {
-      int cost{1};
-      if (word_a[i - 1] == word_b[j - 1]) {
-        cost = 0;
-      }
+  const MyersPattern pattern{query};
+  size_t i{0};
+#ifdef ALGO_SIMD_X86
+  if (simd::HasAvx2()) {
+    // Similar lengths in a group keep the lanes busy.
+    std::vector<size_t> order(candidates.size());
+    for (size_t k = 0; k < order.size(); k++) order[k] = k;
+    std::sort(order.begin(), order.end(),
+              [&candidates](size_t a, size_t b) { return candidates[a].size() < candidates[b].size(); });
 
-      d[i][j] = std::min(d[i - 1][j] + 1, std::min(d[i][j - 1] + 1, d[i - 1][j - 1] + cost));
+    for (; i + 4 <= order.size(); i += 4) {
+      const std::string* texts[4]{&candidates[order[i]], &candidates[order[i + 1]], &candidates[order[i + 2]],
+                                  &candidates[order[i + 3]]};
+      int out[4];
+      MyersWordAvx2(pattern, texts, out);
+      for (size_t l = 0; l < 4; l++) res[order[i + l]] = clamp(out[l]);
+    }
+    for (; i < order.size(); i++) {
+      res[order[i]] = MyersWord(pattern, candidates[order[i]], max_distance);
     }
+    return res;
   }
-  return d[a_size][b_size];
+#endif
+  for (; i < candidates.size(); i++) {
+    res[i] = MyersWord(pattern, candidates[i], max_distance);
+  }
+  return res;
 }
 
 int Hamming(const std::string& word_a, const std::string& word_b)
@@ -271,60 +2013,123 @@ int Hamming(const std::string& word_a, const std::string& word_b)
   return counter;
 }
 
-double Dice(const std::string& word_a, const std::string& word_b)
+namespace {
+
+/// Words up to this length are scored without heap allocation.
+constexpr size_t kStackWord{128};
+
+inline size_t BigramCount(const std::string& word)
+{ return word.size() > 1 ? word.size() - 1 : 0; }
+
+/// \brief Bigram i of word packed in 16 bits.
+inline uint16_t Bigram(const std::string& word, size_t i)
 {
-  std::vector<std::string> bigrams_a, bigrams_b;
+  return static_cast<uint16_t>((static_cast<unsigned>(static_cast<unsigned char>(word[i])) << 8u)
+                               | static_cast<unsigned char>(word[i + 1]));
+}
 
-  for (size_t i = 0; i < word_a.size() - 1; i++) {
-    std::string str{word_a[i], word_a[i + 1]};
-    bigrams_a.emplace_back(str);
-  }
-  for (size_t i = 0; i < word_b.size() - 1; i++) {
-    std::string str{word_b[i], word_b[i + 1]};
-    bigrams_b.emplace_back(str);
+/// \brief Sorted bigrams of word, in stack if they fit, otherwise in heap.
+/// \return Pointer to the bigrams.
+uint16_t* SortedBigrams(const std::string& word, uint16_t (&stack)[kStackWord], std::vector<uint16_t>& heap)
+{
+  const size_t n{BigramCount(word)};
+  uint16_t* bigrams{stack};
+  if (n > kStackWord) {
+    heap.resize(n);
+    bigrams = heap.data();
   }
-  // Find the intersect of bigrams
+  for (size_t i = 0; i < n; i++) bigrams[i] = Bigram(word, i);
+  std::sort(bigrams, bigrams + n);
+  return bigrams;
+}
+
+}// namespace
+
+double Dice(const std::string& word_a, const std::string& word_b)
+{
+  const size_t size_a{BigramCount(word_a)};
+  const size_t size_b{BigramCount(word_b)};
+  uint16_t stack[kStackWord];
+  std::vector<uint16_t> heap;
+  const uint16_t* bigrams_b{SortedBigrams(word_b, stack, heap)};
+
+  // Bigrams of a, duplicates included, that occur anywhere in b.
   int intersect{0};
-  for (const auto& bigram : bigrams_a) {
-    if (find(bigrams_b.begin(), bigrams_b.end(), bigram) != bigrams_b.end()) {
+  for (size_t i = 0; i < size_a; i++) {
+    if (std::binary_search(bigrams_b, bigrams_b + size_b, Bigram(word_a, i))) {
       intersect++;
     }
   }
   // Compute score
-  return 2.0 * intersect / static_cast<double>(bigrams_a.size() + bigrams_b.size());
+  return 2.0 * intersect / static_cast<double>(size_a + size_b);
 }
 
 namespace {
 
-constexpr auto Jaro = [](const std::string& word_a, const std::string& word_b) {
-  double max_dist = std::floor(std::max(word_a.size(), word_b.size()) / 2.0) - 1.0;
-  std::string wa{word_a}, wb{word_b};
+inline size_t CountTrailingZeros(uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_ctzll(x));
+#else
+  size_t n{0};
+  for (; (x & 1u) == 0; x >>= 1u) n++;
+  return n;
+#endif
+}
 
-  if (word_b.size() < word_a.size()) {
-    wa = word_b;
-    wb = word_a;
+/// \brief Each character of the shorter word is matched with the first equal character of the longer word within
+/// max_dist positions, and a match counts as transposed if it lies to the left of the character.
+double Jaro(const std::string& word_a, const std::string& word_b)
+{
+  const double max_dist{std::floor(std::max(word_a.size(), word_b.size()) / 2.0) - 1.0};
+  const std::string& wa{word_b.size() < word_a.size() ? word_b : word_a};
+  const std::string& wb{word_b.size() < word_a.size() ? word_a : word_b};
+  if (max_dist < 0 || wa.empty()) {
+    return 0.0;
   }
-  std::vector<std::pair<int, int>> match;
-  for (int i = 0; i < static_cast<int>(wa.size()); i++) {
-    for (int j = 0; j < static_cast<int>(wb.size()); j++) {
-      if (wa[i] == wb[j] && std::abs(i - j) <= max_dist) {
-        match.emplace_back(std::make_pair(i, j));
-        break;
+  const auto window = static_cast<size_t>(max_dist);
+  size_t matches{0};
+  size_t transposed{0};
+
+  if (wb.size() <= 64) {
+    // The positions of each character of wb as bits, the first match in the window is the lowest bit.
+    uint64_t positions[256]{};
+    for (size_t j = 0; j < wb.size(); j++) {
+      positions[static_cast<unsigned char>(wb[j])] |= uint64_t{1} << j;
+    }
+    for (size_t i = 0; i < wa.size(); i++) {
+      const size_t lo{i > window ? i - window : 0};
+      const size_t hi{std::min(i + window, wb.size() - 1)};
+      if (lo > hi) continue;
+      const uint64_t below_hi{hi == 63 ? ~uint64_t{0} : (uint64_t{1} << (hi + 1)) - 1};
+      const uint64_t in_window{below_hi & ~((uint64_t{1} << lo) - 1)};
+      const uint64_t candidates{positions[static_cast<unsigned char>(wa[i])] & in_window};
+      if (candidates != 0) {
+        matches++;
+        transposed += i > CountTrailingZeros(candidates);
       }
     }
-  }
-  auto m = static_cast<double>(match.size());
-  double t{0.0};
-  for (const auto& mt : match) {
-    if (mt.first > mt.second) {
-      t += 1.0;
+  } else {
+    for (size_t i = 0; i < wa.size(); i++) {
+      const size_t lo{i > window ? i - window : 0};
+      const size_t hi{std::min(i + window + 1, wb.size())};
+      for (size_t j = lo; j < hi; j++) {
+        if (wa[i] == wb[j]) {
+          matches++;
+          transposed += i > j;
+          break;
+        }
+      }
     }
   }
-  if (m == 0) {
+
+  if (matches == 0) {
     return 0.0;
   }
+  const auto m = static_cast<double>(matches);
+  const auto t = static_cast<double>(transposed);
   return 1.0 / 3.0 * (m / wa.size() + m / wb.size() + (m - t) / m);
-};
+}
 
 }// namespace
 
@@ -348,5 +2153,166 @@ double JaroWinkler(const std::string& word_a, const std::string& word_b)
   return jaro + l * kP * (1.0 - jaro);
 }
 
+/////////////////////////////////////////////
+/// Similarity search
+/////////////////////////////////////////////
+
+SimilarityIndex::SimilarityIndex(std::vector<std::string> entries) : entries_(std::move(entries))
+{
+  const size_t n{entries_.size()};
+  bigram_counts_.resize(n);
+  by_length_.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    bigram_counts_[i] = static_cast<uint32_t>(BigramCount(entries_[i]));
+    by_length_[i] = static_cast<uint32_t>(i);
+  }
+  std::stable_sort(by_length_.begin(), by_length_.end(),
+                   [this](uint32_t a, uint32_t b) { return entries_[a].size() < entries_[b].size(); });
+
+  // Each entry is posted once per distinct bigram. Filling in length order sorts the postings by bigram count.
+  uint16_t stack[kStackWord];
+  std::vector<uint16_t> heap;
+  auto for_each_distinct = [&](uint32_t id, auto&& f) {
+    const uint16_t* bigrams{SortedBigrams(entries_[id], stack, heap)};
+    const size_t count{bigram_counts_[id]};
+    for (size_t k = 0; k < count; k++) {
+      if (k == 0 || bigrams[k] != bigrams[k - 1]) f(bigrams[k]);
+    }
+  };
+
+  post_begin_.assign((1u << 16u) + 1, 0);
+  for (uint32_t id : by_length_) {
+    for_each_distinct(id, [this](uint16_t g) { post_begin_[g + 1]++; });
+  }
+  for (size_t g = 0; g < (1u << 16u); g++) post_begin_[g + 1] += post_begin_[g];
+  postings_.resize(post_begin_.back());
+  std::vector<uint32_t> cursor(post_begin_.begin(), post_begin_.end() - 1);
+  for (uint32_t id : by_length_) {
+    for_each_distinct(id, [&](uint16_t g) { postings_[cursor[g]++] = id; });
+  }
+}
+
+std::vector<SimilarityHit> SimilarityIndex::SearchDice(const std::string& query, double threshold,
+                                                       Scratch& scratch) const
+{
+  std::vector<SimilarityHit> hits;
+  const size_t nq{BigramCount(query)};
+  if (nq == 0) {
+    return hits;// Scores are 0 or undefined.
+  }
+
+  // Shared bigrams are at most nq, so 2 * nq / (nq + nb) >= threshold bounds the bigrams nb of an entry.
+  const double max_bigrams{static_cast<double>(nq) * (2.0 - threshold) / threshold};
+  const auto bound = static_cast<uint32_t>(std::clamp(max_bigrams + 1e-9, 0.0, 4294967295.0));
+
+  scratch.shared.resize(entries_.size(), 0);
+  uint16_t stack[kStackWord];
+  std::vector<uint16_t> heap;
+  const uint16_t* bigrams{SortedBigrams(query, stack, heap)};
+
+  for (size_t k = 0; k < nq;) {
+    // A query bigram counts once per occurrence in the query.
+    size_t end{k + 1};
+    while (end < nq && bigrams[end] == bigrams[k]) end++;
+    const auto weight = static_cast<uint32_t>(end - k);
+
+    const auto first = postings_.begin() + post_begin_[bigrams[k]];
+    const auto last = std::upper_bound(first, postings_.begin() + post_begin_[bigrams[k] + 1], bound,
+                                       [this](uint32_t b, uint32_t id) { return b < bigram_counts_[id]; });
+    for (auto it = first; it != last; ++it) {
+      if (scratch.shared[*it] == 0) scratch.touched.push_back(*it);
+      scratch.shared[*it] += weight;
+    }
+    k = end;
+  }
+
+  // The counts are the intersections of Dice, so the scores are exact.
+  for (uint32_t id : scratch.touched) {
+    const int intersect{static_cast<int>(scratch.shared[id])};
+    const double score{2.0 * intersect / static_cast<double>(nq + bigram_counts_[id])};
+    if (score >= threshold) hits.push_back({id, score});
+    scratch.shared[id] = 0;
+  }
+  scratch.touched.clear();
+  std::sort(hits.begin(), hits.end(), [](const auto& a, const auto& b) { return a.index < b.index; });
+  return hits;
+}
+
+std::vector<SimilarityHit> SimilarityIndex::SearchJaroWinkler(const std::string& query, double threshold) const
+{
+  // Jaro is at most (2 + s / l) / 3 for lengths s <= l and the prefix bonus at most 0.4 * (1 - jaro), so a score of
+  // threshold needs s / l >= 5 * threshold - 4.
+  const double ratio{5.0 * threshold - 4.0 - 1e-9};
+  const double q{static_cast<double>(query.size())};
+  size_t min_length{0};
+  size_t max_length{SIZE_MAX};
+  if (ratio > 0) {
+    min_length = static_cast<size_t>(std::ceil(q * ratio));
+    max_length = static_cast<size_t>(std::floor(q / ratio));
+  }
+
+  auto length_less = [this](uint32_t id, size_t length) { return entries_[id].size() < length; };
+  const auto first = std::lower_bound(by_length_.begin(), by_length_.end(), min_length, length_less);
+  std::vector<SimilarityHit> hits;
+  for (auto it = first; it != by_length_.end() && entries_[*it].size() <= max_length; ++it) {
+    const double score{JaroWinkler(query, entries_[*it])};
+    if (score >= threshold) hits.push_back({*it, score});
+  }
+  std::sort(hits.begin(), hits.end(), [](const auto& a, const auto& b) { return a.index < b.index; });
+  return hits;
+}
+
+std::vector<SimilarityHit> SimilarityIndex::SearchPriv(const std::string& query, double threshold,
+                                                       Similarity similarity, Scratch& scratch) const
+{
+  if (threshold <= 0.0) {
+    // Nothing to prune.
+    std::vector<SimilarityHit> hits;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      const double score{similarity == Similarity::Dice ? Dice(query, entries_[i]) : JaroWinkler(query, entries_[i])};
+      if (score >= threshold) hits.push_back({i, score});
+    }
+    return hits;
+  }
+  if (similarity == Similarity::Dice) {
+    return SearchDice(query, threshold, scratch);
+  }
+  return SearchJaroWinkler(query, threshold);
+}
+
+std::vector<SimilarityHit> SimilarityIndex::Search(const std::string& query, double threshold,
+                                                   Similarity similarity) const
+{
+  Scratch scratch;
+  return SearchPriv(query, threshold, similarity, scratch);
+}
+
+std::vector<std::vector<SimilarityHit>> SimilarityIndex::Search(const std::vector<std::string>& queries,
+                                                                double threshold, Similarity similarity,
+                                                                unsigned threads) const
+{
+  std::vector<std::vector<SimilarityHit>> res(queries.size());
+  if (threads == 0) {
+    threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  threads = static_cast<unsigned>(std::max<size_t>(std::min<size_t>(threads, queries.size()), 1));
+
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    const size_t begin{queries.size() * t / threads};
+    const size_t end{queries.size() * (t + 1) / threads};
+    workers.emplace_back([this, &queries, &res, threshold, similarity, begin, end]() {
+      Scratch scratch;
+      for (size_t q = begin; q < end; q++) {
+        res[q] = SearchPriv(queries[q], threshold, similarity, scratch);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return res;
+}
+
 }// namespace metric
 }// namespace algo::string
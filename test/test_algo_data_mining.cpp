@@ -6,6 +6,13 @@
 ///
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <queue>
+#include <random>
+#include <thread>
 
 #include "algo.hpp"
 #include "gtest/gtest.h"
@@ -165,6 +172,280 @@ TEST(test_algo_data_mining, kmeans_standard)
   EXPECT_EQ(clusters.size(), 3);
 }
 
+/////////////////////////////////////////////
+/// N-dimensional K-means
+/////////////////////////////////////////////
+
+namespace {
+/// Points around `centers` well separated centers, with the index of the center of each point.
+FeatureMatrix Blobs(size_t n, size_t dims, size_t centers, uint64_t seed, vector<size_t>& truth)
+{
+  mt19937_64 gen(seed);
+  normal_distribution<double> noise(0.0, 1.0);
+  FeatureMatrix data(n, dims);
+  truth.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    truth[i] = i % centers;
+    for (size_t j = 0; j < dims; j++) {
+      const double center{100.0 * static_cast<double>((truth[i] >> j) & 1u) + 10.0 * static_cast<double>(truth[i])};
+      data(i, j) = center + noise(gen);
+    }
+  }
+  return data;
+}
+
+double SquaredDistance(const FeatureMatrix& a, size_t row_a, const FeatureMatrix& b, size_t row_b)
+{
+  double sum{0.0};
+  for (size_t j = 0; j < a.Cols(); j++) {
+    sum += (a(row_a, j) - b(row_b, j)) * (a(row_a, j) - b(row_b, j));
+  }
+  return sum;
+}
+}// namespace
+
+TEST(test_algo_data_mining, feature_matrix_layout)
+{
+  FeatureMatrix m(vector<vector<double>>{{1.0, 2.0, 3.0}, {4.0, 5.0, 6.0}});
+  EXPECT_EQ(m.Rows(), 2);
+  EXPECT_EQ(m.Cols(), 3);
+  EXPECT_EQ(m.Column(1)[0], 2.0);
+  EXPECT_EQ(m.Column(1)[1], 5.0);
+  EXPECT_EQ(m.Row(1), (vector<double>{4.0, 5.0, 6.0}));
+  EXPECT_EQ(FeatureMatrix(vector<vector<double>>{{1.0}, {1.0, 2.0}}).Rows(), 0);
+
+  FeatureMatrix from_points(Points{{1.0, 2.0}, {3.0, 4.0}});
+  EXPECT_EQ(from_points(1, 0), 3.0);
+  EXPECT_EQ(from_points(1, 1), 4.0);
+}
+
+TEST(test_algo_data_mining, feature_matrix_aligned_views)
+{
+  FeatureMatrix m(13, 4);
+  for (size_t i = 0; i < 13; i++) {
+    for (size_t j = 0; j < 4; j++) {
+      m(i, j) = static_cast<double>(10 * i + j);
+    }
+  }
+  EXPECT_EQ(m.Stride(), 16);
+  for (size_t j = 0; j < 4; j++) {
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(m.Column(j)) % FeatureMatrix::kAlignment, 0);
+  }
+
+  // The views read the matrix itself.
+  const FeatureView rows{m.Slice(3, 8)};
+  EXPECT_EQ(rows.Rows(), 5);
+  EXPECT_EQ(rows.Cols(), 4);
+  EXPECT_EQ(rows.Column(2), m.Column(2) + 3);
+  EXPECT_EQ(rows.Row(0), m.Row(3));
+  const FeatureView part{rows.SliceColumns(1, 3).Slice(1, 100)};
+  EXPECT_EQ(part.Rows(), 4);
+  EXPECT_EQ(part.Cols(), 2);
+  EXPECT_EQ(part(0, 0), 41.0);
+  EXPECT_EQ(part(3, 1), 72.0);
+  m(4, 1) = -1.0;
+  EXPECT_EQ(part(0, 0), -1.0);
+  EXPECT_EQ(FeatureView(m).Slice(9, 2).Rows(), 0);
+
+  const FeatureMatrix copy{part};
+  EXPECT_EQ(copy.Rows(), 4);
+  EXPECT_EQ(copy.Row(3), (vector<double>{71.0, 72.0}));
+}
+
+TEST(test_algo_data_mining, views_are_accepted_by_the_algorithms)
+{
+  vector<size_t> truth;
+  const FeatureMatrix data{Blobs(3000, 3, 4, 49, truth)};
+  const FeatureView half{data.Slice(1000, 2500)};
+  const FeatureMatrix copy{half};
+
+  KMeansOptions options;
+  options.seed = 3;
+  EXPECT_EQ(KMeans(half, 4, options).labels, KMeans(copy, 4, options).labels);
+  EXPECT_EQ(DBSCAN(half, DistFunc::Euclidean, 0.5, 5).labels, DBSCAN(copy, DistFunc::Euclidean, 0.5, 5).labels);
+  EXPECT_EQ(KdTree(half).Nearest(data.Slice(0, 10), 3), KdTree(copy).Nearest(data.Slice(0, 10), 3));
+}
+
+TEST(test_algo_data_mining, kmeans_nd_invalid_input)
+{
+  FeatureMatrix data(5, 3);
+  EXPECT_TRUE(KMeans(data, 0).labels.empty());
+  EXPECT_TRUE(KMeans(data, 6).labels.empty());
+  EXPECT_TRUE(KMeans(FeatureMatrix(5, 0), 2).labels.empty());
+  EXPECT_TRUE(KMeans(FeatureMatrix{}, 1).labels.empty());
+
+  // Fewer distinct points than clusters.
+  const KMeansResult res{KMeans(data, 3)};
+  EXPECT_EQ(res.labels.size(), 5);
+  EXPECT_EQ(res.inertia, 0.0);
+  EXPECT_TRUE(res.converged);
+}
+
+TEST(test_algo_data_mining, kmeans_nd_finds_blobs)
+{
+  vector<size_t> truth;
+  const FeatureMatrix data{Blobs(3001, 5, 6, 1, truth)};
+  const KMeansResult res{KMeans(data, 6)};
+  ASSERT_EQ(res.labels.size(), data.Rows());
+  EXPECT_TRUE(res.converged);
+  EXPECT_EQ(res.centroids.Rows(), 6);
+  EXPECT_EQ(res.centroids.Cols(), 5);
+
+  // Each blob is one cluster.
+  vector<int> label_of(6, -1);
+  for (size_t i = 0; i < data.Rows(); i++) {
+    if (label_of[truth[i]] == -1) {
+      label_of[truth[i]] = static_cast<int>(res.labels[i]);
+    }
+    EXPECT_EQ(label_of[truth[i]], static_cast<int>(res.labels[i]));
+  }
+  std::sort(label_of.begin(), label_of.end());
+  EXPECT_EQ(std::unique(label_of.begin(), label_of.end()), label_of.end());
+}
+
+TEST(test_algo_data_mining, kmeans_nd_is_a_fixed_point)
+{
+  vector<size_t> truth;
+  const FeatureMatrix data{Blobs(20000, 3, 12, 2, truth)};
+  KMeansOptions options;
+  options.tolerance = 0.0;
+  options.seed = 7;
+  options.threads = 3;
+  const KMeansResult res{KMeans(data, 12, options)};
+  ASSERT_TRUE(res.converged);
+
+  // Every point is labeled with its nearest centroid and every centroid is the mean of its points.
+  double inertia{0.0};
+  FeatureMatrix sums(12, 3);
+  vector<size_t> counts(12);
+  for (size_t i = 0; i < data.Rows(); i++) {
+    const double own{SquaredDistance(data, i, res.centroids, res.labels[i])};
+    for (size_t c = 0; c < 12; c++) {
+      EXPECT_LE(own, SquaredDistance(data, i, res.centroids, c));
+    }
+    inertia += own;
+    counts[res.labels[i]]++;
+    for (size_t j = 0; j < 3; j++) {
+      sums(res.labels[i], j) += data(i, j);
+    }
+  }
+  EXPECT_NEAR(res.inertia, inertia, 1e-6 * inertia);
+  for (size_t c = 0; c < 12; c++) {
+    ASSERT_GT(counts[c], 0);
+    for (size_t j = 0; j < 3; j++) {
+      EXPECT_NEAR(res.centroids(c, j), sums(c, j) / static_cast<double>(counts[c]), 1e-9);
+    }
+  }
+
+  // The seed decides the result, the number of threads only changes the rounding of the sums.
+  const KMeansResult again{KMeans(data, 12, options)};
+  EXPECT_EQ(again.labels, res.labels);
+  options.threads = 1;
+  EXPECT_EQ(KMeans(data, 12, options).labels, res.labels);
+}
+
+TEST(test_algo_data_mining, kmeans_hamerly_and_elkan_match_lloyd)
+{
+  vector<size_t> truth;
+  FeatureMatrix blobs{Blobs(12000, 4, 16, 3, truth)};
+  FeatureMatrix uniform(9000, 6);
+  mt19937_64 gen(4);
+  uniform_real_distribution<double> unit(0.0, 1.0);
+  for (size_t i = 0; i < uniform.Rows(); i++) {
+    for (size_t j = 0; j < uniform.Cols(); j++) {
+      uniform(i, j) = unit(gen);
+    }
+  }
+
+  // Random points have no ties, and no point is within rounding of one, so the results are the same bits.
+  for (const FeatureMatrix* data : {&blobs, &uniform}) {
+    KMeansOptions options;
+    options.threads = 2;
+    options.max_iterations = 60;
+    options.tolerance = 0.0;
+    const KMeansResult lloyd{KMeans(*data, 40, options)};
+    EXPECT_EQ(lloyd.skipped_distances, 0);
+    EXPECT_EQ(lloyd.distances, (lloyd.iterations + 1) * data->Rows() * 40);
+
+    for (auto algorithm : {KMeansAlgorithm::Hamerly, KMeansAlgorithm::Elkan}) {
+      options.algorithm = algorithm;
+      const KMeansResult res{KMeans(*data, 40, options)};
+      EXPECT_EQ(res.labels, lloyd.labels);
+      EXPECT_EQ(res.iterations, lloyd.iterations);
+      EXPECT_EQ(res.converged, lloyd.converged);
+      EXPECT_EQ(res.inertia, lloyd.inertia);
+      for (size_t c = 0; c < 40; c++) {
+        EXPECT_EQ(res.centroids.Row(c), lloyd.centroids.Row(c));
+      }
+      EXPECT_EQ(res.distances + res.skipped_distances, lloyd.distances);
+      EXPECT_LT(res.distances, lloyd.distances / 2);
+    }
+  }
+}
+
+TEST(test_algo_data_mining, mini_batch_kmeans_streams_blobs)
+{
+  vector<size_t> truth;
+  const FeatureMatrix data{Blobs(30000, 3, 6, 5, truth)};
+  MiniBatchKMeans model(6, 3, 1.0, 11);
+  EXPECT_FALSE(model.Ready());
+  EXPECT_TRUE(model.Predict(data).empty());
+
+  const size_t batch_rows{500};
+  for (size_t first = 0; first < data.Rows(); first += batch_rows) {
+    FeatureMatrix batch(batch_rows, 3);
+    for (size_t i = 0; i < batch_rows; i++) {
+      for (size_t j = 0; j < 3; j++) {
+        batch(i, j) = data(first + i, j);
+      }
+    }
+    model.PartialFit(batch);
+    EXPECT_TRUE(model.Ready());
+  }
+  model.PartialFit(FeatureMatrix(10, 2));// Wrong number of features, ignored.
+
+  double count{0.0};
+  for (double c : model.Counts()) {
+    count += c;
+  }
+  EXPECT_EQ(count, 30000.0);
+
+  // Each blob is one cluster, with the centroid at the blob center.
+  const vector<uint32_t> labels{model.Predict(data)};
+  const FeatureMatrix means{model.Means()};
+  vector<int> label_of(6, -1);
+  for (size_t i = 0; i < data.Rows(); i++) {
+    if (label_of[truth[i]] == -1) {
+      label_of[truth[i]] = static_cast<int>(labels[i]);
+      for (size_t j = 0; j < 3; j++) {
+        const double center{100.0 * static_cast<double>((truth[i] >> j) & 1u) + 10.0 * static_cast<double>(truth[i])};
+        EXPECT_NEAR(means(labels[i], j), center, 0.1);
+      }
+    }
+    EXPECT_EQ(label_of[truth[i]], static_cast<int>(labels[i]));
+  }
+}
+
+TEST(test_algo_data_mining, mini_batch_kmeans_decay_follows_drift)
+{
+  MiniBatchKMeans keep_all(1, 2);
+  MiniBatchKMeans forget(1, 2, 0.5);
+  for (int b = 0; b < 20; b++) {
+    const double x{b < 10 ? 0.0 : 10.0};
+    const FeatureMatrix batch(vector<vector<double>>{{x - 1.0, 1.0}, {x + 1.0, 1.0}, {x, 1.0}});
+    keep_all.PartialFit(batch);
+    forget.PartialFit(batch);
+  }
+  EXPECT_NEAR(keep_all.Means()(0, 0), 5.0, 1e-9);
+  EXPECT_NEAR(forget.Means()(0, 0), 10.0, 0.01);
+
+  const Centroids centroids{keep_all.ToCentroids()};
+  ASSERT_EQ(centroids.size(), 1);
+  EXPECT_NEAR(centroids[0].p.x, 5.0, 1e-9);
+  EXPECT_NEAR(centroids[0].mean_y, 1.0, 1e-9);
+  EXPECT_EQ(centroids[0].size, 60);
+}
+
 /////////////////////////////////////////////
 /// KNN
 /////////////////////////////////////////////
@@ -254,6 +535,403 @@ TEST(test_algo_data_mining, knn_standard)
   });
 }
 
+TEST(test_algo_data_mining, knn_does_not_change_labeled_data)
+{
+  Points unlabeled_data{{0.1, 0.1}, {0.9, 0.9}, {0.55, 0.55}};
+  const LabeledPoints labeled_points{
+      {0.0, 0.0, 0.0, "B"}, {0.2, 0.2, 0.0, "B"}, {1.0, 1.0, 0.0, "A"}, {0.8, 0.8, 0.0, "A"}, {0.4, 0.4, 0.0, "B"}};
+  const LabeledPoints copy{labeled_points};
+
+  const LabeledPoints classified{KNearestNeighbor(unlabeled_data, labeled_points, 2)};
+  ASSERT_EQ(classified.size(), 3);
+  EXPECT_EQ(classified[0].label, "B");
+  EXPECT_EQ(classified[1].label, "A");
+  EXPECT_EQ(classified[2].label, "A");// One A and one B, the tie goes to A.
+  for (size_t i = 0; i < copy.size(); i++) {
+    EXPECT_EQ(labeled_points[i].x, copy[i].x);
+    EXPECT_EQ(labeled_points[i].label, copy[i].label);
+  }
+}
+
+TEST(test_algo_data_mining, data_frame_labels)
+{
+  const LabeledPoints points{{0.0, 0.0, 0.0, "b"}, {1.0, 0.0, 0.0, "a"}, {2.0, 0.0, 0.0, "b"}};
+  DataFrame frame{points};
+  EXPECT_EQ(frame.Rows(), 3);
+  EXPECT_EQ(frame.Cols(), 2);
+  EXPECT_EQ(frame.Labels(), (vector<uint32_t>{0, 1, 0}));
+  EXPECT_EQ(frame.Dictionary(), (vector<string>{"b", "a"}));
+  EXPECT_EQ(frame.Label(1), "a");
+  EXPECT_EQ(frame.Features()(2, 0), 2.0);
+  frame.SetLabel(0, "c");
+  EXPECT_EQ(frame.Labels(), (vector<uint32_t>{2, 1, 0}));
+  EXPECT_EQ(frame.Code("a"), 1);
+  EXPECT_EQ(frame.Slice(1, 3).Row(0), (vector<double>{1.0, 0.0}));
+
+  EXPECT_EQ(DataFrame(FeatureMatrix(2, 3), {"x"}).Rows(), 0);
+  const DataFrame named(FeatureMatrix(2, 3), {"x", "y"});
+  EXPECT_EQ(named.Label(1), "y");
+  EXPECT_EQ(named.Cols(), 3);
+
+  // The rows of a new frame have the empty name until they are labeled.
+  DataFrame unlabeled(3, 2);
+  EXPECT_EQ(unlabeled.Dictionary(), (vector<string>{""}));
+  EXPECT_EQ(unlabeled.Label(2), "");
+  unlabeled.SetLabel(2, "z");
+  EXPECT_EQ(unlabeled.Labels(), (vector<uint32_t>{0, 0, 1}));
+  EXPECT_EQ(unlabeled.Label(2), "z");
+}
+
+TEST(test_algo_data_mining, knn_data_frame)
+{
+  // Labeled corners of a cube, a query next to each label and one halfway between "a" and "b".
+  const FeatureMatrix corners(vector<vector<double>>{{0, 0, 0}, {0, 0, 0.1}, {1, 1, 1}, {1, 1, 0.9}, {0, 1, 0}});
+  const DataFrame labeled(corners, {"b", "b", "c", "c", "a"});
+  const FeatureMatrix queries(vector<vector<double>>{{0.1, 0, 0}, {0.9, 1, 1}, {0, 0.9, 0}, {0, 0.5, 0}});
+
+  EXPECT_EQ(KNearestNeighbor(labeled, queries, 1), (vector<uint32_t>{0, 1, 2, 0}));
+  // With 3 neighbors the two "b" corners outvote "a" for the query next to "a".
+  const vector<uint32_t> three{KNearestNeighbor(labeled, queries, 3, 2)};
+  EXPECT_EQ(three, (vector<uint32_t>{0, 1, 0, 0}));
+  // Two neighbors of the halfway query: a and b tie, a comes first.
+  EXPECT_EQ(KNearestNeighbor(labeled, queries.Slice(3, 4), 2), (vector<uint32_t>{2}));
+  EXPECT_EQ(KNearestNeighbor(labeled, queries, 100).size(), 4);
+
+  EXPECT_TRUE(KNearestNeighbor(labeled, queries, 0).empty());
+  EXPECT_TRUE(KNearestNeighbor(labeled, FeatureMatrix(2, 2), 1).empty());
+  EXPECT_TRUE(KNearestNeighbor(DataFrame{}, queries, 1).empty());
+}
+
+/////////////////////////////////////////////
+/// K-d tree
+/////////////////////////////////////////////
+
+TEST(test_algo_data_mining, kd_tree_against_brute_force)
+{
+  mt19937_64 gen(45);
+  for (size_t dims : {1, 2, 3, 8}) {
+    // Points on a coarse grid, so there are many equal distances.
+    FeatureMatrix data(2000, dims);
+    FeatureMatrix queries(50, dims);
+    for (size_t j = 0; j < dims; j++) {
+      for (size_t i = 0; i < data.Rows(); i++) {
+        data(i, j) = static_cast<double>(gen() % 20);
+      }
+      for (size_t i = 0; i < queries.Rows(); i++) {
+        queries(i, j) = static_cast<double>(gen() % 40) * 0.5;
+      }
+    }
+    const KdTree tree{data, 8};
+    EXPECT_EQ(tree.Size(), 2000);
+    EXPECT_EQ(tree.Dims(), dims);
+
+    for (size_t k : {1, 7, 100}) {
+      const auto batch = tree.Nearest(queries, k, 3);
+      ASSERT_EQ(batch.size(), queries.Rows());
+      for (size_t q = 0; q < queries.Rows(); q++) {
+        vector<pair<double, uint32_t>> all;
+        for (size_t i = 0; i < data.Rows(); i++) {
+          double dist2{0.0};
+          for (size_t j = 0; j < dims; j++) {
+            dist2 += (data(i, j) - queries(q, j)) * (data(i, j) - queries(q, j));
+          }
+          all.emplace_back(dist2, static_cast<uint32_t>(i));
+        }
+        std::sort(all.begin(), all.end());
+        vector<NeighborHit> expected;
+        for (size_t i = 0; i < k; i++) {
+          expected.push_back(NeighborHit{all[i].second, std::sqrt(all[i].first)});
+        }
+        EXPECT_EQ(batch[q], expected);
+        EXPECT_EQ(tree.Nearest(queries.Row(q).data(), k), expected);
+      }
+    }
+  }
+}
+
+TEST(test_algo_data_mining, kd_tree_edge_cases)
+{
+  const FeatureMatrix same(vector<vector<double>>(100, vector<double>{1.0, 2.0}));
+  const KdTree tree{same, 4};
+  const vector<double> query{0.0, 2.0};
+  const vector<NeighborHit> hits{tree.Nearest(query.data(), 500)};
+  ASSERT_EQ(hits.size(), 100);
+  EXPECT_EQ(hits[0].index, 0);
+  EXPECT_EQ(hits[99].index, 99);
+  EXPECT_EQ(hits[0].distance, 1.0);
+  EXPECT_TRUE(tree.Nearest(query.data(), 0).empty());
+  EXPECT_TRUE(tree.Nearest(FeatureMatrix(3, 5), 1).empty());
+  EXPECT_TRUE(KdTree{FeatureMatrix{}}.Nearest(query.data(), 1).empty());
+}
+
+/////////////////////////////////////////////
+/// HNSW
+/////////////////////////////////////////////
+
+namespace {
+vector<float> RandomVectors(size_t n, size_t dims, uint64_t seed)
+{
+  mt19937_64 gen(seed);
+  normal_distribution<float> normal(0.0f, 1.0f);
+  vector<float> vectors(n * dims);
+  for (float& v : vectors) {
+    v = normal(gen);
+  }
+  return vectors;
+}
+
+/// \brief The share of the true k nearest found by the index.
+double Recall(const HnswIndex& index, const vector<float>& data, const vector<float>& queries, size_t k)
+{
+  const size_t dims{index.Dims()};
+  const size_t n{data.size() / dims};
+  const auto hits = index.SearchBatch(queries.data(), queries.size() / dims, k, 2);
+  size_t found{0};
+  for (size_t q = 0; q < hits.size(); q++) {
+    vector<pair<float, uint32_t>> all;
+    for (size_t i = 0; i < n; i++) {
+      float dist2{0.0f};
+      for (size_t j = 0; j < dims; j++) {
+        dist2 += (data[i * dims + j] - queries[q * dims + j]) * (data[i * dims + j] - queries[q * dims + j]);
+      }
+      all.emplace_back(dist2, static_cast<uint32_t>(i));
+    }
+    std::partial_sort(all.begin(), all.begin() + static_cast<ptrdiff_t>(k), all.end());
+    for (const NeighborHit& hit : hits[q]) {
+      found += std::any_of(all.begin(), all.begin() + static_cast<ptrdiff_t>(k),
+                           [&hit](const pair<float, uint32_t>& p) { return p.second == hit.index; });
+    }
+  }
+  return static_cast<double>(found) / static_cast<double>(hits.size() * k);
+}
+}// namespace
+
+TEST(test_algo_data_mining, hnsw_recall_against_brute_force)
+{
+  const size_t dims{32};
+  const vector<float> data{RandomVectors(1200, dims, 46)};
+  const vector<float> queries{RandomVectors(40, dims, 47)};
+  HnswIndex index(dims, 1200, HnswOptions{12, 64, 64, VectorMetric::L2, 1});
+  EXPECT_EQ(index.AddBatch(data.data(), 1200, 4), 1200);
+  EXPECT_EQ(index.Size(), 1200);
+  EXPECT_GE(Recall(index, data, queries, 10), 0.9);
+
+  // A vector of the index finds itself first.
+  const vector<NeighborHit> self{index.Search(data.data() + 123 * dims, 3)};
+  ASSERT_EQ(self.size(), 3);
+  EXPECT_EQ(self[0].index, 123);
+  EXPECT_EQ(self[0].distance, 0.0);
+  EXPECT_LE(self[1].distance, self[2].distance);
+}
+
+TEST(test_algo_data_mining, hnsw_concurrent_add)
+{
+  const size_t dims{16};
+  const vector<float> data{RandomVectors(1200, dims, 48)};
+  HnswIndex index(dims, 1000, HnswOptions{8, 64});
+  vector<thread> workers;
+  vector<long long> ids(1200);
+  for (size_t t = 0; t < 4; t++) {
+    workers.emplace_back([&, t]() {
+      for (size_t i = t; i < 1200; i += 4) {
+        ids[i] = index.Add(data.data() + i * dims);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  // Exactly capacity vectors got an id, each id once, the rest -1.
+  EXPECT_EQ(index.Size(), 1000);
+  EXPECT_EQ(std::count(ids.begin(), ids.end(), -1), 200);
+  vector<float> added(1000 * dims);
+  vector<bool> seen(1000);
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (ids[i] >= 0) {
+      const auto id = static_cast<size_t>(ids[i]);
+      ASSERT_FALSE(seen[id]);
+      seen[id] = true;
+      std::copy(data.begin() + i * dims, data.begin() + (i + 1) * dims, added.begin() + id * dims);
+    }
+  }
+  const vector<float> queries{RandomVectors(40, dims, 49)};
+  EXPECT_GE(Recall(index, added, queries, 5), 0.9);
+  EXPECT_EQ(index.Add(data.data()), -1);
+  EXPECT_EQ(index.AddBatch(data.data(), 10), 0);
+}
+
+TEST(test_algo_data_mining, hnsw_inner_product)
+{
+  // Unit vectors, so the inner product gives the same order as the Euclidean distance.
+  const size_t dims{24};
+  vector<float> data{RandomVectors(600, dims, 49)};
+  for (size_t i = 0; i < 600; i++) {
+    float norm{0.0f};
+    for (size_t j = 0; j < dims; j++) {
+      norm += data[i * dims + j] * data[i * dims + j];
+    }
+    for (size_t j = 0; j < dims; j++) {
+      data[i * dims + j] /= std::sqrt(norm);
+    }
+  }
+  HnswIndex index(dims, 600, HnswOptions{12, 64, 64, VectorMetric::InnerProduct});
+  index.AddBatch(data.data(), 600, 1);
+  const vector<float> queries(data.begin(), data.begin() + 40 * dims);
+  EXPECT_GE(Recall(index, data, queries, 5), 0.9);
+  const vector<NeighborHit> self{index.Search(data.data() + 7 * dims, 1)};
+  ASSERT_EQ(self.size(), 1);
+  EXPECT_EQ(self[0].index, 7);
+  EXPECT_NEAR(self[0].distance, 0.0, 1e-5);
+}
+
+TEST(test_algo_data_mining, hnsw_save_load)
+{
+  const size_t dims{8};
+  const vector<float> data{RandomVectors(500, dims, 50)};
+  HnswIndex index(dims, 600, HnswOptions{6, 40, 20, VectorMetric::L2, 3});
+  index.AddBatch(data.data(), 500, 1);
+
+  const string path{"hnsw_test.bin"};
+  ASSERT_TRUE(index.Save(path));
+  HnswIndex loaded;
+  EXPECT_TRUE(loaded.Search(data.data(), 1).empty());
+  ASSERT_TRUE(loaded.Load(path));
+  EXPECT_EQ(loaded.Capacity(), 500);
+  ASSERT_TRUE(loaded.Load(path, 600));
+  EXPECT_EQ(loaded.Size(), 500);
+  EXPECT_EQ(loaded.Dims(), dims);
+  EXPECT_EQ(loaded.Capacity(), 600);
+  const vector<float> queries{RandomVectors(20, dims, 51)};
+  EXPECT_EQ(loaded.SearchBatch(queries.data(), 20, 5), index.SearchBatch(queries.data(), 20, 5));
+
+  // The loaded index takes more vectors.
+  EXPECT_EQ(loaded.Add(queries.data()), 500);
+  EXPECT_EQ(loaded.Search(queries.data(), 1)[0].index, 500);
+
+  EXPECT_FALSE(loaded.Load("no_such_file.bin"));
+  std::ofstream(path) << "garbage";
+  EXPECT_FALSE(loaded.Load(path));
+  EXPECT_EQ(loaded.Size(), 501);
+
+  // Headers that claim more than the file holds, or sizes that wrap.
+  const auto write_header = [&path](vector<uint64_t> header, size_t extra_bytes) {
+    std::ofstream file(path, std::ios::binary);
+    file.write("ALGOHNS1", 8);
+    file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size() * 8));
+    file << string(extra_bytes, '\0');
+  };
+  write_header({uint64_t{1} << 40u, 0, 0, 6, 40, 20, 0, 3, 0, 0}, 0);
+  EXPECT_FALSE(loaded.Load(path, 1000));
+  write_header({8, 0, 0, 6, 40, 20, 0, 3, 0, 0}, 0);
+  EXPECT_TRUE(HnswIndex{}.Load(path, 10));
+  write_header({4096, 10, 4, 6, 40, 20, 0, 3, 0, 1}, 1000);
+  EXPECT_FALSE(loaded.Load(path));
+  write_header({8, 10, 4, 1000, 40, 20, 0, 3, 0, 1}, 1000);
+  EXPECT_FALSE(loaded.Load(path));
+  write_header({8, 10, 4, uint64_t{1} << 62u, 40, 20, 0, 3, 0, 1}, 1000);
+  EXPECT_FALSE(loaded.Load(path));
+  EXPECT_EQ(loaded.Size(), 501);
+  std::remove(path.c_str());
+}
+
+/////////////////////////////////////////////
+/// Product quantization
+/////////////////////////////////////////////
+
+TEST(test_algo_data_mining, pq_codes_of_exact_centroids)
+{
+  // Each subspace takes one of 4 values, so 4 centroids per subspace quantize without loss.
+  const size_t dims{12};
+  mt19937_64 gen(47);
+  FeatureMatrix training(400, dims);
+  vector<float> data(400 * dims);
+  for (size_t i = 0; i < 400; i++) {
+    for (size_t s = 0; s < 4; s++) {
+      const auto value = static_cast<float>(gen() % 4);
+      for (size_t j = 0; j < 3; j++) {
+        data[i * dims + s * 3 + j] = value * static_cast<float>(j + 1);
+        training(i, s * 3 + j) = data[i * dims + s * 3 + j];
+      }
+    }
+  }
+  const ProductQuantizer quantizer(training, 4, 4);
+  ASSERT_EQ(quantizer.Subspaces(), 4);
+  EXPECT_EQ(quantizer.Centroids(), 4);
+  EXPECT_EQ(quantizer.Dims(), dims);
+
+  vector<uint8_t> code(4);
+  vector<float> decoded(dims);
+  for (size_t i = 0; i < 400; i++) {
+    quantizer.Encode(data.data() + i * dims, code.data());
+    quantizer.Decode(code.data(), decoded.data());
+    EXPECT_TRUE(std::equal(decoded.begin(), decoded.end(), data.begin() + static_cast<ptrdiff_t>(i * dims)));
+  }
+
+  EXPECT_EQ(ProductQuantizer(training, 5, 4).Subspaces(), 0);
+  EXPECT_EQ(ProductQuantizer(training, 4, 257).Subspaces(), 0);
+  EXPECT_EQ(ProductQuantizer(FeatureMatrix(3, dims), 4, 4).Subspaces(), 0);
+  PqIndex empty{ProductQuantizer{}};
+  empty.Add(data.data(), 10);
+  EXPECT_EQ(empty.Size(), 0);
+  EXPECT_TRUE(empty.Search(data.data(), 3).empty());
+}
+
+TEST(test_algo_data_mining, pq_search_matches_decoded_vectors)
+{
+  const size_t dims{16};
+  const vector<float> data{RandomVectors(1001, dims, 48)};
+  FeatureMatrix training(500, dims);
+  for (size_t i = 0; i < 500; i++) {
+    for (size_t j = 0; j < dims; j++) {
+      training(i, j) = data[i * dims + j];
+    }
+  }
+  KMeansOptions options;
+  options.max_iterations = 10;
+  const vector<float> queries{RandomVectors(10, dims, 49)};
+
+  for (VectorMetric metric : {VectorMetric::L2, VectorMetric::InnerProduct}) {
+    PqIndex index{ProductQuantizer(training, 8, 32, options), metric};
+    index.Add(data.data(), 600, 3);
+    index.Add(data.data() + 600 * dims, 401);
+    ASSERT_EQ(index.Size(), 1001);
+
+    // The distances of the codes, from the decoded vectors.
+    vector<float> decoded(1001 * dims);
+    for (uint32_t i = 0; i < 1001; i++) {
+      index.Reconstruct(i, decoded.data() + i * dims);
+    }
+    const auto batch = index.SearchBatch(queries.data(), 10, 1001, 2);
+    for (size_t q = 0; q < 10; q++) {
+      const float* query{queries.data() + q * dims};
+      vector<float> expected;
+      for (size_t i = 0; i < 1001; i++) {
+        float value{0.0f};
+        for (size_t j = 0; j < dims; j++) {
+          const float x{decoded[i * dims + j]};
+          value += metric == VectorMetric::L2 ? (x - query[j]) * (x - query[j]) : x * query[j];
+        }
+        expected.push_back(metric == VectorMetric::L2 ? std::sqrt(value) : 1.0f - value);
+      }
+
+      // All codes come back once, sorted, with the distance of their decoded vector.
+      ASSERT_EQ(batch[q].size(), 1001);
+      vector<bool> seen(1001);
+      for (size_t r = 0; r < 1001; r++) {
+        const NeighborHit& hit{batch[q][r]};
+        ASSERT_LT(hit.index, 1001);
+        EXPECT_FALSE(seen[hit.index]);
+        seen[hit.index] = true;
+        EXPECT_NEAR(hit.distance, expected[hit.index], 1e-4);
+        if (r > 0) {
+          EXPECT_LE(batch[q][r - 1].distance, hit.distance);
+        }
+      }
+      EXPECT_EQ(index.Search(query, 5), vector<NeighborHit>(batch[q].begin(), batch[q].begin() + 5));
+    }
+  }
+}
+
 /////////////////////////////////////////////
 /// DBSCAN
 /////////////////////////////////////////////
@@ -369,6 +1047,110 @@ TEST(test_algo_data_mining, dbscan_3)
   EXPECT_EQ(num_noise, 6);
 }
 
+namespace {
+/// DBSCAN with all pairs of distances, numbering the clusters in the order of their first core point.
+DbscanResult DbscanReference(const FeatureMatrix& data, DistFunc dist_func, double eps, size_t min_pts)
+{
+  const size_t n{data.Rows()};
+  const auto near = [&](size_t a, size_t b) {
+    double l1{0.0};
+    double l2{0.0};
+    for (size_t j = 0; j < data.Cols(); j++) {
+      l1 += std::abs(data(a, j) - data(b, j));
+      l2 += (data(a, j) - data(b, j)) * (data(a, j) - data(b, j));
+    }
+    return dist_func == DistFunc::Manhattan ? l1 < eps : l2 < eps * eps;
+  };
+  DbscanResult res;
+  res.core.resize(n);
+  res.labels.assign(n, 0);
+  for (size_t i = 0; i < n; i++) {
+    size_t count{0};
+    for (size_t j = 0; j < n; j++) {
+      count += near(i, j) ? 1 : 0;
+    }
+    res.core[i] = count >= min_pts ? 1 : 0;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (res.core[i] == 0 || res.labels[i] != 0) {
+      continue;
+    }
+    res.labels[i] = ++res.clusters;
+    queue<size_t> todo;
+    todo.push(i);
+    while (!todo.empty()) {
+      const size_t a{todo.front()};
+      todo.pop();
+      for (size_t b = 0; b < n; b++) {
+        if (res.core[b] != 0 && res.labels[b] == 0 && near(a, b)) {
+          res.labels[b] = res.clusters;
+          todo.push(b);
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n && res.core[i] == 0; j++) {
+      if (res.core[j] != 0 && near(i, j)) {
+        res.labels[i] = res.labels[j];
+        break;
+      }
+    }
+  }
+  return res;
+}
+
+FeatureMatrix RandomPoints(size_t n, size_t dims, uint64_t seed)
+{
+  mt19937_64 gen(seed);
+  uniform_real_distribution<double> unit(0.0, 1.0);
+  FeatureMatrix data(n, dims);
+  for (size_t i = 0; i < n; i++) {
+    // Dense spots on a sparse background.
+    const double spot{static_cast<double>(i % 4) * 0.25};
+    for (size_t j = 0; j < dims; j++) {
+      data(i, j) = i % 3 == 0 ? unit(gen) : spot + 0.1 * unit(gen);
+    }
+  }
+  return data;
+}
+}// namespace
+
+TEST(test_algo_data_mining, dbscan_grid_against_brute_force)
+{
+  for (size_t dims : {1, 2, 3, 5}) {
+    const FeatureMatrix data{RandomPoints(700, dims, dims)};
+    for (auto dist_func : {DistFunc::Euclidean, DistFunc::Manhattan}) {
+      for (double eps : {0.03, 0.2}) {
+        const DbscanResult expected{DbscanReference(data, dist_func, eps, 5)};
+        const DbscanResult res{DBSCAN(data, dist_func, eps, 5)};
+        EXPECT_EQ(res.labels, expected.labels);
+        EXPECT_EQ(res.core, expected.core);
+        EXPECT_EQ(res.clusters, expected.clusters);
+      }
+    }
+  }
+}
+
+TEST(test_algo_data_mining, dbscan_grid_threads_and_manhattan)
+{
+  const FeatureMatrix data{RandomPoints(20000, 2, 9)};
+  const DbscanResult one{DBSCAN(data, DistFunc::Euclidean, 0.004, 5, 1)};
+  const DbscanResult four{DBSCAN(data, DistFunc::Euclidean, 0.004, 5, 4)};
+  EXPECT_GT(one.clusters, 1);
+  EXPECT_EQ(one.labels, four.labels);
+
+  // The L1 distance of these is 0.6.
+  const FeatureMatrix pair(vector<vector<double>>{{0.0, 0.0}, {0.3, 0.3}});
+  EXPECT_EQ(DBSCAN(pair, DistFunc::Manhattan, 0.5, 2).clusters, 0);
+  EXPECT_EQ(DBSCAN(pair, DistFunc::Manhattan, 0.7, 2).clusters, 1);
+  EXPECT_EQ(DBSCAN(pair, DistFunc::Euclidean, 0.5, 2).clusters, 1);
+
+  EXPECT_TRUE(DBSCAN(pair, DistFunc::Euclidean, 0.0, 2).labels.empty());
+  EXPECT_TRUE(DBSCAN(pair, DistFunc::Euclidean, 0.5, 0).labels.empty());
+  EXPECT_TRUE(DBSCAN(FeatureMatrix{}, DistFunc::Euclidean, 0.5, 2).labels.empty());
+}
+
 TEST(test_algo_data_mining, dbscan_forbidden_cases)
 {
   Points pts{
@@ -398,3 +1180,347 @@ TEST(test_algo_data_mining, dbscan_forbidden_cases)
   lpts = DBSCAN(pts, DistFunc::Euclidean, -0.1, 2);
   EXPECT_TRUE(lpts.empty());
 }
+
+/////////////////////////////////////////////
+/// Hierarchical clustering
+/////////////////////////////////////////////
+
+namespace {
+/// \brief Merges the nearest two clusters by the definition of the linkage, O(n^3).
+vector<double> ReferenceLinkage(const FeatureMatrix& data, Linkage linkage, vector<vector<vector<size_t>>>& partitions)
+{
+  const size_t n{data.Rows()};
+  vector<vector<size_t>> clusters;
+  for (size_t i = 0; i < n; i++) {
+    clusters.push_back({i});
+  }
+  const auto centroid_distance = [&data](const vector<size_t>& a, const vector<size_t>& b) {
+    double sum{0.0};
+    for (size_t j = 0; j < data.Cols(); j++) {
+      double ca{0.0};
+      double cb{0.0};
+      for (size_t p : a) ca += data(p, j);
+      for (size_t p : b) cb += data(p, j);
+      const double diff{ca / static_cast<double>(a.size()) - cb / static_cast<double>(b.size())};
+      sum += diff * diff;
+    }
+    return std::sqrt(sum);
+  };
+
+  vector<double> distances;
+  partitions.assign(1, clusters);
+  while (clusters.size() > 1) {
+    double best{numeric_limits<double>::infinity()};
+    size_t best_a{0};
+    size_t best_b{0};
+    for (size_t a = 0; a < clusters.size(); a++) {
+      for (size_t b = a + 1; b < clusters.size(); b++) {
+        double d{linkage == Linkage::Single ? numeric_limits<double>::infinity() : 0.0};
+        for (size_t p : clusters[a]) {
+          for (size_t q : clusters[b]) {
+            const double pq{std::sqrt(SquaredDistance(data, p, data, q))};
+            d = linkage == Linkage::Single ? std::min(d, pq) : linkage == Linkage::Complete ? std::max(d, pq) : d + pq;
+          }
+        }
+        const auto size_a = static_cast<double>(clusters[a].size());
+        const auto size_b = static_cast<double>(clusters[b].size());
+        if (linkage == Linkage::Average) {
+          d /= size_a * size_b;
+        } else if (linkage == Linkage::Ward) {
+          d = std::sqrt(2.0 * size_a * size_b / (size_a + size_b)) * centroid_distance(clusters[a], clusters[b]);
+        }
+        if (d < best) {
+          best = d;
+          best_a = a;
+          best_b = b;
+        }
+      }
+    }
+    distances.push_back(best);
+    clusters[best_a].insert(clusters[best_a].end(), clusters[best_b].begin(), clusters[best_b].end());
+    clusters.erase(clusters.begin() + static_cast<ptrdiff_t>(best_b));
+    partitions.push_back(clusters);
+  }
+  return distances;
+}
+}// namespace
+
+TEST(test_algo_data_mining, hierarchical_clustering_small_example)
+{
+  const FeatureMatrix line(vector<vector<double>>{{0.0}, {1.0}, {3.0}, {7.0}});
+  const vector<ClusterMerge> single{HierarchicalClustering(line, Linkage::Single)};
+  ASSERT_EQ(single.size(), 3);
+  EXPECT_EQ(single[0].first, 0);
+  EXPECT_EQ(single[0].second, 1);
+  EXPECT_EQ(single[0].distance, 1.0);
+  EXPECT_EQ(single[0].size, 2);
+  EXPECT_EQ(single[1].first, 2);
+  EXPECT_EQ(single[1].second, 4);
+  EXPECT_EQ(single[1].distance, 2.0);
+  EXPECT_EQ(single[2].first, 3);
+  EXPECT_EQ(single[2].second, 5);
+  EXPECT_EQ(single[2].distance, 4.0);
+  EXPECT_EQ(single[2].size, 4);
+
+  const vector<ClusterMerge> complete{HierarchicalClustering(line, Linkage::Complete, DistFunc::Manhattan, 2)};
+  ASSERT_EQ(complete.size(), 3);
+  EXPECT_EQ(complete[1].second, 4);
+  EXPECT_EQ(complete[1].distance, 3.0);
+  EXPECT_EQ(complete[2].distance, 7.0);
+
+  EXPECT_EQ(CutTree(single, 2), (vector<uint32_t>{0, 0, 0, 1}));
+  EXPECT_EQ(CutTree(single, 4), (vector<uint32_t>{0, 1, 2, 3}));
+  EXPECT_EQ(CutTree(single, 1), (vector<uint32_t>{0, 0, 0, 0}));
+  EXPECT_TRUE(CutTree(single, 0).empty());
+  EXPECT_TRUE(CutTree(single, 5).empty());
+  EXPECT_TRUE(HierarchicalClustering(FeatureMatrix(vector<vector<double>>{{1.0}}), Linkage::Single).empty());
+  EXPECT_TRUE(HierarchicalClustering(line, Linkage::Ward, DistFunc::Manhattan).empty());
+}
+
+TEST(test_algo_data_mining, hierarchical_clustering_against_reference)
+{
+  const FeatureMatrix data{RandomPoints(40, 3, 48)};
+  for (Linkage linkage : {Linkage::Single, Linkage::Complete, Linkage::Average, Linkage::Ward}) {
+    vector<vector<vector<size_t>>> partitions;
+    const vector<double> expected{ReferenceLinkage(data, linkage, partitions)};
+    const vector<ClusterMerge> merges{HierarchicalClustering(data, linkage, DistFunc::Euclidean, 3)};
+    ASSERT_EQ(merges.size(), expected.size());
+    for (size_t m = 0; m < merges.size(); m++) {
+      EXPECT_NEAR(merges[m].distance, expected[m], 1e-9);
+    }
+    EXPECT_EQ(merges.back().size, 40);
+
+    // Cutting into k clusters gives the partition of the reference after 40 - k merges.
+    for (size_t k : {2, 5, 17}) {
+      const vector<uint32_t> labels{CutTree(merges, k)};
+      for (const auto& cluster : partitions[40 - k]) {
+        for (size_t p : cluster) {
+          EXPECT_EQ(labels[p], labels[cluster[0]]);
+        }
+      }
+      EXPECT_EQ(*std::max_element(labels.begin(), labels.end()), k - 1);
+    }
+  }
+}
+
+TEST(test_algo_data_mining, condensed_distances_threads)
+{
+  const FeatureMatrix data{RandomPoints(800, 4, 49)};
+  const vector<double> one{CondensedDistances(data, DistFunc::Manhattan, 1)};
+  ASSERT_EQ(one.size(), 800 * 799 / 2);
+  EXPECT_EQ(CondensedDistances(data, DistFunc::Manhattan, 4), one);
+  double l1{0.0};
+  for (size_t j = 0; j < 4; j++) {
+    l1 += std::abs(data(5, j) - data(9, j));
+  }
+  EXPECT_EQ(one[800 * 5 - 5 * 6 / 2 + 9 - 5 - 1], l1);
+  EXPECT_TRUE(CondensedDistances(FeatureMatrix(1, 4), DistFunc::Euclidean).empty());
+}
+
+/////////////////////////////////////////////
+/// Gaussian mixture
+/////////////////////////////////////////////
+
+namespace {
+struct Component {
+  double weight;
+  array<double, 2> mean;
+  array<double, 4> cov;
+};
+
+const vector<Component> kComponents{{0.5, {0.0, 0.0}, {1.0, 0.6, 0.6, 1.0}},
+                                    {0.3, {6.0, 0.0}, {0.5, -0.2, -0.2, 0.3}},
+                                    {0.2, {0.0, 6.0}, {0.3, 0.0, 0.0, 1.5}}};
+
+/// \brief Draws n points from kComponents, labels holds the component of each point.
+FeatureMatrix SampleMixture(size_t n, unsigned seed, vector<uint32_t>& labels)
+{
+  mt19937 gen(seed);
+  normal_distribution<double> normal;
+  discrete_distribution<uint32_t> pick{kComponents[0].weight, kComponents[1].weight, kComponents[2].weight};
+  FeatureMatrix data(n, 2);
+  labels.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    const Component& c{kComponents[labels[i] = pick(gen)]};
+    const double l00{std::sqrt(c.cov[0])};
+    const double l10{c.cov[2] / l00};
+    const double l11{std::sqrt(c.cov[3] - l10 * l10)};
+    const double z0{normal(gen)};
+    const double z1{normal(gen)};
+    data(i, 0) = c.mean[0] + l00 * z0;
+    data(i, 1) = c.mean[1] + l10 * z0 + l11 * z1;
+  }
+  return data;
+}
+
+/// \brief The component of kComponents with the nearest mean to row c of means.
+size_t MatchComponent(const FeatureMatrix& means, size_t c)
+{
+  size_t best{0};
+  for (size_t t = 1; t < kComponents.size(); t++) {
+    const auto dist = [&](size_t u) {
+      return std::hypot(means(c, 0) - kComponents[u].mean[0], means(c, 1) - kComponents[u].mean[1]);
+    };
+    if (dist(t) < dist(best)) {
+      best = t;
+    }
+  }
+  return best;
+}
+}// namespace
+
+TEST(test_algo_data_mining, gmm_full_covariance)
+{
+  vector<uint32_t> truth;
+  const FeatureMatrix data{SampleMixture(3000, 50, truth)};
+  GaussianMixture gmm{3};
+  ASSERT_TRUE(gmm.Fit(data));
+  EXPECT_TRUE(gmm.Converged());
+  ASSERT_EQ(gmm.Covariances().size(), 3 * 4);
+
+  // Compared with the sample statistics of the points drawn from each component.
+  vector<double> weight(3);
+  vector<array<double, 2>> mean(3);
+  vector<array<double, 4>> cov(3);
+  for (size_t i = 0; i < data.Rows(); i++) {
+    weight[truth[i]] += 1.0;
+    mean[truth[i]][0] += data(i, 0);
+    mean[truth[i]][1] += data(i, 1);
+  }
+  for (size_t t = 0; t < 3; t++) {
+    mean[t][0] /= weight[t];
+    mean[t][1] /= weight[t];
+  }
+  for (size_t i = 0; i < data.Rows(); i++) {
+    for (size_t j = 0; j < 4; j++) {
+      cov[truth[i]][j] += (data(i, j / 2) - mean[truth[i]][j / 2]) * (data(i, j % 2) - mean[truth[i]][j % 2]);
+    }
+  }
+  vector<size_t> match(3);
+  for (size_t c = 0; c < 3; c++) {
+    const size_t t{match[c] = MatchComponent(gmm.Means(), c)};
+    EXPECT_NEAR(gmm.Weights()[c], weight[t] / 3000, 0.01);
+    EXPECT_NEAR(gmm.Means()(c, 0), mean[t][0], 0.02);
+    EXPECT_NEAR(gmm.Means()(c, 1), mean[t][1], 0.02);
+    for (size_t j = 0; j < 4; j++) {
+      EXPECT_NEAR(gmm.Covariances()[c * 4 + j], cov[t][j] / weight[t], 0.05);
+    }
+  }
+  EXPECT_NE(match[0], match[1]);
+  EXPECT_NE(match[0], match[2]);
+  EXPECT_NE(match[1], match[2]);
+
+  const vector<uint32_t> labels{gmm.Predict(data)};
+  ASSERT_EQ(labels.size(), 3000);
+  size_t agree{0};
+  for (size_t i = 0; i < labels.size(); i++) {
+    agree += match[labels[i]] == truth[i];
+  }
+  EXPECT_GT(agree, 2950);
+
+  const FeatureMatrix proba{gmm.PredictProba(data)};
+  ASSERT_EQ(proba.Rows(), 3000);
+  ASSERT_EQ(proba.Cols(), 3);
+  for (size_t i = 0; i < proba.Rows(); i++) {
+    EXPECT_NEAR(proba(i, 0) + proba(i, 1) + proba(i, 2), 1.0, 1e-12);
+  }
+}
+
+TEST(test_algo_data_mining, gmm_single_component)
+{
+  vector<uint32_t> truth;
+  const FeatureMatrix data{SampleMixture(500, 51, truth)};
+  const size_t n{data.Rows()};
+  GaussianMixture gmm{1};
+  ASSERT_TRUE(gmm.Fit(data));
+  EXPECT_TRUE(gmm.Converged());
+
+  // One component is the sample mean and covariance, with the closed form log-likelihood.
+  double mean[2]{0.0, 0.0};
+  for (size_t i = 0; i < n; i++) {
+    mean[0] += data(i, 0) / static_cast<double>(n);
+    mean[1] += data(i, 1) / static_cast<double>(n);
+  }
+  double cov[4]{0.0, 0.0, 0.0, 0.0};
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < 2; j++) {
+      for (size_t l = 0; l < 2; l++) {
+        cov[j * 2 + l] += (data(i, j) - mean[j]) * (data(i, l) - mean[l]) / static_cast<double>(n);
+      }
+    }
+  }
+  EXPECT_NEAR(gmm.Weights()[0], 1.0, 1e-12);
+  EXPECT_NEAR(gmm.Means()(0, 0), mean[0], 1e-9);
+  EXPECT_NEAR(gmm.Means()(0, 1), mean[1], 1e-9);
+  EXPECT_NEAR(gmm.Covariances()[0], cov[0] + 1e-6, 1e-9);
+  EXPECT_NEAR(gmm.Covariances()[1], cov[1], 1e-9);
+  EXPECT_NEAR(gmm.Covariances()[3], cov[3] + 1e-6, 1e-9);
+  const double log_det{std::log(cov[0] * cov[3] - cov[1] * cov[2])};
+  EXPECT_NEAR(gmm.LogLikelihood(), -0.5 * (2.0 * std::log(2.0 * M_PI) + log_det + 2.0), 1e-5);
+
+  const vector<double> scores{gmm.ScoreSamples(data)};
+  ASSERT_EQ(scores.size(), n);
+  double sum{0.0};
+  for (double score : scores) {
+    sum += score;
+  }
+  EXPECT_NEAR(sum / static_cast<double>(n), gmm.LogLikelihood(), 1e-9);
+}
+
+TEST(test_algo_data_mining, gmm_diagonal_threads)
+{
+  vector<uint32_t> truth;
+  const FeatureMatrix data{SampleMixture(10000, 52, truth)};
+  GmmOptions options;
+  options.covariance = CovarianceType::Diagonal;
+  options.threads = 1;
+  GaussianMixture one{3, options};
+  ASSERT_TRUE(one.Fit(data));
+  options.threads = 4;
+  GaussianMixture four{3, options};
+  ASSERT_TRUE(four.Fit(data));
+
+  ASSERT_EQ(one.Covariances().size(), 3 * 2);
+  ASSERT_EQ(four.Covariances().size(), 3 * 2);
+  EXPECT_EQ(one.Iterations(), four.Iterations());
+  EXPECT_NEAR(one.LogLikelihood(), four.LogLikelihood(), 1e-9);
+  for (size_t c = 0; c < 3; c++) {
+    EXPECT_NEAR(one.Weights()[c], four.Weights()[c], 1e-9);
+    for (size_t j = 0; j < 2; j++) {
+      EXPECT_NEAR(one.Means()(c, j), four.Means()(c, j), 1e-9);
+      EXPECT_NEAR(one.Covariances()[c * 2 + j], four.Covariances()[c * 2 + j], 1e-9);
+    }
+    // The diagonal of the true covariance, the correlation is not modelled.
+    const Component& expected{kComponents[MatchComponent(one.Means(), c)]};
+    EXPECT_NEAR(one.Covariances()[c * 2], expected.cov[0], 0.1);
+    EXPECT_NEAR(one.Covariances()[c * 2 + 1], expected.cov[3], 0.1);
+  }
+  EXPECT_EQ(one.Predict(data), four.Predict(data));
+}
+
+TEST(test_algo_data_mining, gmm_forbidden_cases)
+{
+  vector<uint32_t> truth;
+  const FeatureMatrix data{SampleMixture(10, 53, truth)};
+  GaussianMixture unfitted{2};
+  EXPECT_FALSE(unfitted.Fitted());
+  EXPECT_TRUE(unfitted.Predict(data).empty());
+  EXPECT_EQ(unfitted.PredictProba(data).Rows(), 0);
+  EXPECT_TRUE(unfitted.ScoreSamples(data).empty());
+
+  EXPECT_FALSE(GaussianMixture{0}.Fit(data));
+  EXPECT_FALSE(GaussianMixture{11}.Fit(data));
+  EXPECT_FALSE(GaussianMixture{1}.Fit(FeatureMatrix(10, 0)));
+
+  // Equal points without regularization have a singular covariance.
+  GmmOptions options;
+  options.regularization = 0.0;
+  GaussianMixture singular{1, options};
+  EXPECT_FALSE(singular.Fit(FeatureMatrix(10, 2)));
+  EXPECT_FALSE(singular.Fitted());
+
+  GaussianMixture gmm{2};
+  ASSERT_TRUE(gmm.Fit(data));
+  EXPECT_TRUE(gmm.Predict(FeatureMatrix(5, 3)).empty());
+  EXPECT_TRUE(gmm.ScoreSamples(FeatureMatrix(5, 3)).empty());
+}
@@ -6,6 +6,11 @@
 ///
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <tuple>
 
 #include "algo.hpp"
 #include "gtest/gtest.h"
@@ -53,6 +58,201 @@ TEST(test_algo_search, binary_search_string)
   EXPECT_EQ(Binary(vec, std::string{"cher"}), 2);
 }
 
+TEST(test_algo_search, lower_bound_matches_std)
+{
+  std::mt19937 gen(30);
+  std::uniform_int_distribution<int> dist(0, 50);
+  for (size_t n = 0; n < 130; n++) {
+    vector<int> vec(n);
+    for (auto& v : vec) v = dist(gen);
+    std::sort(vec.begin(), vec.end());
+    for (int value = -1; value <= 51; value++) {
+      const auto expected = static_cast<size_t>(std::lower_bound(vec.begin(), vec.end(), value) - vec.begin());
+      EXPECT_EQ(LowerBound(vec, value), expected);
+    }
+  }
+}
+
+TEST(test_algo_search, lower_bound_descending)
+{
+  const vector<int> vec{9, 7, 7, 4, 1};
+  EXPECT_EQ(LowerBound(vec, 7, std::greater<>{}), 1U);
+  EXPECT_EQ(LowerBound(vec, 0, std::greater<>{}), 5U);
+}
+
+/////////////////////////////////////////////
+/// Eytzinger search
+/////////////////////////////////////////////
+
+TEST(test_algo_search, eytzinger_empty)
+{
+  const Eytzinger<int> tree{vector<int>{}};
+  EXPECT_EQ(tree.Size(), 0U);
+  EXPECT_EQ(tree.LowerBound(3), 0U);
+  EXPECT_EQ(tree.Find(3), -1);
+  EXPECT_EQ(tree.LowerBound(vector<int>{1, 2}), (vector<size_t>{0, 0}));
+}
+
+TEST(test_algo_search, eytzinger_matches_std)
+{
+  std::mt19937 gen(31);
+  std::uniform_int_distribution<int> dist(0, 100);
+  for (size_t n = 1; n < 300; n += 7) {
+    vector<int> vec(n);
+    for (auto& v : vec) v = dist(gen);
+    std::sort(vec.begin(), vec.end());
+    const Eytzinger<int> tree{vec};
+
+    vector<int> queries;
+    for (int value = -1; value <= 101; value++) queries.push_back(value);
+    const vector<size_t> batch{tree.LowerBound(queries)};
+
+    for (size_t i = 0; i < queries.size(); i++) {
+      const int value{queries[i]};
+      const auto expected = static_cast<size_t>(std::lower_bound(vec.begin(), vec.end(), value) - vec.begin());
+      EXPECT_EQ(tree.LowerBound(value), expected);
+      EXPECT_EQ(batch[i], expected);
+      const bool found{expected < n && vec[expected] == value};
+      EXPECT_EQ(tree.Find(value), found ? static_cast<long long>(expected) : -1);
+    }
+  }
+}
+
+TEST(test_algo_search, eytzinger_strings)
+{
+  const vector<string> vec{"abba", "bono", "cher", "cher", "dion", "eric_c"};
+  const Eytzinger<string> tree{vec};
+  EXPECT_EQ(tree.Find("cher"), 2);
+  EXPECT_EQ(tree.Find("adele"), -1);
+  EXPECT_EQ(tree.LowerBound("zz"), 6U);
+}
+
+/////////////////////////////////////////////
+/// Learned index
+/////////////////////////////////////////////
+
+namespace {
+void ExpectLowerBounds(const LearnedIndex& index, const vector<uint64_t>& keys, const vector<uint64_t>& queries)
+{
+  for (uint64_t q : queries) {
+    const auto expected = static_cast<size_t>(std::lower_bound(keys.begin(), keys.end(), q) - keys.begin());
+    ASSERT_EQ(index.LowerBound(keys, q), expected) << "key " << q;
+  }
+}
+}// namespace
+
+TEST(test_algo_search, learned_index_empty)
+{
+  const vector<uint64_t> keys{};
+  const LearnedIndex index{keys};
+  EXPECT_EQ(index.LowerBound(keys, 5), 0U);
+  EXPECT_EQ(index.Find(keys, 5), -1);
+}
+
+TEST(test_algo_search, learned_index_linear_keys_one_segment)
+{
+  vector<uint64_t> keys(10000);
+  for (size_t i = 0; i < keys.size(); i++) keys[i] = 1000 + 7 * i;
+  const LearnedIndex index{keys, 4};
+  EXPECT_EQ(index.Segments(), 1U);
+  EXPECT_EQ(index.Find(keys, 1000 + 7 * 1234), 1234);
+  EXPECT_EQ(index.Find(keys, 1001), -1);
+  ExpectLowerBounds(index, keys, {0, 999, 1000, 1001, 70000, 80000, UINT64_MAX});
+}
+
+TEST(test_algo_search, learned_index_random_with_duplicates)
+{
+  std::mt19937_64 gen(31);
+  std::lognormal_distribution<double> dist(20.0, 2.0);
+  vector<uint64_t> keys(50000);
+  for (auto& k : keys) k = static_cast<uint64_t>(dist(gen));
+  for (size_t i = 0; i < 2000; i++) keys.push_back(keys[i % 10]);
+  keys.push_back(UINT64_MAX);
+  std::sort(keys.begin(), keys.end());
+
+  for (size_t epsilon : {0, 1, 8, 64}) {
+    const LearnedIndex index{keys, epsilon};
+    EXPECT_LT(index.Segments(), keys.size());
+
+    vector<uint64_t> queries(keys.begin(), keys.begin() + 5000);
+    for (size_t i = 0; i < 5000; i++) {
+      queries.push_back(keys[gen() % keys.size()]);
+      queries.push_back(keys[gen() % keys.size()] + 1);
+      queries.push_back(gen());
+    }
+    queries.push_back(0);
+    ExpectLowerBounds(index, keys, queries);
+  }
+}
+
+TEST(test_algo_search, learned_index_save_load)
+{
+  vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 5000; i++) keys.push_back(i * i);
+  const LearnedIndex index{keys, 16};
+
+  const string path{"learned_index_test.bin"};
+  ASSERT_TRUE(index.Save(path));
+  LearnedIndex loaded;
+  ASSERT_TRUE(loaded.Load(path));
+  EXPECT_EQ(loaded.Size(), keys.size());
+  EXPECT_EQ(loaded.Segments(), index.Segments());
+  ExpectLowerBounds(loaded, keys, {0, 1, 2, 49 * 49, 49 * 49 + 1, 4999ULL * 4999, 4999ULL * 4999 + 1});
+
+  EXPECT_FALSE(loaded.Load("no_such_file.bin"));
+  std::ofstream(path) << "garbage";
+  EXPECT_FALSE(loaded.Load(path));
+
+  // A header that claims more segments than the file holds.
+  {
+    std::ofstream file(path, std::ios::binary);
+    const uint64_t header[3]{uint64_t{1} << 60u, 16, uint64_t{1} << 59u};
+    file.write("ALGOLIX1", 8);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+  }
+  EXPECT_FALSE(loaded.Load(path));
+  EXPECT_EQ(loaded.Size(), keys.size());
+
+  // Segments that do not fit the number of keys: each entry is {first key, slope, start}.
+  auto write_index = [&path](uint64_t n, const vector<std::tuple<uint64_t, double, uint64_t>>& segments) {
+    std::ofstream file(path, std::ios::binary);
+    const uint64_t header[3]{n, 16, segments.size()};
+    file.write("ALGOLIX1", 8);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for (const auto& segment : segments) file.write(reinterpret_cast<const char*>(&get<0>(segment)), 8);
+    for (const auto& segment : segments) {
+      file.write(reinterpret_cast<const char*>(&get<1>(segment)), 8);
+      file.write(reinterpret_cast<const char*>(&get<2>(segment)), 8);
+    }
+  };
+  write_index(100, {{0, 1.0, 0}, {50, 1.0, 50}});
+  EXPECT_TRUE(loaded.Load(path));
+  EXPECT_EQ(loaded.Size(), 100u);
+  write_index(100, {});
+  EXPECT_FALSE(loaded.Load(path));
+  write_index(100, {{0, 1.0, 1}});
+  EXPECT_FALSE(loaded.Load(path));
+  write_index(100, {{0, 1.0, 0}, {50, 1.0, 100}});
+  EXPECT_FALSE(loaded.Load(path));
+  write_index(100, {{0, 1.0, 0}, {50, 1.0, 60}, {70, 1.0, 60}});
+  EXPECT_FALSE(loaded.Load(path));
+  write_index(100, {{50, 1.0, 0}, {10, 1.0, 50}});
+  EXPECT_FALSE(loaded.Load(path));
+  write_index(100, {{0, std::numeric_limits<double>::quiet_NaN(), 0}});
+  EXPECT_FALSE(loaded.Load(path));
+  write_index(100, {{0, -1.0, 0}});
+  EXPECT_FALSE(loaded.Load(path));
+  EXPECT_EQ(loaded.Size(), 100u);
+  std::remove(path.c_str());
+
+  // A vector that is not the one the index was built from is not read past its end.
+  const vector<uint64_t> few{1, 4, 9};
+  EXPECT_EQ(index.LowerBound(few, 5), 2u);
+  EXPECT_EQ(index.LowerBound(few, 100), 3u);
+  EXPECT_EQ(index.Find(few, 9), 2);
+  EXPECT_EQ(index.Find(few, 2), -1);
+}
+
 /////////////////////////////////////////////
 /// Selection min search
 /////////////////////////////////////////////
@@ -102,3 +302,92 @@ TEST(test_algo_search, selection_max_overflow)
   vector<int> found{SelectionMax(vec, 4)};
   EXPECT_TRUE(equal(found.begin(), found.end(), vec.begin()));
 }
+
+TEST(test_algo_search, selection_k_equals_size)
+{
+  vector<int> vec{5, 3, 9, 1};
+  EXPECT_EQ(SelectionMin(vec, 4), (vector<int>{1, 3, 5, 9}));
+  EXPECT_EQ(SelectionMax(vec, 4), (vector<int>{9, 5, 3, 1}));
+  EXPECT_TRUE(SelectionMin(vec, 0).empty());
+}
+
+/////////////////////////////////////////////
+/// Nth element
+/////////////////////////////////////////////
+
+TEST(test_algo_search, nth_element_large_random)
+{
+  vector<int> vec(100000);
+  mt19937 gen(1);
+  generate(vec.begin(), vec.end(), [&gen]() { return static_cast<int>(gen() % 5000); });
+  vector<int> sorted{vec};
+  std::sort(sorted.begin(), sorted.end());
+
+  for (size_t nth : {size_t{0}, size_t{17}, size_t{50000}, size_t{99999}}) {
+    vector<int> v{vec};
+    NthElement(v.begin(), v.begin() + nth, v.end());
+    EXPECT_EQ(v[nth], sorted[nth]);
+    EXPECT_TRUE(all_of(v.begin(), v.begin() + nth, [&](int x) { return x <= v[nth]; }));
+    EXPECT_TRUE(all_of(v.begin() + nth, v.end(), [&](int x) { return x >= v[nth]; }));
+  }
+}
+
+TEST(test_algo_search, nth_element_adversarial_inputs)
+{
+  vector<int> equal(5000, 7);
+  NthElement(equal.begin(), equal.begin() + 2500, equal.end());
+  EXPECT_EQ(equal[2500], 7);
+
+  vector<int> organ_pipe(20000);
+  for (size_t i = 0; i < organ_pipe.size(); i++) {
+    organ_pipe[i] = static_cast<int>(min(i, organ_pipe.size() - i));
+  }
+  vector<int> sorted{organ_pipe};
+  std::sort(sorted.begin(), sorted.end());
+  NthElement(organ_pipe.begin(), organ_pipe.begin() + 1234, organ_pipe.end(), std::less<>{});
+  EXPECT_EQ(organ_pipe[1234], sorted[1234]);
+}
+
+TEST(test_algo_search, partial_sort_with_projection)
+{
+  vector<pair<string, int>> vec{{"a", 5}, {"b", 1}, {"c", 4}, {"d", 2}, {"e", 3}};
+  PartialSort(vec.begin(), vec.begin() + 3, vec.end(), std::greater<>{}, &pair<string, int>::second);
+  EXPECT_EQ(vec[0].first, "a");
+  EXPECT_EQ(vec[1].first, "c");
+  EXPECT_EQ(vec[2].first, "e");
+}
+
+/////////////////////////////////////////////
+/// Top-k
+/////////////////////////////////////////////
+
+TEST(test_algo_search, top_k_streaming)
+{
+  TopK<int> top(3);
+  for (int x : {4, 10, 1, 7, 10, 3, 8}) {
+    top.Push(x);
+  }
+  EXPECT_EQ(top.Size(), 3);
+  EXPECT_EQ(top.Sorted(), (vector<int>{10, 10, 8}));
+
+  TopK<int, std::greater<>> bottom(2);
+  vector<int> vec{4, 10, 1, 7};
+  bottom.Push(vec.begin(), vec.end());
+  EXPECT_EQ(bottom.Sorted(), (vector<int>{1, 4}));
+
+  TopK<int> none(0);
+  none.Push(5);
+  EXPECT_TRUE(none.Sorted().empty());
+}
+
+TEST(test_algo_search, top_k_parallel)
+{
+  vector<uint64_t> vec(1000000);
+  mt19937_64 gen(2);
+  generate(vec.begin(), vec.end(), [&gen]() { return gen(); });
+  vector<uint64_t> top{ParallelTopK(vec.begin(), vec.end(), 1000, std::less<>{}, 4)};
+
+  std::sort(vec.begin(), vec.end(), std::greater<>{});
+  EXPECT_EQ(top, vector<uint64_t>(vec.begin(), vec.begin() + 1000));
+  EXPECT_TRUE(ParallelTopK(vec.begin(), vec.begin(), 10).empty());
+}
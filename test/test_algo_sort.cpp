@@ -6,6 +6,16 @@
 ///
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
 
 #include "algo.hpp"
 #include "gtest/gtest.h"
@@ -327,3 +337,332 @@ TEST(test_algo_sort, quicksort_other_type_string)
   sort::Quick(strings);
   EXPECT_TRUE(is_sorted(strings.begin(), strings.end()));
 }
+
+/////////////////////////////////////////////
+/// External merge sort
+/////////////////////////////////////////////
+
+namespace {
+template<typename T>
+void WriteRecords(const std::string& path, const vector<T>& records)
+{
+  ofstream file(path, ios::binary);
+  file.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+}
+
+template<typename T>
+vector<T> ReadRecords(const std::string& path)
+{
+  ifstream file(path, ios::binary | ios::ate);
+  vector<T> records(file.tellg() / sizeof(T));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(T));
+  return records;
+}
+
+/// \brief A unique path in the system temp directory, the file is removed at the end of the scope.
+struct TempFile {
+  explicit TempFile(const std::string& name)
+  {
+    static std::atomic<unsigned> counter{0};
+    static const unsigned kSeed{std::random_device{}()};
+    const std::string file{"algo_test_" + std::to_string(kSeed) + "_" + std::to_string(counter++) + "_" + name};
+    path = (std::filesystem::temp_directory_path() / file).string();
+  }
+  ~TempFile()
+  {
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+  }
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+
+  std::string path;
+};
+
+struct Record {
+  uint64_t key;
+  char payload[24];
+};
+}// namespace
+
+TEST(test_algo_sort, external_sort_ints_many_runs)
+{
+  const TempFile in{"in"}, out{"out"};
+  vector<int> numbers(100000);
+  mt19937 gen(7);
+  generate(numbers.begin(), numbers.end(), [&gen]() { return static_cast<int>(gen()); });
+  WriteRecords(in.path, numbers);
+
+  // 16 KiB of memory gives 25 runs and a multi-pass merge.
+  sort::ExternalConfig config;
+  config.memory_budget = 1u << 14u;
+  EXPECT_TRUE(sort::External<int>(in.path, out.path, config));
+
+  vector<int> sorted{ReadRecords<int>(out.path)};
+  std::sort(numbers.begin(), numbers.end());
+  EXPECT_EQ(sorted, numbers);
+}
+
+TEST(test_algo_sort, external_sort_fan_in_limit)
+{
+  const TempFile in{"in"}, out{"out"};
+  vector<int> numbers(60000);
+  mt19937 gen(8);
+  generate(numbers.begin(), numbers.end(), [&gen]() { return static_cast<int>(gen()); });
+  WriteRecords(in.path, numbers);
+
+  // 6 runs, the memory allows merging 4 at a time but only 3 are.
+  sort::ExternalConfig config;
+  config.memory_budget = 10 * 4096;
+  config.max_fan_in = 3;
+  EXPECT_TRUE(sort::External<int>(in.path, out.path, config));
+
+  vector<int> sorted{ReadRecords<int>(out.path)};
+  std::sort(numbers.begin(), numbers.end());
+  EXPECT_EQ(sorted, numbers);
+}
+
+TEST(test_algo_sort, external_merge_missing_run)
+{
+  const TempFile run{"run"}, missing{"missing"}, out{"out"};
+  WriteRecords(run.path, vector<int>{1, 2, 3});
+  const vector<std::string> runs{run.path, missing.path};
+  EXPECT_FALSE(sort::MergeRuns<int>(runs, out.path, 4096, std::less<int>{}));
+  EXPECT_TRUE(sort::MergeRuns<int>({run.path}, out.path, 4096, std::less<int>{}));
+  EXPECT_EQ(ReadRecords<int>(out.path), (vector<int>{1, 2, 3}));
+}
+
+TEST(test_algo_sort, external_sort_pod_records)
+{
+  const TempFile in{"in"};
+  vector<Record> records(5000);
+  for (size_t i = 0; i < records.size(); i++) {
+    records[i].key = (i * 7919) % records.size();
+    snprintf(records[i].payload, sizeof(records[i].payload), "rec%zu", i);
+  }
+  WriteRecords(in.path, records);
+
+  sort::ExternalConfig config;
+  config.memory_budget = 1u << 15u;
+  auto by_key_desc = [](const Record& a, const Record& b) { return a.key > b.key; };
+  EXPECT_TRUE(sort::External<Record>(in.path, in.path, config, by_key_desc));
+
+  vector<Record> sorted{ReadRecords<Record>(in.path)};
+  ASSERT_EQ(sorted.size(), records.size());
+  EXPECT_TRUE(is_sorted(sorted.begin(), sorted.end(), by_key_desc));
+  EXPECT_EQ(std::string{sorted.back().payload}, "rec0");
+}
+
+TEST(test_algo_sort, external_sort_disk_budget_exceeded)
+{
+  const TempFile in{"in"}, out{"out"};
+  vector<double> numbers(10000, 1.0);
+  WriteRecords(in.path, numbers);
+
+  sort::ExternalConfig config;
+  config.memory_budget = 1u << 12u;
+  config.disk_budget = 1u << 12u;
+  EXPECT_FALSE(sort::External<double>(in.path, out.path, config));
+}
+
+TEST(test_algo_sort, external_sort_bad_input)
+{
+  const TempFile missing{"missing"}, in{"in"}, out{"out"};
+  EXPECT_FALSE(sort::External<int>(missing.path, out.path));
+
+  WriteRecords(in.path, vector<char>{'a', 'b', 'c'});
+  EXPECT_FALSE(sort::External<int>(in.path, out.path));
+}
+
+/////////////////////////////////////////////
+/// Small sort
+/////////////////////////////////////////////
+
+TEST(test_algo_sort, small_sort_all_sizes)
+{
+  mt19937 gen(11);
+  for (size_t n = 0; n <= sort::kSmallSortMax + 8; n++) {
+    vector<int32_t> ints(n);
+    vector<float> floats(n);
+    vector<double> doubles(n);
+    for (size_t i = 0; i < n; i++) {
+      ints[i] = static_cast<int32_t>(gen() % 50) - 25;// Many duplicates
+      floats[i] = static_cast<float>(gen()) / 7.0f - 1e8f;
+      doubles[i] = static_cast<double>(gen()) / 3.0 - 1e9;
+    }
+    vector<int32_t> ints_ref{ints};
+    vector<float> floats_ref{floats};
+    vector<double> doubles_ref{doubles};
+    std::sort(ints_ref.begin(), ints_ref.end());
+    std::sort(floats_ref.begin(), floats_ref.end());
+    std::sort(doubles_ref.begin(), doubles_ref.end());
+
+    sort::SmallSort(ints.data(), n);
+    sort::SmallSort(floats.data(), n);
+    sort::SmallSort(doubles.data(), n);
+    EXPECT_EQ(ints, ints_ref);
+    EXPECT_EQ(floats, floats_ref);
+    EXPECT_EQ(doubles, doubles_ref);
+  }
+}
+
+TEST(test_algo_sort, small_sort_extreme_values)
+{
+  vector<int32_t> ints{numeric_limits<int32_t>::max(), 0, numeric_limits<int32_t>::min(), numeric_limits<int32_t>::max()};
+  sort::SmallSort(ints.data(), ints.size());
+  EXPECT_TRUE(is_sorted(ints.begin(), ints.end()));
+  EXPECT_EQ(ints.back(), numeric_limits<int32_t>::max());
+
+  vector<double> doubles{numeric_limits<double>::infinity(), 1.0, -numeric_limits<double>::infinity()};
+  sort::SmallSort(doubles.data(), doubles.size());
+  EXPECT_EQ(doubles.back(), numeric_limits<double>::infinity());
+  EXPECT_EQ(doubles.front(), -numeric_limits<double>::infinity());
+}
+
+namespace {
+/// \brief The bit patterns of the values in increasing order, equal for two arrays that are permutations of each
+/// other down to the bits.
+template<typename T, typename Bits>
+vector<Bits> SortedBits(const vector<T>& values)
+{
+  vector<Bits> bits(values.size());
+  memcpy(bits.data(), values.data(), values.size() * sizeof(T));
+  std::sort(bits.begin(), bits.end());
+  return bits;
+}
+}// namespace
+
+TEST(test_algo_sort, small_sort_keeps_signed_zeros)
+{
+  mt19937 gen(5);
+  for (size_t n = 2; n <= sort::kSmallSortMax; n++) {
+    vector<double> doubles(n);
+    vector<float> floats(n);
+    for (size_t i = 0; i < n; i++) {
+      const unsigned pick{static_cast<unsigned>(gen() % 3)};
+      doubles[i] = pick == 0 ? -0.0 : pick == 1 ? 0.0 : static_cast<double>(gen() % 5) - 2.0;
+      floats[i] = static_cast<float>(doubles[i]);
+    }
+    const vector<uint64_t> double_bits{SortedBits<double, uint64_t>(doubles)};
+    const vector<uint32_t> float_bits{SortedBits<float, uint32_t>(floats)};
+    sort::SmallSort(doubles.data(), n);
+    sort::SmallSort(floats.data(), n);
+    EXPECT_TRUE(is_sorted(doubles.begin(), doubles.end()));
+    EXPECT_TRUE(is_sorted(floats.begin(), floats.end()));
+    EXPECT_EQ((SortedBits<double, uint64_t>(doubles)), double_bits);
+    EXPECT_EQ((SortedBits<float, uint32_t>(floats)), float_bits);
+  }
+
+  vector<double> zeros(16, 0.0);
+  fill(zeros.begin(), zeros.begin() + 8, -0.0);
+  sort::SmallSort(zeros.data(), zeros.size());
+  EXPECT_EQ(count_if(zeros.begin(), zeros.end(), [](double x) { return signbit(x); }), 8);
+
+  vector<float> values(40, 0.0f);
+  fill(values.begin(), values.begin() + 15, -0.0f);
+  shuffle(values.begin(), values.end(), gen);
+  sort::Quick(values);
+  EXPECT_EQ(count_if(values.begin(), values.end(), [](float x) { return signbit(x); }), 15);
+}
+
+TEST(test_algo_sort, quicksort_uses_small_sort_for_partitions)
+{
+  vector<int> numbers(1000);
+  mt19937 gen(3);
+  generate(numbers.begin(), numbers.end(), [&gen]() { return static_cast<int>(gen() % 1000); });
+  sort::Quick(numbers);
+  EXPECT_TRUE(is_sorted(numbers.begin(), numbers.end()));
+}
+
+TEST(test_algo_sort, quicksort_pivot_at_end_of_range)
+{
+  // With sorted input every pivot lands on the last element, leaving an empty right partition.
+  for (size_t n : {2u, 3u, 17u, 200u}) {
+    vector<int> numbers(n);
+    iota(numbers.begin(), numbers.end(), 0);
+    numbers.shrink_to_fit();
+    sort::Quick(numbers);
+    EXPECT_TRUE(is_sorted(numbers.begin(), numbers.end()));
+  }
+  vector<int> one{7};
+  sort::Quick(one);
+  EXPECT_EQ(one, vector<int>{7});
+}
+
+/////////////////////////////////////////////
+/// Comparators and projections
+/////////////////////////////////////////////
+
+namespace {
+struct Planet {
+  std::string name;
+  double mass;
+  int64_t moons;
+};
+
+const vector<Planet> kPlanets{{"Mercury", 0.055, 0}, {"Venus", 0.815, 0}, {"Earth", 1.0, 1}, {"Mars", 0.107, 2},
+                              {"Jupiter", 317.8, 95}, {"Saturn", 95.2, 146}, {"Uranus", 14.5, 28}, {"Neptune", 17.1, 16}};
+}// namespace
+
+TEST(test_algo_sort, sort_structs_with_projection)
+{
+  auto by_mass = [](const Planet& a, const Planet& b) { return a.mass < b.mass; };
+
+  vector<Planet> planets{kPlanets};
+  sort::Quick(planets, std::less<>{}, &Planet::mass);
+  EXPECT_TRUE(is_sorted(planets.begin(), planets.end(), by_mass));
+
+  planets = kPlanets;
+  sort::Heap(planets, std::less<>{}, &Planet::mass);
+  EXPECT_TRUE(is_sorted(planets.begin(), planets.end(), by_mass));
+
+  planets = kPlanets;
+  sort::Insertion(planets, std::less<>{}, &Planet::mass);
+  EXPECT_TRUE(is_sorted(planets.begin(), planets.end(), by_mass));
+
+  planets = kPlanets;
+  sort::Bubble(planets, std::less<>{}, &Planet::mass);
+  EXPECT_TRUE(is_sorted(planets.begin(), planets.end(), by_mass));
+
+  planets = kPlanets;
+  sort::Gnome(planets, std::less<>{}, &Planet::mass);
+  EXPECT_TRUE(is_sorted(planets.begin(), planets.end(), by_mass));
+
+  planets = kPlanets;
+  sort::Bucket(planets, &Planet::mass);
+  EXPECT_TRUE(is_sorted(planets.begin(), planets.end(), by_mass));
+}
+
+TEST(test_algo_sort, merge_sort_is_stable)
+{
+  vector<Planet> planets{kPlanets};
+  sort::Merge(planets, std::greater<>{}, [](const Planet& p) { return p.moons == 0 ? 0 : 1; });
+
+  vector<std::string> names;
+  for (const auto& p : planets) names.push_back(p.name);
+  vector<std::string> expected{"Earth", "Mars", "Jupiter", "Saturn", "Uranus", "Neptune", "Mercury", "Venus"};
+  EXPECT_EQ(names, expected);
+}
+
+TEST(test_algo_sort, sort_other_types_and_ranges)
+{
+  vector<float> floats{3.5f, -1.0f, 2.25f, 0.0f};
+  sort::Quick(floats);
+  EXPECT_TRUE(is_sorted(floats.begin(), floats.end()));
+
+  vector<int64_t> big(300);
+  mt19937_64 gen(5);
+  generate(big.begin(), big.end(), [&gen]() { return static_cast<int64_t>(gen()); });
+  sort::Quick(big, std::greater<>{});
+  EXPECT_TRUE(is_sorted(big.begin(), big.end(), std::greater<>{}));
+
+  int arr[]{5, 3, 9, 1, 7};
+  sort::Heap(std::begin(arr), std::end(arr));
+  EXPECT_TRUE(is_sorted(std::begin(arr), std::end(arr)));
+
+  // Only the middle part is sorted.
+  vector<int> part{9, 8, 7, 6, 5, 4};
+  sort::Merge(part.begin() + 1, part.end() - 1);
+  EXPECT_EQ(part, (vector<int>{9, 5, 6, 7, 8, 4}));
+}
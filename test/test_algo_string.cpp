@@ -4,6 +4,13 @@
 /// \date 2019-10-13
 /// \link <a href=https://github.com/alex011235/algo>Algo, Github</a>
 ///
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+
 #include "algo.hpp"
 #include "gtest/gtest.h"
 
@@ -74,6 +81,51 @@ TEST(test_algo_string, boyer_more_empty_input)
   EXPECT_EQ(matches.size(), 0);
 }
 
+//NOLINTNEXTLINE
+TEST(test_algo_string, boyer_more_non_overlapping_and_end)
+{
+  const std::string text{"aaaaab"};
+  EXPECT_EQ(algo::string::SearchBoyerMoore(text, "aa"), (vector<int>{0, 2}));
+  EXPECT_EQ(algo::string::SearchBoyerMoore(text, "b"), (vector<int>{5}));
+  EXPECT_EQ(algo::string::SearchBoyerMoore(text, "aaaaab"), (vector<int>{0}));
+}
+
+/////////////////////////////////////////////
+/// Substring search
+/////////////////////////////////////////////
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, substring_search_random_against_std)
+{
+  std::mt19937 gen(33);
+  for (int round = 0; round < 200; round++) {
+    std::uniform_int_distribution<int> letter('a', 'a' + round % 3 + 1);
+    std::string text(gen() % 300, ' ');
+    for (auto& c : text) c = static_cast<char>(letter(gen));
+    std::string pattern(1 + gen() % 12, ' ');
+    for (auto& c : pattern) c = static_cast<char>(letter(gen));
+
+    vector<size_t> expected;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+      expected.push_back(pos);
+    }
+    EXPECT_EQ(algo::string::SearchAll(text, pattern), expected);
+  }
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, substring_searcher_reused)
+{
+  const algo::string::SubstringSearcher searcher{"needle"};
+  const std::string hay(1000, 'n');
+  EXPECT_TRUE(searcher.FindAll(hay).empty());
+  EXPECT_EQ(searcher.FindAll(hay + "needle" + hay + "needle"), (vector<size_t>{1000, 2006}));
+  EXPECT_EQ(searcher.Find("needleneedle", 1), 6U);
+  EXPECT_EQ(searcher.Find("needle", 7), std::string_view::npos);
+  EXPECT_EQ(searcher.Find("need"), std::string_view::npos);
+  EXPECT_TRUE(algo::string::SearchAll("abc", "").empty());
+}
+
 /////////////////////////////////////////////
 /// Longest common substring
 /////////////////////////////////////////////
@@ -132,6 +184,202 @@ TEST(test_algo_string, longest_common_substring_one_char)
   EXPECT_EQ(x, "");
 }
 
+//NOLINTNEXTLINE
+TEST(test_algo_string, longest_common_substring_random_against_dp)
+{
+  std::mt19937 gen(35);
+  for (int round = 0; round < 300; round++) {
+    std::string a(gen() % 40, ' '), b(gen() % 40, ' ');
+    for (auto& c : a) c = static_cast<char>('a' + gen() % (2 + round % 3));
+    for (auto& c : b) c = static_cast<char>('a' + gen() % (2 + round % 3));
+
+    // Longest first, then the earliest end in a.
+    size_t best{0}, end{0};
+    for (size_t i = 0; i < a.size(); i++) {
+      for (size_t j = 0; j < b.size(); j++) {
+        size_t k{0};
+        while (i + k < a.size() && j + k < b.size() && a[i + k] == b[j + k]) k++;
+        if (k > best || (k == best && k > 0 && i + k < end)) {
+          best = k;
+          end = i + k;
+        }
+      }
+    }
+    EXPECT_EQ(algo::string::LongestCommonSubstring(a, b), a.substr(end - best, best)) << a << " " << b;
+  }
+}
+
+/////////////////////////////////////////////
+/// Suffix array
+/////////////////////////////////////////////
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, suffix_array_banana)
+{
+  const algo::string::SuffixArray index{"banana"};
+  EXPECT_EQ(index.Suffixes(), (vector<uint32_t>{5, 3, 1, 0, 4, 2}));
+  EXPECT_EQ(index.Lcp(), (vector<uint32_t>{0, 1, 3, 0, 0, 2}));
+  EXPECT_EQ(index.Count("ana"), 2U);
+  EXPECT_EQ(index.Locate("ana"), (vector<size_t>{1, 3}));
+  EXPECT_EQ(index.Count("nab"), 0U);
+  EXPECT_EQ(index.Count(""), 6U);
+  EXPECT_TRUE(algo::string::BuildSuffixArray("").empty());
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, suffix_array_random_against_naive)
+{
+  std::mt19937 gen(36);
+  for (int round = 0; round < 200; round++) {
+    std::string text(gen() % 300, ' ');
+    for (auto& c : text) c = static_cast<char>(round % 5 == 0 ? 'a' : 'a' + gen() % (1 + round % 4));
+    if (round % 7 == 0) {
+      for (auto& c : text) c = static_cast<char>(gen());
+    }
+    const algo::string::SuffixArray index{text};
+
+    vector<uint32_t> expected(text.size());
+    for (size_t i = 0; i < text.size(); i++) expected[i] = static_cast<uint32_t>(i);
+    const std::string_view view{text};
+    std::sort(expected.begin(), expected.end(), [&](uint32_t a, uint32_t b) { return view.substr(a) < view.substr(b); });
+    ASSERT_EQ(index.Suffixes(), expected);
+
+    for (size_t i = 1; i < text.size(); i++) {
+      size_t k{0};
+      while (expected[i - 1] + k < text.size() && expected[i] + k < text.size()
+             && text[expected[i - 1] + k] == text[expected[i] + k]) {
+        k++;
+      }
+      ASSERT_EQ(index.Lcp()[i], k);
+    }
+
+    const std::string pattern{text.substr(text.size() / 2, 3)};
+    vector<size_t> occurrences;
+    for (size_t pos = text.find(pattern); pos != std::string::npos && !pattern.empty(); pos = text.find(pattern, pos + 1)) {
+      occurrences.push_back(pos);
+    }
+    if (!pattern.empty()) {
+      EXPECT_EQ(index.Locate(pattern), occurrences);
+      EXPECT_EQ(index.Count(pattern), occurrences.size());
+    }
+  }
+}
+
+/////////////////////////////////////////////
+/// FM-index
+/////////////////////////////////////////////
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, fm_index_banana)
+{
+  const algo::string::FmIndex index{"banana", 2};
+  EXPECT_EQ(index.Size(), 6U);
+  EXPECT_EQ(index.Count("ana"), 2U);
+  EXPECT_EQ(index.Locate("ana"), (vector<size_t>{1, 3}));
+  EXPECT_EQ(index.Locate("a"), (vector<size_t>{1, 3, 5}));
+  EXPECT_EQ(index.Count("banana"), 1U);
+  EXPECT_EQ(index.Count("bananas"), 0U);
+  EXPECT_EQ(index.Count("x"), 0U);
+
+  const algo::string::FmIndex empty{""};
+  EXPECT_EQ(empty.Count("a"), 0U);
+  EXPECT_TRUE(empty.Locate("a").empty());
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, fm_index_random_against_suffix_array)
+{
+  std::mt19937 gen(37);
+  for (int round = 0; round < 40; round++) {
+    std::string text(1 + gen() % 2000, ' ');
+    for (auto& c : text) c = static_cast<char>(round % 4 == 0 ? gen() : 'a' + gen() % (1 + round % 4));
+    const algo::string::SuffixArray sa{text};
+    const algo::string::FmIndex index{text, 1u + round % 40};
+
+    for (int q = 0; q < 20; q++) {
+      const size_t length{1 + gen() % 6};
+      std::string pattern{text.substr(gen() % text.size(), length)};
+      if (q % 4 == 0) pattern.back() = static_cast<char>(gen());
+      ASSERT_EQ(index.Count(pattern), sa.Count(pattern)) << pattern;
+      ASSERT_EQ(index.Locate(pattern), sa.Locate(pattern)) << pattern;
+    }
+  }
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, fm_index_save_load_attach)
+{
+  std::string text;
+  for (int i = 0; i < 200; i++) text += "GET /index.html 200\nPOST /login 403\n";
+  const algo::string::FmIndex index{text, 16};
+  const vector<size_t> expected{index.Locate("403")};
+  ASSERT_EQ(expected.size(), 200U);
+
+  const std::string path{"fm_index_test.bin"};
+  ASSERT_TRUE(index.Save(path));
+
+  algo::string::FmIndex loaded;
+  ASSERT_TRUE(loaded.Load(path));
+  EXPECT_EQ(loaded.Locate("403"), expected);
+  EXPECT_EQ(loaded.Bytes(), index.Bytes());
+
+  // The file contents used in place, as from a memory mapped file.
+  std::ifstream file(path, std::ios::binary);
+  vector<uint64_t> buffer(index.Bytes() / sizeof(uint64_t));
+  file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(index.Bytes()));
+  algo::string::FmIndex attached;
+  ASSERT_TRUE(attached.Attach(buffer.data(), index.Bytes()));
+  EXPECT_EQ(attached.Locate("403"), expected);
+  EXPECT_EQ(attached.Count("/login"), 200U);
+
+  EXPECT_FALSE(attached.Attach(buffer.data(), index.Bytes() - 8));
+  EXPECT_EQ(attached.Count("/login"), 200U);
+  EXPECT_FALSE(loaded.Load("no_such_file.bin"));
+  std::remove(path.c_str());
+
+  // Word offsets of the tables in the file: header, counts, starts, zeros, levels, sampled bits, samples.
+  const size_t rows{text.size() + 1};
+  const size_t bit_words{(rows + 63) / 64};
+  const size_t rank_words{bit_words / 8 + 2};
+  const size_t counts{5}, starts{counts + 257}, levels{starts + 256 + 8};
+  const size_t sampled{levels + 8 * (bit_words + rank_words)};
+  const size_t samples{sampled + bit_words + rank_words};
+  auto corrupted = [&buffer](size_t word, uint64_t value) {
+    vector<uint64_t> copy{buffer};
+    copy[word] = value;
+    return copy;
+  };
+  const vector<vector<uint64_t>> corruptions{
+      corrupted(counts + 'A', buffer[counts + 'A'] + 1000),                 // Counts not increasing.
+      corrupted(counts + 256, buffer[counts + 256] - 1),                    // Counts not ending at the row count.
+      corrupted(starts + 'G', buffer[starts + 'G'] + 1),                    // Start of a byte in the text.
+      corrupted(levels + bit_words + 1, buffer[levels + bit_words + 1] + 1),// Rank block.
+      corrupted(levels, buffer[levels] ^ 1u),                               // Bits that disagree with the counts.
+      corrupted(3, buffer[3] + 1),                                          // End marker row.
+      corrupted(sampled, buffer[sampled] ^ 2u),                             // Sampled rows disagree with the count.
+      corrupted(samples, uint64_t{0xFFFFFFFFu} << 32u),                     // Samples past the end of the text.
+  };
+  for (const vector<uint64_t>& words : corruptions) {
+    algo::string::FmIndex bad;
+    EXPECT_FALSE(bad.Attach(words.data(), words.size() * sizeof(uint64_t)));
+    EXPECT_EQ(bad.Size(), 0U);
+  }
+
+  // Texts at the edges of the layout round trip through Attach.
+  const vector<std::string> edges{"", "a", std::string(127, 'x'), std::string("\0a\0b\0", 5)};
+  for (const std::string& edge : edges) {
+    const algo::string::FmIndex built{edge, 3};
+    ASSERT_TRUE(built.Save(path));
+    std::ifstream in(path, std::ios::binary);
+    vector<uint64_t> words(built.Bytes() / sizeof(uint64_t));
+    in.read(reinterpret_cast<char*>(words.data()), static_cast<std::streamsize>(built.Bytes()));
+    algo::string::FmIndex edge_index;
+    ASSERT_TRUE(edge_index.Attach(words.data(), built.Bytes()));
+    EXPECT_EQ(edge_index.Locate("a"), built.Locate("a"));
+    std::remove(path.c_str());
+  }
+}
+
 /////////////////////////////////////////////
 /// Rabin-Karp
 /////////////////////////////////////////////
@@ -170,6 +418,288 @@ TEST(test_algo_string, rabin_karp_not_found_multi)
   EXPECT_EQ(pos.size(), 0);
 }
 
+//NOLINTNEXTLINE
+TEST(test_algo_string, rabin_karp_random_against_search_all)
+{
+  std::mt19937 gen(40);
+  for (int round = 0; round < 200; round++) {
+    std::string text(gen() % 300, 'a');
+    for (char& c : text) {
+      c = static_cast<char>('a' + gen() % 3);
+    }
+    const std::string pattern{text.substr(gen() % (text.size() + 1), 1 + gen() % 4)};
+    vector<int> expected;
+    for (size_t pos : algo::string::SearchAll(text, pattern)) {
+      expected.push_back(static_cast<int>(pos));
+    }
+    EXPECT_EQ(algo::string::SearchRabinKarpSingle(text, pattern), expected);
+  }
+  EXPECT_TRUE(algo::string::SearchRabinKarpSingle("ab", "abc").empty());
+}
+
+/////////////////////////////////////////////
+/// Rolling hashes, chunking and dedup
+/////////////////////////////////////////////
+
+namespace {
+std::string RandomBytes(std::mt19937& gen, size_t n)
+{
+  std::string data(n, '\0');
+  for (char& c : data) {
+    c = static_cast<char>(gen());
+  }
+  return data;
+}
+}// namespace
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, rolling_hashes_match_fresh_windows)
+{
+  std::mt19937 gen(41);
+  const std::string data{RandomBytes(gen, 1000)};
+  const auto byte = [&data](size_t i) { return static_cast<unsigned char>(data[i]); };
+
+  for (size_t window : {1, 7, 64, 65, 100}) {
+    algo::string::RabinHash rabin{window};
+    algo::string::Buzhash buz{window};
+    for (size_t i = 0; i < window; i++) {
+      rabin.Push(byte(i));
+      buz.Push(byte(i));
+    }
+    for (size_t i = window; i < data.size(); i++) {
+      rabin.Roll(byte(i - window), byte(i));
+      buz.Roll(byte(i - window), byte(i));
+      if (i % 97 == 0) {
+        algo::string::RabinHash fresh_rabin{window};
+        algo::string::Buzhash fresh_buz{window};
+        for (size_t j = i + 1 - window; j <= i; j++) {
+          fresh_rabin.Push(byte(j));
+          fresh_buz.Push(byte(j));
+        }
+        EXPECT_EQ(rabin.Hash(), fresh_rabin.Hash());
+        EXPECT_EQ(buz.Hash(), fresh_buz.Hash());
+      }
+    }
+  }
+
+  // Only the last 64 bytes count for the Gear hash.
+  algo::string::GearHash gear_a;
+  algo::string::GearHash gear_b;
+  for (size_t i = 0; i < 100; i++) {
+    gear_a.Roll(byte(i));
+    gear_b.Roll(byte(i + 500));
+  }
+  EXPECT_NE(gear_a.Hash(), gear_b.Hash());
+  for (size_t i = 0; i < 64; i++) {
+    gear_a.Roll(byte(i + 900));
+    gear_b.Roll(byte(i + 900));
+  }
+  EXPECT_EQ(gear_a.Hash(), gear_b.Hash());
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, chunker_sizes_and_shift_resistance)
+{
+  std::mt19937 gen(42);
+  const std::string data{RandomBytes(gen, 1 << 21)};
+  const algo::string::Chunker chunker{4096};
+  EXPECT_EQ(chunker.Min(), 1024U);
+  EXPECT_EQ(chunker.Max(), 32768U);
+
+  const vector<size_t> lengths{chunker.Split(data)};
+  size_t sum{0};
+  for (size_t i = 0; i < lengths.size(); i++) {
+    EXPECT_LE(lengths[i], chunker.Max());
+    if (i + 1 < lengths.size()) {
+      EXPECT_GE(lengths[i], chunker.Min());
+    }
+    sum += lengths[i];
+  }
+  EXPECT_EQ(sum, data.size());
+  const double average{static_cast<double>(data.size()) / static_cast<double>(lengths.size())};
+  EXPECT_GT(average, 2048.0);
+  EXPECT_LT(average, 8192.0);
+
+  // Inserting bytes at the start changes only the first chunks.
+  const std::string shifted{"inserted" + data};
+  const vector<size_t> shifted_lengths{chunker.Split(shifted)};
+  set<std::string> before;
+  size_t offset{0};
+  for (size_t length : lengths) {
+    before.insert(data.substr(offset, length));
+    offset += length;
+  }
+  size_t shared{0};
+  offset = 0;
+  for (size_t length : shifted_lengths) {
+    shared += before.count(shifted.substr(offset, length));
+    offset += length;
+  }
+  EXPECT_GE(shared + 2, lengths.size());
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, sha256_test_vectors)
+{
+  const auto hex = [](std::string_view data) {
+    std::string out;
+    for (uint8_t byte : algo::string::Sha256(data)) {
+      out += "0123456789abcdef"[byte >> 4u];
+      out += "0123456789abcdef"[byte & 15u];
+    }
+    return out;
+  };
+  EXPECT_EQ(hex(""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(hex("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  EXPECT_EQ(hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"),
+            "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+  EXPECT_EQ(hex(std::string(1000000, 'a')), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, dedup_index)
+{
+  std::mt19937 gen(43);
+  const std::string a{RandomBytes(gen, 1 << 20)};
+  std::string b{a};
+  b.insert(b.size() / 2, "a small edit");
+
+  algo::string::DedupIndex index{algo::string::Chunker{4096}};
+  EXPECT_EQ(index.Add(a), 0U);
+  EXPECT_EQ(index.Add(b), 1U);
+  EXPECT_EQ(index.TotalBytes(), a.size() + b.size());
+  EXPECT_LT(index.UniqueBytes(), a.size() + 3 * 32768);
+  EXPECT_GT(index.UniqueBytes(), a.size());
+
+  uint64_t duplicated{0};
+  for (const auto& dup : index.Duplicates()) {
+    EXPECT_EQ(dup.chunk.input, 1U);
+    EXPECT_EQ(dup.original.input, 0U);
+    EXPECT_EQ(b.substr(dup.chunk.offset, dup.chunk.length), a.substr(dup.original.offset, dup.original.length));
+    duplicated += dup.chunk.length;
+  }
+  EXPECT_EQ(duplicated + index.UniqueBytes(), index.TotalBytes());
+
+  // Reading streams gives the same chunks.
+  algo::string::DedupIndex streamed{algo::string::Chunker{4096}};
+  std::istringstream in_a{a};
+  std::istringstream in_b{b};
+  uint32_t id{99};
+  EXPECT_TRUE(streamed.Add(in_a, id));
+  EXPECT_EQ(id, 0U);
+  EXPECT_TRUE(streamed.Add(in_b, id));
+  EXPECT_EQ(id, 1U);
+  EXPECT_EQ(streamed.UniqueBytes(), index.UniqueBytes());
+  ASSERT_EQ(streamed.Duplicates().size(), index.Duplicates().size());
+  for (size_t i = 0; i < index.Duplicates().size(); i++) {
+    EXPECT_EQ(streamed.Duplicates()[i].chunk, index.Duplicates()[i].chunk);
+    EXPECT_EQ(streamed.Duplicates()[i].original, index.Duplicates()[i].original);
+  }
+}
+
+/////////////////////////////////////////////
+/// Aho-Corasick
+/////////////////////////////////////////////
+
+namespace {
+/// Matches ordered by end position, longest first, the order AhoCorasick reports them in.
+vector<algo::string::Match> NaiveMatches(const std::string& text, const vector<std::string>& patterns)
+{
+  vector<algo::string::Match> res;
+  for (size_t i = 0; i < text.size(); i++) {
+    for (size_t p = 0; p < patterns.size(); p++) {
+      if (!patterns[p].empty() && text.compare(i, patterns[p].size(), patterns[p]) == 0) {
+        res.push_back({i, static_cast<uint32_t>(p)});
+      }
+    }
+  }
+  std::sort(res.begin(), res.end(), [&](const auto& a, const auto& b) {
+    const size_t end_a{a.position + patterns[a.pattern].size()};
+    const size_t end_b{b.position + patterns[b.pattern].size()};
+    return end_a != end_b ? end_a < end_b : (a.position != b.position ? a.position < b.position : a.pattern < b.pattern);
+  });
+  return res;
+}
+}// namespace
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, aho_corasick_classic)
+{
+  const vector<std::string> patterns{"he", "she", "his", "hers"};
+  const algo::string::AhoCorasick ac{patterns};
+  const vector<algo::string::Match> expected{{1, 1}, {2, 0}, {2, 3}};
+  EXPECT_EQ(ac.Search("ushers"), expected);
+  EXPECT_TRUE(ac.Contains("ahisb"));
+  EXPECT_FALSE(ac.Contains("hhhh"));
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, aho_corasick_empty)
+{
+  const algo::string::AhoCorasick none{{}};
+  EXPECT_TRUE(none.Search("abc").empty());
+  const algo::string::AhoCorasick empty_pattern{{"", "b"}};
+  EXPECT_EQ(empty_pattern.Search("abc"), (vector<algo::string::Match>{{1, 1}}));
+  EXPECT_TRUE(empty_pattern.Search("").empty());
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, aho_corasick_random_against_naive)
+{
+  std::mt19937 gen(32);
+  for (int round = 0; round < 30; round++) {
+    std::uniform_int_distribution<int> letter('a', 'a' + round % 4 + 1);
+    std::uniform_int_distribution<int> length(1, 6);
+    vector<std::string> patterns(1 + round * 3);
+    for (auto& p : patterns) {
+      p.resize(length(gen));
+      for (auto& c : p) c = static_cast<char>(letter(gen));
+    }
+    patterns.push_back(patterns.front());// Duplicate pattern.
+    std::string text(500, ' ');
+    for (auto& c : text) c = static_cast<char>(letter(gen) + (gen() % 10 == 0));
+
+    const algo::string::AhoCorasick ac{patterns};
+    const auto expected = NaiveMatches(text, patterns);
+    EXPECT_EQ(ac.Search(text), expected);
+    EXPECT_EQ(ac.Contains(text), !expected.empty());
+  }
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, aho_corasick_all_bytes)
+{
+  vector<std::string> patterns;
+  std::string text;
+  for (int b = 0; b < 256; b++) {
+    patterns.emplace_back(std::string{static_cast<char>(b), static_cast<char>(255 - b)});
+    text.push_back(static_cast<char>(b));
+  }
+  const algo::string::AhoCorasick ac{patterns};
+  const vector<algo::string::Match> expected{{127, 127}};
+  EXPECT_EQ(ac.Search(text), expected);
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, aho_corasick_stream_chunks)
+{
+  const vector<std::string> patterns{"error", "warn", "rror: disk", "k full"};
+  const std::string text{"info ok\nwarn: low\nerror: disk full\nerror"};
+  const algo::string::AhoCorasick ac{patterns};
+  const auto expected = ac.Search(text);
+  EXPECT_EQ(expected, NaiveMatches(text, patterns));
+
+  for (size_t chunk = 1; chunk <= 7; chunk++) {
+    algo::string::AhoCorasick::Scanner scanner{ac};
+    vector<algo::string::Match> matches;
+    for (size_t i = 0; i < text.size(); i += chunk) {
+      scanner.Feed(std::string_view{text}.substr(i, chunk), matches);
+    }
+    EXPECT_EQ(matches, expected);
+    EXPECT_EQ(scanner.Offset(), text.size());
+  }
+}
+
 /////////////////////////////////////////////
 /// Heap's algorithm
 /////////////////////////////////////////////
@@ -184,6 +714,73 @@ TEST(test_algo_string, heaps_generate)
   EXPECT_TRUE(find(perms.begin(), perms.end(), "MEALT") != perms.end());
 }
 
+//NOLINTNEXTLINE
+TEST(test_algo_string, permutation_generator_lexicographic)
+{
+  std::string expected{"AABC\xff"};
+  algo::string::PermutationGenerator gen{"\xff" "CABA"};
+  uint64_t rank{0};
+  while (gen.Next()) {
+    EXPECT_EQ(gen.Current(), expected);
+    EXPECT_EQ(algo::string::PermutationRank(gen.Current()), rank);
+    EXPECT_EQ(algo::string::PermutationUnrank("ABCA\xff", rank), expected);
+    std::next_permutation(expected.begin(), expected.end(), [](unsigned char a, unsigned char b) { return a < b; });
+    rank++;
+  }
+  EXPECT_EQ(rank, 60U);
+  EXPECT_EQ(algo::string::CountPermutations("ABCA\xff"), 60U);
+  EXPECT_TRUE(algo::string::PermutationUnrank("ABCA\xff", 60).empty());
+
+  algo::string::PermutationGenerator empty{""};
+  EXPECT_TRUE(empty.Next());
+  EXPECT_FALSE(empty.Next());
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, permutation_rank_large)
+{
+  const std::string letters{"abcdefghijklmnopqrst"};
+  EXPECT_EQ(algo::string::CountPermutations(letters), 2432902008176640000U);
+  EXPECT_EQ(algo::string::CountPermutations(letters + "u"), 0U);
+  EXPECT_EQ(algo::string::PermutationRank(letters + "u"), UINT64_MAX);
+  EXPECT_EQ(algo::string::CountPermutations(std::string(40, 'a') + std::string(20, 'b')), 4191844505805495U);
+
+  const std::string last{"tsrqponmlkjihgfedcba"};
+  EXPECT_EQ(algo::string::PermutationRank(last), 2432902008176639999U);
+  EXPECT_EQ(algo::string::PermutationUnrank(letters, 2432902008176639999U), last);
+
+  std::mt19937_64 gen(39);
+  for (int i = 0; i < 100; i++) {
+    const uint64_t rank{gen() % 2432902008176640000U};
+    EXPECT_EQ(algo::string::PermutationRank(algo::string::PermutationUnrank(letters, rank)), rank);
+  }
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, permutation_generator_ranges)
+{
+  const std::string str{"mississippi"};
+  const uint64_t total{algo::string::CountPermutations(str)};
+  EXPECT_EQ(total, 34650U);
+
+  std::vector<std::string> all;
+  algo::string::PermutationGenerator gen{str};
+  while (gen.Next()) {
+    all.emplace_back(gen.Current());
+  }
+  ASSERT_EQ(all.size(), total);
+
+  std::vector<std::string> joined;
+  const uint64_t step{1000};
+  for (uint64_t first = 0; first < total + step; first += step) {
+    algo::string::PermutationGenerator range{str, first, step};
+    while (range.Next()) {
+      joined.emplace_back(range.Current());
+    }
+  }
+  EXPECT_EQ(joined, all);
+}
+
 /////////////////////////////////////////////
 /// Rotated string
 /////////////////////////////////////////////
@@ -214,6 +811,112 @@ TEST(test_algo_string, compressed_string_standard)
   EXPECT_EQ(algo::string::Compress(str), "ab3cd2efg11h");
 }
 
+/////////////////////////////////////////////
+/// Run-length codec
+/////////////////////////////////////////////
+
+namespace {
+std::string RunnyData(std::mt19937& gen, size_t n)
+{
+  std::string data;
+  while (data.size() < n) {
+    const auto c = static_cast<char>(gen() % 4 == 0 ? gen() : 'a' + gen() % 3);
+    data.append(gen() % 3 == 0 ? 1 + gen() % 100 : 1 + gen() % 3, c);
+  }
+  return data;
+}
+}// namespace
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, rle_round_trip)
+{
+  std::mt19937 gen(38);
+  for (size_t n : {0, 1, 2, 3, 17, 1000, 200000}) {
+    const std::string data{RunnyData(gen, n)};
+    const std::string encoded{algo::string::RleEncode(data)};
+    std::string decoded;
+    ASSERT_TRUE(algo::string::RleDecode(encoded, decoded));
+    EXPECT_EQ(decoded, data);
+  }
+
+  const std::string runs(1000000, 'x');
+  EXPECT_EQ(algo::string::RleEncode(runs).size(), 4U);// Three byte varint header and the byte.
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, rle_format)
+{
+  // Literal "ab", run of five c, literal "dd".
+  const std::string encoded{algo::string::RleEncode("abcccccdd")};
+  EXPECT_EQ(encoded, (std::string{4, 'a', 'b', 11, 'c', 4, 'd', 'd'}));
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, rle_chunking_does_not_change_the_output)
+{
+  std::mt19937 gen(39);
+  const std::string data{RunnyData(gen, 5000)};
+  const std::string expected{algo::string::RleEncode(data)};
+
+  for (size_t chunk : {1, 2, 3, 7, 64, 1000}) {
+    algo::string::RleEncoder encoder;
+    std::string encoded;
+    for (size_t i = 0; i < data.size(); i += chunk) {
+      encoder.Feed(std::string_view{data}.substr(i, chunk), encoded);
+    }
+    encoder.Finish(encoded);
+    EXPECT_EQ(encoded, expected);
+
+    algo::string::RleDecoder decoder;
+    std::string decoded;
+    for (size_t i = 0; i < encoded.size(); i += chunk) {
+      ASSERT_TRUE(decoder.Feed(std::string_view{encoded}.substr(i, chunk), decoded));
+    }
+    EXPECT_TRUE(decoder.Finish());
+    EXPECT_EQ(decoded, data);
+  }
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, rle_malformed)
+{
+  std::string out;
+  EXPECT_FALSE(algo::string::RleDecode(std::string{6, 'a', 'b'}, out));                  // Truncated literal.
+  EXPECT_FALSE(algo::string::RleDecode(std::string{7}, out));                            // Run without its byte.
+  EXPECT_FALSE(algo::string::RleDecode(std::string{0}, out));                            // Empty token.
+  EXPECT_FALSE(algo::string::RleDecode(std::string(11, static_cast<char>(0xff)), out));  // Varint too long.
+  const std::string huge_run{"\x81\x80\x80\x80\x80\x80\x80\x80\x40x", 10};  // A run of 2^61 bytes.
+  EXPECT_FALSE(algo::string::RleDecode(huge_run, out));
+  EXPECT_FALSE(algo::string::RleDecode(std::string{9, 'x'}, out, 3));                    // Run over the limit.
+  EXPECT_TRUE(algo::string::RleDecode(std::string{9, 'x'}, out, 4));
+  EXPECT_EQ(out, "xxxx");
+  std::ostringstream stream;
+  algo::string::RleDecoder limited{1000};
+  EXPECT_FALSE(limited.Feed(huge_run, stream));
+  EXPECT_TRUE(stream.str().empty());
+  EXPECT_TRUE(algo::string::RleDecode("", out));
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, rle_streams)
+{
+  std::mt19937 gen(40);
+  const std::string data{RunnyData(gen, 100000) + std::string(50000, 'z')};
+  std::istringstream in{data};
+  std::ostringstream encoded;
+  ASSERT_TRUE(algo::string::RleEncode(in, encoded, 4096));
+  EXPECT_EQ(encoded.str(), algo::string::RleEncode(data));
+
+  std::istringstream encoded_in{encoded.str()};
+  std::ostringstream decoded;
+  ASSERT_TRUE(algo::string::RleDecode(encoded_in, decoded, 333));
+  EXPECT_EQ(decoded.str(), data);
+
+  std::istringstream truncated{encoded.str().substr(0, encoded.str().size() - 1)};
+  std::ostringstream ignored;
+  EXPECT_FALSE(algo::string::RleDecode(truncated, ignored, 333));
+}
+
 /////////////////////////////////////////////
 /// Unique chars
 /////////////////////////////////////////////
@@ -246,6 +949,85 @@ TEST(test_algo_string, levest_dist_standard)
 /// Hamming distance
 /////////////////////////////////////////////
 
+namespace {
+int LevenshteinReference(const std::string& a, const std::string& b)
+{
+  vector<int> row(b.size() + 1);
+  for (size_t j = 0; j <= b.size(); j++) row[j] = static_cast<int>(j);
+  for (size_t i = 1; i <= a.size(); i++) {
+    int diag{row[0]};
+    row[0] = static_cast<int>(i);
+    for (size_t j = 1; j <= b.size(); j++) {
+      const int up{row[j]};
+      row[j] = std::min({row[j] + 1, row[j - 1] + 1, diag + (a[i - 1] != b[j - 1])});
+      diag = up;
+    }
+  }
+  return row[b.size()];
+}
+
+std::string RandomWord(std::mt19937& gen, size_t max_length, int letters)
+{
+  std::string word(gen() % (max_length + 1), ' ');
+  for (auto& c : word) c = static_cast<char>('a' + gen() % letters);
+  return word;
+}
+}// namespace
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, levenshtein_random_long_words)
+{
+  std::mt19937 gen(34);
+  for (int round = 0; round < 300; round++) {
+    const std::string a{RandomWord(gen, round < 150 ? 70 : 300, 2 + round % 4)};
+    const std::string b{RandomWord(gen, round < 150 ? 70 : 300, 2 + round % 4)};
+    EXPECT_EQ(algo::string::metric::Levenshtein(a, b), LevenshteinReference(a, b)) << a << " " << b;
+  }
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, levenshtein_bounded)
+{
+  EXPECT_EQ(algo::string::metric::LevenshteinBounded("book", "back", 2), 2);
+  EXPECT_EQ(algo::string::metric::LevenshteinBounded("book", "back", 1), 2);
+  EXPECT_EQ(algo::string::metric::LevenshteinBounded("book", "", 1), 2);
+  EXPECT_EQ(algo::string::metric::LevenshteinBounded("book", "back", -1), -1);
+
+  std::mt19937 gen(35);
+  for (int round = 0; round < 300; round++) {
+    std::string a{RandomWord(gen, 400, 4)};
+    std::string b{a};
+    // A few edits, so that small cutoffs are sometimes met.
+    for (int e = gen() % 8; e > 0 && !b.empty(); e--) b[gen() % b.size()] = 'z';
+    if (round % 3 == 0) b = b.substr(std::min<size_t>(gen() % 4, b.size()));
+    const int expected{LevenshteinReference(a, b)};
+    for (int k : {0, 1, 3, 7, 20, 500}) {
+      EXPECT_EQ(algo::string::metric::LevenshteinBounded(a, b, k), std::min(expected, k + 1));
+    }
+  }
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, levenshtein_batch)
+{
+  std::mt19937 gen(36);
+  for (size_t query_length : {0, 5, 40, 64, 90}) {
+    std::string query(query_length, 'a');
+    for (auto& c : query) c = static_cast<char>('a' + gen() % 3);
+    vector<std::string> candidates(23);
+    for (auto& c : candidates) c = RandomWord(gen, 80, 3);
+
+    const vector<int> all{algo::string::metric::LevenshteinBatch(query, candidates)};
+    const vector<int> bounded{algo::string::metric::LevenshteinBatch(query, candidates, 30)};
+    ASSERT_EQ(all.size(), candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++) {
+      const int expected{LevenshteinReference(query, candidates[i])};
+      EXPECT_EQ(all[i], expected);
+      EXPECT_EQ(bounded[i], std::min(expected, 31));
+    }
+  }
+}
+
 //NOLINTNEXTLINE
 TEST(test_algo_string, test_hamming_distance)
 {
@@ -307,4 +1089,105 @@ TEST(test_algo_string, test_jaro_winkler)
   jw = algo::string::metric::JaroWinkler("dwayne", "duane");
   EXPECT_GT(jw, 0.839);
   EXPECT_LT(jw, 0.841);
-}
\ No newline at end of file
+}
+namespace {
+/// The original implementations, the rewritten ones must give bitwise equal scores.
+double DiceReference(const std::string& word_a, const std::string& word_b)
+{
+  std::vector<std::string> bigrams_a, bigrams_b;
+  for (size_t i = 0; i + 1 < word_a.size(); i++) bigrams_a.emplace_back(std::string{word_a[i], word_a[i + 1]});
+  for (size_t i = 0; i + 1 < word_b.size(); i++) bigrams_b.emplace_back(std::string{word_b[i], word_b[i + 1]});
+  int intersect{0};
+  for (const auto& bigram : bigrams_a) {
+    if (find(bigrams_b.begin(), bigrams_b.end(), bigram) != bigrams_b.end()) intersect++;
+  }
+  return 2.0 * intersect / static_cast<double>(bigrams_a.size() + bigrams_b.size());
+}
+
+double JaroWinklerReference(const std::string& word_a, const std::string& word_b)
+{
+  if (word_a == word_b) return 1.0;
+  double max_dist = std::floor(std::max(word_a.size(), word_b.size()) / 2.0) - 1.0;
+  std::string wa{word_a}, wb{word_b};
+  if (word_b.size() < word_a.size()) {
+    wa = word_b;
+    wb = word_a;
+  }
+  std::vector<std::pair<int, int>> match;
+  for (int i = 0; i < static_cast<int>(wa.size()); i++) {
+    for (int j = 0; j < static_cast<int>(wb.size()); j++) {
+      if (wa[i] == wb[j] && std::abs(i - j) <= max_dist) {
+        match.emplace_back(i, j);
+        break;
+      }
+    }
+  }
+  auto m = static_cast<double>(match.size());
+  double t{0.0};
+  for (const auto& mt : match) {
+    if (mt.first > mt.second) t += 1.0;
+  }
+  double jaro{m == 0 ? 0.0 : 1.0 / 3.0 * (m / wa.size() + m / wb.size() + (m - t) / m)};
+  int l{0};
+  int sz = static_cast<int>(std::min(word_a.size(), word_b.size()));
+  for (int i = 0; i < std::min(4, sz) && word_a[i] == word_b[i]; i++) l++;
+  return jaro + l * 0.1 * (1.0 - jaro);
+}
+
+vector<std::string> RandomNames(std::mt19937& gen, size_t count, size_t max_length)
+{
+  vector<std::string> names(count);
+  for (auto& name : names) {
+    name.resize(2 + gen() % (max_length - 1));
+    for (auto& c : name) c = static_cast<char>('a' + gen() % 5);
+  }
+  return names;
+}
+}// namespace
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, dice_and_jaro_winkler_match_reference)
+{
+  std::mt19937 gen(37);
+  for (const auto& [a, b] : {std::pair<std::string, std::string>{"aaa", "aa"}, {"ab", "ba"}, {"x", "xy"}}) {
+    EXPECT_EQ(algo::string::metric::Dice(a, b), DiceReference(a, b));
+    EXPECT_EQ(algo::string::metric::JaroWinkler(a, b), JaroWinklerReference(a, b));
+  }
+  const vector<std::string> words{RandomNames(gen, 200, 150)};
+  for (size_t i = 0; i + 1 < words.size(); i++) {
+    EXPECT_EQ(algo::string::metric::Dice(words[i], words[i + 1]), DiceReference(words[i], words[i + 1]));
+    EXPECT_EQ(algo::string::metric::JaroWinkler(words[i], words[i + 1]),
+              JaroWinklerReference(words[i], words[i + 1]));
+  }
+}
+
+//NOLINTNEXTLINE
+TEST(test_algo_string, similarity_index_against_brute_force)
+{
+  using algo::string::metric::Similarity;
+  std::mt19937 gen(38);
+  const vector<std::string> dictionary{RandomNames(gen, 800, 12)};
+  const algo::string::metric::SimilarityIndex index{dictionary};
+  const vector<std::string> queries{RandomNames(gen, 30, 12)};
+
+  for (Similarity similarity : {Similarity::Dice, Similarity::JaroWinkler}) {
+    for (double threshold : {0.0, 0.5, 0.8, 0.9}) {
+      const auto batch = index.Search(queries, threshold, similarity, 3);
+      ASSERT_EQ(batch.size(), queries.size());
+      for (size_t q = 0; q < queries.size(); q++) {
+        vector<size_t> expected;
+        for (size_t i = 0; i < dictionary.size(); i++) {
+          const double score{similarity == Similarity::Dice ? DiceReference(queries[q], dictionary[i])
+                                                            : JaroWinklerReference(queries[q], dictionary[i])};
+          if (score >= threshold) expected.push_back(i);
+        }
+        const auto hits = index.Search(queries[q], threshold, similarity);
+        vector<size_t> found;
+        for (const auto& hit : hits) found.push_back(hit.index);
+        EXPECT_EQ(found, expected);
+        ASSERT_EQ(batch[q].size(), hits.size());
+        for (size_t h = 0; h < hits.size(); h++) EXPECT_EQ(batch[q][h].score, hits[h].score);
+      }
+    }
+  }
+}